@@ -0,0 +1,142 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "benchmark.h"
+#include "simd.h"
+#include "host/audioconverter.h"
+#include "host/audiometer.h"
+#include "scripts/Lexer.h"
+#include "scripts/ScriptScheduler.h"
+#include "ui/TaskManager.h"
+#include "video/eepromsimulator.h"
+#include "video/framediff.h"
+#include "video/framesource.h"
+#include "video/framescaler.h"
+#include "video/mjpegdecoder.h"
+#include "video/imagesearch.h"
+#include "video/pixelsearch.h"
+
+#include <QDebug>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <new>
+
+namespace {
+
+// A relaxed increment per allocation, so the benchmarks can count them
+std::atomic<quint64> allocationCount{0};
+
+}
+
+void *operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept
+{
+    std::free(memory);
+}
+
+namespace Benchmark {
+
+namespace {
+
+const std::map<QString, std::function<void()>> &registry()
+{
+    static const std::map<QString, std::function<void()>> benchmarks = {
+        {"firmware", &EepromSimulator::runBenchmark},
+        {"framediff", &FrameDiff::runBenchmark},
+        {"imagesearch", &ImageSearch::runBenchmark},
+        {"pixelsearch", &PixelSearch::runBenchmark},
+        {"pipeline", &FrameSource::runBenchmark},
+        {"mjpeg", &MjpegDecoder::runBenchmark},
+        {"present", &FrameScaler::runBenchmark},
+        {"audioconvert", &AudioConverter::runBenchmark},
+        {"audiometer", &AudioMeter::runBenchmark},
+        {"lexer", &Lexer::runBenchmark},
+        {"scheduler", &ScriptScheduler::runBenchmark},
+        {"taskmanager", &TaskManager::runBenchmark},
+    };
+    return benchmarks;
+}
+
+}
+
+quint64 allocations()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+QStringList suites()
+{
+    QStringList names;
+    for (const auto &entry : registry()) {
+        names << entry.first;
+    }
+    return names;
+}
+
+int run(const QString &requested)
+{
+    QStringList names = requested.split(',', Qt::SkipEmptyParts);
+    if (names.contains("all")) {
+        names = suites();
+    }
+
+    qInfo().noquote() << "Benchmark, best simd level:" << Simd::levelName(Simd::bestLevel());
+    int exitCode = 0;
+    for (const QString &name : names) {
+        auto it = registry().find(name.trimmed());
+        if (it == registry().end()) {
+            qWarning().noquote() << "Unknown benchmark" << name << "available:" << suites().join(", ");
+            exitCode = 1;
+            continue;
+        }
+        it->second();
+    }
+    return exitCode;
+}
+
+}
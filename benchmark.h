@@ -0,0 +1,47 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QString>
+#include <QStringList>
+
+/*
+ * Micro benchmarks for the hot paths, run from the command line with
+ *     openterfaceQT --benchmark <suite>[,<suite>...]
+ * or "--benchmark all". Results are printed through qInfo and the process
+ * exits without showing the main window.
+ */
+namespace Benchmark {
+
+QStringList suites();
+
+// Returns the process exit code
+int run(const QString &suites);
+
+// Heap allocations through the global operator new since the process started
+quint64 allocations();
+
+}
+
+#endif // BENCHMARK_H
@@ -97,7 +97,7 @@ public:
     void setToolbarHeight(int height) { toolbarHeight = height; }
 
 private:
-    GlobalVar() : input_width(1920), input_height(1080), capture_width(1920), capture_height(1080), capture_fps(30) {} // Private constructor
+    GlobalVar() : input_width(1920), input_height(1080), input_fps(0), capture_width(1920), capture_height(1080), capture_fps(30) {} // Private constructor
     ~GlobalVar() {} // Private destructor
 
     // Prevent copying
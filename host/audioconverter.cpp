@@ -0,0 +1,682 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "audioconverter.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+// Filter cutoff as a fraction of the lower Nyquist frequency
+const double CUTOFF = 0.86;
+// Kaiser window shape, about 75 dB stopband at TAPS taps
+const double KAISER_BETA = 7.5;
+const int MAX_CHANNELS = 8;
+
+using DecodeFn = void (*)(const char *, float *, qsizetype);
+using EncodeFn = void (*)(const float *, char *, qsizetype);
+using DotFn = float (*)(const float *, const float *, int);
+
+void decodeUInt8(const char *src, float *dst, qsizetype count)
+{
+    const quint8 *in = reinterpret_cast<const quint8 *>(src);
+    for (qsizetype i = 0; i < count; i++) {
+        dst[i] = (int(in[i]) - 128) * (1.0f / 128.0f);
+    }
+}
+
+void decodeInt16Scalar(const char *src, float *dst, qsizetype count)
+{
+    const qint16 *in = reinterpret_cast<const qint16 *>(src);
+    for (qsizetype i = 0; i < count; i++) {
+        dst[i] = in[i] * (1.0f / 32768.0f);
+    }
+}
+
+void decodeInt32Scalar(const char *src, float *dst, qsizetype count)
+{
+    const qint32 *in = reinterpret_cast<const qint32 *>(src);
+    for (qsizetype i = 0; i < count; i++) {
+        dst[i] = float(in[i]) * (1.0f / 2147483648.0f);
+    }
+}
+
+void decodeFloat(const char *src, float *dst, qsizetype count)
+{
+    memcpy(dst, src, size_t(count) * sizeof(float));
+}
+
+void encodeUInt8(const float *src, char *dst, qsizetype count)
+{
+    quint8 *out = reinterpret_cast<quint8 *>(dst);
+    for (qsizetype i = 0; i < count; i++) {
+        out[i] = quint8(std::lrint(qBound(0.0f, src[i] * 128.0f + 128.0f, 255.0f)));
+    }
+}
+
+void encodeInt16Scalar(const float *src, char *dst, qsizetype count)
+{
+    qint16 *out = reinterpret_cast<qint16 *>(dst);
+    for (qsizetype i = 0; i < count; i++) {
+        out[i] = qint16(std::lrint(qBound(-32768.0f, src[i] * 32768.0f, 32767.0f)));
+    }
+}
+
+// The largest float below 2^31, a full scale positive sample must not wrap
+const float INT32_CEILING = 2147483520.0f;
+
+void encodeInt32Scalar(const float *src, char *dst, qsizetype count)
+{
+    qint32 *out = reinterpret_cast<qint32 *>(dst);
+    for (qsizetype i = 0; i < count; i++) {
+        out[i] = qint32(std::lrint(qBound(-2147483648.0f, src[i] * 2147483648.0f, INT32_CEILING)));
+    }
+}
+
+void encodeFloat(const float *src, char *dst, qsizetype count)
+{
+    memcpy(dst, src, size_t(count) * sizeof(float));
+}
+
+float dotScalar(const float *a, const float *b, int n)
+{
+    // Four sums so the compiler can keep them in one vector register
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += a[i] * b[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef OPF_HAVE_SSE2
+void decodeInt16Sse2(const char *src, float *dst, qsizetype count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+        // Duplicate every sample into a 32 bit lane, the arithmetic shift sign extends it
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    decodeInt16Scalar(src + i * 2, dst + i, count - i);
+}
+
+void decodeInt32Sse2(const char *src, float *dst, qsizetype count)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    decodeInt32Scalar(src + i * 4, dst + i, count - i);
+}
+
+void encodeInt16Sse2(const float *src, char *dst, qsizetype count)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 low = _mm_set1_ps(-32768.0f);
+    const __m128 high = _mm_set1_ps(32767.0f);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), low), high);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), low), high);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 2), packed);
+    }
+    encodeInt16Scalar(src + i, dst + i * 2, count - i);
+}
+
+void encodeInt32Sse2(const float *src, char *dst, qsizetype count)
+{
+    const __m128 scale = _mm_set1_ps(2147483648.0f);
+    const __m128 low = _mm_set1_ps(-2147483648.0f);
+    const __m128 high = _mm_set1_ps(INT32_CEILING);
+    qsizetype i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), low), high);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), _mm_cvtps_epi32(a));
+    }
+    encodeInt32Scalar(src + i, dst + i * 4, count - i);
+}
+
+float dotSse2(const float *a, const float *b, int n)
+{
+    __m128 s0 = _mm_setzero_ps();
+    __m128 s1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    s0 = _mm_add_ps(s0, s1);
+    s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+    s0 = _mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1));
+    return _mm_cvtss_f32(s0) + dotScalar(a + i, b + i, n - i);
+}
+#endif
+
+#ifdef OPF_HAVE_AVX2
+OPF_TARGET_AVX2
+void decodeInt16Avx2(const char *src, float *dst, qsizetype count)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+    qsizetype i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2)));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2 + 16)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+    decodeInt16Scalar(src + i * 2, dst + i, count - i);
+}
+
+OPF_TARGET_AVX2
+void decodeInt32Avx2(const char *src, float *dst, qsizetype count)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    decodeInt32Scalar(src + i * 4, dst + i, count - i);
+}
+
+OPF_TARGET_AVX2
+void encodeInt16Avx2(const float *src, char *dst, qsizetype count)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 low = _mm256_set1_ps(-32768.0f);
+    const __m256 high = _mm256_set1_ps(32767.0f);
+    qsizetype i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), low), high);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), low), high);
+        // Packing works per 128 bit lane, put the four quarters back in order
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 2), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    encodeInt16Scalar(src + i, dst + i * 2, count - i);
+}
+
+OPF_TARGET_AVX2
+void encodeInt32Avx2(const float *src, char *dst, qsizetype count)
+{
+    const __m256 scale = _mm256_set1_ps(2147483648.0f);
+    const __m256 low = _mm256_set1_ps(-2147483648.0f);
+    const __m256 high = _mm256_set1_ps(INT32_CEILING);
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), low), high);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), _mm256_cvtps_epi32(a));
+    }
+    encodeInt32Scalar(src + i, dst + i * 4, count - i);
+}
+
+OPF_TARGET_AVX2
+float dotAvx2(const float *a, const float *b, int n)
+{
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    s0 = _mm256_add_ps(s0, s1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    // The tail stays in this function, calling the legacy SSE encoded scalar
+    // kernel with the upper halves dirty costs a state transition every call
+    float tail = 0;
+    for (; i < n; i++) {
+        tail += a[i] * b[i];
+    }
+    return _mm_cvtss_f32(s) + tail;
+}
+#endif
+
+DecodeFn decodeFor(QAudioFormat::SampleFormat format, Simd::Level level)
+{
+    switch (format) {
+    case QAudioFormat::UInt8:
+        return decodeUInt8;
+    case QAudioFormat::Int16:
+#ifdef OPF_HAVE_AVX2
+        if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+            return decodeInt16Avx2;
+        }
+#endif
+#ifdef OPF_HAVE_SSE2
+        if (level != Simd::Level::Scalar) {
+            return decodeInt16Sse2;
+        }
+#endif
+        return decodeInt16Scalar;
+    case QAudioFormat::Int32:
+#ifdef OPF_HAVE_AVX2
+        if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+            return decodeInt32Avx2;
+        }
+#endif
+#ifdef OPF_HAVE_SSE2
+        if (level != Simd::Level::Scalar) {
+            return decodeInt32Sse2;
+        }
+#endif
+        return decodeInt32Scalar;
+    case QAudioFormat::Float:
+        return decodeFloat;
+    default:
+        Q_UNUSED(level);
+        return nullptr;
+    }
+}
+
+EncodeFn encodeFor(QAudioFormat::SampleFormat format, Simd::Level level)
+{
+    switch (format) {
+    case QAudioFormat::UInt8:
+        return encodeUInt8;
+    case QAudioFormat::Int16:
+#ifdef OPF_HAVE_AVX2
+        if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+            return encodeInt16Avx2;
+        }
+#endif
+#ifdef OPF_HAVE_SSE2
+        if (level != Simd::Level::Scalar) {
+            return encodeInt16Sse2;
+        }
+#endif
+        return encodeInt16Scalar;
+    case QAudioFormat::Int32:
+#ifdef OPF_HAVE_AVX2
+        if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+            return encodeInt32Avx2;
+        }
+#endif
+#ifdef OPF_HAVE_SSE2
+        if (level != Simd::Level::Scalar) {
+            return encodeInt32Sse2;
+        }
+#endif
+        return encodeInt32Scalar;
+    case QAudioFormat::Float:
+        return encodeFloat;
+    default:
+        Q_UNUSED(level);
+        return nullptr;
+    }
+}
+
+DotFn dotFor(Simd::Level level)
+{
+#ifdef OPF_HAVE_AVX2
+    if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+        return dotAvx2;
+    }
+#endif
+#ifdef OPF_HAVE_SSE2
+    if (level != Simd::Level::Scalar) {
+        return dotSse2;
+    }
+#endif
+    Q_UNUSED(level);
+    return dotScalar;
+}
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+bool reduceRates(int input, int output, int *phases, int *step)
+{
+    const int divisor = std::gcd(input, output);
+    *phases = output / divisor;
+    *step = input / divisor;
+    return *phases <= AudioConverter::MAX_PHASES;
+}
+
+bool isKnownFormat(QAudioFormat::SampleFormat format)
+{
+    return format == QAudioFormat::UInt8 || format == QAudioFormat::Int16
+           || format == QAudioFormat::Int32 || format == QAudioFormat::Float;
+}
+
+}
+
+bool AudioConverter::isSupported(const QAudioFormat &input, const QAudioFormat &output)
+{
+    int phases;
+    int step;
+    return input.isValid() && output.isValid()
+           && isKnownFormat(input.sampleFormat()) && isKnownFormat(output.sampleFormat())
+           && input.channelCount() <= MAX_CHANNELS && output.channelCount() <= MAX_CHANNELS
+           && reduceRates(input.sampleRate(), output.sampleRate(), &phases, &step);
+}
+
+bool AudioConverter::configure(const QAudioFormat &input, const QAudioFormat &output, Simd::Level level)
+{
+    m_inputFrameBytes = 0;
+    if (!isSupported(input, output)) {
+        return false;
+    }
+    m_input = input;
+    m_output = output;
+    m_level = level;
+    m_passthrough = input == output;
+    m_inputFrameBytes = input.bytesPerFrame();
+    m_inChannels = input.channelCount();
+    m_outChannels = output.channelCount();
+    reduceRates(input.sampleRate(), output.sampleRate(), &m_phases, &m_step);
+
+    // Mono is copied to every output, every output of a downmix to mono gets
+    // the average, otherwise channels map one to one and the surplus inputs
+    // are folded into the outputs with the weights of every row adding to 1
+    m_matrix.assign(size_t(m_outChannels) * m_inChannels, 0.0f);
+    for (int o = 0; o < m_outChannels; o++) {
+        float *row = m_matrix.data() + size_t(o) * m_inChannels;
+        if (m_inChannels == 1) {
+            row[0] = 1.0f;
+        } else if (m_outChannels == 1) {
+            std::fill(row, row + m_inChannels, 1.0f / m_inChannels);
+        } else if (o >= m_inChannels) {
+            row[o % m_inChannels] = 1.0f;
+        } else {
+            int sources = 0;
+            for (int i = o; i < m_inChannels; i += m_outChannels) {
+                sources++;
+            }
+            for (int i = o; i < m_inChannels; i += m_outChannels) {
+                row[i] = 1.0f / sources;
+            }
+        }
+    }
+
+    buildFilter();
+    reset();
+    return true;
+}
+
+void AudioConverter::reset()
+{
+    m_planar.assign(size_t(m_outChannels), std::vector<float>());
+    m_resampled.assign(size_t(m_outChannels), std::vector<float>());
+    m_phase = 0;
+    m_index = 0;
+    if (m_phases != 1 || m_step != 1) {
+        // The filter starts on silence
+        for (std::vector<float> &plane : m_planar) {
+            plane.assign(size_t(m_taps - 1), 0.0f);
+        }
+        m_index = m_taps - 1;
+    }
+}
+
+void AudioConverter::buildFilter()
+{
+    m_filter.clear();
+    m_taps = TAPS;
+    if (m_phases == 1 && m_step == 1) {
+        return;
+    }
+    // Downsampling narrows the pass band, the filter needs as many more taps
+    // to keep its transition band, rounded up to whole vectors
+    if (m_step > m_phases) {
+        m_taps = (int(std::ceil(double(TAPS) * m_step / m_phases)) + 7) / 8 * 8;
+    }
+    // Prototype low pass at phases times the input rate, cut below the lower Nyquist frequency
+    const int length = m_taps * m_phases;
+    const double cutoff = 0.5 * CUTOFF * qMin(1.0, double(m_phases) / m_step) / m_phases;
+    const double centre = (length - 1) / 2.0;
+    const double window = besselI0(KAISER_BETA);
+    std::vector<double> prototype(static_cast<size_t>(length));
+    double sum = 0;
+    for (int k = 0; k < length; k++) {
+        const double t = k - centre;
+        const double x = 2.0 * PI * cutoff * t;
+        const double sinc = t == 0 ? 1.0 : std::sin(x) / x;
+        const double r = t / (length / 2.0);
+        const double kaiser = besselI0(KAISER_BETA * std::sqrt(qMax(0.0, 1.0 - r * r))) / window;
+        prototype[size_t(k)] = 2.0 * cutoff * sinc * kaiser;
+        sum += prototype[size_t(k)];
+    }
+
+    // Every phase gets a unity DC gain, stored in reverse so a phase is a
+    // dot product with the input in memory order
+    m_filter.assign(size_t(length), 0.0f);
+    const double gain = m_phases / sum;
+    for (int p = 0; p < m_phases; p++) {
+        for (int j = 0; j < m_taps; j++) {
+            m_filter[size_t(p) * m_taps + (m_taps - 1 - j)] = float(prototype[size_t(j) * m_phases + p] * gain);
+        }
+    }
+}
+
+void AudioConverter::decode(QAudioFormat::SampleFormat format, const char *input, float *samples, qsizetype count,
+                            Simd::Level level)
+{
+    DecodeFn fn = decodeFor(format, level);
+    if (fn) {
+        fn(input, samples, count);
+    }
+}
+
+qsizetype AudioConverter::outputBytesFor(qsizetype inputBytes) const
+{
+    if (!isConfigured()) {
+        return 0;
+    }
+    const qint64 frames = inputBytes / m_inputFrameBytes;
+    return qsizetype((frames * m_phases / m_step + 2) * m_output.bytesPerFrame());
+}
+
+void AudioConverter::mixToPlanar(const float *samples, int frames)
+{
+    for (int o = 0; o < m_outChannels; o++) {
+        std::vector<float> &plane = m_planar[size_t(o)];
+        const size_t start = plane.size();
+        plane.resize(start + size_t(frames));
+        float *dst = plane.data() + start;
+        const float *row = m_matrix.data() + size_t(o) * m_inChannels;
+        if (row[o % m_inChannels] == 1.0f) {
+            // A plain copy of one input channel, the common case
+            const int channel = o % m_inChannels;
+            for (int f = 0; f < frames; f++) {
+                dst[f] = samples[size_t(f) * m_inChannels + channel];
+            }
+            continue;
+        }
+        for (int f = 0; f < frames; f++) {
+            const float *frame = samples + size_t(f) * m_inChannels;
+            float sum = 0;
+            for (int i = 0; i < m_inChannels; i++) {
+                sum += row[i] * frame[i];
+            }
+            dst[f] = sum;
+        }
+    }
+}
+
+int AudioConverter::resample()
+{
+    const DotFn dot = dotFor(m_level);
+    const int available = int(m_planar[0].size());
+    int index = m_index;
+    int phase = m_phase;
+    for (int c = 0; c < m_outChannels; c++) {
+        const float *input = m_planar[size_t(c)].data();
+        std::vector<float> &out = m_resampled[size_t(c)];
+        out.clear();
+        index = m_index;
+        phase = m_phase;
+        while (index < available) {
+            out.push_back(dot(m_filter.data() + size_t(phase) * m_taps, input + index - (m_taps - 1), m_taps));
+            phase += m_step;
+            index += phase / m_phases;
+            phase %= m_phases;
+        }
+    }
+
+    // Keep the history the next output needs. When the input step is larger
+    // than one, index may already be past the samples received so far.
+    const int consumed = qMin(index - (m_taps - 1), available);
+    for (std::vector<float> &plane : m_planar) {
+        plane.erase(plane.begin(), plane.begin() + consumed);
+    }
+    m_index = index - consumed;
+    m_phase = phase;
+    return int(m_resampled[0].size());
+}
+
+qsizetype AudioConverter::process(const char *input, qsizetype inputBytes, std::vector<char> &output)
+{
+    if (!isConfigured() || inputBytes < m_inputFrameBytes) {
+        return 0;
+    }
+    const int frames = int(inputBytes / m_inputFrameBytes);
+    const size_t start = output.size();
+    if (m_passthrough) {
+        const qsizetype bytes = qsizetype(frames) * m_inputFrameBytes;
+        output.insert(output.end(), input, input + bytes);
+        return bytes;
+    }
+
+    m_decoded.resize(size_t(frames) * m_inChannels);
+    decodeFor(m_input.sampleFormat(), m_level)(input, m_decoded.data(), qsizetype(m_decoded.size()));
+    mixToPlanar(m_decoded.data(), frames);
+
+    const bool resampling = m_phases != 1 || m_step != 1;
+    const int outFrames = resampling ? resample() : frames;
+    const std::vector<std::vector<float>> &planes = resampling ? m_resampled : m_planar;
+
+    m_interleaved.resize(size_t(outFrames) * m_outChannels);
+    for (int c = 0; c < m_outChannels; c++) {
+        const float *src = planes[size_t(c)].data();
+        float *dst = m_interleaved.data() + c;
+        for (int f = 0; f < outFrames; f++) {
+            dst[size_t(f) * m_outChannels] = src[f];
+        }
+    }
+    if (!resampling) {
+        for (std::vector<float> &plane : m_planar) {
+            plane.clear();
+        }
+    }
+
+    const qsizetype bytes = qsizetype(outFrames) * m_output.bytesPerFrame();
+    output.resize(start + size_t(bytes));
+    encodeFor(m_output.sampleFormat(), m_level)(m_interleaved.data(), output.data() + start,
+                                                qsizetype(m_interleaved.size()));
+    return bytes;
+}
+
+void AudioConverter::runBenchmark()
+{
+    struct Case {
+        const char *name;
+        int rate;
+        int channels;
+        QAudioFormat::SampleFormat format;
+    };
+    const Case cases[] = {
+        {"48k s16 stereo -> 44.1k f32 stereo", 44100, 2, QAudioFormat::Float},
+        {"48k s16 stereo -> 44.1k s16 mono  ", 44100, 1, QAudioFormat::Int16},
+        {"48k s16 stereo -> 48k f32 stereo  ", 48000, 2, QAudioFormat::Float},
+    };
+    const int periodsMs[] = {10, 20};
+    const int iterations = 2000;
+
+    QAudioFormat input;
+    input.setSampleRate(48000);
+    input.setChannelCount(2);
+    input.setSampleFormat(QAudioFormat::Int16);
+
+    // A 1 kHz tone with some noise on top
+    std::vector<char> source(size_t(input.bytesForDuration(20000)));
+    qint16 *samples = reinterpret_cast<qint16 *>(source.data());
+    for (size_t i = 0; i < source.size() / 2; i++) {
+        samples[i] = qint16(12000 * std::sin(2.0 * PI * 1000.0 * double(i / 2) / 48000.0) + (i * 7919) % 512);
+    }
+
+    const Simd::Level levels[] = {Simd::Level::Scalar, Simd::Level::Sse2, Simd::Level::Avx2};
+    std::vector<char> output;
+    for (const Case &c : cases) {
+        QAudioFormat format;
+        format.setSampleRate(c.rate);
+        format.setChannelCount(c.channels);
+        format.setSampleFormat(c.format);
+        for (Simd::Level level : levels) {
+            if (!Simd::isSupported(level)) {
+                continue;
+            }
+            for (int periodMs : periodsMs) {
+                AudioConverter converter;
+                converter.configure(input, format, level);
+                const qsizetype bytes = input.bytesForDuration(periodMs * 1000);
+                output.reserve(size_t(converter.outputBytesFor(bytes)));
+                QElapsedTimer timer;
+                timer.start();
+                for (int i = 0; i < iterations; i++) {
+                    output.clear();
+                    converter.process(source.data(), bytes, output);
+                }
+                const double us = timer.nsecsElapsed() / (iterations * 1000.0);
+                qInfo().noquote() << QString("audioconvert %1 %2 %3 ms buffer: %4 us, %5% of the period")
+                                         .arg(c.name)
+                                         .arg(Simd::levelName(level), -6)
+                                         .arg(periodMs, 2)
+                                         .arg(us, 0, 'f', 1)
+                                         .arg(100.0 * us / (periodMs * 1000.0), 0, 'f', 2);
+            }
+        }
+    }
+}
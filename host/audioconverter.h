@@ -0,0 +1,108 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef AUDIOCONVERTER_H
+#define AUDIOCONVERTER_H
+
+#include <QAudioFormat>
+#include <QtGlobal>
+#include <vector>
+
+#include "simd.h"
+
+/*
+ * Converts the capture card's audio to the output device's format: sample
+ * format (UInt8, Int16, Int32, Float), channel count and sample rate.
+ *
+ * Samples are decoded to float, mixed to the output channel count into one
+ * buffer per channel, resampled and encoded again. Resampling uses a
+ * polyphase windowed sinc filter with TAPS taps per phase, more when
+ * downsampling so the filter keeps its length at the output rate, and one
+ * phase for every output position between two input samples of the reduced
+ * rate ratio, so 48000 to 44100 Hz runs 147 phases without accumulating error.
+ * The decode, encode and filter kernels are SSE2 or AVX2 on x86. Elsewhere
+ * they are plain loops the compiler vectorizes, NEON on a Raspberry Pi.
+ *
+ * The converter keeps the filter history between calls, so a stream can be
+ * fed in buffers of any size.
+ */
+class AudioConverter
+{
+public:
+    static const int TAPS = 32;
+    // Rate ratios that do not reduce to this many phases are refused
+    static const int MAX_PHASES = 1024;
+
+    static bool isSupported(const QAudioFormat &input, const QAudioFormat &output);
+
+    bool configure(const QAudioFormat &input, const QAudioFormat &output, Simd::Level level = Simd::bestLevel());
+    bool isConfigured() const { return m_inputFrameBytes > 0; }
+    // Input and output are the same format, nothing to do
+    bool isPassthrough() const { return m_passthrough; }
+    void reset();
+
+    QAudioFormat inputFormat() const { return m_input; }
+    QAudioFormat outputFormat() const { return m_output; }
+
+    // Upper bound of the output bytes for inputBytes of input
+    qsizetype outputBytesFor(qsizetype inputBytes) const;
+
+    // Converts whole input frames and appends the result to output. Returns the
+    // number of output bytes appended, a trailing partial frame is ignored.
+    qsizetype process(const char *input, qsizetype inputBytes, std::vector<char> &output);
+
+    // Decodes count samples of format to float in [-1, 1), with the converter's kernels
+    static void decode(QAudioFormat::SampleFormat format, const char *input, float *samples, qsizetype count,
+                       Simd::Level level = Simd::bestLevel());
+
+    // Prints the cost of converting 10 ms and 20 ms buffers from 48 kHz stereo Int16
+    static void runBenchmark();
+
+private:
+    void buildFilter();
+    void mixToPlanar(const float *samples, int frames);
+    int resample();
+
+    QAudioFormat m_input;
+    QAudioFormat m_output;
+    Simd::Level m_level = Simd::Level::Scalar;
+    bool m_passthrough = false;
+    int m_inputFrameBytes = 0;
+    int m_inChannels = 0;
+    int m_outChannels = 0;
+
+    std::vector<float> m_matrix;            // m_outChannels x m_inChannels
+    std::vector<float> m_decoded;           // Interleaved input as float
+    std::vector<std::vector<float>> m_planar;       // Per output channel, history then new samples
+    std::vector<std::vector<float>> m_resampled;    // Per output channel
+    std::vector<float> m_interleaved;
+
+    // Resampler, output n reads input n * m_step / m_phases at phase (n * m_step) % m_phases
+    int m_phases = 1;
+    int m_step = 1;
+    int m_phase = 0;
+    int m_index = 0;                        // Next output's newest input sample in m_planar
+    int m_taps = TAPS;
+    std::vector<float> m_filter;            // m_phases x m_taps, taps reversed
+};
+
+#endif // AUDIOCONVERTER_H
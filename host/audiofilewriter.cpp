@@ -0,0 +1,542 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "audiofilewriter.h"
+
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int MAX_FIXED_ORDER = 4;
+const int MAX_PARTITION_ORDER = 8;
+const int MAX_RICE_PARAMETER = 14;
+
+void put32(QByteArray &data, quint32 value)
+{
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    data.append(bytes, 4);
+}
+
+void put16(QByteArray &data, quint16 value)
+{
+    char bytes[2];
+    qToLittleEndian(value, bytes);
+    data.append(bytes, 2);
+}
+
+// MSB first, as FLAC stores everything
+class BitWriter
+{
+public:
+    explicit BitWriter(quint8 *data) : m_data(data) {}
+
+    void put(quint32 value, int bits)
+    {
+        m_bits = (m_bits << bits) | (value & ((quint64(1) << bits) - 1));
+        m_count += bits;
+        while (m_count >= 8) {
+            m_count -= 8;
+            m_data[m_size++] = quint8(m_bits >> m_count);
+        }
+    }
+
+    void putSigned(qint32 value, int bits) { put(quint32(value), bits); }
+
+    void putRice(quint32 value, int parameter)
+    {
+        quint32 zeros = value >> parameter;
+        while (zeros >= 32) {
+            put(0, 32);
+            zeros -= 32;
+        }
+        put(1, int(zeros) + 1);
+        if (parameter > 0) {
+            put(value, parameter);
+        }
+    }
+
+    void alignToByte()
+    {
+        if (m_count > 0) {
+            put(0, 8 - m_count);
+        }
+    }
+
+    qsizetype size() const { return m_size; }
+
+private:
+    quint8 *m_data;
+    qsizetype m_size = 0;
+    quint64 m_bits = 0;
+    int m_count = 0;
+};
+
+quint8 crc8(const quint8 *data, qsizetype size)
+{
+    quint8 crc = 0;
+    for (qsizetype i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+        }
+    }
+    return crc;
+}
+
+quint16 crc16(const quint8 *data, qsizetype size)
+{
+    quint16 crc = 0;
+    for (qsizetype i = 0; i < size; i++) {
+        crc ^= quint16(data[i] << 8);
+        for (int k = 0; k < 8; k++) {
+            crc = (crc & 0x8000) ? quint16((crc << 1) ^ 0x8005) : quint16(crc << 1);
+        }
+    }
+    return crc;
+}
+
+quint32 zigzag(qint32 value)
+{
+    return (quint32(value) << 1) ^ quint32(value >> 31);
+}
+
+// Fixed predictor of the given order, residuals for samples order to count
+void fixedResidual(const qint32 *samples, int count, int order, qint32 *residual)
+{
+    for (int i = order; i < count; i++) {
+        const qint32 *x = samples + i;
+        switch (order) {
+        case 0: residual[i] = x[0]; break;
+        case 1: residual[i] = x[0] - x[-1]; break;
+        case 2: residual[i] = x[0] - 2 * x[-1] + x[-2]; break;
+        case 3: residual[i] = x[0] - 3 * x[-1] + 3 * x[-2] - x[-3]; break;
+        default: residual[i] = x[0] - 4 * x[-1] + 6 * x[-2] - 4 * x[-3] + x[-4]; break;
+        }
+    }
+}
+
+// The order whose residual is smallest, judged by the sum of magnitudes
+int bestFixedOrder(const qint32 *samples, int count)
+{
+    quint64 sums[MAX_FIXED_ORDER + 1] = {};
+    for (int i = MAX_FIXED_ORDER; i < count; i++) {
+        const qint64 e0 = samples[i];
+        const qint64 e1 = e0 - samples[i - 1];
+        const qint64 e2 = e1 - (qint64(samples[i - 1]) - samples[i - 2]);
+        const qint64 e3 = e2 - (qint64(samples[i - 1]) - 2 * qint64(samples[i - 2]) + samples[i - 3]);
+        const qint64 e4 = e3 - (qint64(samples[i - 1]) - 3 * qint64(samples[i - 2]) + 3 * qint64(samples[i - 3]) - samples[i - 4]);
+        sums[0] += quint64(std::llabs(e0));
+        sums[1] += quint64(std::llabs(e1));
+        sums[2] += quint64(std::llabs(e2));
+        sums[3] += quint64(std::llabs(e3));
+        sums[4] += quint64(std::llabs(e4));
+    }
+    int best = 0;
+    for (int order = 1; order <= MAX_FIXED_ORDER; order++) {
+        if (sums[order] < sums[best]) {
+            best = order;
+        }
+    }
+    return best;
+}
+
+// Rice parameter for count values adding up to sum, and an upper bound of the bits it takes
+int riceParameter(quint64 sum, qint64 count, quint64 &bits)
+{
+    int best = 0;
+    bits = ~quint64(0);
+    for (int parameter = 0; parameter <= MAX_RICE_PARAMETER; parameter++) {
+        const quint64 cost = quint64(count) * quint64(parameter + 1) + (sum >> parameter);
+        if (cost < bits) {
+            bits = cost;
+            best = parameter;
+        }
+    }
+    return best;
+}
+
+struct RicePlan {
+    int partitionOrder = 0;
+    int parameters[1 << MAX_PARTITION_ORDER];
+    quint64 bits = ~quint64(0);
+};
+
+// Picks the partition order and parameters for residual[order..count)
+void planRice(const qint32 *residual, int count, int order, RicePlan &plan)
+{
+    int maxOrder = 0;
+    while (maxOrder < MAX_PARTITION_ORDER && (count % (2 << maxOrder)) == 0
+           && (count >> (maxOrder + 1)) > order) {
+        maxOrder++;
+    }
+
+    // Sums of the finest partitions, merged pairwise for the coarser ones
+    quint64 sums[1 << MAX_PARTITION_ORDER];
+    const int finest = 1 << maxOrder;
+    const int length = count >> maxOrder;
+    for (int p = 0; p < finest; p++) {
+        quint64 sum = 0;
+        for (int i = p == 0 ? order : p * length; i < (p + 1) * length; i++) {
+            sum += zigzag(residual[i]);
+        }
+        sums[p] = sum;
+    }
+
+    plan.bits = ~quint64(0);
+    for (int partitionOrder = maxOrder; partitionOrder >= 0; partitionOrder--) {
+        const int partitions = 1 << partitionOrder;
+        quint64 bits = 0;
+        int parameters[1 << MAX_PARTITION_ORDER];
+        for (int p = 0; p < partitions; p++) {
+            const qint64 values = (count >> partitionOrder) - (p == 0 ? order : 0);
+            quint64 partitionBits;
+            parameters[p] = riceParameter(sums[p], values, partitionBits);
+            bits += 4 + partitionBits;
+        }
+        if (bits < plan.bits) {
+            plan.bits = bits;
+            plan.partitionOrder = partitionOrder;
+            memcpy(plan.parameters, parameters, sizeof(int) * size_t(partitions));
+        }
+        for (int p = 0; p < partitions / 2; p++) {
+            sums[p] = sums[2 * p] + sums[2 * p + 1];
+        }
+    }
+}
+
+void putUtf8(BitWriter &writer, quint64 value)
+{
+    if (value < 0x80) {
+        writer.put(quint32(value), 8);
+        return;
+    }
+    int bytes = 2;
+    while (bytes < 7 && value >= (quint64(1) << (5 * bytes + 1))) {
+        bytes++;
+    }
+    const int shift = 6 * (bytes - 1);
+    writer.put((0xFF00u >> bytes) | quint32(value >> shift), 8);
+    for (int i = bytes - 2; i >= 0; i--) {
+        writer.put(0x80 | quint32((value >> (6 * i)) & 0x3F), 8);
+    }
+}
+
+int flacRateCode(int sampleRate)
+{
+    switch (sampleRate) {
+    case 88200: return 0x1;
+    case 176400: return 0x2;
+    case 192000: return 0x3;
+    case 8000: return 0x4;
+    case 16000: return 0x5;
+    case 22050: return 0x6;
+    case 24000: return 0x7;
+    case 32000: return 0x8;
+    case 44100: return 0x9;
+    case 48000: return 0xA;
+    case 96000: return 0xB;
+    default: return 0x0;    // Taken from STREAMINFO
+    }
+}
+
+int flacSizeCode(int bits)
+{
+    return bits == 8 ? 0x1 : bits == 16 ? 0x4 : 0x6;
+}
+
+qint32 flacSample(const char *sample, QAudioFormat::SampleFormat format)
+{
+    switch (format) {
+    case QAudioFormat::UInt8:
+        return qint32(quint8(*sample)) - 128;
+    case QAudioFormat::Int16: {
+        qint16 value;
+        memcpy(&value, sample, sizeof(value));
+        return value;
+    }
+    case QAudioFormat::Int32: {
+        qint32 value;
+        memcpy(&value, sample, sizeof(value));
+        return value >> 8;
+    }
+    case QAudioFormat::Float: {
+        float value;
+        memcpy(&value, sample, sizeof(value));
+        return qint32(std::lrint(qBound(-1.0f, value, 1.0f) * 8388607.0f));
+    }
+    default:
+        return 0;
+    }
+}
+
+} // namespace
+
+AudioFileWriter::~AudioFileWriter()
+{
+    if (m_file.isOpen()) {
+        close();
+    }
+}
+
+bool AudioFileWriter::isSupported(const QAudioFormat &format)
+{
+    return format.isValid() && format.channelCount() <= 8 && format.sampleRate() < (1 << 20)
+           && format.sampleFormat() != QAudioFormat::Unknown;
+}
+
+bool AudioFileWriter::open(const QString &path, const QAudioFormat &format, Container container)
+{
+    if (!isSupported(format)) {
+        return false;
+    }
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    m_format = format;
+    m_container = container;
+    m_frames = 0;
+    m_ok = true;
+
+    const int frameBytes = format.bytesPerFrame();
+    m_silence.assign(size_t(FLAC_BLOCK_FRAMES) * size_t(frameBytes),
+                     format.sampleFormat() == QAudioFormat::UInt8 ? char(0x80) : char(0));
+
+    if (container == Container::Flac) {
+        m_flacBits = format.bytesPerSample() == 1 ? 8 : format.bytesPerSample() == 2 ? 16 : 24;
+        m_block.assign(size_t(FLAC_BLOCK_FRAMES) * size_t(format.channelCount()), 0);
+        m_residual.assign(size_t(FLAC_BLOCK_FRAMES), 0);
+        // A frame never grows past its verbatim size, which this covers with room for the headers
+        m_encoded.assign(size_t(32 + format.channelCount() * (8 + FLAC_BLOCK_FRAMES * 4)), 0);
+        m_blockFrames = 0;
+        m_flacFrameNumber = 0;
+        m_minFrameBytes = 0;
+        m_maxFrameBytes = 0;
+    }
+
+    QByteArray placeholder = container == Container::Flac ? flacHeader() : wavHeader();
+    return writeBytes(placeholder.constData(), placeholder.size());
+}
+
+bool AudioFileWriter::write(const char *data, qint64 frames)
+{
+    if (!m_file.isOpen() || frames <= 0) {
+        return m_ok;
+    }
+    if (m_container == Container::Flac) {
+        appendFlac(data, frames);
+    } else {
+        writeBytes(data, frames * m_format.bytesPerFrame());
+    }
+    m_frames += frames;
+    return m_ok;
+}
+
+bool AudioFileWriter::writeSilence(qint64 frames)
+{
+    while (frames > 0 && m_ok) {
+        const qint64 count = qMin<qint64>(frames, FLAC_BLOCK_FRAMES);
+        write(m_silence.data(), count);
+        frames -= count;
+    }
+    return m_ok;
+}
+
+bool AudioFileWriter::close()
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    if (m_container == Container::Flac && m_blockFrames > 0) {
+        encodeFlacBlock();
+    }
+    QByteArray header = m_container == Container::Flac ? flacHeader() : wavHeader();
+    m_ok = m_ok && m_file.seek(0);
+    writeBytes(header.constData(), header.size());
+    m_file.close();
+    return m_ok;
+}
+
+bool AudioFileWriter::writeBytes(const char *data, qint64 size)
+{
+    m_ok = m_ok && m_file.write(data, size) == size;
+    return m_ok;
+}
+
+QByteArray AudioFileWriter::wavHeader() const
+{
+    const bool isFloat = m_format.sampleFormat() == QAudioFormat::Float;
+    const quint32 dataBytes = quint32(qMin<qint64>(m_frames * m_format.bytesPerFrame(), 0xFFFFFFFFLL - 36));
+
+    QByteArray data;
+    data.reserve(44);
+    data.append("RIFF", 4);
+    put32(data, 36 + dataBytes);
+    data.append("WAVE", 4);
+
+    data.append("fmt ", 4);
+    put32(data, 16);
+    put16(data, isFloat ? 3 : 1);                                   // IEEE float or PCM
+    put16(data, quint16(m_format.channelCount()));
+    put32(data, quint32(m_format.sampleRate()));
+    put32(data, quint32(m_format.sampleRate() * m_format.bytesPerFrame()));
+    put16(data, quint16(m_format.bytesPerFrame()));
+    put16(data, quint16(m_format.bytesPerSample() * 8));
+
+    data.append("data", 4);
+    put32(data, dataBytes);
+    return data;
+}
+
+QByteArray AudioFileWriter::flacHeader() const
+{
+    quint8 bytes[42];
+    BitWriter writer(bytes);
+    writer.put('f', 8);
+    writer.put('L', 8);
+    writer.put('a', 8);
+    writer.put('C', 8);
+
+    // STREAMINFO, the only and so the last metadata block
+    writer.put(1, 1);
+    writer.put(0, 7);
+    writer.put(34, 24);
+    writer.put(FLAC_BLOCK_FRAMES, 16);
+    writer.put(FLAC_BLOCK_FRAMES, 16);
+    writer.put(m_minFrameBytes, 24);
+    writer.put(m_maxFrameBytes, 24);
+    writer.put(quint32(m_format.sampleRate()), 20);
+    writer.put(quint32(m_format.channelCount() - 1), 3);
+    writer.put(quint32(m_flacBits - 1), 5);
+    writer.put(quint32(quint64(m_frames) >> 32), 4);
+    writer.put(quint32(m_frames), 32);
+    for (int i = 0; i < 4; i++) {
+        writer.put(0, 32);                                          // No MD5
+    }
+    return QByteArray(reinterpret_cast<const char *>(bytes), int(writer.size()));
+}
+
+void AudioFileWriter::appendFlac(const char *data, qint64 frames)
+{
+    const int channels = m_format.channelCount();
+    const int sampleBytes = m_format.bytesPerSample();
+    const QAudioFormat::SampleFormat format = m_format.sampleFormat();
+    while (frames > 0) {
+        const int count = int(qMin<qint64>(frames, FLAC_BLOCK_FRAMES - m_blockFrames));
+        for (int c = 0; c < channels; c++) {
+            qint32 *block = m_block.data() + size_t(c) * FLAC_BLOCK_FRAMES + m_blockFrames;
+            const char *sample = data + c * sampleBytes;
+            for (int i = 0; i < count; i++, sample += channels * sampleBytes) {
+                block[i] = flacSample(sample, format);
+            }
+        }
+        m_blockFrames += count;
+        data += qint64(count) * channels * sampleBytes;
+        frames -= count;
+        if (m_blockFrames == FLAC_BLOCK_FRAMES) {
+            encodeFlacBlock();
+        }
+    }
+}
+
+/*
+ * One frame with an independent subframe per channel. A subframe is constant
+ * when all samples are equal, as in padded silence, otherwise the best fixed
+ * predictor or verbatim, whichever is smaller.
+ */
+bool AudioFileWriter::encodeFlacBlock()
+{
+    const int count = m_blockFrames;
+    const int bits = m_flacBits;
+    BitWriter writer(m_encoded.data());
+
+    writer.put(0xFFF8, 16);                                         // Sync, fixed block size
+    writer.put(0x7, 4);                                             // Block size follows in 16 bits
+    writer.put(quint32(flacRateCode(m_format.sampleRate())), 4);
+    writer.put(quint32(m_format.channelCount() - 1), 4);            // Independent channels
+    writer.put(quint32(flacSizeCode(bits)), 3);
+    writer.put(0, 1);
+    putUtf8(writer, m_flacFrameNumber);
+    writer.put(quint32(count - 1), 16);
+    writer.put(crc8(m_encoded.data(), writer.size()), 8);
+
+    RicePlan plan;
+    for (int c = 0; c < m_format.channelCount(); c++) {
+        const qint32 *samples = m_block.data() + size_t(c) * FLAC_BLOCK_FRAMES;
+
+        bool constant = true;
+        for (int i = 1; i < count && constant; i++) {
+            constant = samples[i] == samples[0];
+        }
+        if (constant) {
+            writer.put(0x00, 8);
+            writer.putSigned(samples[0], bits);
+            continue;
+        }
+
+        const quint64 verbatimBits = quint64(count) * quint64(bits);
+        int order = -1;
+        if (count > MAX_FIXED_ORDER) {
+            order = bestFixedOrder(samples, count);
+            fixedResidual(samples, count, order, m_residual.data());
+            planRice(m_residual.data(), count, order, plan);
+            if (quint64(order) * quint64(bits) + 6 + plan.bits >= verbatimBits) {
+                order = -1;
+            }
+        }
+        if (order < 0) {
+            writer.put(0x02, 8);
+            for (int i = 0; i < count; i++) {
+                writer.putSigned(samples[i], bits);
+            }
+            continue;
+        }
+
+        writer.put(quint32(0x10 | (order << 1)), 8);
+        for (int i = 0; i < order; i++) {
+            writer.putSigned(samples[i], bits);
+        }
+        writer.put(0, 2);                                           // Rice with 4 bit parameters
+        writer.put(quint32(plan.partitionOrder), 4);
+        const int length = count >> plan.partitionOrder;
+        for (int p = 0; p < (1 << plan.partitionOrder); p++) {
+            const int parameter = plan.parameters[p];
+            writer.put(quint32(parameter), 4);
+            for (int i = p == 0 ? order : p * length; i < (p + 1) * length; i++) {
+                writer.putRice(zigzag(m_residual[i]), parameter);
+            }
+        }
+    }
+
+    writer.alignToByte();
+    writer.put(crc16(m_encoded.data(), writer.size()), 16);
+
+    const quint32 size = quint32(writer.size());
+    m_minFrameBytes = m_minFrameBytes == 0 ? size : qMin(m_minFrameBytes, size);
+    m_maxFrameBytes = qMax(m_maxFrameBytes, size);
+    m_flacFrameNumber++;
+    m_blockFrames = 0;
+    return writeBytes(reinterpret_cast<const char *>(m_encoded.data()), size);
+}
@@ -0,0 +1,90 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef AUDIOFILEWRITER_H
+#define AUDIOFILEWRITER_H
+
+#include <QAudioFormat>
+#include <QFile>
+#include <QString>
+#include <vector>
+
+/*
+ * Writes PCM to a WAV or FLAC file.
+ *
+ * WAV keeps the samples as they are. FLAC stores integers only, 8 and 16 bit
+ * samples are kept, 32 bit and float samples are stored with 24 bits. The
+ * FLAC encoder uses the fixed predictors with Rice coded residuals, which
+ * costs little CPU and still halves the size of typical audio.
+ *
+ * Like AviWriter, the header is written with placeholder sizes on open() and
+ * rewritten in place on close(). All buffers are sized on open(), write()
+ * does not allocate.
+ */
+class AudioFileWriter
+{
+public:
+    enum class Container { Wav, Flac };
+
+    static const int FLAC_BLOCK_FRAMES = 4096;
+
+    ~AudioFileWriter();
+
+    static bool isSupported(const QAudioFormat &format);
+    static QString suffix(Container container) { return container == Container::Flac ? "flac" : "wav"; }
+
+    bool open(const QString &path, const QAudioFormat &format, Container container);
+    bool write(const char *data, qint64 frames);
+    bool writeSilence(qint64 frames);
+    bool close();
+
+    bool isOpen() const { return m_file.isOpen(); }
+    qint64 frameCount() const { return m_frames; }
+    QString fileName() const { return m_file.fileName(); }
+    QString errorString() const { return m_file.errorString(); }
+
+private:
+    QByteArray wavHeader() const;
+    QByteArray flacHeader() const;
+    void appendFlac(const char *data, qint64 frames);
+    bool encodeFlacBlock();
+    bool writeBytes(const char *data, qint64 size);
+
+    QFile m_file;
+    QAudioFormat m_format;
+    Container m_container = Container::Wav;
+    qint64 m_frames = 0;
+    bool m_ok = true;
+    std::vector<char> m_silence;
+
+    // FLAC only
+    int m_flacBits = 16;
+    std::vector<qint32> m_block;        // Channel after channel
+    int m_blockFrames = 0;
+    quint64 m_flacFrameNumber = 0;
+    std::vector<quint8> m_encoded;
+    std::vector<qint32> m_residual;
+    quint32 m_minFrameBytes = 0;
+    quint32 m_maxFrameBytes = 0;
+};
+
+#endif // AUDIOFILEWRITER_H
@@ -0,0 +1,178 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "audiogain.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+quint32 floatBits(float value)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(quint32 bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+template <typename T>
+T scaleSample(T sample, float gain);
+
+template <>
+quint8 scaleSample(quint8 sample, float gain)
+{
+    return quint8(std::lrint(qBound(0.0f, (int(sample) - 128) * gain + 128.0f, 255.0f)));
+}
+
+template <>
+qint16 scaleSample(qint16 sample, float gain)
+{
+    return qint16(std::lrint(qBound(-32768.0f, sample * gain, 32767.0f)));
+}
+
+template <>
+qint32 scaleSample(qint32 sample, float gain)
+{
+    // Through double, a float has too few bits for full scale 32 bit samples
+    return qint32(std::llrint(qBound(-2147483648.0, double(sample) * gain, 2147483647.0)));
+}
+
+template <>
+float scaleSample(float sample, float gain)
+{
+    return sample * gain;
+}
+
+// Scales frames starting at gain, adding step after every frame. Returns the gain after the last frame.
+template <typename T>
+float scale(char *data, qsizetype frames, int channels, float gain, float step)
+{
+    T *samples = reinterpret_cast<T *>(data);
+    if (step == 0.0f) {
+        const qsizetype count = frames * channels;
+        for (qsizetype i = 0; i < count; i++) {
+            samples[i] = scaleSample(samples[i], gain);
+        }
+        return gain;
+    }
+    // Computed from the start of the segment, summing the steps drifts over a long fade
+    for (qsizetype f = 0; f < frames; f++) {
+        const float frameGain = gain + step * float(f);
+        for (int c = 0; c < channels; c++) {
+            samples[f * channels + c] = scaleSample(samples[f * channels + c], frameGain);
+        }
+    }
+    return gain + step * float(frames);
+}
+
+float scaleFor(const QAudioFormat &format, char *data, qsizetype frames, float gain, float step)
+{
+    const int channels = format.channelCount();
+    switch (format.sampleFormat()) {
+    case QAudioFormat::UInt8:
+        return scale<quint8>(data, frames, channels, gain, step);
+    case QAudioFormat::Int16:
+        return scale<qint16>(data, frames, channels, gain, step);
+    case QAudioFormat::Int32:
+        return scale<qint32>(data, frames, channels, gain, step);
+    case QAudioFormat::Float:
+        return scale<float>(data, frames, channels, gain, step);
+    default:
+        return gain + step * frames;
+    }
+}
+
+}
+
+float AudioGain::targetGain() const
+{
+    return bitsFloat(quint32(m_parameters.load(std::memory_order_acquire) >> 32));
+}
+
+void AudioGain::setTarget(float gain, qint64 rampUs)
+{
+    gain = qBound(0.0f, gain, MAX_GAIN);
+    const quint64 ramp = quint64(qBound<qint64>(0, rampUs, 0xFFFFFFFF));
+    m_parameters.store(quint64(floatBits(gain)) << 32 | ramp, std::memory_order_release);
+}
+
+void AudioGain::configure(const QAudioFormat &format)
+{
+    m_format = format;
+    m_seenParameters = m_parameters.load(std::memory_order_acquire);
+    m_seenMuted = m_muted.load(std::memory_order_acquire);
+    // A new stream starts silent and ramps in, over a fade set before the start if there is one
+    m_gain = 0.0f;
+    startRamp(m_seenMuted ? 0.0f : bitsFloat(quint32(m_seenParameters >> 32)),
+              qMax<qint64>(qint64(m_seenParameters & 0xFFFFFFFF), DEFAULT_RAMP_MS * 1000));
+}
+
+void AudioGain::startRamp(float target, qint64 rampUs)
+{
+    m_target = target;
+    m_rampFrames = m_format.framesForDuration(rampUs);
+    if (m_rampFrames <= 0) {
+        m_gain = target;
+        m_step = 0.0f;
+        m_rampFrames = 0;
+    } else {
+        m_step = (target - m_gain) / m_rampFrames;
+    }
+}
+
+void AudioGain::process(char *data, qsizetype frames)
+{
+    const quint64 parameters = m_parameters.load(std::memory_order_acquire);
+    const bool muted = m_muted.load(std::memory_order_acquire);
+    if (parameters != m_seenParameters || muted != m_seenMuted) {
+        const float target = muted ? 0.0f : bitsFloat(quint32(parameters >> 32));
+        // Mute changes use the short ramp, a new target its own
+        const qint64 rampUs = muted != m_seenMuted ? DEFAULT_RAMP_MS * 1000 : qint64(parameters & 0xFFFFFFFF);
+        m_seenParameters = parameters;
+        m_seenMuted = muted;
+        startRamp(target, rampUs);
+    }
+
+    if (m_rampFrames > 0) {
+        const qsizetype rampFrames = qMin<qsizetype>(frames, m_rampFrames);
+        m_gain = scaleFor(m_format, data, rampFrames, m_gain, m_step);
+        m_rampFrames -= rampFrames;
+        if (m_rampFrames == 0) {
+            // Land exactly on the target, not a rounding error away
+            m_gain = m_target;
+            m_step = 0.0f;
+        }
+        data += rampFrames * m_format.bytesPerFrame();
+        frames -= rampFrames;
+    }
+    if (frames <= 0 || m_gain == 1.0f) {
+        return;
+    }
+    scaleFor(m_format, data, frames, m_gain, 0.0f);
+}
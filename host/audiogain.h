@@ -0,0 +1,75 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef AUDIOGAIN_H
+#define AUDIOGAIN_H
+
+#include <QAudioFormat>
+#include <QtGlobal>
+#include <atomic>
+
+/*
+ * Gain, mute and fades applied to every sample of the output stream.
+ *
+ * Any thread may change the parameters, they are published through two
+ * atomics and never lock. The audio thread picks them up at the start of the
+ * next buffer and moves to the new gain in a linear ramp, one step per frame,
+ * so changes are free of the zipper noise of stepping the sink volume.
+ */
+class AudioGain
+{
+public:
+    static constexpr float MAX_GAIN = 4.0f;
+    // Ramp for plain volume changes and mute, long enough to be click free
+    static const int DEFAULT_RAMP_MS = 20;
+
+    // Sets the gain at once, no ramp
+    void setGain(float gain) { setTarget(gain, 0); }
+    // Ramps from wherever the gain is now to gain over milliseconds
+    void fadeTo(float gain, int milliseconds) { setTarget(gain, qint64(milliseconds) * 1000); }
+    void setMuted(bool muted) { m_muted.store(muted, std::memory_order_release); }
+
+    float targetGain() const;
+    bool isMuted() const { return m_muted.load(std::memory_order_acquire); }
+
+    // Audio thread side, configure() at the start of every stream
+    void configure(const QAudioFormat &format);
+    void process(char *data, qsizetype frames);
+
+private:
+    void setTarget(float gain, qint64 rampUs);
+    void startRamp(float target, qint64 rampUs);
+
+    // Target gain bits in the high half, ramp length in microseconds in the low half
+    std::atomic<quint64> m_parameters{quint64(0x3F800000) << 32};
+    std::atomic<bool> m_muted{false};
+
+    QAudioFormat m_format;
+    quint64 m_seenParameters = quint64(0x3F800000) << 32;
+    bool m_seenMuted = false;
+    float m_gain = 1.0f;
+    float m_target = 1.0f;
+    float m_step = 0.0f;
+    qint64 m_rampFrames = 0;
+};
+
+#endif // AUDIOGAIN_H
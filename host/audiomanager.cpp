@@ -1,6 +1,9 @@
 #include "audiomanager.h"
 #include "audiothread.h"
+#include "ui/globalsetting.h"
 #include <QDebug>
+#include <QFileInfo>
+#include <QSettings>
 
 Q_LOGGING_CATEGORY(log_core_host_audio, "opf.core.host.audio");
 
@@ -11,6 +14,7 @@ AudioManager::AudioManager(QObject *parent)
 
 AudioManager::~AudioManager() {
     disconnect();
+    m_recorder.stop();
 }
 
 QAudioDevice AudioManager::findUvcCameraAudioDevice(QString deviceName) {
@@ -58,44 +62,63 @@ void AudioManager::initializeAudio() {
         qCDebug(log_core_host_audio) << "Channel count:" << format.channelCount();
         qCDebug(log_core_host_audio) << "Sample size:" << format.bytesPerSample();
 
+        // Capture in the card's own format, AudioThread converts it for the output
+        QAudioFormat captureFormat = inputDevice.isNull() ? format : inputDevice.preferredFormat();
+        if (!AudioConverter::isSupported(captureFormat, format)) {
+            captureFormat = format;
+        }
+        qCDebug(log_core_host_audio) << "Capture format:" << captureFormat;
+
         // Create and start the audio thread
-        m_audioThread = new AudioThread(inputDevice, outputDevice, format, this);
+        m_audioThread = new AudioThread(inputDevice, outputDevice, captureFormat, format, this);
+        m_audioThread->setLatencyTarget(GlobalSetting::instance().getAudioLatency());
         connect(m_audioThread, &AudioThread::error, this, &AudioManager::handleAudioError);
+        connect(m_audioThread, &AudioThread::statsUpdated, this, &AudioManager::handleAudioStats);
+        m_audioThread->setRecorder(&m_recorder);
+        m_audioThread->setMuted(GlobalSetting::instance().getAudioMuted());
+        // The stream starts silent and fades in to the saved volume
+        fadeInVolume(3000);
         m_audioThread->start();
 
-        // Initialize volume to 0 and start fade-in
-        m_audioThread->setVolume(0.0);
-        fadeInVolume(100, 3);
-
     } catch (const std::exception &e) {
         qCWarning(log_core_host_audio) << "Exception occurred during audio initialization:" << e.what();
         return;
     }
 }
 
-void AudioManager::fadeInVolume(int timeout, int durationInSeconds) {
+void AudioManager::fadeInVolume(int durationMs) {
     if (!m_audioThread) return;
+    // Ramped per sample by the audio thread, nothing to drive from here
+    m_audioThread->fadeTo(GlobalSetting::instance().getAudioVolume() / 100.0, durationMs);
+}
 
-    // Calculate the number of steps and the increment per step
-    int steps = (durationInSeconds * 1000) / timeout;
-    qreal increment = 1.0 / steps;
-
-    // Create a QTimer to handle the volume fade-in
-    QTimer *volumeTimer = new QTimer(this);
-    connect(volumeTimer, &QTimer::timeout, [this, volumeTimer, increment]() {
-        qreal currentVolume = m_audioThread->volume();
-
-        if (currentVolume < 1.0) {
-            m_audioThread->setVolume(currentVolume + increment);
-        } else {
-            m_audioThread->setVolume(1.0);
-            volumeTimer->stop();
-            volumeTimer->deleteLater();
-        }
-    });
+void AudioManager::setVolume(qreal volume) {
+    if (m_audioThread) {
+        m_audioThread->setVolume(volume);
+    }
+}
+
+void AudioManager::setMuted(bool muted) {
+    if (m_audioThread) {
+        m_audioThread->setMuted(muted);
+    }
+}
 
-    // Start the timer with the given interval
-    volumeTimer->start(timeout);
+void AudioManager::startRecording(const QString& videoFilePath, qint64 firstFrameUs) {
+    QSettings settings("Techxartisan", "Openterface");
+    const QString format = settings.value("recording/audioFormat", "flac").toString();
+    if (format == "none") {
+        return;
+    }
+    const AudioFileWriter::Container container = format == "wav" ? AudioFileWriter::Container::Wav
+                                                                 : AudioFileWriter::Container::Flac;
+    QFileInfo info(videoFilePath);
+    m_recorder.startFile(info.path() + "/" + info.completeBaseName() + "." + AudioFileWriter::suffix(container),
+                         firstFrameUs, container);
+}
+
+void AudioManager::stopRecording() {
+    m_recorder.stop();
 }
 
 void AudioManager::disconnect() {
@@ -111,3 +134,12 @@ void AudioManager::disconnect() {
 void AudioManager::handleAudioError(const QString& error) {
     qCWarning(log_core_host_audio) << "Audio error:" << error;
 }
+
+void AudioManager::handleAudioStats(const AudioThread::Stats& stats) {
+    qCDebug(log_core_host_audio).noquote() << QString("latency %1 ms (ring %2 ms), drift %3 ppm, underruns %4, overruns %5")
+                                                  .arg(stats.latencyMs, 0, 'f', 1)
+                                                  .arg(stats.ringMs, 0, 'f', 1)
+                                                  .arg(stats.driftPpm, 0, 'f', 0)
+                                                  .arg(stats.underruns)
+                                                  .arg(stats.overruns);
+}
@@ -5,9 +5,9 @@
 #include <QAudioDevice>
 #include <QMediaDevices>
 #include <QLoggingCategory>
-#include <QTimer>
 
-class AudioThread;
+#include "audiothread.h"
+#include "audiorecorder.h"
 
 Q_DECLARE_LOGGING_CATEGORY(log_core_host_audio)
 
@@ -20,16 +20,26 @@ public:
 
     void initializeAudio();
     void disconnect();
+    // Apply to the running stream, a restarted one takes the saved settings
+    void setVolume(qreal volume);
+    void setMuted(bool muted);
+
+    // Records the target audio next to a video file, starting at its first
+    // frame, into a file of the same name with a .flac or .wav suffix
+    void startRecording(const QString& videoFilePath, qint64 firstFrameUs);
+    void stopRecording();
 
 private slots:
     void handleAudioError(const QString& error);
+    void handleAudioStats(const AudioThread::Stats& stats);
 
 private:
     QAudioDevice findUvcCameraAudioDevice(QString deviceName);
     QAudioDevice findSystemAudioOuptutDevice(QString deviceName);
-    void fadeInVolume(int timeout, int durationInSeconds);
+    void fadeInVolume(int durationMs);
 
     AudioThread* m_audioThread;
+    AudioRecorder m_recorder;
 };
 
 #endif // AUDIOMANAGER_H
@@ -0,0 +1,483 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "audiometer.h"
+#include "audioconverter.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+#include <cmath>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+// Share of a block's energy at a tone frequency that starts a beep, and the lower share that keeps it going
+const double TONE_START = 0.3;
+const double TONE_HOLD = 0.15;
+// Quieter blocks never hold a tone, about -50 dBFS
+const double MIN_TONE_RMS = 0.003;
+
+using LevelsFn = void (*)(const float *, qsizetype, float *, float *);
+using GoertzelFn = void (*)(const float *, qsizetype, int, const float *, float *, float *, float *);
+
+// Raises peak to the largest magnitude and adds the squares of count samples to sumSquares
+void levelsScalar(const float *samples, qsizetype count, float *peak, float *sumSquares)
+{
+    float p = *peak;
+    float s0 = 0, s1 = 0;
+    qsizetype i = 0;
+    for (; i + 2 <= count; i += 2) {
+        p = qMax(p, qMax(std::fabs(samples[i]), std::fabs(samples[i + 1])));
+        s0 += samples[i] * samples[i];
+        s1 += samples[i + 1] * samples[i + 1];
+    }
+    for (; i < count; i++) {
+        p = qMax(p, std::fabs(samples[i]));
+        s0 += samples[i] * samples[i];
+    }
+    *peak = p;
+    *sumSquares += s0 + s1;
+}
+
+// Runs the bank over frames of interleaved samples mixed to mono, adding the mono energy to energy
+void goertzelScalar(const float *samples, qsizetype frames, int channels, const float *coefficients,
+                    float *s1, float *s2, float *energy)
+{
+    float a[AudioMeter::TONE_COUNT];
+    float b[AudioMeter::TONE_COUNT];
+    for (int k = 0; k < AudioMeter::TONE_COUNT; k++) {
+        a[k] = s1[k];
+        b[k] = s2[k];
+    }
+    const float scale = 1.0f / float(channels);
+    float e = 0;
+    for (qsizetype f = 0; f < frames; f++) {
+        float x = 0;
+        for (int c = 0; c < channels; c++) {
+            x += samples[f * channels + c];
+        }
+        x *= scale;
+        e += x * x;
+        for (int k = 0; k < AudioMeter::TONE_COUNT; k++) {
+            const float s0 = x + coefficients[k] * a[k] - b[k];
+            b[k] = a[k];
+            a[k] = s0;
+        }
+    }
+    for (int k = 0; k < AudioMeter::TONE_COUNT; k++) {
+        s1[k] = a[k];
+        s2[k] = b[k];
+    }
+    *energy += e;
+}
+
+#ifdef OPF_HAVE_SSE2
+void levelsSse2(const float *samples, qsizetype count, float *peak, float *sumSquares)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 p = _mm_setzero_ps();
+    __m128 s0 = _mm_setzero_ps();
+    __m128 s1 = _mm_setzero_ps();
+    qsizetype i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_loadu_ps(samples + i);
+        __m128 b = _mm_loadu_ps(samples + i + 4);
+        p = _mm_max_ps(p, _mm_max_ps(_mm_andnot_ps(sign, a), _mm_andnot_ps(sign, b)));
+        s0 = _mm_add_ps(s0, _mm_mul_ps(a, a));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(b, b));
+    }
+    p = _mm_max_ps(p, _mm_movehl_ps(p, p));
+    p = _mm_max_ss(p, _mm_shuffle_ps(p, p, 1));
+    s0 = _mm_add_ps(s0, s1);
+    s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+    s0 = _mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1));
+    *peak = qMax(*peak, _mm_cvtss_f32(p));
+    *sumSquares += _mm_cvtss_f32(s0);
+    levelsScalar(samples + i, count - i, peak, sumSquares);
+}
+
+void goertzelSse2(const float *samples, qsizetype frames, int channels, const float *coefficients,
+                  float *s1, float *s2, float *energy)
+{
+    // Two independent halves of the bank, which also hides the latency of each chain
+    const __m128 cLow = _mm_loadu_ps(coefficients);
+    const __m128 cHigh = _mm_loadu_ps(coefficients + 4);
+    __m128 aLow = _mm_loadu_ps(s1);
+    __m128 aHigh = _mm_loadu_ps(s1 + 4);
+    __m128 bLow = _mm_loadu_ps(s2);
+    __m128 bHigh = _mm_loadu_ps(s2 + 4);
+    const float scale = 1.0f / float(channels);
+    float e = 0;
+    for (qsizetype f = 0; f < frames; f++) {
+        float x = 0;
+        for (int c = 0; c < channels; c++) {
+            x += samples[f * channels + c];
+        }
+        x *= scale;
+        e += x * x;
+        const __m128 v = _mm_set1_ps(x);
+        const __m128 low = _mm_sub_ps(_mm_add_ps(v, _mm_mul_ps(cLow, aLow)), bLow);
+        const __m128 high = _mm_sub_ps(_mm_add_ps(v, _mm_mul_ps(cHigh, aHigh)), bHigh);
+        bLow = aLow;
+        bHigh = aHigh;
+        aLow = low;
+        aHigh = high;
+    }
+    _mm_storeu_ps(s1, aLow);
+    _mm_storeu_ps(s1 + 4, aHigh);
+    _mm_storeu_ps(s2, bLow);
+    _mm_storeu_ps(s2 + 4, bHigh);
+    *energy += e;
+}
+#endif
+
+#ifdef OPF_HAVE_AVX2
+OPF_TARGET_AVX2
+void levelsAvx2(const float *samples, qsizetype count, float *peak, float *sumSquares)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 p = _mm256_setzero_ps();
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    qsizetype i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_loadu_ps(samples + i);
+        __m256 b = _mm256_loadu_ps(samples + i + 8);
+        p = _mm256_max_ps(p, _mm256_max_ps(_mm256_andnot_ps(sign, a), _mm256_andnot_ps(sign, b)));
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(a, a));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(b, b));
+    }
+    __m128 p4 = _mm_max_ps(_mm256_castps256_ps128(p), _mm256_extractf128_ps(p, 1));
+    p4 = _mm_max_ps(p4, _mm_movehl_ps(p4, p4));
+    p4 = _mm_max_ss(p4, _mm_shuffle_ps(p4, p4, 1));
+    s0 = _mm256_add_ps(s0, s1);
+    __m128 s4 = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    s4 = _mm_add_ps(s4, _mm_movehl_ps(s4, s4));
+    s4 = _mm_add_ss(s4, _mm_shuffle_ps(s4, s4, 1));
+    float pk = qMax(*peak, _mm_cvtss_f32(p4));
+    float sum = _mm_cvtss_f32(s4);
+    // The tail stays in this function, calling the scalar kernel would mix in non-VEX code
+    for (; i < count; i++) {
+        pk = qMax(pk, std::fabs(samples[i]));
+        sum += samples[i] * samples[i];
+    }
+    *peak = pk;
+    *sumSquares += sum;
+}
+
+OPF_TARGET_AVX2
+void goertzelAvx2(const float *samples, qsizetype frames, int channels, const float *coefficients,
+                  float *s1, float *s2, float *energy)
+{
+    const __m256 c = _mm256_loadu_ps(coefficients);
+    __m256 a = _mm256_loadu_ps(s1);
+    __m256 b = _mm256_loadu_ps(s2);
+    const float scale = 1.0f / float(channels);
+    float e = 0;
+    for (qsizetype f = 0; f < frames; f++) {
+        float x = 0;
+        for (int ch = 0; ch < channels; ch++) {
+            x += samples[f * channels + ch];
+        }
+        x *= scale;
+        e += x * x;
+        const __m256 s0 = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(x), _mm256_mul_ps(c, a)), b);
+        b = a;
+        a = s0;
+    }
+    _mm256_storeu_ps(s1, a);
+    _mm256_storeu_ps(s2, b);
+    *energy += e;
+}
+#endif
+
+LevelsFn levelsFor(Simd::Level level)
+{
+#ifdef OPF_HAVE_AVX2
+    if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+        return levelsAvx2;
+    }
+#endif
+#ifdef OPF_HAVE_SSE2
+    if (level != Simd::Level::Scalar) {
+        return levelsSse2;
+    }
+#endif
+    Q_UNUSED(level);
+    return levelsScalar;
+}
+
+GoertzelFn goertzelFor(Simd::Level level)
+{
+#ifdef OPF_HAVE_AVX2
+    if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+        return goertzelAvx2;
+    }
+#endif
+#ifdef OPF_HAVE_SSE2
+    if (level != Simd::Level::Scalar) {
+        return goertzelSse2;
+    }
+#endif
+    Q_UNUSED(level);
+    return goertzelScalar;
+}
+
+} // namespace
+
+AudioMeter &AudioMeter::getInstance()
+{
+    static AudioMeter instance;
+    return instance;
+}
+
+double AudioMeter::toDb(float linear)
+{
+    return linear > 1e-6f ? 20.0 * std::log10(double(linear)) : -120.0;
+}
+
+void AudioMeter::configure(const QAudioFormat &format, qsizetype maxBytes, Simd::Level level)
+{
+    m_format = format;
+    m_level = level;
+    const int channels = qMax(format.channelCount(), 1);
+    const qsizetype frames = qMax<qsizetype>(maxBytes / qMax(format.bytesPerFrame(), 1), 1);
+    m_decoded.assign(size_t(frames * channels), 0.0f);
+    m_blockFrames = format.sampleRate() * BLOCK_MS / 1000;
+    for (int k = 0; k < TONE_COUNT; k++) {
+        m_coefficients[k] = float(2.0 * std::cos(2.0 * PI * TONE_FREQUENCIES[k] / qMax(format.sampleRate(), 1)));
+        m_s1[k] = 0;
+        m_s2[k] = 0;
+        m_toneBlocks[k] = 0;
+    }
+    m_frames = 0;
+    m_peak = 0;
+    m_sumSquares = 0;
+    m_monoEnergy = 0;
+}
+
+void AudioMeter::process(const char *data, qsizetype size, qint64 startUs)
+{
+    if (m_blockFrames <= 0) {
+        return;
+    }
+    const int channels = m_format.channelCount();
+    const int frameBytes = m_format.bytesPerFrame();
+    const qsizetype capacity = qsizetype(m_decoded.size()) / channels;
+    const qsizetype frames = size / frameBytes;
+    const LevelsFn levels = levelsFor(m_level);
+    const GoertzelFn goertzel = goertzelFor(m_level);
+
+    for (qsizetype done = 0; done < frames;) {
+        const qsizetype count = qMin(frames - done, capacity);
+        AudioConverter::decode(m_format.sampleFormat(), data + done * frameBytes, m_decoded.data(), count * channels,
+                               m_level);
+        for (qsizetype offset = 0; offset < count;) {
+            if (m_frames == 0) {
+                m_blockStartUs = startUs + (done + offset) * 1000000 / m_format.sampleRate();
+            }
+            const qsizetype segment = qMin<qsizetype>(count - offset, m_blockFrames - m_frames);
+            const float *samples = m_decoded.data() + offset * channels;
+            float sumSquares = 0;
+            float energy = 0;
+            levels(samples, segment * channels, &m_peak, &sumSquares);
+            goertzel(samples, segment, channels, m_coefficients, m_s1, m_s2, &energy);
+            m_sumSquares += sumSquares;
+            m_monoEnergy += energy;
+            m_frames += int(segment);
+            offset += segment;
+            if (m_frames == m_blockFrames) {
+                finishBlock();
+            }
+        }
+        done += count;
+    }
+}
+
+void AudioMeter::finishBlock()
+{
+    const int frames = m_blockFrames;
+    publishLevel(m_peak, float(std::sqrt(m_sumSquares / (double(frames) * m_format.channelCount()))), m_blockStartUs);
+
+    const bool loud = std::sqrt(m_monoEnergy / frames) >= MIN_TONE_RMS;
+    for (int k = 0; k < TONE_COUNT; k++) {
+        const double a = m_s1[k];
+        const double b = m_s2[k];
+        const double power = a * a + b * b - m_coefficients[k] * a * b;
+        // A sine at the tone frequency has all of the energy, which gives 1
+        const double share = loud && TONE_FREQUENCIES[k] * 2 < m_format.sampleRate()
+                                 ? 2.0 * power / (double(frames) * m_monoEnergy)
+                                 : 0.0;
+        if (share >= (m_toneBlocks[k] > 0 ? TONE_HOLD : TONE_START)) {
+            if (m_toneBlocks[k]++ == 0) {
+                m_toneStartUs[k] = m_blockStartUs;
+            }
+        } else if (m_toneBlocks[k] > 0) {
+            const int durationMs = int(qint64(m_toneBlocks[k]) * frames * 1000 / m_format.sampleRate());
+            if (durationMs >= MIN_BEEP_MS) {
+                publishBeep(TONE_FREQUENCIES[k], m_toneStartUs[k], durationMs);
+            }
+            m_toneBlocks[k] = 0;
+        }
+        m_s1[k] = 0;
+        m_s2[k] = 0;
+    }
+
+    m_frames = 0;
+    m_peak = 0;
+    m_sumSquares = 0;
+    m_monoEnergy = 0;
+}
+
+/*
+ * The slot's number is cleared while its fields change, a reader that sees
+ * the same number before and after reading them has a consistent copy
+ */
+void AudioMeter::publishLevel(float peak, float rms, qint64 timestampUs)
+{
+    const quint64 number = m_levelCount.load(std::memory_order_relaxed) + 1;
+    LevelSlot &slot = m_levels[number % LEVEL_HISTORY];
+    slot.number.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.peak.store(peak, std::memory_order_relaxed);
+    slot.rms.store(rms, std::memory_order_relaxed);
+    slot.timestampUs.store(timestampUs, std::memory_order_relaxed);
+    slot.number.store(number, std::memory_order_release);
+    m_levelCount.store(number, std::memory_order_release);
+}
+
+void AudioMeter::publishBeep(float frequency, qint64 startUs, int durationMs)
+{
+    const quint64 number = m_beepCount.load(std::memory_order_relaxed) + 1;
+    BeepSlot &slot = m_beeps[number % BEEP_HISTORY];
+    slot.number.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.frequency.store(frequency, std::memory_order_relaxed);
+    slot.startUs.store(startUs, std::memory_order_relaxed);
+    slot.durationMs.store(durationMs, std::memory_order_relaxed);
+    slot.number.store(number, std::memory_order_release);
+    m_beepCount.store(number, std::memory_order_release);
+}
+
+bool AudioMeter::latestLevel(Level *level) const
+{
+    const quint64 newest = levelCount();
+    return newest > 0 && levelSince(newest - 1, level);
+}
+
+bool AudioMeter::levelSince(quint64 after, Level *level) const
+{
+    const quint64 newest = levelCount();
+    const quint64 first = qMax(after + 1, newest >= LEVEL_HISTORY ? newest - LEVEL_HISTORY + 1 : quint64(1));
+    int blocks = 0;
+    double meanSquares = 0;
+    Level result;
+    for (quint64 number = first; number <= newest; number++) {
+        const LevelSlot &slot = m_levels[number % LEVEL_HISTORY];
+        if (slot.number.load(std::memory_order_acquire) != number) {
+            continue;
+        }
+        const float peak = slot.peak.load(std::memory_order_relaxed);
+        const float rms = slot.rms.load(std::memory_order_relaxed);
+        const qint64 timestampUs = slot.timestampUs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.number.load(std::memory_order_relaxed) != number) {
+            continue;
+        }
+        if (blocks++ == 0) {
+            result.timestampUs = timestampUs;
+        }
+        result.peak = qMax(result.peak, peak);
+        meanSquares += double(rms) * rms;
+    }
+    if (blocks == 0) {
+        return false;
+    }
+    result.rms = float(std::sqrt(meanSquares / blocks));
+    *level = result;
+    return true;
+}
+
+bool AudioMeter::beep(quint64 number, Beep *beep) const
+{
+    const BeepSlot &slot = m_beeps[number % BEEP_HISTORY];
+    if (number == 0 || slot.number.load(std::memory_order_acquire) != number) {
+        return false;
+    }
+    Beep result;
+    result.frequency = slot.frequency.load(std::memory_order_relaxed);
+    result.startUs = slot.startUs.load(std::memory_order_relaxed);
+    result.durationMs = slot.durationMs.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.number.load(std::memory_order_relaxed) != number) {
+        return false;
+    }
+    *beep = result;
+    return true;
+}
+
+void AudioMeter::runBenchmark()
+{
+    QAudioFormat format;
+    format.setSampleRate(48000);
+    format.setChannelCount(2);
+    format.setSampleFormat(QAudioFormat::Int16);
+
+    // Beeps of 1 kHz, 100 ms on and 100 ms off, over some noise
+    const int seconds = 2;
+    std::vector<char> source(size_t(format.bytesForDuration(seconds * 1000000)));
+    qint16 *samples = reinterpret_cast<qint16 *>(source.data());
+    for (size_t i = 0; i < source.size() / 2; i++) {
+        const size_t frame = i / 2;
+        const bool on = (frame / 4800) % 2 == 0;
+        samples[i] = qint16((on ? 12000 * std::sin(2.0 * PI * 1000.0 * double(frame) / 48000.0) : 0)
+                            + int((i * 7919) % 512) - 256);
+    }
+
+    const qsizetype buffer = format.bytesForDuration(10000);
+    const qsizetype buffers = qsizetype(source.size()) / buffer;
+    const int rounds = 50;
+    const Simd::Level levels[] = {Simd::Level::Scalar, Simd::Level::Sse2, Simd::Level::Avx2};
+    for (Simd::Level level : levels) {
+        if (!Simd::isSupported(level)) {
+            continue;
+        }
+        AudioMeter meter;
+        meter.configure(format, buffer, level);
+        QElapsedTimer timer;
+        timer.start();
+        for (int round = 0; round < rounds; round++) {
+            for (qsizetype i = 0; i < buffers; i++) {
+                meter.process(source.data() + i * buffer, buffer, (round * buffers + i) * 10000);
+            }
+        }
+        const double us = timer.nsecsElapsed() / (rounds * buffers * 1000.0);
+        Level level10;
+        meter.latestLevel(&level10);
+        qInfo().noquote() << QString("audiometer %1 10 ms buffer: %2 us, %3% of the period, %4 beeps, peak %5 dB")
+                                 .arg(Simd::levelName(level), -6)
+                                 .arg(us, 0, 'f', 2)
+                                 .arg(100.0 * us / 10000.0, 0, 'f', 3)
+                                 .arg(meter.beepCount())
+                                 .arg(toDb(level10.peak), 0, 'f', 1);
+    }
+}
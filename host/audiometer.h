@@ -0,0 +1,137 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef AUDIOMETER_H
+#define AUDIOMETER_H
+
+#include <QAudioFormat>
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+
+#include "simd.h"
+
+/*
+ * Level meter and beep detector on the captured audio.
+ *
+ * The audio thread feeds every capture buffer through process(). The samples
+ * are decoded to float and cut into blocks of BLOCK_MS. For every block the
+ * meter publishes the peak and RMS level over all channels, and a bank of
+ * Goertzel filters measures how much of the block's energy lies at each of
+ * TONE_COUNT fixed frequencies, the usual pitches of PC speaker POST beeps
+ * and boot chimes. The filters run side by side in one vector register, so
+ * the whole bank costs about as much as a single filter. A tone that holds
+ * most of the energy for MIN_BEEP_MS or longer is published as a beep when it
+ * ends.
+ *
+ * Blocks and beeps go into small rings of slots guarded by sequence numbers,
+ * process() never blocks or allocates and readers on any thread never see a
+ * half written slot.
+ */
+class AudioMeter
+{
+public:
+    static const int BLOCK_MS = 20;
+    static const int TONE_COUNT = 8;
+    static constexpr float TONE_FREQUENCIES[TONE_COUNT] = {440, 600, 750, 880, 1000, 1500, 2000, 3000};
+    // A filter over one block is 1000 / BLOCK_MS Hz wide, a tone further off
+    // than half of that loses most of its response
+    static const int TONE_TOLERANCE_HZ = 1000 / BLOCK_MS / 2;
+    static const int MIN_BEEP_MS = 40;
+    static const int LEVEL_HISTORY = 64;
+    static const int BEEP_HISTORY = 64;
+
+    struct Level {
+        float peak = 0;             // Linear, 1.0 is full scale
+        float rms = 0;
+        qint64 timestampUs = 0;     // MediaClock time of the block's start
+    };
+
+    struct Beep {
+        float frequency = 0;
+        qint64 startUs = 0;         // MediaClock time
+        int durationMs = 0;
+    };
+
+    static AudioMeter &getInstance();
+
+    // Audio thread side. maxBytes is the largest buffer process() will see.
+    void configure(const QAudioFormat &format, qsizetype maxBytes, Simd::Level level = Simd::bestLevel());
+    void process(const char *data, qsizetype size, qint64 startUs);
+
+    // Blocks and beeps are numbered from 1, the counts are the newest numbers
+    quint64 levelCount() const { return m_levelCount.load(std::memory_order_acquire); }
+    quint64 beepCount() const { return m_beepCount.load(std::memory_order_acquire); }
+    // The newest block, false before the first one
+    bool latestLevel(Level *level) const;
+    // Highest peak and mean RMS of the blocks after block number after, false when there are none
+    bool levelSince(quint64 after, Level *level) const;
+    // Beep number number, false when it is not published yet or already overwritten
+    bool beep(quint64 number, Beep *beep) const;
+
+    static double toDb(float linear);
+
+    // Prints the cost of metering 10 ms buffers of 48 kHz stereo Int16
+    static void runBenchmark();
+
+private:
+    struct LevelSlot {
+        std::atomic<quint64> number{0};
+        std::atomic<float> peak{0};
+        std::atomic<float> rms{0};
+        std::atomic<qint64> timestampUs{0};
+    };
+
+    struct BeepSlot {
+        std::atomic<quint64> number{0};
+        std::atomic<float> frequency{0};
+        std::atomic<qint64> startUs{0};
+        std::atomic<int> durationMs{0};
+    };
+
+    void finishBlock();
+    void publishLevel(float peak, float rms, qint64 timestampUs);
+    void publishBeep(float frequency, qint64 startUs, int durationMs);
+
+    // Only touched from the audio thread
+    QAudioFormat m_format;
+    Simd::Level m_level = Simd::Level::Scalar;
+    std::vector<float> m_decoded;
+    int m_blockFrames = 0;
+    int m_frames = 0;                       // In the current block
+    qint64 m_blockStartUs = 0;
+    float m_peak = 0;
+    double m_sumSquares = 0;
+    double m_monoEnergy = 0;
+    alignas(32) float m_coefficients[TONE_COUNT] = {};
+    alignas(32) float m_s1[TONE_COUNT] = {};
+    alignas(32) float m_s2[TONE_COUNT] = {};
+    int m_toneBlocks[TONE_COUNT] = {};      // Consecutive blocks the tone held
+    qint64 m_toneStartUs[TONE_COUNT] = {};
+
+    LevelSlot m_levels[LEVEL_HISTORY];
+    BeepSlot m_beeps[BEEP_HISTORY];
+    std::atomic<quint64> m_levelCount{0};
+    std::atomic<quint64> m_beepCount{0};
+};
+
+#endif // AUDIOMETER_H
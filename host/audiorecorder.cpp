@@ -0,0 +1,272 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "audiorecorder.h"
+#include "audiomanager.h"
+
+#include <QFileInfo>
+#include <QTimer>
+#include <QDebug>
+#include <climits>
+#include <cstring>
+
+AudioRecorder::AudioRecorder(QObject *parent)
+    : QObject(parent)
+    , m_ring(RING_BYTES)
+    , m_staging(sizeof(ChunkHeader) + size_t(MAX_CHUNK_BYTES))
+    , m_chunk(size_t(MAX_CHUNK_BYTES))
+{
+    m_thread.setObjectName("AudioRecorder");
+}
+
+AudioRecorder::~AudioRecorder()
+{
+    stop();
+}
+
+void AudioRecorder::startFile(const QString &filePath, qint64 anchorUs, AudioFileWriter::Container container)
+{
+    if (!m_thread.isRunning()) {
+        m_worker = new QObject();
+        m_worker->moveToThread(&m_thread);
+        connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+        m_thread.start(QThread::LowPriority);
+        QMetaObject::invokeMethod(m_worker, [this]() {
+            QTimer *timer = new QTimer(m_worker);
+            connect(timer, &QTimer::timeout, m_worker, [this]() { drain(); });
+            timer->start(DRAIN_INTERVAL_MS);
+        }, Qt::QueuedConnection);
+    }
+    m_armed = true;
+    QMetaObject::invokeMethod(m_worker, [this, filePath, anchorUs, container]() {
+        drain();
+        m_filePath = filePath;
+        m_pending = true;
+        m_pendingPath = filePath;
+        m_pendingAnchorUs = anchorUs;
+        m_container = container;
+        m_part = 0;
+        // An anchor the stream has already passed is served from the history right away
+        if (m_streaming && frameAt(anchorUs) <= m_streamFrames) {
+            openPending();
+        }
+    }, Qt::QueuedConnection);
+}
+
+void AudioRecorder::stop()
+{
+    if (!m_thread.isRunning()) {
+        return;
+    }
+    m_armed = false;
+    QMetaObject::invokeMethod(m_worker, [this]() {
+        drain();
+        closeFile();
+        m_pending = false;
+        m_streaming = false;
+    }, Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+    m_worker = nullptr;
+}
+
+void AudioRecorder::push(const QAudioFormat &format, const char *data, qsizetype size, qint64 startUs)
+{
+    if (!m_armed.load(std::memory_order_acquire) || size <= 0) {
+        return;
+    }
+    const qsizetype total = qsizetype(sizeof(ChunkHeader)) + size;
+    if (size > MAX_CHUNK_BYTES || m_ring.freeSpace() < total) {
+        m_droppedFrames += size / qMax(format.bytesPerFrame(), 1);
+        m_droppedChunks++;
+        return;
+    }
+    ChunkHeader header{startUs, qint32(size), qint32(qMin<qint64>(m_droppedFrames, INT_MAX)),
+                       qint32(format.sampleRate()), qint16(format.channelCount()), qint16(format.sampleFormat())};
+    m_droppedFrames = 0;
+    // A single write, so the writer never sees a header without its data
+    memcpy(m_staging.data(), &header, sizeof(header));
+    memcpy(m_staging.data() + sizeof(header), data, size_t(size));
+    m_ring.write(m_staging.data(), total);
+}
+
+void AudioRecorder::drain()
+{
+    ChunkHeader header;
+    while (m_ring.available() >= qsizetype(sizeof(header))) {
+        m_ring.read(reinterpret_cast<char *>(&header), sizeof(header));
+        m_ring.read(m_chunk.data(), header.bytes);
+
+        QAudioFormat format;
+        format.setSampleRate(header.sampleRate);
+        format.setChannelCount(header.channelCount);
+        format.setSampleFormat(QAudioFormat::SampleFormat(header.sampleFormat));
+        if (!m_streaming || format != m_format) {
+            setStreamFormat(format, header.startUs);
+        }
+        const int frameBytes = m_format.bytesPerFrame();
+        if (frameBytes <= 0) {
+            continue;
+        }
+
+        // Known losses are filled exactly, the timestamps only catch what is left
+        append(nullptr, header.droppedFrames);
+
+        const char *data = m_chunk.data();
+        qint64 frames = header.bytes / frameBytes;
+        const qint64 offsetUs = header.startUs - streamUs();
+        if (m_originChunks < ORIGIN_CHUNKS && qAbs(offsetUs) <= RESYNC_MS * 1000) {
+            // A single timestamp is off by the jitter of the capture callback, the origin is their mean
+            m_originChunks++;
+            m_streamOriginUs += offsetUs / m_originChunks;
+        } else if (offsetUs > RESYNC_MS * 1000) {
+            // Input was dropped or the capture stalled, silence keeps the timeline
+            append(nullptr, m_format.framesForDuration(offsetUs));
+        } else if (offsetUs < -RESYNC_MS * 1000) {
+            // The capture card's clock ran ahead of the MediaClock
+            const qint64 skip = qMin<qint64>(frames, m_format.framesForDuration(-offsetUs));
+            data += skip * frameBytes;
+            frames -= skip;
+        }
+        append(data, frames);
+    }
+}
+
+void AudioRecorder::setStreamFormat(const QAudioFormat &format, qint64 startUs)
+{
+    if (m_file.isOpen()) {
+        // A file holds a single format, the recording goes on in a new part
+        closeFile();
+        if (!m_pending) {
+            QFileInfo info(m_filePath);
+            m_pending = true;
+            m_pendingAnchorUs = startUs;
+            m_pendingPath = QString("%1/%2_%3.%4").arg(info.path(), info.completeBaseName())
+                                .arg(++m_part).arg(info.suffix());
+        }
+    }
+    qCDebug(log_core_host_audio) << "Recorder stream format" << format;
+    m_format = format;
+    m_streaming = true;
+    m_streamOriginUs = startUs;
+    m_streamFrames = 0;
+    m_originChunks = 1;
+    m_historyFrames = qMax<qint64>(format.framesForDuration(qint64(HISTORY_MS) * 1000), 1);
+    m_history.assign(size_t(m_historyFrames) * size_t(qMax(format.bytesPerFrame(), 1)),
+                     format.sampleFormat() == QAudioFormat::UInt8 ? char(0x80) : char(0));
+}
+
+qint64 AudioRecorder::streamUs() const
+{
+    return m_streamOriginUs + m_streamFrames * 1000000 / m_format.sampleRate();
+}
+
+qint64 AudioRecorder::frameAt(qint64 timestampUs) const
+{
+    return (timestampUs - m_streamOriginUs) * m_format.sampleRate() / 1000000;
+}
+
+// Appends to the stream, data null for silence, switching files at a pending anchor
+void AudioRecorder::append(const char *data, qint64 frames)
+{
+    if (m_pending && frameAt(m_pendingAnchorUs) < m_streamFrames + frames) {
+        const qint64 before = qBound<qint64>(0, frameAt(m_pendingAnchorUs) - m_streamFrames, frames);
+        writeStream(data, before);
+        if (data) {
+            data += before * m_format.bytesPerFrame();
+        }
+        frames -= before;
+        openPending();
+    }
+    writeStream(data, frames);
+}
+
+void AudioRecorder::writeStream(const char *data, qint64 frames)
+{
+    if (frames <= 0) {
+        return;
+    }
+    if (m_file.isOpen()) {
+        const bool ok = data ? m_file.write(data, frames) : m_file.writeSilence(frames);
+        if (!ok) {
+            qCWarning(log_core_host_audio) << "Failed to write" << m_file.fileName() << m_file.errorString();
+            closeFile();
+        }
+    }
+
+    // Only the newest m_historyFrames are kept
+    const int frameBytes = m_format.bytesPerFrame();
+    const qint64 skip = qMax<qint64>(frames - m_historyFrames, 0);
+    for (qint64 done = skip; done < frames;) {
+        const qint64 slot = (m_streamFrames + done) % m_historyFrames;
+        const qint64 count = qMin(frames - done, m_historyFrames - slot);
+        char *target = m_history.data() + slot * frameBytes;
+        if (data) {
+            memcpy(target, data + done * frameBytes, size_t(count * frameBytes));
+        } else {
+            memset(target, m_format.sampleFormat() == QAudioFormat::UInt8 ? 0x80 : 0, size_t(count * frameBytes));
+        }
+        done += count;
+    }
+    m_streamFrames += frames;
+}
+
+void AudioRecorder::openPending()
+{
+    closeFile();
+    m_pending = false;
+    if (!m_file.open(m_pendingPath, m_format, m_container)) {
+        qCWarning(log_core_host_audio) << "Failed to open" << m_pendingPath << m_file.errorString();
+        return;
+    }
+
+    // Audio from before the anchor that was already written comes from the
+    // history, what is older than the history or the capture becomes silence
+    const qint64 anchor = frameAt(m_pendingAnchorUs);
+    const qint64 historyStart = qMax<qint64>(m_streamFrames - m_historyFrames, 0);
+    if (anchor < historyStart) {
+        m_file.writeSilence(historyStart - anchor);
+    }
+    const int frameBytes = m_format.bytesPerFrame();
+    for (qint64 frame = qMax(anchor, historyStart); frame < m_streamFrames;) {
+        const qint64 slot = frame % m_historyFrames;
+        const qint64 count = qMin(m_streamFrames - frame, m_historyFrames - slot);
+        m_file.write(m_history.data() + slot * frameBytes, count);
+        frame += count;
+    }
+    qCDebug(log_core_host_audio) << "Recording audio to" << m_pendingPath << "from"
+                                 << (m_streamFrames - anchor) * 1000 / m_format.sampleRate() << "ms back";
+    emit fileStarted(m_pendingPath);
+}
+
+void AudioRecorder::closeFile()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    const QString filePath = m_file.fileName();
+    const qint64 frames = m_file.frameCount();
+    const bool ok = m_file.close();
+    qCDebug(log_core_host_audio) << "Closed" << filePath << frames << "frames," << m_droppedChunks.load()
+                                 << "buffers dropped so far";
+    emit fileFinished(filePath, ok);
+}
@@ -0,0 +1,132 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef AUDIORECORDER_H
+#define AUDIORECORDER_H
+
+#include <QObject>
+#include <QAudioFormat>
+#include <QThread>
+#include <QString>
+#include <atomic>
+#include <vector>
+
+#include "audioringbuffer.h"
+#include "audiofilewriter.h"
+
+/*
+ * Records the captured audio next to the video recording.
+ *
+ * The audio thread hands every capture buffer to push(), which copies it
+ * into a preallocated lock-free ring together with its capture time on the
+ * MediaClock and returns. When the ring is full the buffer is dropped, the
+ * passthrough is never held up, and the writer is told how much it missed.
+ * A writer thread drains the ring a few times
+ * a second and writes WAV or FLAC.
+ *
+ * The written stream follows the MediaClock: gaps in the capture are filled
+ * with silence and input that runs ahead of the clock is dropped, so a
+ * sample's position in the file always maps back to its capture time. A file
+ * starts at an anchor time, normally the first frame of a video segment, and
+ * the last seconds of audio are kept on the writer thread so an anchor that
+ * is already in the past still gets its audio. Both files then start at the
+ * same instant and can be muxed without an offset.
+ */
+class AudioRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const qsizetype RING_BYTES = 4 * 1024 * 1024;
+    static const qsizetype MAX_CHUNK_BYTES = 256 * 1024;
+    static const int HISTORY_MS = 2000;
+    static const int DRAIN_INTERVAL_MS = 50;
+    // Timing error of the capture timestamps that is left alone
+    static const int RESYNC_MS = 50;
+    // Capture timestamps averaged into the start time of the stream
+    static const int ORIGIN_CHUNKS = 32;
+
+    explicit AudioRecorder(QObject *parent = nullptr);
+    ~AudioRecorder();
+
+    // Ends the current file, the new one starts with the audio captured at anchorUs
+    void startFile(const QString &filePath, qint64 anchorUs, AudioFileWriter::Container container);
+    void stop();
+    bool isRecording() const { return m_armed.load(); }
+    quint64 droppedChunks() const { return m_droppedChunks.load(); }
+
+    // Audio thread side, never blocks. startUs is the capture time of the first frame.
+    void push(const QAudioFormat &format, const char *data, qsizetype size, qint64 startUs);
+
+signals:
+    // Emitted from the writer thread
+    void fileStarted(const QString &filePath);
+    void fileFinished(const QString &filePath, bool success);
+
+private:
+    struct ChunkHeader {
+        qint64 startUs;
+        qint32 bytes;
+        qint32 droppedFrames;           // Lost for lack of room since the last chunk
+        qint32 sampleRate;
+        qint16 channelCount;
+        qint16 sampleFormat;
+    };
+
+    void drain();
+    void setStreamFormat(const QAudioFormat &format, qint64 startUs);
+    void append(const char *data, qint64 frames);
+    void writeStream(const char *data, qint64 frames);
+    void openPending();
+    void closeFile();
+    qint64 streamUs() const;
+    qint64 frameAt(qint64 timestampUs) const;
+
+    QThread m_thread;
+    QObject *m_worker = nullptr;
+    AudioRingBuffer m_ring;
+    std::atomic<bool> m_armed{false};
+    std::atomic<quint64> m_droppedChunks{0};
+
+    // Only touched from the audio thread
+    std::vector<char> m_staging;
+    qint64 m_droppedFrames = 0;
+
+    // Only touched from the writer thread
+    std::vector<char> m_chunk;
+    QAudioFormat m_format;
+    bool m_streaming = false;
+    qint64 m_streamOriginUs = 0;
+    qint64 m_streamFrames = 0;
+    int m_originChunks = 0;
+    std::vector<char> m_history;        // Last frames of the stream, indexed by frame modulo size
+    qint64 m_historyFrames = 0;
+    AudioFileWriter m_file;
+    AudioFileWriter::Container m_container = AudioFileWriter::Container::Flac;
+    QString m_filePath;
+    bool m_pending = false;
+    QString m_pendingPath;
+    qint64 m_pendingAnchorUs = 0;
+    int m_part = 0;
+};
+
+#endif // AUDIORECORDER_H
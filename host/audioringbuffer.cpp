@@ -0,0 +1,93 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "audioringbuffer.h"
+
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer(qsizetype capacity)
+{
+    reset(capacity);
+}
+
+void AudioRingBuffer::reset(qsizetype capacity)
+{
+    quint64 size = 1;
+    while (size < quint64(qMax<qsizetype>(capacity, 1))) {
+        size <<= 1;
+    }
+    m_data.assign(size, 0);
+    m_mask = size - 1;
+    m_writeIndex.store(0, std::memory_order_relaxed);
+    m_readIndex.store(0, std::memory_order_relaxed);
+}
+
+qsizetype AudioRingBuffer::available() const
+{
+    return qsizetype(m_writeIndex.load(std::memory_order_acquire) - m_readIndex.load(std::memory_order_acquire));
+}
+
+qsizetype AudioRingBuffer::write(const char *data, qsizetype length)
+{
+    const quint64 write = m_writeIndex.load(std::memory_order_relaxed);
+    const quint64 read = m_readIndex.load(std::memory_order_acquire);
+    length = qMin<qsizetype>(length, capacity() - qsizetype(write - read));
+    if (length <= 0) {
+        return 0;
+    }
+    const qsizetype offset = qsizetype(write & m_mask);
+    const qsizetype first = qMin(length, capacity() - offset);
+    memcpy(m_data.data() + offset, data, size_t(first));
+    memcpy(m_data.data(), data + first, size_t(length - first));
+    // Publish the bytes only after they are in place
+    m_writeIndex.store(write + quint64(length), std::memory_order_release);
+    return length;
+}
+
+qsizetype AudioRingBuffer::read(char *data, qsizetype length)
+{
+    const quint64 read = m_readIndex.load(std::memory_order_relaxed);
+    const quint64 write = m_writeIndex.load(std::memory_order_acquire);
+    length = qMin<qsizetype>(length, qsizetype(write - read));
+    if (length <= 0) {
+        return 0;
+    }
+    const qsizetype offset = qsizetype(read & m_mask);
+    const qsizetype first = qMin(length, capacity() - offset);
+    memcpy(data, m_data.data() + offset, size_t(first));
+    memcpy(data + first, m_data.data(), size_t(length - first));
+    // Hand the space back only after the bytes are copied out
+    m_readIndex.store(read + quint64(length), std::memory_order_release);
+    return length;
+}
+
+qsizetype AudioRingBuffer::skip(qsizetype length)
+{
+    const quint64 read = m_readIndex.load(std::memory_order_relaxed);
+    const quint64 write = m_writeIndex.load(std::memory_order_acquire);
+    length = qMin<qsizetype>(length, qsizetype(write - read));
+    if (length <= 0) {
+        return 0;
+    }
+    m_readIndex.store(read + quint64(length), std::memory_order_release);
+    return length;
+}
@@ -0,0 +1,66 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+
+/*
+ * Byte ring between exactly one producer thread and one consumer thread.
+ *
+ * The indices only ever grow and are masked into the storage, whose size is
+ * rounded up to a power of two. The producer owns the write index and the
+ * consumer the read index, so neither side takes a lock and a slow reader
+ * never blocks the capture callback. reset() is not thread safe and must only
+ * be called while neither side is running.
+ */
+class AudioRingBuffer
+{
+public:
+    explicit AudioRingBuffer(qsizetype capacity = 0);
+
+    void reset(qsizetype capacity);
+    qsizetype capacity() const { return qsizetype(m_data.size()); }
+
+    // Bytes ready for the consumer
+    qsizetype available() const;
+    // Bytes the producer can still write
+    qsizetype freeSpace() const { return capacity() - available(); }
+
+    // Producer side, returns the number of bytes stored
+    qsizetype write(const char *data, qsizetype length);
+
+    // Consumer side, returns the number of bytes read or dropped
+    qsizetype read(char *data, qsizetype length);
+    qsizetype skip(qsizetype length);
+
+private:
+    std::vector<char> m_data;
+    quint64 m_mask = 0;
+    alignas(64) std::atomic<quint64> m_writeIndex{0};
+    alignas(64) std::atomic<quint64> m_readIndex{0};
+};
+
+#endif // AUDIORINGBUFFER_H
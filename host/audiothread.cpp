@@ -1,20 +1,70 @@
 #include "audiothread.h"
+#include "audiomanager.h"
+#include "audiometer.h"
+#include "audiorecorder.h"
+#include "mediaclock.h"
+#include <QTimer>
 #include <QDebug>
+#include <cstring>
 
-AudioThread::AudioThread(const QAudioDevice& inputDevice, 
+namespace {
+// Fraction of the new fill level taken into the running average per pull
+const double FILL_SMOOTHING = 0.02;
+// Correction for a fill level off by the whole target
+const double DRIFT_GAIN_PPM = 4000.0;
+}
+
+/*
+ * Pull mode device for the sink, every read is served from the ring
+ */
+class AudioPlaybackDevice : public QIODevice
+{
+public:
+    explicit AudioPlaybackDevice(AudioThread *thread) : m_thread(thread) {}
+
+    bool isSequential() const override { return true; }
+
+    qint64 bytesAvailable() const override
+    {
+        // Underruns are padded with silence, so there is always something to play
+        return QIODevice::bytesAvailable() + qMax<qint64>(m_thread->m_ring.available(), m_thread->m_targetBytes);
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override { return m_thread->readPlayback(data, maxSize); }
+    qint64 writeData(const char *data, qint64 maxSize) override
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(maxSize);
+        return -1;
+    }
+
+private:
+    AudioThread *m_thread;
+};
+
+AudioThread::AudioThread(const QAudioDevice& inputDevice,
+                       const QAudioDevice& outputDevice,
+                       const QAudioFormat& format,
+                       QObject* parent)
+    : AudioThread(inputDevice, outputDevice, format, format, parent)
+{
+}
+
+AudioThread::AudioThread(const QAudioDevice& inputDevice,
                        const QAudioDevice& outputDevice,
+                       const QAudioFormat& captureFormat,
                        const QAudioFormat& format,
                        QObject* parent)
     : QThread(parent)
     , m_inputDevice(inputDevice)
     , m_outputDevice(outputDevice)
+    , m_captureFormat(captureFormat)
     , m_format(format)
     , m_audioSource(nullptr)
-    , m_audioIODevice(nullptr)
-    , m_sinkIODevice(nullptr)
     , m_running(false)
-    , m_volume(1.0)
 {
+    qRegisterMetaType<AudioThread::Stats>();
 }
 
 AudioThread::~AudioThread()
@@ -26,24 +76,49 @@ AudioThread::~AudioThread()
 void AudioThread::stop()
 {
     m_running = false;
+    // Also ends an event loop that has not been entered yet
+    quit();
 }
 
 void AudioThread::setVolume(qreal volume)
 {
-    m_mutex.lock();
-    m_volume = volume;
-    if (m_audioSink) {
-        m_audioSink->setVolume(volume);
-    }
-    m_mutex.unlock();
+    m_gain.fadeTo(float(volume), AudioGain::DEFAULT_RAMP_MS);
 }
 
 qreal AudioThread::volume() const
 {
-    m_mutex.lock();
-    qreal vol = m_volume;
-    m_mutex.unlock();
-    return vol;
+    return m_gain.targetGain();
+}
+
+void AudioThread::fadeTo(qreal volume, int milliseconds)
+{
+    m_gain.fadeTo(float(volume), milliseconds);
+}
+
+void AudioThread::setMuted(bool muted)
+{
+    m_gain.setMuted(muted);
+}
+
+bool AudioThread::isMuted() const
+{
+    return m_gain.isMuted();
+}
+
+void AudioThread::setLatencyTarget(int milliseconds)
+{
+    m_latencyMs = qBound(MIN_LATENCY_MS, milliseconds, MAX_LATENCY_MS);
+}
+
+AudioThread::Stats AudioThread::stats() const
+{
+    Stats stats;
+    stats.underruns = m_underruns;
+    stats.overruns = m_overruns;
+    stats.latencyMs = m_latencyMsMeasured;
+    stats.ringMs = m_format.durationForBytes(m_ring.available()) / 1000.0;
+    stats.driftPpm = m_driftPpm;
+    return stats;
 }
 
 void AudioThread::run()
@@ -51,70 +126,202 @@ void AudioThread::run()
     m_running = true;
 
     try {
-        m_audioSource = new QAudioSource(m_inputDevice, m_format);
-        m_audioIODevice = m_audioSource->start();
+        m_frameBytes = m_format.bytesPerFrame();
+        if (m_frameBytes <= 0) {
+            emit error("Invalid audio format");
+            return;
+        }
+        const qint64 latencyUs = qint64(m_latencyMs) * 1000;
+        m_targetBytes = qMax<qsizetype>(m_format.bytesForDuration(latencyUs) / m_frameBytes * m_frameBytes, m_frameBytes);
+        // Room for a few targets, so a late pull does not lose input
+        m_ring.reset(m_targetBytes * 4);
+
+        if (!m_converter.configure(m_captureFormat, m_format)) {
+            qCWarning(log_core_host_audio) << "No conversion from" << m_captureFormat << "to" << m_format
+                                           << ", capturing in the output format";
+            m_captureFormat = m_format;
+            m_converter.configure(m_captureFormat, m_format);
+        }
+        const int captureFrameBytes = m_captureFormat.bytesPerFrame();
+        const qsizetype captureBytes = qMax<qsizetype>(m_captureFormat.bytesForDuration(latencyUs) / captureFrameBytes, 1)
+                                       * captureFrameBytes;
+        m_captureBuffer.resize(size_t(captureBytes));
+        m_convertBuffer.clear();
+        m_convertBuffer.reserve(size_t(m_converter.outputBytesFor(captureBytes)));
+        m_lastFrame.assign(size_t(m_frameBytes), 0);
+        m_gain.configure(m_format);
+        AudioMeter::getInstance().configure(m_captureFormat, captureBytes);
+        m_prebuffering = true;
+        m_averageFill = m_targetBytes;
+        m_driftAccumulator = 0;
+        m_underruns = 0;
+        m_overruns = 0;
+        m_driftPpm = 0;
+
+        m_audioSource = new QAudioSource(m_inputDevice, m_captureFormat);
+        m_audioSource->setBufferSize(m_captureFormat.bytesForDuration(latencyUs / 2));
+        QIODevice *capture = m_audioSource->start();
 
-        if (!m_audioIODevice) {
+        if (!capture) {
             emit error("Failed to start audio source");
+            delete m_audioSource;
+            m_audioSource = nullptr;
             return;
         }
 
+        AudioPlaybackDevice playback(this);
+        playback.open(QIODevice::ReadOnly);
         m_audioSink.reset(new QAudioSink(m_outputDevice, m_format));
-        m_audioSink->setVolume(m_volume);
-        m_sinkIODevice = m_audioSink->start();  // Get the IO device for writing
+        m_audioSink->setBufferSize(m_format.bytesForDuration(latencyUs / 2));
+        m_audioSink->start(&playback);
 
-        if (!m_sinkIODevice) {
+        if (m_audioSink->error() != QAudio::NoError) {
             emit error("Failed to start audio sink");
-            return;
-        }
+        } else {
+            connect(capture, &QIODevice::readyRead, capture, [this, capture]() {
+                captureReady(capture);
+            });
+
+            QTimer statsTimer;
+            connect(&statsTimer, &QTimer::timeout, &statsTimer, [this]() {
+                publishStats();
+            });
+            statsTimer.start(1000);
 
-        // Buffer for audio data
-        const int bufferSize = 4096;  // Adjust buffer size based on your needs
-        char buffer[bufferSize];
-        
-        // Main audio processing loop
-        while (m_running) {
-            // Check if there's data available to read
-            if (m_audioIODevice->bytesAvailable() > 0) {
-                // Read audio data from source
-                qint64 bytesRead = m_audioIODevice->read(buffer, bufferSize);
-                
-                if (bytesRead > 0) {                    
-                    // Write processed data to sink's IO device
-                    qint64 bytesWritten = m_sinkIODevice->write(buffer, bytesRead);
-                    
-                    if (bytesWritten != bytesRead) {
-                        qDebug() << "Audio write mismatch:" << bytesWritten << "vs" << bytesRead;
-                    }
-                }
-            } else {
-                // No data available, sleep briefly to prevent CPU hogging
-                QThread::usleep(100);  // Sleep for 100 microseconds
+            qCDebug(log_core_host_audio) << "Audio passthrough started, latency target" << m_latencyMs
+                                         << "ms, ring" << m_ring.capacity() << "bytes"
+                                         << (m_converter.isPassthrough() ? "" : ", converting from") << m_captureFormat;
+            // Sleeps until one of the devices needs service or stop() is called
+            if (m_running) {
+                exec();
             }
         }
 
         // Cleanup
-        if (m_audioSource) {
-            qDebug() << "Stopping audio source.";
-            m_audioSource->stop();
-            delete m_audioSource;
-            m_audioSource = nullptr;
-        }
+        qCDebug(log_core_host_audio) << "Stopping audio passthrough, underruns" << m_underruns
+                                     << "overruns" << m_overruns;
+        m_audioSink->stop();
+        m_audioSource->stop();
+        delete m_audioSource;
+        m_audioSource = nullptr;
+        m_audioSink.reset();
+        playback.close();
 
-        if (m_audioIODevice) {
-            qDebug() << "Closing audio IO device.";
-            m_audioIODevice->close();
-            m_audioIODevice = nullptr;
+    } catch (const std::exception& e) {
+        emit error(QString("Audio thread exception: %1").arg(e.what()));
+    }
+}
+
+void AudioThread::captureReady(QIODevice *capture)
+{
+    AudioRecorder *recorder = m_recorder.load(std::memory_order_acquire);
+    qint64 size;
+    while ((size = capture->read(m_captureBuffer.data(), qint64(m_captureBuffer.size()))) > 0) {
+        const char *data = m_captureBuffer.data();
+        // The buffer ends where the data still waiting in the source begins
+        const qint64 startUs = MediaClock::nowUs() - m_captureFormat.durationForBytes(size + capture->bytesAvailable());
+        AudioMeter::getInstance().process(data, size, startUs);
+        if (recorder) {
+            recorder->push(m_captureFormat, data, size, startUs);
+        }
+        if (!m_converter.isPassthrough()) {
+            m_convertBuffer.clear();
+            size = m_converter.process(data, size, m_convertBuffer);
+            data = m_convertBuffer.data();
         }
+        // Whole frames only, so the channels stay in place after a drop
+        const qsizetype room = m_ring.freeSpace() / m_frameBytes * m_frameBytes;
+        if (m_ring.write(data, qMin<qsizetype>(size, room)) < size) {
+            m_overruns++;
+        }
+    }
+}
+
+qint64 AudioThread::readPlayback(char *data, qint64 maxSize)
+{
+    const qint64 length = maxSize / m_frameBytes * m_frameBytes;
+    if (length <= 0) {
+        return 0;
+    }
+    fillPlayback(data, length);
+    m_gain.process(data, length / m_frameBytes);
+    return length;
+}
 
-        if (m_sinkIODevice) {
-            m_sinkIODevice->close();
-            m_sinkIODevice = nullptr;
+void AudioThread::fillPlayback(char *data, qint64 length)
+{
+    const int frame = m_frameBytes;
+    if (m_prebuffering) {
+        if (m_ring.available() < m_targetBytes) {
+            fillSilence(data, length);
+            return;
         }
+        m_prebuffering = false;
+        m_averageFill = m_targetBytes;
+        m_driftAccumulator = 0;
+    }
 
-        m_audioSink.reset();
+    // After a stall of the output, catching up through drift correction would take minutes
+    const qsizetype queued = m_ring.available();
+    if (queued > 3 * m_targetBytes) {
+        m_ring.skip((queued - m_targetBytes) / frame * frame);
+        m_averageFill = m_targetBytes;
+        m_overruns++;
+    }
 
-    } catch (const std::exception& e) {
-        emit error(QString("Audio thread exception: %1").arg(e.what()));
+    updateDrift();
+    m_driftAccumulator += double(length / frame) * m_driftPpm / 1e6;
+    // One frame more (dropped) or less (repeated) than the sink asked for
+    int adjust = 0;
+    if (m_driftAccumulator >= 1.0) {
+        adjust = 1;
+    } else if (m_driftAccumulator <= -1.0) {
+        adjust = -1;
+    }
+    m_driftAccumulator -= adjust;
+
+    const qint64 wanted = adjust < 0 ? length - frame : length;
+    const qsizetype ready = m_ring.available() / frame * frame;
+    const qint64 got = m_ring.read(data, qMin<qint64>(wanted, ready));
+    if (got < wanted) {
+        fillSilence(data + got, length - got);
+        m_underruns++;
+        m_prebuffering = true;
+        return;
+    }
+
+    if (got >= frame) {
+        memcpy(m_lastFrame.data(), data + got - frame, size_t(frame));
+    }
+    if (adjust < 0) {
+        memcpy(data + got, m_lastFrame.data(), size_t(frame));
+    } else if (adjust > 0) {
+        m_ring.skip(frame);
+    }
+}
+
+void AudioThread::fillSilence(char *data, qint64 size) const
+{
+    memset(data, m_format.sampleFormat() == QAudioFormat::UInt8 ? 0x80 : 0, size_t(size));
+}
+
+void AudioThread::updateDrift()
+{
+    m_averageFill += (m_ring.available() - m_averageFill) * FILL_SMOOTHING;
+    // Above the target the source clock is faster than the sink's
+    const double error = (m_averageFill - m_targetBytes) / m_targetBytes;
+    m_driftPpm = qBound(-MAX_DRIFT_PPM, error * DRIFT_GAIN_PPM, MAX_DRIFT_PPM);
+}
+
+void AudioThread::publishStats()
+{
+    qint64 buffered = m_ring.available();
+    if (m_audioSource) {
+        buffered += m_format.bytesForDuration(m_captureFormat.durationForBytes(m_audioSource->bytesAvailable()));
+    }
+    if (m_audioSink) {
+        buffered += m_audioSink->bufferSize() - m_audioSink->bytesFree();
     }
+    m_latencyMsMeasured = m_format.durationForBytes(buffered) / 1000.0;
+    emit statsUpdated(stats());
 }
@@ -6,39 +6,127 @@
 #include <QAudioSink>
 #include <QAudioDevice>
 #include <QAudioFormat>
-#include <QMutex>
+#include <atomic>
+#include <vector>
 
+#include "audioringbuffer.h"
+#include "audioconverter.h"
+#include "audiogain.h"
+
+class AudioRecorder;
+
+/*
+ * Plays the capture card's audio input on the host output device.
+ *
+ * The input is captured in its own format and run through an AudioConverter
+ * when that differs from the output format, so the backend never has to
+ * convert, or refuse to.
+ *
+ * The thread runs an event loop. The source notifies readyRead and its data
+ * goes into a lock-free ring, the sink pulls from the ring whenever its
+ * buffer has room, so nothing polls. The ring is kept filled to the latency
+ * target: the two devices run on different clocks, and the fill level is
+ * steered back to the target by dropping or repeating a single frame now and
+ * then, at most MAX_DRIFT_PPM. An empty ring plays silence and waits for the
+ * target fill again, a full one drops the new input.
+ *
+ * Volume, mute and fades are applied per sample as the sink pulls, the
+ * setters only store atomics and are safe to call from any thread.
+ */
 class AudioThread : public QThread {
     Q_OBJECT
 
 public:
-    AudioThread(const QAudioDevice& inputDevice, 
+    struct Stats {
+        quint64 underruns = 0;      // Times the sink found the ring empty
+        quint64 overruns = 0;       // Times input was dropped for lack of room
+        double latencyMs = 0;       // Source, ring and sink buffers together
+        double ringMs = 0;          // Ring fill alone
+        double driftPpm = 0;        // Current correction, positive drops frames
+    };
+
+    static const int DEFAULT_LATENCY_MS = 40;
+    static const int MIN_LATENCY_MS = 10;
+    static const int MAX_LATENCY_MS = 500;
+    static constexpr double MAX_DRIFT_PPM = 2000.0;
+
+    AudioThread(const QAudioDevice& inputDevice,
                const QAudioDevice& outputDevice,
                const QAudioFormat& format,
                QObject* parent = nullptr);
+    // Captures in captureFormat and converts to format for the output
+    AudioThread(const QAudioDevice& inputDevice,
+               const QAudioDevice& outputDevice,
+               const QAudioFormat& captureFormat,
+               const QAudioFormat& format,
+               QObject* parent = nullptr);
     ~AudioThread();
 
     void stop();
+    // Moves to volume over a short ramp
     void setVolume(qreal volume);
     qreal volume() const;
+    void fadeTo(qreal volume, int milliseconds);
+    void setMuted(bool muted);
+    bool isMuted() const;
+
+    // Gets a copy of every capture buffer, in the capture format. nullptr detaches.
+    void setRecorder(AudioRecorder *recorder) { m_recorder.store(recorder, std::memory_order_release); }
+
+    // Ring fill to aim for, takes effect on the next start()
+    void setLatencyTarget(int milliseconds);
+    int latencyTarget() const { return m_latencyMs; }
+
+    Stats stats() const;
 
 signals:
     void error(const QString& message);
+    // Once a second while running
+    void statsUpdated(const AudioThread::Stats &stats);
 
 protected:
     void run() override;
 
 private:
+    friend class AudioPlaybackDevice;
+
+    void captureReady(QIODevice *capture);
+    qint64 readPlayback(char *data, qint64 maxSize);
+    void fillPlayback(char *data, qint64 length);
+    void fillSilence(char *data, qint64 size) const;
+    void updateDrift();
+    void publishStats();
+
     QAudioDevice m_inputDevice;
     QAudioDevice m_outputDevice;
-    QAudioFormat m_format;
+    QAudioFormat m_captureFormat;
+    QAudioFormat m_format;             // Output format, also the format in the ring
     QAudioSource* m_audioSource;
     QScopedPointer<QAudioSink> m_audioSink;
-    QIODevice* m_audioIODevice;    // For reading from source
-    QIODevice* m_sinkIODevice;     // For writing to sink
-    bool m_running;
-    mutable QMutex m_mutex;  // Make the mutex mutable so it can be locked in const functions
-    qreal m_volume;
+    std::atomic<bool> m_running;
+    AudioGain m_gain;
+    std::atomic<AudioRecorder *> m_recorder{nullptr};
+
+    int m_latencyMs = DEFAULT_LATENCY_MS;
+    AudioRingBuffer m_ring;
+    AudioConverter m_converter;
+    std::vector<char> m_captureBuffer;
+    std::vector<char> m_convertBuffer;
+    qsizetype m_targetBytes = 0;
+    int m_frameBytes = 0;
+
+    // Only touched by the consumer, the sink may pull from its own thread
+    bool m_prebuffering = true;
+    double m_averageFill = 0;
+    double m_driftAccumulator = 0;
+    std::vector<char> m_lastFrame;
+
+    std::atomic<quint64> m_underruns{0};
+    std::atomic<quint64> m_overruns{0};
+    std::atomic<double> m_driftPpm{0};
+    std::atomic<double> m_latencyMsMeasured{0};
 };
 
+Q_DECLARE_METATYPE(AudioThread::Stats)
+
 #endif // AUDIOTHREAD_H
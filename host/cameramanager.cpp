@@ -5,6 +5,9 @@
 #include <QMediaDevices>
 #include "global.h"
 #include "video/videohid.h"
+#include "video/framedistributor.h"
+#include "video/framediff.h"
+#include "video/framemetrics.h"
 #include <QVideoWidget>
 
 
@@ -16,12 +19,24 @@ CameraManager::CameraManager(QObject *parent)
 {
     qDebug() << "CameraManager init...";
     m_imageCapture = std::make_unique<QImageCapture>();
-    m_mediaRecorder = std::make_unique<QMediaRecorder>();
     connect(m_imageCapture.get(), &QImageCapture::imageCaptured, this, &CameraManager::onImageCaptured);
+    connect(&m_screenshotWriter, &ScreenshotWriter::saved, this, [this](const QString& path, bool success, qint64 elapsedUs) {
+        Q_UNUSED(elapsedUs);
+        emit screenshotSaved(path, success);
+    });
+    connect(&m_videoRecorder, &VideoRecorder::saved, this, [this](const QString& path, bool success, int frames) {
+        Q_UNUSED(frames);
+        emit recentVideoSaved(path, success);
+    });
+    connect(&m_videoRecorder, &VideoRecorder::segmentStarted, this, &CameraManager::recordingSegmentStarted);
 
 }
 
-CameraManager::~CameraManager() = default;
+CameraManager::~CameraManager()
+{
+    m_videoRecorder.stop();
+    FrameDiff::getInstance().stop();
+}
 
 void CameraManager::setCamera(const QCameraDevice &cameraDevice, QVideoWidget* videoOutput)
 {
@@ -41,7 +56,11 @@ void CameraManager::setCamera(const QCameraDevice &cameraDevice, QVideoWidget* v
 
 void CameraManager::setCameraDevice(const QCameraDevice &cameraDevice)
 {
+    // The session must not write into the sink of the source going away
+    m_captureSession.setVideoSink(nullptr);
+    m_frameSource.reset();
     m_camera.reset(new QCamera(cameraDevice));
+    m_frameSource = std::make_unique<CameraFrameSource>(m_camera.get());
     setupConnections();
     m_captureSession.setCamera(m_camera.get());
     m_captureSession.setImageCapture(m_imageCapture.get());
@@ -52,61 +71,148 @@ void CameraManager::setVideoOutput(QVideoWidget* videoOutput)
     if (videoOutput) {
         m_videoOutput = videoOutput;
         qCDebug(log_ui_camera) << "Setting video output to: " << videoOutput->objectName();
-        m_captureSession.setVideoOutput(videoOutput);
+        if (m_frameSource) {
+            m_frameSource->setVideoSink(activeSink());
+        }
+        if (m_frameSource && m_frameSource->type() == FrameSource::Type::Camera) {
+            // MJPEG is decoded by the camera source on its own pool, not by the video widget
+            m_captureSession.setVideoSink(static_cast<CameraFrameSource *>(m_frameSource.get())->captureSink());
+        } else if (m_softwarePresenter) {
+            m_captureSession.setVideoSink(&m_presenterSink);
+        } else {
+            m_captureSession.setVideoOutput(videoOutput);
+        }
+        // Other consumers read frames from the widget's sink instead of capturing
+        FrameDistributor::getInstance().attach(activeSink());
+        FrameDiff::getInstance().start();
+        m_videoRecorder.start(VideoRecorder::loadOptions());
     } else {
         qCWarning(log_ui_camera) << "Attempted to set null video output";
     }
 }
 
+void CameraManager::setSoftwarePresenter(bool enabled)
+{
+    if (enabled == m_softwarePresenter) {
+        return;
+    }
+    m_softwarePresenter = enabled;
+    qCDebug(log_ui_camera) << "Software presenter" << (enabled ? "enabled" : "disabled");
+    if (m_videoOutput) {
+        setVideoOutput(m_videoOutput);
+    }
+    emit softwarePresenterChanged(enabled);
+}
+
+QVideoSink* CameraManager::activeSink()
+{
+    if (m_softwarePresenter) {
+        return &m_presenterSink;
+    }
+    return m_videoOutput ? m_videoOutput->videoSink() : nullptr;
+}
+
 void CameraManager::startCamera()
 {
     qCDebug(log_ui_camera) << "Camera start..";
-    if (m_camera) {
-        m_camera->start();
+    if (m_frameSource) {
+        m_frameSource->start();
+        FrameMetrics::getInstance().setStreamOrigin(m_frameSource->streamOriginUs());
         qCDebug(log_ui_camera) << "Camera started";
     } else {
         qCWarning(log_ui_camera) << "Camera is null, cannot start";
     }
 }
 
+bool CameraManager::startSyntheticSource(QVideoWidget* videoOutput)
+{
+    FrameSource::Settings settings = FrameSource::loadSettings();
+    std::unique_ptr<FrameSource> source = FrameSource::create(settings);
+    if (!source) {
+        return false;
+    }
+
+    // The source writes into the video widget sink, the camera must not
+    m_captureSession.setCamera(nullptr);
+    m_captureSession.setVideoSink(nullptr);
+    m_frameSource.reset();
+    m_camera.reset();
+    m_frameSource = std::move(source);
+    connect(m_frameSource.get(), &FrameSource::activeChanged, this, &CameraManager::cameraActiveChanged);
+    connect(m_frameSource.get(), &FrameSource::errorOccurred, this, &CameraManager::cameraError);
+
+    setVideoOutput(videoOutput);
+
+    // Scripts and the input mapping see the synthetic frame as the target screen
+    GlobalVar::instance().setInputWidth(settings.size.width());
+    GlobalVar::instance().setInputHeight(settings.size.height());
+    GlobalVar::instance().setCaptureWidth(settings.size.width());
+    GlobalVar::instance().setCaptureHeight(settings.size.height());
+    GlobalVar::instance().setCaptureFps(settings.fps);
+    m_video_width = settings.size.width();
+    m_video_height = settings.size.height();
+    updateResolutions(settings.size.width(), settings.size.height(), settings.fps,
+                      settings.size.width(), settings.size.height(), settings.fps);
+
+    qCDebug(log_ui_camera) << "Using synthetic frame source:" << m_frameSource->description();
+    if (!m_frameSource->start()) {
+        // Without a source hasSyntheticSource() is false again, so the caller can set up the camera
+        qCWarning(log_ui_camera) << "Synthetic frame source failed to start, falling back to the camera";
+        m_frameSource.reset();
+        FrameDistributor::getInstance().clear();
+        return false;
+    }
+    FrameMetrics::getInstance().setStreamOrigin(m_frameSource->streamOriginUs());
+    return true;
+}
+
 void CameraManager::stopCamera()
 {
     VideoHid::getInstance().stop();
 
-    if (m_camera) {
-        m_camera->stop();
+    if (m_frameSource) {
+        m_frameSource->stop();
+        FrameDistributor::getInstance().clear();
         qCDebug(log_ui_camera) << "Camera stopped";
     } else {
         qCWarning(log_ui_camera) << "Camera is null, cannot stop";
     }
 }
 
-void CameraManager::onImageCaptured(int id, const QImage& img){
-    Q_UNUSED(id);
-    
-    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss");
+QString CameraManager::screenshotPath(const QString& folder, const QString& suffix)
+{
+    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss_zzz");
     QString picturesPath = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
     QString customFolderPath;
     if (picturesPath.isEmpty()) {
         picturesPath = QDir::currentPath();
     }
-    if(filePath==""){
+    if(folder==""){
         customFolderPath = picturesPath + "/" + "openterfaceCaptureImg";
     }else{
-        customFolderPath = filePath + "/";
+        customFolderPath = folder + "/";
         customFolderPath = customFolderPath.trimmed();
     }
-    
+
     QDir dir(customFolderPath);
-    if (!dir.exists() && filePath=="") {
+    if (!dir.exists() && folder=="") {
         qCDebug(log_ui_camera) << "Directory do not exist";
         if (!dir.mkpath(".")) {
             qCDebug(log_ui_camera) << "Failed to create directory: " << customFolderPath;
-            return;
+            return QString();
         }
     }
-    
-    QString saveName = customFolderPath + "/" + timestamp + ".png";
+
+    return customFolderPath + "/" + timestamp + "." + suffix;
+}
+
+void CameraManager::onImageCaptured(int id, const QImage& img){
+    Q_UNUSED(id);
+
+    QString saveName = screenshotPath(filePath, "png");
+    if (saveName.isEmpty()) {
+        return;
+    }
 
     QImage coayImage = img.copy(copyRect);
     if(coayImage.save(saveName)){
@@ -117,8 +223,33 @@ void CameraManager::onImageCaptured(int id, const QImage& img){
     copyRect = QRect(0, 0, m_video_width, m_video_height);
 }
 
+/*
+ * Save the newest frame seen by the frame distributor. The frame is only
+ * referenced here, cropping, conversion and encoding happen on the
+ * screenshot writer's pool. Returns false when no frame is available so the
+ * caller can fall back to QImageCapture.
+ */
+bool CameraManager::captureFromFrame(const QString& folder, const QRect& area)
+{
+    FrameDistributor::Frame frame = FrameDistributor::getInstance().latestFrame();
+    if (!frame.isValid()) {
+        return false;
+    }
+
+    ScreenshotWriter::Options options = ScreenshotWriter::loadOptions();
+    QString saveName = screenshotPath(folder, ScreenshotWriter::suffixFor(options.format));
+    if (saveName.isEmpty()) {
+        return true;
+    }
+    m_screenshotWriter.capture(frame.frame, area, saveName, options);
+    return true;
+}
+
 void CameraManager::takeImage(const QString& file)
 {
+    if (captureFromFrame(file, QRect())) {
+        return;
+    }
     if (m_imageCapture && m_camera && m_camera->isActive()) {
         if (m_imageCapture->isReadyForCapture()) {
             filePath = file;
@@ -133,6 +264,9 @@ void CameraManager::takeImage(const QString& file)
 }
 
 void CameraManager::takeAreaImage(const QString& file, const QRect& captureArea){
+    if (captureFromFrame(file, captureArea)) {
+        return;
+    }
     if (m_imageCapture && m_camera && m_camera->isActive()) {
         if (m_imageCapture->isReadyForCapture()) {
             filePath = file;
@@ -147,18 +281,52 @@ void CameraManager::takeAreaImage(const QString& file, const QRect& captureArea)
     }
 }
 
+QString CameraManager::recordingFolder(const QString& folder)
+{
+    if (!folder.trimmed().isEmpty()) {
+        return folder.trimmed();
+    }
+    QString moviesPath = QStandardPaths::writableLocation(QStandardPaths::MoviesLocation);
+    if (moviesPath.isEmpty()) {
+        moviesPath = QDir::currentPath();
+    }
+    return moviesPath + "/openterfaceRecordings";
+}
+
+/*
+ * Continuous recording, written as fixed length segments by the video
+ * recorder from the same encoded frames that feed the pre-roll ring.
+ */
 void CameraManager::startRecording()
 {
-    if (m_mediaRecorder) {
-        m_mediaRecorder->record();
+    if (m_videoRecorder.isRecordingSegments()) {
+        return;
+    }
+    m_videoRecorder.startSegments(recordingFolder(QString()));
+    if (m_videoRecorder.isRecordingSegments()) {
+        emit recordingStarted();
     }
 }
 
 void CameraManager::stopRecording()
 {
-    if (m_mediaRecorder) {
-        m_mediaRecorder->stop();
+    if (m_videoRecorder.isRecordingSegments()) {
+        m_videoRecorder.stopSegments();
+        emit recordingStopped();
+    }
+}
+
+void CameraManager::saveRecentVideo(const QString& folder)
+{
+    QString dirPath = recordingFolder(folder);
+    if (!QDir().mkpath(dirPath)) {
+        qCWarning(log_ui_camera) << "Failed to create directory:" << dirPath;
+        emit recentVideoSaved(dirPath, false);
+        return;
     }
+    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss_zzz");
+    VideoRecorder::Options options = VideoRecorder::loadOptions();
+    m_videoRecorder.saveLast(options.prerollSeconds, dirPath + "/replay_" + timestamp + ".avi");
 }
 
 void CameraManager::setupConnections()
@@ -182,18 +350,6 @@ void CameraManager::setupConnections()
     } else {
         qCWarning(log_ui_camera) << "Image capture is null";
     }
-
-    if (m_mediaRecorder) {
-        connect(m_mediaRecorder.get(), &QMediaRecorder::recorderStateChanged, this, [this](QMediaRecorder::RecorderState state) {
-            if (state == QMediaRecorder::RecordingState) {
-                emit recordingStarted();
-            } else if (state == QMediaRecorder::StoppedState) {
-                emit recordingStopped();
-            }
-        });
-    } else {
-        qCWarning(log_ui_camera) << "Media recorder is null";
-    }
 }
 
 void CameraManager::setCameraFormat(const QCameraFormat &format) {
@@ -213,6 +369,9 @@ QList<QCameraFormat> CameraManager::getCameraFormats() const {
 void CameraManager::loadCameraSettingAndSetCamera()
 {
     qCDebug(log_ui_camera) << "Load camera setting and set camera";
+    if (hasSyntheticSource()) {
+        return;
+    }
     QSettings settings("Techxartisan", "Openterface");
     QString configDeviceDescription = settings.value("camera/device", "Openterface").toString();
     
@@ -248,6 +407,9 @@ void CameraManager::loadCameraSettingAndSetCamera()
 
 void CameraManager::queryResolutions()
 {
+    if (hasSyntheticSource()) {
+        return;     // Set from the source settings, there is no capture card to ask
+    }
     QPair<int, int> resolution = VideoHid::getInstance().getResolution();
     qCDebug(log_ui_camera) << "Input resolution: " << resolution;
     GlobalVar::instance().setInputWidth(resolution.first);
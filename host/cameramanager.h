@@ -5,12 +5,16 @@
 #include <QCamera>
 #include <QMediaCaptureSession>
 #include <QImageCapture>
-#include <QMediaRecorder>
 #include <QVideoWidget>  // Add this include
+#include <QVideoSink>
 #include <QDir>
 #include <QImageCapture>
 #include <QStandardPaths>
 #include <QRect>
+#include "video/screenshotwriter.h"
+#include "video/framesource.h"
+#include "video/videorecorder.h"
+#include <memory>
 
 class CameraManager : public QObject
 {
@@ -24,12 +28,24 @@ public:
     void setCameraDevice(const QCameraDevice &cameraDevice);
     void startCamera();
     void stopCamera();
+    // Start the test pattern or file source configured in the settings or on
+    // the command line instead of the camera. Returns false when the camera is
+    // configured or the source fails to start, the caller then sets up the camera.
+    bool startSyntheticSource(QVideoWidget* videoOutput);
+    bool hasSyntheticSource() const { return m_frameSource && m_frameSource->type() != FrameSource::Type::Camera; }
     void takeImage(const QString& file);
     void takeAreaImage(const QString& file, const QRect& captureArea);
     void startRecording();
     void stopRecording();
+    bool isRecording() const { return m_videoRecorder.isRecordingSegments(); }
+    // Save the pre-roll ring, the last seconds of video, into folder
+    void saveRecentVideo(const QString& folder);
     QCamera* getCamera() const { return m_camera.get(); }
     void setVideoOutput(QVideoWidget* videoOutput);
+    // Route the frames to a plain sink for the software presenter instead of
+    // the video widget, so the backend does no conversion for display
+    void setSoftwarePresenter(bool enabled);
+    bool isSoftwarePresenter() const { return m_softwarePresenter; }
     void setCameraFormat(const QCameraFormat &format);
     QCameraFormat getCameraFormat() const;
     QList<QCameraFormat> getCameraFormats() const;
@@ -42,23 +58,36 @@ signals:
     void cameraSettingsApplied();
     void recordingStarted();
     void recordingStopped();
+    // A new video file of the recording, for recording the audio alongside
+    void recordingSegmentStarted(const QString &filePath, qint64 firstFrameUs);
     void cameraError(const QString &errorString);
     void resolutionsUpdated(int input_width, int input_height, float input_fps, int capture_width, int capture_height, int capture_fps);
     void imageCaptured(int id, const QImage& img);
+    void screenshotSaved(const QString& filePath, bool success);
+    void recentVideoSaved(const QString& filePath, bool success);
+    void softwarePresenterChanged(bool enabled);
     
 private slots:
     void onImageCaptured(int id, const QImage& img);
     
 private:
     std::unique_ptr<QCamera> m_camera;
+    std::unique_ptr<FrameSource> m_frameSource;
+    QVideoSink m_presenterSink;
     QMediaCaptureSession m_captureSession;
     std::unique_ptr<QImageCapture> m_imageCapture;
-    std::unique_ptr<QMediaRecorder> m_mediaRecorder;
-    QVideoWidget* m_videoOutput;
+    QVideoWidget* m_videoOutput = nullptr;
+    bool m_softwarePresenter = false;
     int m_video_width;
     int m_video_height;
     QString filePath;
+    ScreenshotWriter m_screenshotWriter;
+    VideoRecorder m_videoRecorder;
+    QString recordingFolder(const QString& folder);
+    QVideoSink* activeSink();
     void setupConnections();
+    QString screenshotPath(const QString& folder, const QString& suffix);
+    bool captureFromFrame(const QString& folder, const QRect& area);
     QRect copyRect;
 };
 
@@ -24,6 +24,8 @@
 #include "ui/loghandler.h"
 #include "global.h"
 #include "target/KeyboardLayouts.h"
+#include "benchmark.h"
+#include "scripts/DryRun.h"
 #include <QCoreApplication>
 
 #include <iostream>
@@ -106,6 +108,17 @@ int main(int argc, char *argv[])
     QCoreApplication::setApplicationName("Openterface Mini-KVM");
     QCoreApplication::setOrganizationName("TechxArtisan");
     QCoreApplication::setApplicationVersion(APP_VERSION);
+
+    int benchmarkIndex = app.arguments().indexOf("--benchmark");
+    if (benchmarkIndex != -1) {
+        return Benchmark::run(app.arguments().value(benchmarkIndex + 1, "all"));
+    }
+
+    int dryRunIndex = app.arguments().indexOf("--dry-run");
+    if (dryRunIndex != -1) {
+        return DryRun::runCommandLine(app.arguments().mid(dryRunIndex + 1));
+    }
+
     qDebug() << "Show window now";
     app.setWindowIcon(QIcon("://images/icon_32.png"));
     
@@ -13,6 +13,7 @@ QT       += core gui multimedia multimediawidgets serialport concurrent svg netw
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 SOURCES += main.cpp \
+    benchmark.cpp \
     target/mouseeventdto.cpp \
     host/audiomanager.cpp \
     host/cameramanager.cpp \
@@ -21,10 +22,25 @@ SOURCES += main.cpp \
     ui/settingdialog.cpp \
     ui/statuswidget.cpp \
     video/videohid.cpp \
+    video/firmwaretransfer.cpp \
+    video/eepromsimulator.cpp \
+    video/framedistributor.cpp \
+    video/frameconverter.cpp \
+    video/screenshotwriter.cpp \
+    video/framediff.cpp \
+    video/imagesearch.cpp \
+    video/pixelsearch.cpp \
+    video/framesource.cpp \
+    video/aviwriter.cpp \
+    video/videorecorder.cpp \
+    video/mjpegdecoder.cpp \
+    video/framescaler.cpp \
+    video/framemetrics.cpp \
     ui/helppane.cpp \
     ui/mainwindow.cpp \
     ui/metadatadialog.cpp \
     ui/videopane.cpp \
+    ui/videopresenter.cpp \
     ui/globalsetting.cpp \
     ui/toolbarmanager.cpp \
     ui/toggleswitch.cpp \
@@ -37,23 +53,36 @@ SOURCES += main.cpp \
     ui/videopage.cpp \
     ui/audiopage.cpp \
     ui/cameraajust.cpp \
+    ui/scripthighlighter.cpp \
     ui/scripttool.cpp \
+    ui/firmwaredialog.cpp \
     ui/TaskManager.cpp \
     host/HostManager.cpp \
     serial/SerialPortManager.cpp \
     target/KeyboardManager.cpp \
     target/MouseManager.cpp \
     host/audiothread.cpp \
+    host/audioringbuffer.cpp \
+    host/audioconverter.cpp \
+    host/audiogain.cpp \
+    host/audiofilewriter.cpp \
+    host/audiorecorder.cpp \
+    host/audiometer.cpp \
     host/usbcontrol.cpp \
     scripts/Lexer.cpp \
     scripts/Parser.cpp \
     scripts/semanticAnalyzer.cpp \
+    scripts/Compiler.cpp \
+    scripts/ScriptScheduler.cpp \
     scripts/KeyboardMouse.cpp \
+    scripts/DryRun.cpp \
     target/KeyboardLayouts.cpp \
     regex/RegularExpression.cpp \
     server/tcpServer.cpp
 
 HEADERS  += \
+    benchmark.h \
+    simd.h \
     global.h \
     target/mouseeventdto.h \
     host/audiomanager.h \
@@ -63,10 +92,27 @@ HEADERS  += \
     ui/settingdialog.h \
     ui/statuswidget.h \
     video/videohid.h \
+    video/eepromaccess.h \
+    video/firmwaretransfer.h \
+    video/eepromsimulator.h \
+    video/framedistributor.h \
+    video/frameconverter.h \
+    video/screenshotwriter.h \
+    video/framediff.h \
+    video/imagesearch.h \
+    video/pixelsearch.h \
+    video/framesource.h \
+    video/aviwriter.h \
+    video/videorecorder.h \
+    video/mjpegdecoder.h \
+    video/framescaler.h \
+    video/framemetrics.h \
+    host/mediaclock.h \
     ui/helppane.h \
     ui/mainwindow.h \
     ui/metadatadialog.h \
     ui/videopane.h \
+    ui/videopresenter.h \
     ui/globalsetting.h \
     ui/statusevents.h \
     ui/toolbarmanager.h \
@@ -80,21 +126,34 @@ HEADERS  += \
     ui/videopage.h   \
     ui/audiopage.h \
     ui/cameraajust.h \
+    ui/scripthighlighter.h \
     ui/scripttool.h \
+    ui/firmwaredialog.h \
     ui/TaskManager.h \
     host/HostManager.h \
     serial/ch9329.h \
     serial/SerialPortManager.h \
+    serial/HidSink.h \
     target/KeyboardManager.h \
     target/MouseManager.h \
     target/Keymapping.h \
     resources/version.h \
     host/audiothread.h \
+    host/audioringbuffer.h \
+    host/audioconverter.h \
+    host/audiogain.h \
+    host/audiofilewriter.h \
+    host/audiorecorder.h \
+    host/audiometer.h \
     host/usbcontrol.h \
     scripts/Lexer.h \
     scripts/Parser.h \
     scripts/semanticAnalyzer.h \
+    scripts/Bytecode.h \
+    scripts/Compiler.h \
+    scripts/ScriptScheduler.h \
     scripts/KeyboardMouse.h \
+    scripts/DryRun.h \
     target/KeyboardLayouts.h \
     regex/RegularExpression.h \ 
     server/tcpServer.h
@@ -121,6 +180,7 @@ system($$QMAKE_MKDIR $$shell_path($$OUT_PWD/config/keyboards))
 # Link against the HID library
 win32:LIBS += -lhid
 win32:LIBS += -lsetupapi
+win32:LIBS += -lwinmm
 
 win32 {
     INCLUDEPATH += $$PWD/lib
@@ -132,6 +192,17 @@ unix {
     LIBS += -lusb-1.0
 }
 
+# Optional libjpeg-turbo for the MJPEG decode stage, Qt's JPEG reader is used without it
+unix:packagesExist(libturbojpeg) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libturbojpeg
+    DEFINES += HAVE_TURBOJPEG
+}
+win32:exists($$PWD/lib/turbojpeg.h) {
+    LIBS += -L$$PWD/lib -lturbojpeg
+    DEFINES += HAVE_TURBOJPEG
+}
+
 # Set platform-specific installation paths
 win32 {
     target.path = $$(PROGRAMFILES)/openterfaceQT
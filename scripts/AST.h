@@ -34,6 +34,11 @@ enum class ASTNodeType {
     CommandStatement,
 
     StatementList,
+    Assignment,
+    If,
+    Loop,
+    Label,
+    Jump,
     // Add more node types as needed
 };
 
@@ -46,10 +51,37 @@ protected:
     std::vector<std::unique_ptr<ASTNode>> children;
 };
 
+/*
+ * A literal, a variable or an operator applied to the operand children.
+ * The value is the literal text, the variable name or the operator.
+ */
 class ExpressionNode : public ASTNode {
 public:
+    enum class Kind {
+        Number,
+        String,
+        Variable,
+        Unary,
+        Binary,
+    };
+
+    ExpressionNode(Kind kind, const QString& value) : kind(kind), value(value) {}
+    ExpressionNode(const QString& op, std::unique_ptr<ExpressionNode> operand)
+        : kind(Kind::Unary), value(op) {
+        children.push_back(std::move(operand));
+    }
+    ExpressionNode(const QString& op, std::unique_ptr<ExpressionNode> left, std::unique_ptr<ExpressionNode> right)
+        : kind(Kind::Binary), value(op) {
+        children.push_back(std::move(left));
+        children.push_back(std::move(right));
+    }
     ASTNodeType getType() const override { return ASTNodeType::Expression; }
-    // Add expression-specific members
+    Kind getKind() const { return kind; }
+    const QString& getValue() const { return value; }
+    const ExpressionNode* operand(size_t index) const { return static_cast<const ExpressionNode*>(children[index].get()); }
+private:
+    Kind kind;
+    QString value;
 };
 
 class StatementNode : public ASTNode {
@@ -82,6 +114,91 @@ public:
     }
 };
 
+// name := value, the compound forms keep their operator, e.g. "+="
+class AssignmentNode : public ASTNode {
+public:
+    AssignmentNode(const QString& name, const QString& op, std::unique_ptr<ExpressionNode> value)
+        : name(name), op(op), value(std::move(value)) {}
+    ASTNodeType getType() const override { return ASTNodeType::Assignment; }
+    const QString& getName() const { return name; }
+    const QString& getOperator() const { return op; }
+    const ExpressionNode* getValue() const { return value.get(); }
+private:
+    QString name;
+    QString op;
+    std::unique_ptr<ExpressionNode> value;
+};
+
+class IfNode : public ASTNode {
+public:
+    IfNode(std::unique_ptr<ExpressionNode> condition, std::unique_ptr<ASTNode> thenBranch, std::unique_ptr<ASTNode> elseBranch)
+        : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)) {}
+    ASTNodeType getType() const override { return ASTNodeType::If; }
+    const ExpressionNode* getCondition() const { return condition.get(); }
+    const ASTNode* getThen() const { return thenBranch.get(); }
+    // nullptr without Else
+    const ASTNode* getElse() const { return elseBranch.get(); }
+private:
+    std::unique_ptr<ExpressionNode> condition;
+    std::unique_ptr<ASTNode> thenBranch;
+    std::unique_ptr<ASTNode> elseBranch;
+};
+
+/*
+ * Loop [Count] or While Condition, both optionally followed by Until.
+ * A Loop without a count runs until Break, Until or Goto ends it.
+ */
+class LoopNode : public ASTNode {
+public:
+    enum class Kind {
+        Count,
+        While,
+    };
+
+    LoopNode(Kind kind, std::unique_ptr<ExpressionNode> expression, std::unique_ptr<ASTNode> body)
+        : kind(kind), expression(std::move(expression)), body(std::move(body)) {}
+    ASTNodeType getType() const override { return ASTNodeType::Loop; }
+    Kind getKind() const { return kind; }
+    // The count or the While condition, nullptr for an endless Loop
+    const ExpressionNode* getExpression() const { return expression.get(); }
+    const ASTNode* getBody() const { return body.get(); }
+    const ExpressionNode* getUntil() const { return until.get(); }
+    void setUntil(std::unique_ptr<ExpressionNode> condition) { until = std::move(condition); }
+private:
+    Kind kind;
+    std::unique_ptr<ExpressionNode> expression;
+    std::unique_ptr<ASTNode> body;
+    std::unique_ptr<ExpressionNode> until;
+};
+
+class LabelNode : public ASTNode {
+public:
+    LabelNode(const QString& name) : name(name) {}
+    ASTNodeType getType() const override { return ASTNodeType::Label; }
+    const QString& getName() const { return name; }
+private:
+    QString name;
+};
+
+// Goto, Break, Continue and Return
+class JumpNode : public ASTNode {
+public:
+    enum class Kind {
+        Goto,
+        Break,
+        Continue,
+        Return,
+    };
+
+    JumpNode(Kind kind, const QString& label = QString()) : kind(kind), label(label) {}
+    ASTNodeType getType() const override { return ASTNodeType::Jump; }
+    Kind getKind() const { return kind; }
+    const QString& getLabel() const { return label; }
+private:
+    Kind kind;
+    QString label;
+};
+
 // Add more specific node types as needed
 
 #endif // AST_H 
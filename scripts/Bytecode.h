@@ -0,0 +1,166 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <QRect>
+#include <QString>
+#include <QStringList>
+#include "AST.h"
+#include "KeyboardMouse.h"
+
+enum class Op : uint8_t {
+    SendReports,        // a: first report, b: report count
+    Click,              // a, b: HID coordinates, c: Qt mouse button
+    ClickAt,            // a, b: target coordinate expressions, -1 for 0, c: Qt mouse button
+    Sleep,              // a: milliseconds
+    SleepFor,           // a: milliseconds expression
+    SetLockState,       // a: LockKey, b: 1 on, 0 off
+    SetDelay,           // a: Delay, b: milliseconds, -1 for none
+    Capture,            // a: path
+    CaptureArea,        // a: path, b: rect
+    SaveRecentVideo,    // a: path
+    Command,            // a: node, run by the SemanticAnalyzer, b: template of its options, -1 without variables
+    Dynamic,            // a: template, compiled again for values it has not run with
+    Assign,             // a: variable slot, b: expression
+    Jump,               // a: target
+    JumpIf,             // a: target, b: expression, c: 1 jumps when true, 0 when false
+    LoopStart,          // a: loop, b: count expression, -1 for an endless loop
+    LoopNext,           // a: target when the count is used up, b: loop
+};
+
+enum class LockKey : uint8_t {
+    CapsLock,
+    NumLock,
+    ScrollLock,
+};
+
+enum class Delay : uint8_t {
+    Key,                // After each key
+    KeyPress,           // Between press and release
+    Mouse,              // After each click
+};
+
+// Expressions are compiled to postfix, the operators pop their operands
+enum class ExprOp : uint8_t {
+    Number,             // number
+    String,             // index: string
+    Variable,           // index: variable slot
+    LoopIndex,          // index: loop whose A_Index is read, -1 outside loops
+    Negate,
+    Not,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    FloorDivide,
+    Power,
+    Concat,
+    Equal,              // Case insensitive for strings
+    CaseEqual,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    And,
+    Or,
+};
+
+struct ExprTerm {
+    ExprOp op;
+    int index = 0;
+    double number = 0;
+};
+
+/*
+ * A script value. Like in AHK every value is text, numbers also keep the
+ * parsed number so arithmetic does not parse again. The result of arithmetic
+ * has no text until toText() formats it, a default value is an unset variable.
+ */
+struct ScriptValue {
+    QString text;
+    double number = 0;
+    bool isNumber = false;
+
+    static ScriptValue fromText(const QString& text);
+    static ScriptValue fromNumber(double number);
+    QString toText() const;
+    bool isTrue() const { return isNumber ? number != 0 : !text.isEmpty(); }
+    bool isSet() const { return isNumber || !text.isNull(); }
+};
+
+// Script coordinates are target screen pixels, the HID report uses 0 - 4096
+inline int toHidCoordinate(int value, int size)
+{
+    return size > 0 ? value * 4096 / size : value;
+}
+
+/*
+ * The options of a command that reads %variables%. A reference is kept as
+ * an expression reading the variable, so running the command only
+ * substitutes the values.
+ */
+struct CommandTemplate {
+    struct Part {
+        std::string text;       // The token, or the name of the variable
+        int expression = -1;    // -1 for a token
+    };
+    const CommandStatementNode* node;
+    std::vector<Part> parts;
+};
+
+struct Instruction {
+    Op op;
+    int a = 0;
+    int b = 0;
+    int c = 0;
+};
+
+/*
+ * A compiled script. Instructions refer to the pools by index, so running
+ * one is a switch on the opcode without any parsing. Jump targets are
+ * instruction indices, so a loop body is compiled once however often it runs.
+ */
+struct Program {
+    std::vector<Instruction> instructions;
+    std::vector<HidReport> reports;
+    QStringList strings;
+    std::vector<QRect> rects;
+    std::vector<const CommandStatementNode*> nodes;
+    std::vector<CommandTemplate> templates;
+    std::vector<std::vector<ExprTerm>> expressions;
+    // Lower case name of every variable slot
+    QStringList variables;
+    int loopCount = 0;
+    // The input resolution Click coordinates are scaled with
+    int inputWidth = 0;
+    int inputHeight = 0;
+    // Keeps the nodes alive
+    std::shared_ptr<ASTNode> tree;
+};
+
+#endif // BYTECODE_H
@@ -0,0 +1,771 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "Compiler.h"
+#include "semanticAnalyzer.h"
+#include "global.h"
+#include <QDebug>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+
+// Commands with a compiled form, the others run through SemanticAnalyzer::analyzeCommandStetement
+const QSet<QString> compiledCommands = {
+    "Send", "Click", "Sleep", "MouseMove", "SetCapsLockState", "SetNumLockState", "SetScrollLockState",
+    "SetKeyDelay", "SetMouseDelay", "FullScreenCapture", "AreaScreenCapture", "SaveRecentVideo"
+};
+
+// The lexer splits "%FoundX%" into "%", "FoundX", "%"
+bool hasVariables(const std::vector<std::string>& options)
+{
+    return std::find(options.begin(), options.end(), "%") != options.end();
+}
+
+bool isVariableReference(const std::vector<std::string>& options, size_t i)
+{
+    return options[i] == "%" && i + 2 < options.size() && options[i + 2] == "%";
+}
+
+QString joinOptions(const std::vector<std::string>& options)
+{
+    QString text;
+    for (const auto& token : options){
+        if (token != "\"") text.append(QString::fromStdString(token));
+    }
+    return text;
+}
+
+}
+
+Compiler::Compiler()
+    : inputWidth(GlobalVar::instance().getInputWidth()), inputHeight(GlobalVar::instance().getInputHeight())
+{
+}
+
+Program Compiler::compile(std::shared_ptr<ASTNode> tree)
+{
+    Program program;
+    program.tree = tree;
+    program.inputWidth = inputWidth;
+    program.inputHeight = inputHeight;
+    loops.clear();
+    labels.clear();
+    gotos.clear();
+    returns.clear();
+    variableSlots.clear();
+    compileNode(tree.get(), program);
+
+    const int end = int(program.instructions.size());
+    for (const auto& jump : gotos) {
+        // An unknown label jumps to the next instruction
+        int target = labels.value(jump.second, jump.first + 1);
+        if (!labels.contains(jump.second)) {
+            qCWarning(log_script) << "Goto to unknown label" << jump.second;
+        }
+        program.instructions[jump.first].a = target;
+    }
+    for (int jump : returns) {
+        program.instructions[jump].a = end;
+    }
+    qCDebug(log_script) << "Compiled" << program.instructions.size() << "instructions," << program.reports.size()
+                        << "HID reports," << program.expressions.size() << "expressions";
+    return program;
+}
+
+void Compiler::compileNode(const ASTNode* node, Program& program)
+{
+    if (!node) {
+        return;
+    }
+    switch (node->getType()) {
+    case ASTNodeType::CommandStatement:
+        break;
+    case ASTNodeType::Assignment:
+        compileAssignment(static_cast<const AssignmentNode*>(node), program);
+        return;
+    case ASTNodeType::If:
+        compileIf(static_cast<const IfNode*>(node), program);
+        return;
+    case ASTNodeType::Loop:
+        compileLoop(static_cast<const LoopNode*>(node), program);
+        return;
+    case ASTNodeType::Label: {
+        const QString name = static_cast<const LabelNode*>(node)->getName().toLower();
+        if (labels.contains(name)) {
+            qCWarning(log_script) << "Label" << name << "is defined twice, the first one is used";
+        } else {
+            labels.insert(name, int(program.instructions.size()));
+        }
+        return;
+    }
+    case ASTNodeType::Jump:
+        compileJump(static_cast<const JumpNode*>(node), program);
+        return;
+    default:
+        for (const auto& child : node->getChildren()) {
+            compileNode(child.get(), program);
+        }
+        return;
+    }
+
+    const auto* command = static_cast<const CommandStatementNode*>(node);
+    if (hasVariables(command->getOptions())) {
+        compileVariableCommand(command, program);
+    } else {
+        compileCommand(command, program);
+    }
+}
+
+void Compiler::compileVariableCommand(const CommandStatementNode* node, Program& program)
+{
+    const QString commandName = node->getCommandName();
+    if (!compiledCommands.contains(commandName)) {
+        program.nodes.push_back(node);
+        program.instructions.push_back({Op::Command, int(program.nodes.size()) - 1, compileTemplate(node, program)});
+    } else if (commandName == "Sleep") {
+        compileVariableSleep(node, program);
+    } else if (commandName != "Click" || !compileVariableClick(node, program)) {
+        program.instructions.push_back({Op::Dynamic, compileTemplate(node, program)});
+    }
+}
+
+int Compiler::compileTemplate(const CommandStatementNode* node, Program& program)
+{
+    const auto& options = node->getOptions();
+    CommandTemplate command{node, {}};
+    for (size_t i = 0; i < options.size(); i++) {
+        if (isVariableReference(options, i)) {
+            const QString name = QString::fromStdString(options[i + 1]);
+            command.parts.push_back({options[i + 1], addExpression({variableTerm(name, program)}, program)});
+            i += 2;
+        } else {
+            command.parts.push_back({options[i]});
+        }
+    }
+    program.templates.push_back(std::move(command));
+    return int(program.templates.size()) - 1;
+}
+
+bool Compiler::compileVariableClick(const CommandStatementNode* node, Program& program)
+{
+    const auto& options = node->getOptions();
+    // Like parseCoordinates, the last number on each side of the comma
+    std::vector<ExprTerm> coordinates[2];
+    std::vector<std::string> others;
+    int side = 0;
+    for (size_t i = 0; i < options.size(); i++) {
+        bool ok = false;
+        int value = QString::fromStdString(options[i]).toInt(&ok);
+        if (options[i] == ",") {
+            side = 1;
+        } else if (isVariableReference(options, i)) {
+            coordinates[side] = {variableTerm(QString::fromStdString(options[i + 1]), program)};
+            i += 2;
+        } else if (options[i] == "%") {
+            return false;
+        } else if (ok) {
+            ExprTerm term{ExprOp::Number};
+            term.number = value;
+            coordinates[side] = {term};
+        } else {
+            others.push_back(options[i]);
+        }
+    }
+    if (side == 0) {
+        return false;
+    }
+    const int x = coordinates[0].empty() ? -1 : addExpression(std::move(coordinates[0]), program);
+    const int y = coordinates[1].empty() ? -1 : addExpression(std::move(coordinates[1]), program);
+    program.instructions.push_back({Op::ClickAt, x, y, parseMouseButton(others)});
+    return true;
+}
+
+void Compiler::compileVariableSleep(const CommandStatementNode* node, Program& program)
+{
+    // Like compileSleep, every number or variable is a sleep
+    const auto& options = node->getOptions();
+    for (size_t i = 0; i < options.size(); i++) {
+        bool ok;
+        int sleepTime = QString::fromStdString(options[i]).toInt(&ok);
+        if (isVariableReference(options, i)) {
+            const QString name = QString::fromStdString(options[i + 1]);
+            program.instructions.push_back({Op::SleepFor, addExpression({variableTerm(name, program)}, program)});
+            i += 2;
+        } else if (ok && sleepTime >= 0) {
+            program.instructions.push_back({Op::Sleep, sleepTime});
+        }
+    }
+}
+
+void Compiler::compileAssignment(const AssignmentNode* node, Program& program)
+{
+    static const QHash<QString, ExprOp> compoundOps = {
+        {"+=", ExprOp::Add}, {"-=", ExprOp::Subtract}, {"*=", ExprOp::Multiply}, {"/=", ExprOp::Divide},
+        {".=", ExprOp::Concat},
+    };
+
+    const int slot = variableSlot(node->getName(), program);
+    std::vector<ExprTerm> terms;
+    // x += y is compiled as x := x + y
+    const bool compound = compoundOps.contains(node->getOperator());
+    if (compound) {
+        terms.push_back({ExprOp::Variable, slot});
+    }
+    appendTerms(node->getValue(), program, terms);
+    if (compound) {
+        terms.push_back({compoundOps.value(node->getOperator())});
+    }
+    program.instructions.push_back({Op::Assign, slot, addExpression(std::move(terms), program)});
+}
+
+void Compiler::compileIf(const IfNode* node, Program& program)
+{
+    const int skipThen = int(program.instructions.size());
+    program.instructions.push_back({Op::JumpIf, 0, compileExpression(node->getCondition(), program), 0});
+    compileNode(node->getThen(), program);
+    if (node->getElse()) {
+        const int skipElse = int(program.instructions.size());
+        program.instructions.push_back({Op::Jump});
+        program.instructions[skipThen].a = int(program.instructions.size());
+        compileNode(node->getElse(), program);
+        program.instructions[skipElse].a = int(program.instructions.size());
+    } else {
+        program.instructions[skipThen].a = int(program.instructions.size());
+    }
+}
+
+/*
+ * LoopStart        loop, count
+ * top: LoopNext    exit, loop
+ *      JumpIf      exit, While condition false
+ *      body
+ * next: JumpIf     exit, Until condition true
+ *      Jump        top
+ * exit:
+ *
+ * A_Index in the body, While and Until reads the loop's index, after the
+ * loop it reads the enclosing loop's again.
+ */
+void Compiler::compileLoop(const LoopNode* node, Program& program)
+{
+    const int loop = program.loopCount++;
+    const bool counted = node->getKind() == LoopNode::Kind::Count && node->getExpression();
+    program.instructions.push_back({Op::LoopStart, loop, counted ? compileExpression(node->getExpression(), program) : -1});
+
+    const int top = int(program.instructions.size());
+    program.instructions.push_back({Op::LoopNext, 0, loop});
+    loops.push_back({loop, {top}, {}});
+    if (node->getKind() == LoopNode::Kind::While) {
+        loops.back().breaks.push_back(int(program.instructions.size()));
+        program.instructions.push_back({Op::JumpIf, 0, compileExpression(node->getExpression(), program), 0});
+    }
+
+    compileNode(node->getBody(), program);
+
+    // Continue still checks Until
+    for (int jump : loops.back().continues) {
+        program.instructions[jump].a = int(program.instructions.size());
+    }
+    if (node->getUntil()) {
+        loops.back().breaks.push_back(int(program.instructions.size()));
+        program.instructions.push_back({Op::JumpIf, 0, compileExpression(node->getUntil(), program), 1});
+    }
+    program.instructions.push_back({Op::Jump, top});
+
+    for (int jump : loops.back().breaks) {
+        program.instructions[jump].a = int(program.instructions.size());
+    }
+    loops.pop_back();
+}
+
+void Compiler::compileJump(const JumpNode* node, Program& program)
+{
+    const int jump = int(program.instructions.size());
+    switch (node->getKind()) {
+    case JumpNode::Kind::Goto:
+        gotos.emplace_back(jump, node->getLabel().toLower());
+        break;
+    case JumpNode::Kind::Break:
+    case JumpNode::Kind::Continue:
+        if (loops.empty()) {
+            qCWarning(log_script) << (node->getKind() == JumpNode::Kind::Break ? "Break" : "Continue")
+                                  << "outside a loop is ignored";
+            return;
+        }
+        if (node->getKind() == JumpNode::Kind::Break) {
+            loops.back().breaks.push_back(jump);
+        } else {
+            loops.back().continues.push_back(jump);
+        }
+        break;
+    case JumpNode::Kind::Return:
+        returns.push_back(jump);
+        break;
+    }
+    program.instructions.push_back({Op::Jump});
+}
+
+int Compiler::compileExpression(const ExpressionNode* node, Program& program)
+{
+    std::vector<ExprTerm> terms;
+    appendTerms(node, program, terms);
+    return addExpression(std::move(terms), program);
+}
+
+void Compiler::appendTerms(const ExpressionNode* node, Program& program, std::vector<ExprTerm>& terms)
+{
+    static const QHash<QString, ExprOp> binaryOps = {
+        {"+", ExprOp::Add}, {"-", ExprOp::Subtract}, {"*", ExprOp::Multiply}, {"/", ExprOp::Divide},
+        {"//", ExprOp::FloorDivide}, {"**", ExprOp::Power}, {".", ExprOp::Concat}, {"=", ExprOp::Equal},
+        {"==", ExprOp::CaseEqual}, {"!=", ExprOp::NotEqual}, {"<", ExprOp::Less}, {"<=", ExprOp::LessEqual},
+        {">", ExprOp::Greater}, {">=", ExprOp::GreaterEqual}, {"&&", ExprOp::And}, {"||", ExprOp::Or},
+    };
+
+    switch (node->getKind()) {
+    case ExpressionNode::Kind::Number: {
+        bool ok;
+        double number = node->getValue().toDouble(&ok);
+        if (!ok) {
+            // Hexadecimal
+            number = double(node->getValue().toLongLong(&ok, 0));
+        }
+        ExprTerm term{ExprOp::Number};
+        term.number = number;
+        terms.push_back(term);
+        break;
+    }
+    case ExpressionNode::Kind::String:
+        terms.push_back({ExprOp::String, addString(node->getValue(), program)});
+        break;
+    case ExpressionNode::Kind::Variable:
+        terms.push_back(variableTerm(node->getValue(), program));
+        break;
+    case ExpressionNode::Kind::Unary:
+        appendTerms(node->operand(0), program, terms);
+        terms.push_back({node->getValue() == "-" ? ExprOp::Negate : ExprOp::Not});
+        break;
+    case ExpressionNode::Kind::Binary:
+        appendTerms(node->operand(0), program, terms);
+        appendTerms(node->operand(1), program, terms);
+        terms.push_back({binaryOps.value(node->getValue())});
+        break;
+    }
+}
+
+int Compiler::addString(const QString& text, Program& program)
+{
+    program.strings.append(text);
+    return int(program.strings.size()) - 1;
+}
+
+int Compiler::variableSlot(const QString& name, Program& program)
+{
+    const QString lower = name.toLower();
+    auto it = variableSlots.constFind(lower);
+    if (it != variableSlots.constEnd()) {
+        return it.value();
+    }
+    program.variables.append(lower);
+    return variableSlots[lower] = int(program.variables.size()) - 1;
+}
+
+ExprTerm Compiler::variableTerm(const QString& name, Program& program)
+{
+    if (name.compare("A_Index", Qt::CaseInsensitive) == 0) {
+        return {ExprOp::LoopIndex, currentLoop()};
+    }
+    return {ExprOp::Variable, variableSlot(name, program)};
+}
+
+int Compiler::addExpression(std::vector<ExprTerm> terms, Program& program)
+{
+    program.expressions.push_back(std::move(terms));
+    return int(program.expressions.size()) - 1;
+}
+
+void Compiler::compileCommand(const CommandStatementNode* node, Program& program)
+{
+    QString commandName = node->getCommandName();
+
+    if(commandName == "Click"){
+        compileClick(node, program);
+    } else if(commandName == "Send"){
+        compileSend(node, program);
+    } else if(commandName == "Sleep"){
+        compileSleep(node, program);
+    } else if(commandName == "MouseMove"){
+        qCDebug(log_script) << "MouseMove is not supported";
+    } else if(commandName == "SetCapsLockState"){
+        compileLockState(node, LockKey::CapsLock, program);
+    } else if(commandName == "SetNumLockState"){
+        compileLockState(node, LockKey::NumLock, program);
+    } else if(commandName == "SetScrollLockState"){
+        compileLockState(node, LockKey::ScrollLock, program);
+    } else if(commandName == "SetKeyDelay"){
+        compileDelays(node, {Delay::Key, Delay::KeyPress}, program);
+    } else if(commandName == "SetMouseDelay"){
+        compileDelays(node, {Delay::Mouse}, program);
+    } else if(commandName == "FullScreenCapture"){
+        compileFullScreenCapture(node, program);
+    } else if(commandName == "AreaScreenCapture"){
+        compileAreaScreenCapture(node, program);
+    } else if(commandName == "SaveRecentVideo"){
+        compileSaveRecentVideo(node, program);
+    } else {
+        program.nodes.push_back(node);
+        program.instructions.push_back({Op::Command, int(program.nodes.size()) - 1, -1});
+    }
+}
+
+int Compiler::toHidX(int x) const
+{
+    return toHidCoordinate(x, inputWidth);
+}
+
+int Compiler::toHidY(int y) const
+{
+    return toHidCoordinate(y, inputHeight);
+}
+
+void Compiler::compileSend(const CommandStatementNode* node, Program& program)
+{
+    const auto& options = node->getOptions();
+    if (options.empty()) {
+        qDebug(log_script) << "No keys provided for Send command";
+        return;
+    }
+
+    // Combine all tokens from the first quote into a single string
+    QString tmpKeys;
+    bool append = false;
+    for (const auto& token : options) {
+        if (token =="\"")append = true;
+        if (append) tmpKeys.append(QString::fromStdString(token));
+    }
+    static const QRegularExpression quotes("^\"|\"$");
+    tmpKeys.replace(quotes, "");
+
+    std::vector<keyPacket> packets = sendPackets(tmpKeys);
+    if (packets.empty()) {
+        return;
+    }
+    int first = int(program.reports.size());
+    for (const keyPacket& packet : packets) {
+        program.reports.push_back(KeyboardMouse::encode(packet));
+    }
+    program.instructions.push_back({Op::SendReports, first, int(packets.size())});
+}
+
+std::vector<keyPacket> Compiler::sendPackets(const QString& tmpKeys)
+{
+    std::vector<keyPacket> packets;
+    int pos = 0;
+    while (pos < tmpKeys.length()) {
+        std::array<uint8_t, 6> general = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        uint8_t control = 0x00;
+
+        // Check for control characters first
+        QRegularExpressionMatch controlMatch = regex.controlKeyRegex.match(tmpKeys, pos);
+        if (controlMatch.hasMatch() && controlMatch.capturedStart() == pos) {
+            // Process control key sequence
+            QString controlChar = controlMatch.captured(1);
+            QString keys = controlMatch.captured(2);
+            control = controldata.value(controlChar[0]);
+
+            // Process the keys after the control character
+            int keyIndex = 0;
+            int keyPos = 0;
+            while (keyPos < keys.length() && keyIndex < 6) {
+                if (keys[keyPos] == '{') {
+                    // Handle braced key
+                    QRegularExpressionMatch braceMatch = regex.braceKeyRegex.match(keys, keyPos);
+                    if (braceMatch.hasMatch()) {
+                        QString keyName = braceMatch.captured(1);
+                        if (keydata.value(keyName)){
+                            general[keyIndex++] = keydata.value(keyName);
+                            keyPos = braceMatch.capturedEnd();
+                            continue;
+                        }
+                        // A click with the modifiers held ends the keys of this sequence
+                        keyName.remove("Click");
+                        MouseParams params = parserClickParam(keyName);
+                        packets.emplace_back(general, control, params.mode, params.mouseButton, params.wheelDelta, params.coord);
+                        break;
+                    }
+                }
+                // Handle single character
+                general[keyIndex++] = keydata.value(keys[keyPos]);
+                keyPos++;
+            }
+            packets.emplace_back(general, control);
+            pos = controlMatch.capturedEnd();
+        } else {
+            // Check for braced keys
+            QRegularExpressionMatch braceMatch = regex.braceKeyRegex.match(tmpKeys, pos);
+            if (braceMatch.hasMatch() && braceMatch.capturedStart() == pos) {
+                QString keyName = braceMatch.captured(1);
+                if (keydata.value(keyName)){
+                    general[0] = keydata.value(keyName);
+                    packets.emplace_back(general, control);
+                } else {
+                    keyName.remove("Click");
+                    MouseParams params = parserClickParam(keyName);
+                    packets.emplace_back(params.mode, params.mouseButton, params.wheelDelta, params.coord);
+                }
+                pos = braceMatch.capturedEnd();
+            } else {
+                // Upper case letters are sent with shift held
+                if (tmpKeys[pos].isUpper()){
+                    control = 0x02;
+                }
+                general[0] = keydata.value(tmpKeys[pos]);
+                pos++;
+                packets.emplace_back(general, control);
+            }
+        }
+    }
+    return packets;
+}
+
+void Compiler::compileClick(const CommandStatementNode* node, Program& program)
+{
+    const auto& options = node->getOptions();
+    if (options.empty()) {
+        qDebug(log_script) << "No coordinates provided for Click command";
+        return;
+    }
+    QPoint coords = parseCoordinates(options);
+    int mouseButton = parseMouseButton(options);
+    program.instructions.push_back({Op::Click, toHidX(coords.x()), toHidY(coords.y()), mouseButton});
+}
+
+void Compiler::compileSleep(const CommandStatementNode* node, Program& program)
+{
+    const auto& options = node->getOptions();
+    if (options.empty()){
+        qDebug(log_script) << "No sleep time set";
+        return;
+    }
+    for (const auto& token : options){
+        bool ok;
+        int sleepTime = QString::fromStdString(token).toInt(&ok);
+        if (ok && sleepTime >= 0) {
+            program.instructions.push_back({Op::Sleep, sleepTime});
+        }
+    }
+}
+
+void Compiler::compileLockState(const CommandStatementNode* node, LockKey key, Program& program)
+{
+    QString tmpKeys = joinOptions(node->getOptions());
+    tmpKeys.remove(' ');
+    if (tmpKeys.isEmpty()){
+        qCDebug(log_script) << "Please enter parameters.";
+        return;
+    }
+    if (regex.onRegex.match(tmpKeys).hasMatch()){
+        program.instructions.push_back({Op::SetLockState, int(key), 1});
+    } else if (regex.offRegex.match(tmpKeys).hasMatch()){
+        program.instructions.push_back({Op::SetLockState, int(key), 0});
+    }
+}
+
+void Compiler::compileDelays(const CommandStatementNode* node, std::initializer_list<Delay> delays, Program& program)
+{
+    QString text = joinOptions(node->getOptions()).trimmed();
+    if (text.startsWith(',')) {
+        text.remove(0, 1);
+    }
+    // An empty parameter keeps the current delay, like in AHK
+    const QStringList params = text.split(',');
+    int i = 0;
+    for (Delay delay : delays) {
+        const QString param = i < params.size() ? params[i++].trimmed() : QString();
+        if (param.isEmpty()) {
+            continue;
+        }
+        bool ok;
+        int milliseconds = param.toInt(&ok);
+        if (!ok) {
+            qCDebug(log_script) << "Invalid delay" << param;
+            continue;
+        }
+        program.instructions.push_back({Op::SetDelay, int(delay), qMax(milliseconds, -1)});
+    }
+}
+
+void Compiler::compileFullScreenCapture(const CommandStatementNode* node, Program& program)
+{
+    QString path;
+    if (node->getOptions().empty()){
+        qCDebug(log_script) << "No path given";
+    } else {
+        path = extractFilePath(joinOptions(node->getOptions()));
+        path.replace('\\', '/');
+    }
+    program.strings.append(path);
+    program.instructions.push_back({Op::Capture, int(program.strings.size()) - 1});
+}
+
+void Compiler::compileAreaScreenCapture(const CommandStatementNode* node, Program& program)
+{
+    if (node->getOptions().empty()){
+        qCDebug(log_script) << "No param given";
+        return;
+    }
+    QString tmpTxt = joinOptions(node->getOptions());
+    QString path = extractFilePath(tmpTxt);
+    std::vector<int> numData;
+    QRegularExpressionMatchIterator numMatchs = regex.numberRegex.globalMatch(tmpTxt);
+    while(numMatchs.hasNext()){
+        bool ok;
+        int value = numMatchs.next().captured(0).toInt(&ok);
+        if (ok){
+            numData.push_back(value);
+        }
+    }
+    if (numData.size()<4) {
+        qCDebug(log_script) << "the param of area rect is x y width height";
+        return;
+    }
+    path.replace('\\', '/');
+    program.strings.append(path);
+    program.rects.push_back(QRect(numData[0], numData[1], numData[2], numData[3]));
+    program.instructions.push_back({Op::CaptureArea, int(program.strings.size()) - 1, int(program.rects.size()) - 1});
+}
+
+void Compiler::compileSaveRecentVideo(const CommandStatementNode* node, Program& program)
+{
+    QString path = extractFilePath(joinOptions(node->getOptions()));
+    path.replace('\\', '/');
+    program.strings.append(path);
+    program.instructions.push_back({Op::SaveRecentVideo, int(program.strings.size()) - 1});
+}
+
+QString Compiler::extractFilePath(const QString& originText){
+    static const QRegularExpression pathRegex(R"(([a-zA-Z]:[\\\/][^\s]+|\/[^\s]+))");
+    QRegularExpressionMatch match = pathRegex.match(originText);
+    if (match.hasMatch()){
+        return match.captured(0);
+    }
+    return QString();
+}
+
+QPoint Compiler::parseCoordinates(const std::vector<std::string>& options) {
+    int x = 0, y = 0;
+    bool foundComma = false;
+    bool beforeComma = true;
+    bool okX = false, okY = false;
+
+    for (const auto& token : options) {
+        if (token == ",") {
+            foundComma = true;
+            beforeComma = false;
+            continue;
+        }
+
+        // Try to parse the token as a number
+        bool ok = false;
+        int value = QString::fromStdString(token).toInt(&ok);
+        if (ok) {
+            if (beforeComma) {
+                x = value;
+                okX = true;
+            } else {
+                y = value;
+                okY = true;
+            }
+        }
+    }
+
+    if (!foundComma || (!okX && !okY)) {
+        qDebug(log_script) << "Invalid coordinate format, using defaults";
+        return QPoint(0, 0);
+    }
+    return QPoint(x, y);
+}
+
+int Compiler::parseMouseButton(const std::vector<std::string>& options) {
+    // Default to left click for each new statement
+    int mouseButton = Qt::LeftButton;
+
+    // Look for button specification in options
+    for (const auto& option : options) {
+        QString opt = QString::fromStdString(option).toLower();
+        if (opt == "right" || opt == "r") {
+            mouseButton = Qt::RightButton;
+            break;
+        } else if (opt == "middle" || opt == "m") {
+            mouseButton = Qt::MiddleButton;
+            break;
+        }
+    }
+    return mouseButton;
+}
+
+MouseParams Compiler::parserClickParam(const QString& command) {
+    MouseParams params = {0x02, 0x00, 0x00, {}}; // Default to absolute mode
+
+    bool relative = regex.relativeRegex.match(command).hasMatch();
+    if (relative) {
+        params.mode = 0x01; // Relative mode
+    }
+
+    std::vector<int> numData;
+    QRegularExpressionMatchIterator numMatchs = regex.numberRegex.globalMatch(command);
+    while(numMatchs.hasNext()){
+        bool ok;
+        int value = numMatchs.next().captured(0).toInt(&ok);
+        if (ok){
+            numData.push_back(value);
+        }
+    }
+
+    // Set mouse button based on parsed button string
+    QString button = regex.buttonRegex.match(command).captured(0).toLower();
+    if (button.startsWith('r')) {
+        params.mouseButton = 0x02; // Right button
+    } else if (button.startsWith('m')) {
+        params.mouseButton = 0x04; // Middle button
+    } else {
+        params.mouseButton = 0x01; // Left button (default)
+    }
+
+    // Set coordinates
+    if (numData.size() >= 2) {
+        if (relative) {
+            // Relative coordinates are single bytes
+            params.coord.rel.x = static_cast<uint8_t>(std::min(std::max(numData[0], -128), 127) & 0xFF);
+            params.coord.rel.y = static_cast<uint8_t>(std::min(std::max(numData[1], -128), 127) & 0xFF);
+        } else {
+            // Absolute coordinates are 2 bytes each
+            int x = toHidX(numData[0]);
+            int y = toHidY(numData[1]);
+            params.coord.abs.x[0] = static_cast<uint8_t>(x & 0xFF);
+            params.coord.abs.x[1] = static_cast<uint8_t>((x >> 8) & 0xFF);
+            params.coord.abs.y[0] = static_cast<uint8_t>(y & 0xFF);
+            params.coord.abs.y[1] = static_cast<uint8_t>((y >> 8) & 0xFF);
+        }
+    }
+    return params;
+}
@@ -0,0 +1,121 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <initializer_list>
+#include <QHash>
+#include <QPoint>
+#include <QString>
+#include "Bytecode.h"
+#include "regex/RegularExpression.h"
+
+struct MouseParams{
+    uint8_t mode;
+    uint8_t mouseButton;
+    uint8_t wheelDelta;
+    Coordinate coord;
+};
+
+/*
+ * Compiles the syntax tree into a Program for SemanticAnalyzer::run().
+ *
+ * Send strings become encoded HID reports and Click coordinates are scaled to
+ * the HID range with the input resolution at compile time, so running them
+ * does no parsing. Click and Sleep evaluate the %variables% they read when
+ * they run, other commands get a template of their options with the
+ * references compiled to expressions. Commands without a compiled form are
+ * left to the analyzer.
+ * If, loops and Goto become jumps to instruction indices and expressions
+ * are compiled to postfix.
+ */
+class Compiler {
+public:
+    Compiler();
+    Program compile(std::shared_ptr<ASTNode> tree);
+    // Appends the instructions of one command, variables already expanded
+    void compileCommand(const CommandStatementNode* node, Program& program);
+
+private:
+    void compileNode(const ASTNode* node, Program& program);
+    // A command that reads %variables%
+    void compileVariableCommand(const CommandStatementNode* node, Program& program);
+    int compileTemplate(const CommandStatementNode* node, Program& program);
+    // Click with %variables% as coordinates, false when they are used otherwise
+    bool compileVariableClick(const CommandStatementNode* node, Program& program);
+    void compileVariableSleep(const CommandStatementNode* node, Program& program);
+    void compileAssignment(const AssignmentNode* node, Program& program);
+    void compileIf(const IfNode* node, Program& program);
+    void compileLoop(const LoopNode* node, Program& program);
+    void compileJump(const JumpNode* node, Program& program);
+    int compileExpression(const ExpressionNode* node, Program& program);
+    void appendTerms(const ExpressionNode* node, Program& program, std::vector<ExprTerm>& terms);
+    int addString(const QString& text, Program& program);
+    // The slot of a variable, names are case insensitive like in AHK
+    int variableSlot(const QString& name, Program& program);
+    ExprTerm variableTerm(const QString& name, Program& program);
+    int addExpression(std::vector<ExprTerm> terms, Program& program);
+    // The innermost loop being compiled, its A_Index is the one a read sees
+    int currentLoop() const { return loops.empty() ? -1 : loops.back().loop; }
+    void compileSend(const CommandStatementNode* node, Program& program);
+    void compileClick(const CommandStatementNode* node, Program& program);
+    void compileSleep(const CommandStatementNode* node, Program& program);
+    void compileLockState(const CommandStatementNode* node, LockKey key, Program& program);
+    // One SetDelay per given parameter, in the order of the delays
+    void compileDelays(const CommandStatementNode* node, std::initializer_list<Delay> delays, Program& program);
+    void compileFullScreenCapture(const CommandStatementNode* node, Program& program);
+    void compileAreaScreenCapture(const CommandStatementNode* node, Program& program);
+    void compileSaveRecentVideo(const CommandStatementNode* node, Program& program);
+
+    std::vector<keyPacket> sendPackets(const QString& keys);
+    MouseParams parserClickParam(const QString& command);
+    QPoint parseCoordinates(const std::vector<std::string>& options);
+    int parseMouseButton(const std::vector<std::string>& options);
+    QString extractFilePath(const QString& originText);
+    int toHidX(int x) const;
+    int toHidY(int y) const;
+
+    int inputWidth;
+    int inputHeight;
+
+    // The loops being compiled, their Break and Continue jumps are patched at the end of the loop
+    struct LoopJumps {
+        int loop;
+        std::vector<int> breaks;
+        std::vector<int> continues;
+    };
+    std::vector<LoopJumps> loops;
+    // Label names are lower case, gotos are patched once all labels are known
+    QHash<QString, int> labels;
+    std::vector<std::pair<int, QString>> gotos;
+    std::vector<int> returns;
+    // Lower case variable names to their slots
+    QHash<QString, int> variableSlots;
+    RegularExpression& regex = RegularExpression::instance();
+};
+
+#endif // COMPILER_H
@@ -0,0 +1,197 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "DryRun.h"
+#include "Compiler.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "semanticAnalyzer.h"
+#include "target/MouseManager.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+DryRun::DryRun(qint64 limitMs) : m_limitMs(limitMs)
+{
+}
+
+void DryRun::run(const QString &source)
+{
+    m_trace.clear();
+    m_elapsedNs = 0;
+    m_lockIndicators = 0;
+    m_heldKeys.clear();
+    if (source.trimmed().isEmpty()) {
+        return;
+    }
+
+    Lexer lexer;
+    lexer.setSource(source.toStdString());
+    const std::vector<Token> tokens = lexer.tokenize();
+    Parser parser(tokens);
+    std::shared_ptr<ASTNode> syntaxTree = parser.parse();
+
+    MouseManager mouseManager;
+    mouseManager.setSink(this);
+    KeyboardMouse keyboardMouse;
+    keyboardMouse.setSink(this);
+    SemanticAnalyzer analyzer(&mouseManager, &keyboardMouse);
+    m_timeline = &analyzer.scriptTimeline();
+    m_timeline->setVirtual(true, m_limitMs);
+
+    // Emitted on this thread, so they are recorded at the time they happen
+    QObject::connect(&analyzer, &SemanticAnalyzer::captureImg, [this](const QString &path) {
+        record(QString("capture \"%1\"").arg(path));
+    });
+    QObject::connect(&analyzer, &SemanticAnalyzer::captureAreaImg, [this](const QString &path, const QRect &area) {
+        record(QString("capture-area %1,%2 %3x%4 \"%5\"")
+                   .arg(area.x()).arg(area.y()).arg(area.width()).arg(area.height()).arg(path));
+    });
+    QObject::connect(&analyzer, &SemanticAnalyzer::saveRecentVideo, [this](const QString &path) {
+        record(QString("save-video \"%1\"").arg(path));
+    });
+
+    analyzer.run(Compiler().compile(syntaxTree));
+    if (m_timeline->isStalled()) {
+        record(QString("stopped after %1 instructions without a wait").arg(ScriptTimeline::MAX_VIRTUAL_STEPS));
+    } else if (m_timeline->isCancelled()) {
+        record(QString("stopped after %1 ms").arg(m_limitMs));
+    }
+    m_elapsedNs = m_timeline->nowNs();
+    m_timeline = nullptr;
+}
+
+void DryRun::send(const QByteArray &frame)
+{
+    if (frame.size() >= 13 && uchar(frame[3]) == 0x02) {
+        trackLockKeys(frame.mid(7, 6));
+    }
+    record(describe(frame));
+}
+
+void DryRun::record(const QString &event)
+{
+    const qint64 ns = m_timeline ? m_timeline->nowNs() : 0;
+    m_trace.append(QString("%1 %2").arg(ns / 1e6, 12, 'f', 3).arg(event));
+}
+
+/*
+ * One line per frame, decoded for the keyboard and the two mouse modes
+ */
+QString DryRun::describe(const QByteArray &frame)
+{
+    const int length = frame.size() >= 5 ? uchar(frame[4]) : 0;
+    const QByteArray data = frame.mid(5, length);
+    auto hex = [](uchar byte) { return QString("%1").arg(byte, 2, 16, QChar('0')); };
+    const uchar command = frame.size() >= 5 ? uchar(frame[3]) : 0;
+
+    if (command == 0x02 && data.size() >= 8) {
+        QStringList keys;
+        for (int i = 2; i < 8; i++) {
+            if (data[i]) {
+                keys << hex(uchar(data[i]));
+            }
+        }
+        return QString("key mod=%1 keys=%2").arg(hex(uchar(data[0])), keys.isEmpty() ? "-" : keys.join(','));
+    }
+    if (command == 0x04 && data.size() >= 7) {
+        const int x = uchar(data[2]) | (uchar(data[3]) << 8);
+        const int y = uchar(data[4]) | (uchar(data[5]) << 8);
+        return QString("mouse abs buttons=%1 x=%2 y=%3 wheel=%4")
+            .arg(hex(uchar(data[1]))).arg(x).arg(y).arg(int(qint8(data[6])));
+    }
+    if (command == 0x05 && data.size() >= 5) {
+        return QString("mouse rel buttons=%1 dx=%2 dy=%3 wheel=%4")
+            .arg(hex(uchar(data[1]))).arg(int(qint8(data[2]))).arg(int(qint8(data[3]))).arg(int(qint8(data[4])));
+    }
+    return QString("frame %1").arg(QString::fromLatin1(frame.toHex(' ')));
+}
+
+void DryRun::trackLockKeys(const QByteArray &keys)
+{
+    // Num Lock, Caps Lock and Scroll Lock toggle their LED when pressed
+    static const uchar lockKeys[] = {0x53, 0x39, 0x47};
+    for (int bit = 0; bit < 3; bit++) {
+        const char key = char(lockKeys[bit]);
+        if (keys.contains(key) && !m_heldKeys.contains(key)) {
+            m_lockIndicators ^= uint8_t(1 << bit);
+        }
+    }
+    m_heldKeys = keys;
+}
+
+int DryRun::runCommandLine(const QStringList &arguments)
+{
+    const QString path = arguments.value(0);
+    qint64 limitMs = DEFAULT_LIMIT_MS;
+    bool limitOk = true;
+    const int limitIndex = arguments.indexOf("--max-time");
+    if (limitIndex != -1) {
+        // A missing or zero limit would let an endless script run forever
+        limitMs = arguments.value(limitIndex + 1).toLongLong(&limitOk);
+        limitOk = limitOk && limitMs > 0;
+    }
+    if (path.isEmpty() || path.startsWith("--") || !limitOk) {
+        qWarning().noquote() << "Usage: openterfaceQT --dry-run <script.ahk> [--trace <file>] [--max-time <ms>]";
+        return 2;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning().noquote() << "Could not read" << path;
+        return 1;
+    }
+    const QString source = QTextStream(&file).readAll();
+    file.close();
+
+    DryRun dryRun(limitMs);
+    QElapsedTimer timer;
+    timer.start();
+    dryRun.run(source);
+    const qint64 realMs = timer.elapsed();
+
+    QFile output;
+    const int traceIndex = arguments.indexOf("--trace");
+    bool opened;
+    if (traceIndex != -1) {
+        output.setFileName(arguments.value(traceIndex + 1));
+        opened = output.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+    } else {
+        opened = output.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+    }
+    if (!opened) {
+        qWarning().noquote() << "Could not write" << output.fileName();
+        return 1;
+    }
+    QTextStream stream(&output);
+    for (const QString &line : dryRun.trace()) {
+        stream << line << '\n';
+    }
+    stream.flush();
+
+    qInfo().noquote() << QString("dry run %1: %2 events over %3 s of script time in %4 ms")
+                             .arg(path)
+                             .arg(dryRun.trace().size())
+                             .arg(dryRun.elapsedNs() / 1e9, 0, 'f', 3)
+                             .arg(realMs);
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef DRYRUN_H
+#define DRYRUN_H
+
+#include <QString>
+#include <QStringList>
+#include "serial/HidSink.h"
+
+class ScriptTimeline;
+
+/*
+ * Runs a script without a target. Waits only move the script's virtual
+ * clock, and every HID frame and capture action is written to a trace with
+ * its time on that clock, so a script of hours runs in milliseconds and the
+ * traces of two versions can be diffed. The lock keys start off and follow
+ * the lock key presses of the script.
+ *
+ *     openterfaceQT --dry-run script.ahk [--trace trace.txt] [--max-time ms]
+ */
+class DryRun : public HidSink {
+public:
+    // A script still running after this much virtual time is stopped, e.g. an endless loop
+    static const qint64 DEFAULT_LIMIT_MS = 24LL * 3600 * 1000;
+
+    explicit DryRun(qint64 limitMs = DEFAULT_LIMIT_MS);
+
+    // Runs the script source, the trace is started afresh
+    void run(const QString &source);
+    const QStringList &trace() const { return m_trace; }
+    // Virtual time at the end of the last run
+    qint64 elapsedNs() const { return m_elapsedNs; }
+
+    void send(const QByteArray &frame) override;
+    uint8_t lockIndicators() const override { return m_lockIndicators; }
+
+    // The arguments after --dry-run, returns the exit code
+    static int runCommandLine(const QStringList &arguments);
+
+private:
+    void record(const QString &event);
+    static QString describe(const QByteArray &frame);
+    void trackLockKeys(const QByteArray &keys);
+
+    qint64 m_limitMs;
+    ScriptTimeline *m_timeline = nullptr;
+    QStringList m_trace;
+    qint64 m_elapsedNs = 0;
+    uint8_t m_lockIndicators = 0;
+    QByteArray m_heldKeys;          // Of the previous keyboard frame
+};
+
+#endif // DRYRUN_H
@@ -44,45 +44,13 @@ void KeyboardMouse::addKeyPacket(const keyPacket& packet) {
 }
 
 
-void KeyboardMouse::dataSend(){
+void KeyboardMouse::dataSend(ScriptTimeline* timeline){
     while(!keyData.empty()){
-        
-        qDebug() << "Sending data for key packet: " 
-            << keyData.front().keyboardSendOrNot
-            << keyData.front().mouseSendOrNot
-            << keyData.front().keyboardMouseSendOrNot;
-        if(keyData.front().keyboardSendOrNot) {
-            qDebug() << "Sending keyboard data.";
-            keyboardSend();
-        }
-        if(keyData.front().mouseSendOrNot) {
-            qDebug() << "Sending mouse data.";
-            mouseSend();
-        }
-        if(keyData.front().keyboardMouseSendOrNot) {
-            qDebug() << "Sending keyboard and mouse data.";
-            keyboardMouseSend();
-        }
+        sendReport(encode(keyData.front()), timeline);
         keyData.pop();
-        qDebug() << "After" << keyData.size();
     }
 }
 
-void KeyboardMouse::keyboardSend(){
-    QByteArray data = CMD_SEND_KB_GENERAL_DATA;
-    QByteArray release = CMD_SEND_KB_GENERAL_DATA;
-    // while(!keyData.empty()){
-    QByteArray tmpKeyData = keyData.front().KeytoQByteArray();
-    qDebug() << "Data: " << tmpKeyData.toHex();
-    data.replace(data.size() - 8, 8, tmpKeyData);   // replace the last 8 byte data
-    qDebug() << "After checksum data: " << data.toHex();
-    emit SerialPortManager::getInstance().sendCommandAsync(data, false);
-    QThread::msleep(clickInterval);
-    emit SerialPortManager::getInstance().sendCommandAsync(release, false);
-    // keyData.pop();
-    // }
-}
-
 uint8_t KeyboardMouse::calculateChecksum(const QByteArray &data){
     quint32 sum = 0;
     for (auto byte : data) {
@@ -91,83 +59,79 @@ uint8_t KeyboardMouse::calculateChecksum(const QByteArray &data){
     return sum % 256;
 }
 
-void KeyboardMouse::mouseSend(){
-    QByteArray data;
-    QByteArray release;
-    uint8_t clickCount = keyData.front().mouseClickCount;
-    // while(!keyData.empty()){
-    if (keyData.front().mouseMode == 0x02) {
-        data.append(MOUSE_ABS_ACTION_PREFIX);
-        release.append(MOUSE_ABS_ACTION_PREFIX);
-    }else{
-        data.append(MOUSE_REL_ACTION_PREFIX);
-        release.append(MOUSE_REL_ACTION_PREFIX);
-    } 
-
-    QByteArray tmpMouseData = keyData.front().MousetoQByteArray();
-    QByteArray releaseMouseData = tmpMouseData;
-    releaseMouseData[0] = 0x00;
-    qDebug() << "Release data: " << releaseMouseData.toHex();
-    qDebug() << "Mouse Data: " << tmpMouseData.toHex();
-    
-    data.append(tmpMouseData);
-    release.append(releaseMouseData);
-    data.append(static_cast<char>(calculateChecksum(data)));
-    release.append(static_cast<char>(calculateChecksum(release)));
-    qDebug() << "merged data: " << data.toHex();
-    qDebug() << "merged release: " << release.toHex();
-    for (int i = 0; i<clickCount; i++){
-        emit SerialPortManager::getInstance().sendCommandAsync(data, false);
-        emit SerialPortManager::getInstance().sendCommandAsync(release, false);
-        QThread::msleep(clickInterval);
+HidReport KeyboardMouse::encode(const keyPacket& packet){
+    HidReport report;
+    report.keyboard = packet.keyboardSendOrNot || packet.keyboardMouseSendOrNot;
+    report.mouse = packet.mouseSendOrNot || packet.keyboardMouseSendOrNot;
+    report.clickCount = packet.mouseClickCount;
+
+    if (report.keyboard) {
+        report.keyboardPress = CMD_SEND_KB_GENERAL_DATA;
+        report.keyboardRelease = CMD_SEND_KB_GENERAL_DATA;
+        // replace the last 8 byte data
+        report.keyboardPress.replace(report.keyboardPress.size() - 8, 8, packet.KeytoQByteArray());
     }
-    
-    // keyData.pop();
-        // emit SerialPortManager::getInstance().sendCommandAsync(release, false);
-    // }
-}
 
-void KeyboardMouse::keyboardMouseSend(){
-    QByteArray mouseData;
-    QByteArray mouseRelease;
-    QByteArray keyboardData = CMD_SEND_KB_GENERAL_DATA;
-    QByteArray keyboardRelease = CMD_SEND_KB_GENERAL_DATA;
-
-    // Prepare keyboard data
-    QByteArray tmpKeyData = keyData.front().KeytoQByteArray();
-    keyboardData.replace(keyboardData.size() - 8, 8, tmpKeyData);
-
-    // Prepare mouse data
-    if (keyData.front().mouseMode == 0x02) {
-        mouseData.append(MOUSE_ABS_ACTION_PREFIX);
-        mouseRelease.append(MOUSE_ABS_ACTION_PREFIX);
-    } else {
-        mouseData.append(MOUSE_REL_ACTION_PREFIX);
-        mouseRelease.append(MOUSE_REL_ACTION_PREFIX);
+    if (report.mouse) {
+        const QByteArray &prefix = packet.mouseMode == 0x02 ? MOUSE_ABS_ACTION_PREFIX : MOUSE_REL_ACTION_PREFIX;
+        QByteArray mouseData = packet.MousetoQByteArray();
+        report.mousePress = prefix + mouseData;
+        mouseData[0] = 0x00;    // Release state for the buttons
+        report.mouseRelease = prefix + mouseData;
+        report.mousePress.append(static_cast<char>(calculateChecksum(report.mousePress)));
+        report.mouseRelease.append(static_cast<char>(calculateChecksum(report.mouseRelease)));
     }
+    return report;
+}
 
-    QByteArray tmpMouseData = keyData.front().MousetoQByteArray();
-    QByteArray releaseMouseData = tmpMouseData;
-    releaseMouseData[0] = 0x00;  // Set release state for mouse
-
-    mouseData.append(tmpMouseData);
-    mouseRelease.append(releaseMouseData);
-    mouseData.append(static_cast<char>(calculateChecksum(mouseData)));
-    mouseRelease.append(static_cast<char>(calculateChecksum(mouseRelease)));
-    qDebug() << "keyboard data: " << keyboardData.toHex();
-    qDebug() << "mouse data: " << mouseData.toHex();
-
-    // Send press data for both devices
-    emit SerialPortManager::getInstance().sendCommandAsync(keyboardData, false);
-    emit SerialPortManager::getInstance().sendCommandAsync(mouseData, false);
+bool KeyboardMouse::wait(int milliseconds, ScriptTimeline* timeline){
+    if (milliseconds < 0) {
+        return !timeline || !timeline->isCancelled();
+    }
+    if (timeline) {
+        return timeline->sleep(milliseconds);
+    }
+    QThread::msleep(milliseconds);
+    return true;
+}
 
-    // Send release data for both devices
-    emit SerialPortManager::getInstance().sendCommandAsync(mouseRelease, false);
-    QThread::msleep(keyInterval);
-    emit SerialPortManager::getInstance().sendCommandAsync(keyboardRelease, false);
-    
+void KeyboardMouse::sendFrame(const QByteArray& frame){
+    if (sink) {
+        sink->send(frame);
+        return;
+    }
+    SerialPortManager &serial = SerialPortManager::getInstance();
+    if (!serial.canWaitForAck()) {
+        serial.sendCommandAsync(frame, false);
+        return;
+    }
+    serial.acquireAckSlot();
+    emit serial.sendCommandAsync(frame, true);
+}
 
-    
+bool KeyboardMouse::sendReport(const HidReport& report, ScriptTimeline* timeline){
+    bool completed = true;
+    if (report.keyboard && report.mouse) {
+        // Press for both devices, then release the mouse before the keys
+        sendFrame(report.keyboardPress);
+        sendFrame(report.mousePress);
+        sendFrame(report.mouseRelease);
+        completed = wait(keyPressDuration, timeline);
+        sendFrame(report.keyboardRelease);
+        completed = completed && wait(keyDelay, timeline);
+    } else if (report.keyboard) {
+        sendFrame(report.keyboardPress);
+        completed = wait(keyPressDuration, timeline);
+        sendFrame(report.keyboardRelease);
+        completed = completed && wait(keyDelay, timeline);
+    } else if (report.mouse) {
+        for (int i = 0; i < report.clickCount && completed; i++){
+            sendFrame(report.mousePress);
+            sendFrame(report.mouseRelease);
+            completed = wait(mouseDelay, timeline);
+        }
+    }
+    return completed;
 }
 
 void KeyboardMouse::setMouseSpeed(int speed){
@@ -179,17 +143,20 @@ int KeyboardMouse::getMouseSpeed(){
 }
 
 void KeyboardMouse::updateNumCapsScrollLockState(){
+    if (sink) {
+        return;
+    }
     emit SerialPortManager::getInstance().sendCommandAsync(CMD_GET_INFO, false);
 }
 
 bool KeyboardMouse::getNumLockState_(){
-    return SerialPortManager::getInstance().getNumLockState();
+    return sink ? (sink->lockIndicators() & 0x01) != 0 : SerialPortManager::getInstance().getNumLockState();
 }
 
 bool KeyboardMouse::getCapsLockState_(){
-    return SerialPortManager::getInstance().getCapsLockState();
+    return sink ? (sink->lockIndicators() & 0x02) != 0 : SerialPortManager::getInstance().getCapsLockState();
 }
 
 bool KeyboardMouse::getScrollLockState_(){
-    return SerialPortManager::getInstance().getScrollLockState();
+    return sink ? (sink->lockIndicators() & 0x04) != 0 : SerialPortManager::getInstance().getScrollLockState();
 }
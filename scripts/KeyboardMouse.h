@@ -40,7 +40,9 @@
 #include <QDebug>
 #include <QObject>
 #include "serial/SerialPortManager.h"
+#include "serial/HidSink.h"
 #include "AST.h"
+#include "ScriptScheduler.h"
 
 // keyboard data packet
 union Coordinate {
@@ -117,6 +119,17 @@ struct keyPacket {
     }
 };
 
+// Serial frames of one keyPacket, encoded once and sent as often as needed
+struct HidReport {
+    bool keyboard = false;
+    bool mouse = false;
+    uint8_t clickCount = 1;
+    QByteArray keyboardPress;
+    QByteArray keyboardRelease;
+    QByteArray mousePress;
+    QByteArray mouseRelease;
+};
+
 class KeyboardMouse : public QObject
 {
     Q_OBJECT
@@ -125,24 +138,44 @@ public:
     explicit KeyboardMouse(QObject *parent = nullptr);
 
     void addKeyPacket(const keyPacket& packet);
-    void dataSend();
-    void keyboardSend();
-    void mouseSend();
-    void keyboardMouseSend();
+    // The intervals are waited on the timeline when there is one
+    void dataSend(ScriptTimeline* timeline = nullptr);
+    static HidReport encode(const keyPacket& packet);
+    // Sends the press and release frames, paced by the key and mouse delays.
+    // False when the timeline was cancelled, the release is sent anyway.
+    bool sendReport(const HidReport& report, ScriptTimeline* timeline = nullptr);
     void updateNumCapsScrollLockState();
     bool getNumLockState_();
     bool getCapsLockState_();
     bool getScrollLockState_();
     void setMouseSpeed(int speed);
     int getMouseSpeed();
+    // Frames go to the sink instead of the serial port, nullptr for the port.
+    // The lock states are then read from the sink too.
+    void setSink(HidSink* sink) { this->sink = sink; }
+    // Like AHK's SetKeyDelay and SetMouseDelay: the delay follows each key or
+    // click, the press duration is how long keys are held. -1 does not wait,
+    // so frames go out as fast as the serial link and its ACK window allow.
+    void setKeyDelay(int milliseconds) { keyDelay = milliseconds; }
+    int getKeyDelay() const { return keyDelay; }
+    void setKeyPressDuration(int milliseconds) { keyPressDuration = milliseconds; }
+    int getKeyPressDuration() const { return keyPressDuration; }
+    void setMouseDelay(int milliseconds) { mouseDelay = milliseconds; }
+    int getMouseDelay() const { return mouseDelay; }
+    // Waits the milliseconds on the timeline when there is one, -1 does not wait
+    bool wait(int milliseconds, ScriptTimeline* timeline);
 
 
 private:
     std::queue<keyPacket> keyData;
     int mouseSpeed;
-    int clickInterval = 50;
-    int keyInterval = 40;
-    uint8_t calculateChecksum(const QByteArray &data);
+    int keyDelay = 10;
+    int keyPressDuration = 10;
+    int mouseDelay = 10;
+    HidSink* sink = nullptr;
+    static uint8_t calculateChecksum(const QByteArray &data);
+    // Waits for a place in the serial ACK window, then queues the frame
+    void sendFrame(const QByteArray& frame);
 };
 
 const QMap<QString, uint8_t> controldata = {
@@ -22,26 +22,136 @@
 
 
 #include "Lexer.h"
-#include <cctype>
+#include "benchmark.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QString>
+#include <array>
+#include <cstdint>
 #include <stdexcept>
 
+namespace {
 
+enum CharClass : uint8_t {
+    Other,
+    Space,
+    Newline,
+    Letter,         // Also starts identifiers
+    Digit,
+    OperatorStart,
+    Utf8Lead,
+    Utf8Continuation,
+};
 
-Lexer::Lexer() : currentIndex(0) {}
-
-void Lexer::setSource(const std::string& source) {
-    this->source = source;
-    currentIndex = 0;
+constexpr std::array<uint8_t, 256> makeClasses()
+{
+    std::array<uint8_t, 256> classes{};
+    for (int c = 0; c < 256; c++) {
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f') {
+            classes[c] = Space;
+        } else if (c == '\n') {
+            classes[c] = Newline;
+        } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            classes[c] = Letter;
+        } else if (c >= '0' && c <= '9') {
+            classes[c] = Digit;
+        } else if (c >= 0xC0) {
+            classes[c] = Utf8Lead;
+        } else if (c >= 0x80) {
+            classes[c] = Utf8Continuation;
+        }
+    }
+    // The first characters of the entries in operators
+    for (char c : std::string_view(":=+-*/.|&^><!%(")) {
+        classes[uint8_t(c)] = OperatorStart;
+    }
+    return classes;
 }
 
-char Lexer::currentChar() {
-    return currentIndex < source.size() ? source[currentIndex] : '\0';
+constexpr std::array<uint8_t, 256> charClasses = makeClasses();
+
+inline uint8_t classOf(char c)
+{
+    return charClasses[uint8_t(c)];
 }
 
-void Lexer::advance() {
-    if (currentIndex < source.size()) {
-        currentIndex++;
+/*
+ * Keywords, commands and operators in an open addressed table without
+ * collisions. The seed is searched once at startup, so a lookup is one hash
+ * and at most one string compare.
+ */
+class WordTable {
+public:
+    static const WordTable& instance() {
+        static const WordTable table;
+        return table;
     }
+
+    AHKTokenType find(std::string_view word, AHKTokenType otherwise) const {
+        const Slot& slot = slots[hash(word, seed) & (SLOT_COUNT - 1)];
+        return slot.used && slot.word == word ? slot.type : otherwise;
+    }
+
+private:
+    static const uint32_t SLOT_COUNT = 512;
+
+    struct Slot {
+        std::string word;
+        AHKTokenType type = AHKTokenType::INVALID;
+        bool used = false;
+    };
+
+    WordTable() {
+        std::vector<std::pair<std::string, AHKTokenType>> words;
+        for (const auto& word : keywords) {
+            words.emplace_back(word, AHKTokenType::KEYWORD);
+        }
+        for (const auto& word : mouse_keyboard) {
+            words.emplace_back(word, AHKTokenType::COMMAND);
+        }
+        for (const auto& word : operators) {
+            words.emplace_back(word, AHKTokenType::OPERATOR);
+        }
+
+        for (seed = 1; ; seed++) {
+            slots.assign(SLOT_COUNT, Slot());
+            bool collision = false;
+            for (const auto& word : words) {
+                Slot& slot = slots[hash(word.first, seed) & (SLOT_COUNT - 1)];
+                if (slot.used) {
+                    collision = true;
+                    break;
+                }
+                slot = {word.first, word.second, true};
+            }
+            if (!collision) {
+                break;
+            }
+        }
+    }
+
+    // FNV-1a with the seed mixed into the offset basis
+    static uint32_t hash(std::string_view word, uint32_t seed) {
+        uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+        for (char c : word) {
+            h = (h ^ uint8_t(c)) * 16777619u;
+        }
+        return h ^ (h >> 15);
+    }
+
+    std::vector<Slot> slots;
+    uint32_t seed = 0;
+};
+
+}
+
+Lexer::Lexer() : currentIndex(0), line(1), lineStart(0) {}
+
+void Lexer::setSource(const std::string& source) {
+    this->source = source;
+    currentIndex = 0;
+    line = 1;
+    lineStart = 0;
 }
 
 std::vector<Token> Lexer::tokenize() {
@@ -49,6 +159,7 @@ std::vector<Token> Lexer::tokenize() {
         throw std::runtime_error("Source is not set.");
     }
     std::vector<Token> tokens;
+    tokens.reserve(source.size() / 4 + 1);
     Token token;
     do {
         token = nextToken();
@@ -57,71 +168,139 @@ std::vector<Token> Lexer::tokenize() {
     return tokens;
 }
 
+Token Lexer::makeToken(AHKTokenType type, size_t start) const {
+    return {type, std::string_view(source).substr(start, currentIndex - start), line, int(start - lineStart) + 1};
+}
+
 Token Lexer::nextToken() {
-    while (std::isspace(currentChar())) {
-        if (currentChar() == '\n') {
-            advance();
-            return {AHKTokenType::NEWLINE, "\\n"};
-        }
-        advance();
-        return {AHKTokenType::WHITESPACE, " "};
+    const size_t size = source.size();
+    const char* text = source.data();
+    const size_t start = currentIndex;
+    if (start >= size) {
+        return makeToken(AHKTokenType::ENDOFFILE, start);
     }
 
-    if (std::isalpha(currentChar())) {
-        return identifier();
+    switch (classOf(text[start])) {
+    case Newline: {
+        currentIndex++;
+        Token token = makeToken(AHKTokenType::NEWLINE, start);
+        line++;
+        lineStart = currentIndex;
+        return token;
     }
 
-    if (std::isdigit(currentChar())) {
-        return number();
-    }
+    case Space:
+        // A run of blanks is one token, a carriage return before a newline belongs to the newline
+        while (currentIndex < size && classOf(text[currentIndex]) == Space) {
+            if (text[currentIndex] == '\r' && currentIndex + 1 < size && text[currentIndex + 1] == '\n') {
+                if (currentIndex == start) {
+                    currentIndex += 2;
+                    Token token = makeToken(AHKTokenType::NEWLINE, start);
+                    line++;
+                    lineStart = currentIndex;
+                    return token;
+                }
+                break;
+            }
+            currentIndex++;
+        }
+        return makeToken(AHKTokenType::WHITESPACE, start);
 
-    for (const auto& op : operators) {
-        if (source.substr(currentIndex, op.length()) == op) {
-            advance();
-            return {AHKTokenType::OPERATOR, op};
+    case Letter: {
+        while (currentIndex < size && (classOf(text[currentIndex]) == Letter || classOf(text[currentIndex]) == Digit)) {
+            currentIndex++;
         }
+        Token token = makeToken(AHKTokenType::IDENTIFIER, start);
+        token.type = WordTable::instance().find(token.value, AHKTokenType::IDENTIFIER);
+        return token;
     }
 
-    if (currentChar() == '\0') {
-        return {AHKTokenType::ENDOFFILE, ""};
+    case Digit: {
+        bool hasDecimalPoint = false;
+        while (currentIndex < size) {
+            char c = text[currentIndex];
+            if (c == '.' && !hasDecimalPoint) {
+                hasDecimalPoint = true;
+            } else if (classOf(c) != Digit) {
+                break;
+            }
+            currentIndex++;
+        }
+        return makeToken(hasDecimalPoint ? AHKTokenType::FLOAT : AHKTokenType::INTEGER, start);
     }
 
-    return symbol();
-}
-
-Token Lexer::identifier() {
-    std::string result;
-    while (std::isalnum(currentChar())) {
-        result += currentChar();
-        advance();
+    case OperatorStart: {
+        // Longest match first, operators are at most three characters
+        std::string_view rest = std::string_view(source).substr(start, 3);
+        for (size_t length = rest.size(); length > 0; length--) {
+            if (WordTable::instance().find(rest.substr(0, length), AHKTokenType::INVALID) == AHKTokenType::OPERATOR) {
+                currentIndex += length;
+                return makeToken(AHKTokenType::OPERATOR, start);
+            }
+        }
+        currentIndex++;
+        return makeToken(AHKTokenType::SYMBOL, start);
     }
 
-    if (keywords.find(result) != keywords.end()) {
-        return {AHKTokenType::KEYWORD, result};
-    }
+    case Utf8Lead:
+        // The whole character, so a token never splits it
+        currentIndex++;
+        while (currentIndex < size && classOf(text[currentIndex]) == Utf8Continuation) {
+            currentIndex++;
+        }
+        return makeToken(AHKTokenType::SYMBOL, start);
 
-    if (mouse_keyboard.find(result) != mouse_keyboard.end()){
-        return {AHKTokenType::COMMAND, result};
+    default:
+        currentIndex++;
+        return makeToken(AHKTokenType::SYMBOL, start);
     }
-
-    return {AHKTokenType::IDENTIFIER, result};
 }
 
-Token Lexer::number() {
-    std::string result;
-    bool hasDecimalPoint = false;
-    while (std::isdigit(currentChar()) || (currentChar() == '.' && !hasDecimalPoint)) {
-        if (currentChar() == '.') {
-            hasDecimalPoint = true;
+void Lexer::runBenchmark()
+{
+    const char* lines[] = {
+        "Send \"Hello World{Enter}\"\n",
+        "Click 960, 540\n",
+        "Sleep 50\n",
+        "ImageSearch, FoundX, FoundY, 0, 0, 1919, 1079, *20 C:/images/ok.png\n",
+        "Send ^c\n",
+        "x := 1.5 + count * 2\n",
+        "PixelSearch, FoundX, FoundY, 100, 100, 200, 200, 0x0000FF, 10, RGB\n",
+    };
+
+    for (size_t megabytes : {1, 4, 16}) {
+        std::string script;
+        script.reserve(megabytes << 20);
+        for (size_t i = 0; script.size() < (megabytes << 20); i++) {
+            script += lines[i % (sizeof(lines) / sizeof(lines[0]))];
         }
-        result += currentChar();
-        advance();
-    }
-    return {hasDecimalPoint ? AHKTokenType::FLOAT : AHKTokenType::INTEGER, result};
-}
 
-Token Lexer::symbol() {
-    char current = currentChar();
-    advance();
-    return {AHKTokenType::SYMBOL, std::string(1, current)};
+        Lexer lexer;
+        lexer.setSource(script);
+        qint64 best = 0;
+        size_t count = 0;
+        quint64 allocations = 0;
+        for (int round = 0; round < 3; round++) {
+            lexer.setSource(script);
+            QElapsedTimer timer;
+            timer.start();
+            const quint64 allocationsBefore = Benchmark::allocations();
+            std::vector<Token> tokens = lexer.tokenize();
+            qint64 ns = timer.nsecsElapsed();
+            allocations = Benchmark::allocations() - allocationsBefore;
+            if (round == 0 || ns < best) {
+                best = ns;
+            }
+            count = tokens.size();
+        }
+        qInfo().noquote() << QString("lexer %1 MB: %2 ms, %3 MB/s, %4 tokens, %5 ns per token, "
+                                     "%6 allocations (%7 per token)")
+                                 .arg(int(megabytes), 2)
+                                 .arg(best / 1e6, 0, 'f', 1)
+                                 .arg(script.size() / 1048576.0 / (best / 1e9), 0, 'f', 0)
+                                 .arg(qulonglong(count))
+                                 .arg(double(best) / count, 0, 'f', 1)
+                                 .arg(allocations)
+                                 .arg(double(allocations) / count, 0, 'f', 2);
+    }
 }
@@ -24,25 +24,34 @@
 #define LEXER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include "Token.h"
 
+/*
+ * Splits a script into tokens in a single pass. Every character is
+ * classified through a 256 entry table, and keywords, commands and operators
+ * are looked up in a perfect hash, so the cost is linear in the source size.
+ * Token values are views into the source held by the lexer, they stay valid
+ * until the next setSource().
+ */
 class Lexer {
 public:
     Lexer();
     void setSource(const std::string& source);
     std::vector<Token> tokenize();
 
+    // Prints the tokenize speed for generated scripts of a few megabytes
+    static void runBenchmark();
+
 private:
     std::string source;
     size_t currentIndex;
-    char currentChar();
+    int line;
+    size_t lineStart;
 
-    void advance();
     Token nextToken();
-    Token identifier();
-    Token number();
-    Token symbol();
+    Token makeToken(AHKTokenType type, size_t start) const;
 };
 
 #endif // LEXER_H
@@ -23,7 +23,36 @@
 
 #include "Parser.h"
 #include <QDebug>
+#include <QLoggingCategory>
+#include <cctype>
+#include <cstring>
 
+Q_DECLARE_LOGGING_CATEGORY(log_script)
+
+namespace {
+
+// After a variable name these start an assignment, ++ and -- included
+const char* const assignmentOperators[] = {":=", "=", "+=", "-=", "*=", "/=", ".=", "++", "--"};
+
+bool isAssignmentOperator(const Token& token)
+{
+    if (token.type != AHKTokenType::OPERATOR) {
+        return false;
+    }
+    for (const char* op : assignmentOperators) {
+        if (token.value == op) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isLineEnd(const Token& token)
+{
+    return token.type == AHKTokenType::NEWLINE || token.type == AHKTokenType::ENDOFFILE;
+}
+
+}
 
 Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens), currentIndex(0) {}
 
@@ -37,6 +66,58 @@ void Parser::advance() {
     }
 }
 
+void Parser::skipWhitespace() {
+    while (currentToken().type == AHKTokenType::WHITESPACE) {
+        advance();
+    }
+}
+
+void Parser::skipLine() {
+    while (!isLineEnd(currentToken())) {
+        advance();
+    }
+}
+
+void Parser::endStatement() {
+    skipWhitespace();
+    const Token token = currentToken();
+    if (isLineEnd(token)) {
+        return;
+    }
+    if (!isSymbol(token, ";")) {
+        warn(QString("Unexpected \"%1\"").arg(tokenText(token)));
+    }
+    skipLine();
+}
+
+bool Parser::isWord(const Token& token, const char* word) const {
+    if (token.type != AHKTokenType::KEYWORD && token.type != AHKTokenType::IDENTIFIER) {
+        return false;
+    }
+    const size_t length = strlen(word);
+    if (token.value.size() != length) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (std::tolower(uchar(token.value[i])) != std::tolower(uchar(word[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Parser::isSymbol(const Token& token, const char* symbol) const {
+    return (token.type == AHKTokenType::SYMBOL || token.type == AHKTokenType::OPERATOR) && token.value == symbol;
+}
+
+QString Parser::tokenText(const Token& token) const {
+    return QString::fromUtf8(token.value.data(), int(token.value.size()));
+}
+
+void Parser::warn(const QString& message) {
+    qCWarning(log_script).noquote() << QString("Line %1: %2").arg(currentToken().line).arg(message);
+}
+
 std::unique_ptr<ASTNode> Parser::parse() {
     // Create a root node to hold all statements
     auto root = std::make_unique<StatementListNode>();
@@ -57,42 +138,497 @@ std::unique_ptr<ASTNode> Parser::parse() {
     return root;
 }
 
-std::unique_ptr<ASTNode> Parser::parseExpression() {
-    // Implement expression parsing logic
-    return std::make_unique<ExpressionNode>();
-}
-
 std::unique_ptr<ASTNode> Parser::parseStatement() {
-    // Skip any leading newlines
-    while (currentToken().type == AHKTokenType::NEWLINE) {
+    // Skip any leading newlines and indentation
+    while (currentToken().type == AHKTokenType::NEWLINE || currentToken().type == AHKTokenType::WHITESPACE) {
         advance();
     }
-    
-    if (currentToken().type == AHKTokenType::COMMAND) {
+
+    const Token token = currentToken();
+    if (token.type == AHKTokenType::ENDOFFILE) {
+        return nullptr;
+    }
+    if (token.type == AHKTokenType::COMMAND) {
         return parseCommandStatement();
     }
-    // Add other statement types here
-    
-    // Skip unknown statements until newline
-    while (currentToken().type != AHKTokenType::NEWLINE &&
-           currentToken().type != AHKTokenType::ENDOFFILE) {
+    if (isSymbol(token, ";")) {
+        // Comment line
+        skipLine();
+        return nullptr;
+    }
+    if (isWord(token, "If")) {
+        return parseIf();
+    }
+    if (isWord(token, "Loop")) {
+        return parseLoop();
+    }
+    if (isWord(token, "While")) {
+        return parseWhile();
+    }
+    if (isWord(token, "Goto") || isWord(token, "Break") || isWord(token, "Continue") || isWord(token, "Return")) {
+        return parseJump();
+    }
+    if (token.type == AHKTokenType::IDENTIFIER) {
+        const size_t start = currentIndex;
         advance();
+        // A label is a name directly followed by a colon
+        if (isSymbol(currentToken(), ":")) {
+            advance();
+            endStatement();
+            return std::make_unique<LabelNode>(tokenText(token));
+        }
+        skipWhitespace();
+        const bool assignment = isAssignmentOperator(currentToken());
+        currentIndex = start;
+        if (assignment) {
+            return parseAssignment();
+        }
     }
-    
+
+    warn(QString("Unsupported statement \"%1\"").arg(tokenText(token)));
+    skipLine();
     return nullptr;
 }
 
 std::unique_ptr<ASTNode> Parser::parseCommandStatement() {
-    QString tmp = QString::fromStdString(currentToken().value);
+    const std::string_view name = currentToken().value;
+    QString tmp = QString::fromUtf8(name.data(), int(name.size()));
     advance(); // Move past the COMMAND token
     
     std::vector<std::string> options;
     while (currentToken().type != AHKTokenType::NEWLINE &&
            currentToken().type != AHKTokenType::ENDOFFILE) {
-        options.push_back(currentToken().value);
+        options.emplace_back(currentToken().value);
         advance();
     }
     auto commandStatementNode = std::make_unique<CommandStatementNode>(options);
     commandStatementNode->setCommandName(tmp);
     return commandStatementNode;
 }
+
+std::unique_ptr<ASTNode> Parser::parseAssignment() {
+    const QString name = tokenText(currentToken());
+    advance();
+    skipWhitespace();
+    QString op = tokenText(currentToken());
+    advance();
+
+    std::unique_ptr<ExpressionNode> value;
+    if (op == "++" || op == "--") {
+        value = std::make_unique<ExpressionNode>(ExpressionNode::Kind::Number, "1");
+        op = op == "++" ? "+=" : "-=";
+    } else if (op == "=") {
+        // The legacy assignment takes the rest of the line as text
+        value = parseText();
+    } else {
+        value = parseExpression();
+        if (!value) {
+            skipLine();
+            return nullptr;
+        }
+    }
+    endStatement();
+    return std::make_unique<AssignmentNode>(name, op, std::move(value));
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseText() {
+    skipWhitespace();
+    std::unique_ptr<ExpressionNode> text;
+    QString literal;
+    auto append = [&text](std::unique_ptr<ExpressionNode> part) {
+        text = text ? std::make_unique<ExpressionNode>(".", std::move(text), std::move(part)) : std::move(part);
+    };
+
+    while (!isLineEnd(currentToken())) {
+        const Token token = currentToken();
+        // A comment needs a blank before the semicolon
+        if (isSymbol(token, ";") && (literal.endsWith(' ') || literal.endsWith('\t'))) {
+            break;
+        }
+        if (isSymbol(token, "%") && currentIndex + 2 < tokens.size()
+            && tokens[currentIndex + 1].type == AHKTokenType::IDENTIFIER && isSymbol(tokens[currentIndex + 2], "%")) {
+            if (!literal.isEmpty()) {
+                append(std::make_unique<ExpressionNode>(ExpressionNode::Kind::String, literal));
+                literal.clear();
+            }
+            append(std::make_unique<ExpressionNode>(ExpressionNode::Kind::Variable, tokenText(tokens[currentIndex + 1])));
+            currentIndex += 3;
+            continue;
+        }
+        literal += tokenText(token);
+        advance();
+    }
+
+    while (literal.endsWith(' ') || literal.endsWith('\t')) {
+        literal.chop(1);
+    }
+    if (!literal.isEmpty() || !text) {
+        append(std::make_unique<ExpressionNode>(ExpressionNode::Kind::String, literal));
+    }
+    return text;
+}
+
+std::unique_ptr<ASTNode> Parser::parseIf() {
+    advance(); // Move past If
+    auto condition = parseExpression();
+    if (!condition) {
+        skipLine();
+        return nullptr;
+    }
+    if (!expectBody()) {
+        return nullptr;
+    }
+    auto thenBranch = parseBody();
+
+    // Else may follow the closing brace or start a later line
+    std::unique_ptr<ASTNode> elseBranch;
+    const size_t afterThen = currentIndex;
+    while (currentToken().type == AHKTokenType::NEWLINE || currentToken().type == AHKTokenType::WHITESPACE) {
+        advance();
+    }
+    if (isWord(currentToken(), "Else")) {
+        advance();
+        elseBranch = parseBody();
+    } else {
+        currentIndex = afterThen;
+    }
+    return std::make_unique<IfNode>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
+}
+
+std::unique_ptr<ASTNode> Parser::parseLoop() {
+    advance(); // Move past Loop
+    skipWhitespace();
+    if (isSymbol(currentToken(), ",")) {
+        advance();
+        skipWhitespace();
+    }
+
+    std::unique_ptr<ExpressionNode> count;
+    const Token token = currentToken();
+    if (!isLineEnd(token) && !isSymbol(token, "{") && !isSymbol(token, ";")) {
+        count = parseExpression();
+        if (!count) {
+            skipLine();
+            return nullptr;
+        }
+    }
+    if (!expectBody()) {
+        return nullptr;
+    }
+    auto loop = std::make_unique<LoopNode>(LoopNode::Kind::Count, std::move(count), parseBody());
+    parseUntil(loop.get());
+    return loop;
+}
+
+std::unique_ptr<ASTNode> Parser::parseWhile() {
+    advance(); // Move past While
+    auto condition = parseExpression();
+    if (!condition) {
+        skipLine();
+        return nullptr;
+    }
+    if (!expectBody()) {
+        return nullptr;
+    }
+    auto loop = std::make_unique<LoopNode>(LoopNode::Kind::While, std::move(condition), parseBody());
+    parseUntil(loop.get());
+    return loop;
+}
+
+void Parser::parseUntil(LoopNode* loop) {
+    const size_t afterBody = currentIndex;
+    while (currentToken().type == AHKTokenType::NEWLINE || currentToken().type == AHKTokenType::WHITESPACE) {
+        advance();
+    }
+    if (!isWord(currentToken(), "Until")) {
+        currentIndex = afterBody;
+        return;
+    }
+    advance();
+    auto condition = parseExpression();
+    if (condition) {
+        loop->setUntil(std::move(condition));
+        endStatement();
+    } else {
+        skipLine();
+    }
+}
+
+std::unique_ptr<ASTNode> Parser::parseJump() {
+    const Token token = currentToken();
+    advance();
+
+    if (isWord(token, "Goto")) {
+        skipWhitespace();
+        if (isSymbol(currentToken(), ",")) {
+            advance();
+            skipWhitespace();
+        }
+        const Token label = currentToken();
+        if (label.type != AHKTokenType::IDENTIFIER && label.type != AHKTokenType::KEYWORD) {
+            warn("Goto without a label");
+            skipLine();
+            return nullptr;
+        }
+        advance();
+        endStatement();
+        return std::make_unique<JumpNode>(JumpNode::Kind::Goto, tokenText(label));
+    }
+
+    endStatement();
+    if (isWord(token, "Break")) {
+        return std::make_unique<JumpNode>(JumpNode::Kind::Break);
+    }
+    if (isWord(token, "Continue")) {
+        return std::make_unique<JumpNode>(JumpNode::Kind::Continue);
+    }
+    return std::make_unique<JumpNode>(JumpNode::Kind::Return);
+}
+
+bool Parser::expectBody() {
+    skipWhitespace();
+    const Token token = currentToken();
+    if (isLineEnd(token) || isSymbol(token, "{") || isSymbol(token, ";")) {
+        return true;
+    }
+    warn(QString("Unexpected \"%1\"").arg(tokenText(token)));
+    skipLine();
+    return false;
+}
+
+std::unique_ptr<ASTNode> Parser::parseBody() {
+    skipWhitespace();
+    if (isSymbol(currentToken(), ";")) {
+        skipLine();
+    }
+    while (currentToken().type == AHKTokenType::NEWLINE || currentToken().type == AHKTokenType::WHITESPACE) {
+        advance();
+    }
+    if (isSymbol(currentToken(), "{")) {
+        advance();
+        return parseBlock();
+    }
+    auto statement = parseStatement();
+    if (!statement) {
+        return std::make_unique<StatementListNode>();
+    }
+    return statement;
+}
+
+std::unique_ptr<ASTNode> Parser::parseBlock() {
+    auto block = std::make_unique<StatementListNode>();
+    endStatement();
+    while (true) {
+        while (currentToken().type == AHKTokenType::NEWLINE || currentToken().type == AHKTokenType::WHITESPACE) {
+            advance();
+        }
+        const Token token = currentToken();
+        if (token.type == AHKTokenType::ENDOFFILE) {
+            warn("Missing }");
+            break;
+        }
+        if (isSymbol(token, "}")) {
+            advance();
+            break;
+        }
+        block->addStatement(parseStatement());
+    }
+    return block;
+}
+
+QString Parser::matchOperator(std::initializer_list<const char*> ops) {
+    skipWhitespace();
+    const Token token = currentToken();
+    for (const char* op : ops) {
+        // and, or and not are words, the others operator tokens
+        const bool matched = std::isalpha(uchar(op[0])) ? isWord(token, op)
+                                                        : token.type == AHKTokenType::OPERATOR && token.value == op;
+        if (matched) {
+            advance();
+            return QString::fromLatin1(op);
+        }
+    }
+    return QString();
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseExpression() {
+    return parseOr();
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseOr() {
+    auto left = parseAnd();
+    while (left && !matchOperator({"||", "or"}).isEmpty()) {
+        auto right = parseAnd();
+        if (!right) {
+            return nullptr;
+        }
+        left = std::make_unique<ExpressionNode>("||", std::move(left), std::move(right));
+    }
+    return left;
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseAnd() {
+    auto left = parseNot();
+    while (left && !matchOperator({"&&", "and"}).isEmpty()) {
+        auto right = parseNot();
+        if (!right) {
+            return nullptr;
+        }
+        left = std::make_unique<ExpressionNode>("&&", std::move(left), std::move(right));
+    }
+    return left;
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseNot() {
+    if (!matchOperator({"not"}).isEmpty()) {
+        auto operand = parseNot();
+        return operand ? std::make_unique<ExpressionNode>("!", std::move(operand)) : nullptr;
+    }
+    return parseComparison();
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseComparison() {
+    auto left = parseConcat();
+    QString op;
+    while (left && !(op = matchOperator({"=", "==", "!=", "<>", "<", "<=", ">", ">="})).isEmpty()) {
+        auto right = parseConcat();
+        if (!right) {
+            return nullptr;
+        }
+        left = std::make_unique<ExpressionNode>(op == "<>" ? "!=" : op, std::move(left), std::move(right));
+    }
+    return left;
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseConcat() {
+    auto left = parseAdditive();
+    while (left && !matchOperator({"."}).isEmpty()) {
+        auto right = parseAdditive();
+        if (!right) {
+            return nullptr;
+        }
+        left = std::make_unique<ExpressionNode>(".", std::move(left), std::move(right));
+    }
+    return left;
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseAdditive() {
+    auto left = parseMultiplicative();
+    QString op;
+    while (left && !(op = matchOperator({"+", "-"})).isEmpty()) {
+        auto right = parseMultiplicative();
+        if (!right) {
+            return nullptr;
+        }
+        left = std::make_unique<ExpressionNode>(op, std::move(left), std::move(right));
+    }
+    return left;
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseMultiplicative() {
+    auto left = parseUnary();
+    QString op;
+    while (left && !(op = matchOperator({"*", "/", "//"})).isEmpty()) {
+        auto right = parseUnary();
+        if (!right) {
+            return nullptr;
+        }
+        left = std::make_unique<ExpressionNode>(op, std::move(left), std::move(right));
+    }
+    return left;
+}
+
+std::unique_ptr<ExpressionNode> Parser::parseUnary() {
+    const QString op = matchOperator({"-", "!"});
+    if (!op.isEmpty()) {
+        auto operand = parseUnary();
+        return operand ? std::make_unique<ExpressionNode>(op, std::move(operand)) : nullptr;
+    }
+    return parsePower();
+}
+
+std::unique_ptr<ExpressionNode> Parser::parsePower() {
+    auto base = parsePrimary();
+    if (base && !matchOperator({"**"}).isEmpty()) {
+        // Right associative, and the exponent may be negative
+        auto exponent = parseUnary();
+        if (!exponent) {
+            return nullptr;
+        }
+        return std::make_unique<ExpressionNode>("**", std::move(base), std::move(exponent));
+    }
+    return base;
+}
+
+std::unique_ptr<ExpressionNode> Parser::parsePrimary() {
+    skipWhitespace();
+    const Token token = currentToken();
+
+    if (token.type == AHKTokenType::INTEGER || token.type == AHKTokenType::FLOAT) {
+        advance();
+        QString text = tokenText(token);
+        // The lexer splits 0x1F into 0 and x1F
+        const Token rest = currentToken();
+        if (text == "0" && rest.type == AHKTokenType::IDENTIFIER && (rest.value[0] == 'x' || rest.value[0] == 'X')) {
+            text += tokenText(rest);
+            advance();
+        }
+        return std::make_unique<ExpressionNode>(ExpressionNode::Kind::Number, text);
+    }
+
+    if (isSymbol(token, "\"")) {
+        advance();
+        QString text;
+        while (true) {
+            const Token part = currentToken();
+            if (isLineEnd(part)) {
+                warn("Missing closing quote");
+                return nullptr;
+            }
+            advance();
+            if (isSymbol(part, "\"")) {
+                // "" is a quote inside the string
+                if (!isSymbol(currentToken(), "\"")) {
+                    break;
+                }
+                advance();
+            }
+            text += tokenText(part);
+        }
+        return std::make_unique<ExpressionNode>(ExpressionNode::Kind::String, text);
+    }
+
+    if (isSymbol(token, "(")) {
+        advance();
+        auto inner = parseExpression();
+        if (!inner) {
+            return nullptr;
+        }
+        skipWhitespace();
+        if (!isSymbol(currentToken(), ")")) {
+            warn("Missing )");
+            return nullptr;
+        }
+        advance();
+        return inner;
+    }
+
+    // %name% is accepted for the variable as in command arguments
+    if (isSymbol(token, "%") && currentIndex + 2 < tokens.size()
+        && tokens[currentIndex + 1].type == AHKTokenType::IDENTIFIER && isSymbol(tokens[currentIndex + 2], "%")) {
+        const QString name = tokenText(tokens[currentIndex + 1]);
+        currentIndex += 3;
+        return std::make_unique<ExpressionNode>(ExpressionNode::Kind::Variable, name);
+    }
+
+    if (token.type == AHKTokenType::IDENTIFIER) {
+        advance();
+        if (isWord(token, "true") || isWord(token, "false")) {
+            return std::make_unique<ExpressionNode>(ExpressionNode::Kind::Number, isWord(token, "true") ? "1" : "0");
+        }
+        return std::make_unique<ExpressionNode>(ExpressionNode::Kind::Variable, tokenText(token));
+    }
+
+    warn(isLineEnd(token) ? QString("Missing value") : QString("Unexpected \"%1\"").arg(tokenText(token)));
+    return nullptr;
+}
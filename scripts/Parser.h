@@ -24,10 +24,18 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <initializer_list>
 #include <vector>
+#include <QString>
 #include "Token.h"
 #include "AST.h"
 
+/*
+ * Builds the syntax tree from the lexer's tokens. Besides commands it parses
+ * assignments, expressions, If/Else, Loop, While, Until, labels and Goto,
+ * Break, Continue and Return. Keywords are case insensitive like in AHK.
+ * A line that cannot be parsed is logged with its line number and skipped.
+ */
 class Parser {
 public:
     Parser(const std::vector<Token>& tokens);
@@ -39,11 +47,44 @@ private:
 
     Token currentToken();
     void advance();
-    std::unique_ptr<ASTNode> parseExpression();
+    void skipWhitespace();
+    void skipLine();
+    // Skips blanks and a trailing comment, warns about anything else before the newline
+    void endStatement();
+    bool isWord(const Token& token, const char* word) const;
+    bool isSymbol(const Token& token, const char* symbol) const;
+    QString tokenText(const Token& token) const;
+
     std::unique_ptr<ASTNode> parseStatement();
     std::unique_ptr<ASTNode> parseCommandStatement();
-    // std::unique_ptr<ASTNode> parseSendStatement();
-    // Add more parsing methods as needed
+    std::unique_ptr<ASTNode> parseAssignment();
+    std::unique_ptr<ASTNode> parseIf();
+    std::unique_ptr<ASTNode> parseLoop();
+    std::unique_ptr<ASTNode> parseWhile();
+    std::unique_ptr<ASTNode> parseJump();
+    // A { } block or a single statement, on the same or the next line
+    std::unique_ptr<ASTNode> parseBody();
+    std::unique_ptr<ASTNode> parseBlock();
+    // After an If, Loop or While header, true when a body can follow
+    bool expectBody();
+    void parseUntil(LoopNode* loop);
+    // The rest of the line as text, %name% references become variables
+    std::unique_ptr<ExpressionNode> parseText();
+
+    std::unique_ptr<ExpressionNode> parseExpression();
+    std::unique_ptr<ExpressionNode> parseOr();
+    std::unique_ptr<ExpressionNode> parseAnd();
+    std::unique_ptr<ExpressionNode> parseNot();
+    std::unique_ptr<ExpressionNode> parseComparison();
+    std::unique_ptr<ExpressionNode> parseConcat();
+    std::unique_ptr<ExpressionNode> parseAdditive();
+    std::unique_ptr<ExpressionNode> parseMultiplicative();
+    std::unique_ptr<ExpressionNode> parseUnary();
+    std::unique_ptr<ExpressionNode> parsePower();
+    std::unique_ptr<ExpressionNode> parsePrimary();
+    // The operator at the current token when it is one of ops, empty otherwise
+    QString matchOperator(std::initializer_list<const char*> ops);
+    void warn(const QString& message);
 };
 
 #endif // PARSER_H
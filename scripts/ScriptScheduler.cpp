@@ -0,0 +1,415 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "ScriptScheduler.h"
+#include <QDebug>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QString>
+#include <algorithm>
+#include <limits>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+
+ScriptTimeline::ScriptTimeline()
+{
+    ScriptScheduler& scheduler = ScriptScheduler::getInstance();
+    QMutexLocker locker(&scheduler.m_mutex);
+    scheduler.m_timelines.push_back(this);
+    cursorNs = ScriptScheduler::nowNs();
+}
+
+ScriptTimeline::~ScriptTimeline()
+{
+    ScriptScheduler& scheduler = ScriptScheduler::getInstance();
+    QMutexLocker locker(&scheduler.m_mutex);
+    scheduler.unschedule(this);
+    auto& timelines = scheduler.m_timelines;
+    timelines.erase(std::remove(timelines.begin(), timelines.end(), this), timelines.end());
+}
+
+void ScriptTimeline::start()
+{
+    virtualSteps = 0;
+    stalled = false;
+    if (virtualClock) {
+        state.store(State::Running, std::memory_order_release);
+        cursorNs = 0;
+        return;
+    }
+    QMutexLocker locker(&ScriptScheduler::getInstance().m_mutex);
+    state.store(State::Running, std::memory_order_release);
+    cursorNs = ScriptScheduler::nowNs();
+}
+
+void ScriptTimeline::setVirtual(bool enabled, qint64 limitMs)
+{
+    virtualClock = enabled;
+    virtualLimitNs = limitMs * 1000000;
+}
+
+qint64 ScriptTimeline::nowNs() const
+{
+    return virtualClock ? cursorNs : ScriptScheduler::nowNs();
+}
+
+bool ScriptTimeline::sleep(int milliseconds)
+{
+    if (virtualClock) {
+        if (milliseconds > 0) {
+            cursorNs += qint64(milliseconds) * 1000000;
+            virtualSteps = 0;
+        }
+        if (virtualLimitNs > 0 && cursorNs > virtualLimitNs) {
+            cancel();
+        }
+        return !isCancelled();
+    }
+    const qint64 now = ScriptScheduler::nowNs();
+    // Work since the previous deadline shortens this wait, a longer stall starts over from now
+    const qint64 anchor = now - cursorNs <= qint64(MAX_CATCH_UP_MS) * 1000000 ? cursorNs : now;
+    qint64 deadline = anchor + qint64(qMax(milliseconds, 0)) * 1000000;
+    const bool completed = ScriptScheduler::getInstance().waitUntil(this, deadline);
+    cursorNs = deadline;
+    return completed;
+}
+
+bool ScriptTimeline::checkpoint()
+{
+    if (virtualClock && ++virtualSteps > MAX_VIRTUAL_STEPS && !isCancelled()) {
+        // Nothing would move the clock to the time limit
+        stalled = true;
+        cancel();
+    }
+    if (state.load(std::memory_order_acquire) == State::Running) {
+        return true;
+    }
+    ScriptScheduler& scheduler = ScriptScheduler::getInstance();
+    QMutexLocker locker(&scheduler.m_mutex);
+    while (state.load() == State::Paused) {
+        condition.wait(&scheduler.m_mutex);
+    }
+    return state.load() != State::Cancelled;
+}
+
+void ScriptTimeline::pause()
+{
+    ScriptScheduler& scheduler = ScriptScheduler::getInstance();
+    QMutexLocker locker(&scheduler.m_mutex);
+    scheduler.setState(this, State::Paused);
+}
+
+void ScriptTimeline::resume()
+{
+    ScriptScheduler& scheduler = ScriptScheduler::getInstance();
+    QMutexLocker locker(&scheduler.m_mutex);
+    scheduler.setState(this, State::Running);
+}
+
+void ScriptTimeline::cancel()
+{
+    ScriptScheduler& scheduler = ScriptScheduler::getInstance();
+    QMutexLocker locker(&scheduler.m_mutex);
+    scheduler.setState(this, State::Cancelled);
+}
+
+ScriptScheduler& ScriptScheduler::getInstance()
+{
+    static ScriptScheduler instance;
+    return instance;
+}
+
+qint64 ScriptScheduler::nowNs()
+{
+    static const QElapsedTimer timer = [] {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return timer.nsecsElapsed();
+}
+
+ScriptScheduler::ScriptScheduler()
+{
+    setObjectName("ScriptScheduler");
+}
+
+ScriptScheduler::~ScriptScheduler()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stop = true;
+        m_wheelCondition.wakeOne();
+    }
+    wait();
+}
+
+void ScriptScheduler::pauseAll()
+{
+    QMutexLocker locker(&m_mutex);
+    for (ScriptTimeline* timeline : m_timelines) {
+        setState(timeline, ScriptTimeline::State::Paused);
+    }
+}
+
+void ScriptScheduler::resumeAll()
+{
+    QMutexLocker locker(&m_mutex);
+    for (ScriptTimeline* timeline : m_timelines) {
+        setState(timeline, ScriptTimeline::State::Running);
+    }
+}
+
+void ScriptScheduler::cancelAll()
+{
+    QMutexLocker locker(&m_mutex);
+    for (ScriptTimeline* timeline : m_timelines) {
+        setState(timeline, ScriptTimeline::State::Cancelled);
+    }
+}
+
+void ScriptScheduler::setState(ScriptTimeline* timeline, ScriptTimeline::State state)
+{
+    // A cancelled run stays cancelled until the next start()
+    if (timeline->state.load() == ScriptTimeline::State::Cancelled) {
+        return;
+    }
+    timeline->state.store(state, std::memory_order_release);
+    timeline->condition.wakeAll();
+}
+
+bool ScriptScheduler::waitUntil(ScriptTimeline* timeline, qint64& deadlineNs)
+{
+    QMutexLocker locker(&m_mutex);
+    while (true) {
+        const ScriptTimeline::State state = timeline->state.load();
+        if (state == ScriptTimeline::State::Cancelled) {
+            return false;
+        }
+        if (state == ScriptTimeline::State::Paused) {
+            // The remaining time is kept for after the pause
+            const qint64 pausedAt = nowNs();
+            while (timeline->state.load() == ScriptTimeline::State::Paused) {
+                timeline->condition.wait(&m_mutex);
+            }
+            deadlineNs += nowNs() - pausedAt;
+            continue;
+        }
+
+        const qint64 wakeNs = deadlineNs - EARLY_WAKE_NS;
+        if (nowNs() < wakeNs) {
+            schedule(timeline, wakeNs);
+            while (!timeline->due && timeline->state.load() == ScriptTimeline::State::Running) {
+                timeline->condition.wait(&m_mutex);
+            }
+            unschedule(timeline);
+            if (!timeline->due) {
+                // Paused or cancelled
+                continue;
+            }
+        }
+
+        // The wheel only knows milliseconds, a precise timed wait gets within SPIN_NS
+        const qint64 remainingNs = deadlineNs - SPIN_NS - nowNs();
+        if (remainingNs <= 0) {
+            break;
+        }
+        QDeadlineTimer timer(Qt::PreciseTimer);
+        timer.setPreciseRemainingTime(0, remainingNs, Qt::PreciseTimer);
+        timeline->condition.wait(&m_mutex, timer);
+    }
+    locker.unlock();
+
+    // The rest is yielded away
+    while (nowNs() < deadlineNs) {
+        if (timeline->isCancelled()) {
+            return false;
+        }
+        QThread::yieldCurrentThread();
+    }
+    return !timeline->isCancelled();
+}
+
+void ScriptScheduler::schedule(ScriptTimeline* timeline, qint64 wakeNs)
+{
+    // Served when its tick begins, so up to a tick early, which the timed wait makes up for
+    const qint64 tick = wakeNs / TICK_NS;
+    const qint64 nowTick = nowNs() / TICK_NS;
+    timeline->due = false;
+    if (tick <= nowTick) {
+        timeline->due = true;
+        return;
+    }
+    if (m_pending++ == 0) {
+        // The wheel stood still while nothing waited
+        m_currentTick = nowTick;
+        if (!isRunning()) {
+            start(QThread::TimeCriticalPriority);
+        }
+        m_wheelCondition.wakeOne();
+    } else if (tick < m_wakeTick) {
+        // Earlier than the slot the wheel sleeps until
+        m_wheelCondition.wakeOne();
+    }
+    m_slots[tick % SLOT_COUNT].push_back(timeline);
+    timeline->wheelTick = tick;
+}
+
+void ScriptScheduler::unschedule(ScriptTimeline* timeline)
+{
+    if (timeline->wheelTick < 0) {
+        return;
+    }
+    auto& slot = m_slots[timeline->wheelTick % SLOT_COUNT];
+    slot.erase(std::remove(slot.begin(), slot.end(), timeline), slot.end());
+    timeline->wheelTick = -1;
+    m_pending--;
+}
+
+void ScriptScheduler::run()
+{
+    QMutexLocker locker(&m_mutex);
+    bool fineTimer = false;
+    while (!m_stop) {
+        if (m_pending == 0) {
+#ifdef Q_OS_WIN
+            if (fineTimer) {
+                timeEndPeriod(1);
+                fineTimer = false;
+            }
+#endif
+            m_wakeTick = -1;
+            m_wheelCondition.wait(&m_mutex);
+            continue;
+        }
+#ifdef Q_OS_WIN
+        if (!fineTimer) {
+            // The default timer resolution of 15.6 ms would make every wake late, it is raised only
+            // while scripts wait
+            timeBeginPeriod(1);
+            fineTimer = true;
+        }
+#endif
+
+        // Sleeps until the next occupied slot instead of turning through the empty ones
+        m_wakeTick = std::numeric_limits<qint64>::max();
+        for (const ScriptTimeline* timeline : m_timelines) {
+            if (timeline->wheelTick >= 0) {
+                m_wakeTick = std::min(m_wakeTick, timeline->wheelTick);
+            }
+        }
+        const qint64 waitNs = m_wakeTick * TICK_NS - nowNs();
+        if (waitNs > 0) {
+            QDeadlineTimer wake;
+            wake.setPreciseRemainingTime(0, waitNs, Qt::PreciseTimer);
+            m_wheelCondition.wait(&m_mutex, wake);
+        }
+
+        const qint64 nowTick = nowNs() / TICK_NS;
+        // After a stall longer than a turn every slot is served once, later rounds stay
+        const qint64 lastTick = std::min(nowTick, m_currentTick + SLOT_COUNT);
+        for (qint64 tick = m_currentTick + 1; tick <= lastTick && m_pending > 0; tick++) {
+            auto& slot = m_slots[tick % SLOT_COUNT];
+            for (size_t i = 0; i < slot.size();) {
+                ScriptTimeline* timeline = slot[i];
+                if (timeline->wheelTick > nowTick) {
+                    i++;
+                    continue;
+                }
+                timeline->wheelTick = -1;
+                timeline->due = true;
+                timeline->condition.wakeAll();
+                slot[i] = slot.back();
+                slot.pop_back();
+                m_pending--;
+            }
+        }
+        m_currentTick = std::max(m_currentTick, nowTick);
+    }
+#ifdef Q_OS_WIN
+    if (fineTimer) {
+        timeEndPeriod(1);
+    }
+#endif
+}
+
+void ScriptScheduler::runBenchmark()
+{
+    const int rounds = 50;
+    for (int ms : {1, 5, 20}) {
+        qint64 sleepTotal = 0;
+        qint64 sleepWorst = 0;
+        qint64 timelineTotal = 0;
+        qint64 timelineWorst = 0;
+        ScriptTimeline timeline;
+        for (int i = 0; i < rounds; i++) {
+            qint64 start = nowNs();
+            QThread::msleep(ms);
+            qint64 late = nowNs() - start - qint64(ms) * 1000000;
+            sleepTotal += late;
+            sleepWorst = qMax(sleepWorst, late);
+
+            // A fresh start, so each wait is measured on its own
+            timeline.start();
+            start = nowNs();
+            timeline.sleep(ms);
+            late = nowNs() - start - qint64(ms) * 1000000;
+            timelineTotal += late;
+            timelineWorst = qMax(timelineWorst, late);
+        }
+        qInfo().noquote() << QString("scheduler wait %1 ms: msleep %2 us late on average, %3 us at most; "
+                                     "timeline %4 us late on average, %5 us at most")
+                                 .arg(ms, 2)
+                                 .arg(sleepTotal / rounds / 1000)
+                                 .arg(sleepWorst / 1000)
+                                 .arg(timelineTotal / rounds / 1000)
+                                 .arg(timelineWorst / 1000);
+    }
+
+    // A loop that sends for 2 ms between waits of 10 ms
+    const int loops = 50;
+    auto work = [] {
+        const qint64 start = nowNs();
+        while (nowNs() - start < 2000000) {
+        }
+    };
+    qint64 start = nowNs();
+    for (int i = 0; i < loops; i++) {
+        work();
+        QThread::msleep(10);
+    }
+    const qint64 sleepDrift = nowNs() - start - loops * 10000000LL;
+    ScriptTimeline timeline;
+    timeline.start();
+    start = nowNs();
+    for (int i = 0; i < loops; i++) {
+        work();
+        timeline.sleep(10);
+    }
+    const qint64 timelineDrift = nowNs() - start - loops * 10000000LL;
+    qInfo().noquote() << QString("scheduler %1 x (2 ms work + 10 ms wait): msleep %2 ms over, timeline %3 ms over")
+                             .arg(loops)
+                             .arg(sleepDrift / 1000000.0, 0, 'f', 1)
+                             .arg(timelineDrift / 1000000.0, 0, 'f', 1);
+}
@@ -0,0 +1,153 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef SCRIPTSCHEDULER_H
+#define SCRIPTSCHEDULER_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <array>
+#include <atomic>
+#include <vector>
+
+class ScriptScheduler;
+
+/*
+ * The clock of one running script. Waits are placed after the previous
+ * deadline rather than after the current time, so the time spent sending
+ * between two waits does not add up over a loop. A stall longer than
+ * MAX_CATCH_UP_MS, e.g. an ImageSearch, starts the timeline again from now.
+ *
+ * pause(), resume() and cancel() may be called from any thread and take
+ * effect in the middle of a wait. A paused wait keeps its remaining time.
+ */
+class ScriptTimeline {
+public:
+    static const int MAX_CATCH_UP_MS = 10;
+    // A virtual run this many instructions past its last wait never moves its clock again, e.g. an
+    // empty Loop, and is stopped
+    static const qint64 MAX_VIRTUAL_STEPS = 10000000;
+
+    ScriptTimeline();
+    ~ScriptTimeline();
+
+    // Starts a run: not paused or cancelled, and the timeline begins now
+    void start();
+    // Waits only move the clock of a virtual timeline, for dry runs. A wait
+    // past limitMs of virtual time cancels the run, 0 is no limit. A virtual
+    // timeline never uses the scheduler's thread.
+    void setVirtual(bool enabled, qint64 limitMs = 0);
+    bool isVirtual() const { return virtualClock; }
+    // Whether a virtual run was cancelled after MAX_VIRTUAL_STEPS without a wait
+    bool isStalled() const { return stalled; }
+    // The scheduler's clock, or the time since start() on a virtual timeline
+    qint64 nowNs() const;
+    // Waits the milliseconds after the previous deadline, false when cancelled
+    bool sleep(int milliseconds);
+    // Blocks while paused, false when cancelled. Cheap when running. Called
+    // before every instruction, a virtual timeline counts them.
+    bool checkpoint();
+
+    void pause();
+    void resume();
+    void cancel();
+    bool isPaused() const { return state.load(std::memory_order_acquire) == State::Paused; }
+    bool isCancelled() const { return state.load(std::memory_order_acquire) == State::Cancelled; }
+
+private:
+    friend class ScriptScheduler;
+    enum class State {
+        Running,
+        Paused,
+        Cancelled,
+    };
+
+    // Guarded by the scheduler's mutex, state is also read without it
+    std::atomic<State> state{State::Running};
+    QWaitCondition condition;
+    bool due = false;
+    qint64 wheelTick = -1;          // -1 when not on the wheel
+    qint64 cursorNs = 0;            // The previous deadline, only used by the script's thread
+    bool virtualClock = false;
+    qint64 virtualLimitNs = 0;
+    qint64 virtualSteps = 0;        // Since the virtual clock last moved
+    bool stalled = false;
+};
+
+/*
+ * Wakes waiting scripts at their deadlines. One thread, started by the
+ * first real wait, keeps them on a wheel of 1 ms slots and sleeps until the
+ * next occupied one, and is idle while nothing waits. A wait leaves
+ * the wheel slightly early, waits with a precise timer until shortly before
+ * the deadline and yields through the last microseconds, so it ends close
+ * to the deadline instead of at the scheduler granularity of the OS without
+ * spinning for long. Any number of scripts may wait at once.
+ */
+class ScriptScheduler : public QThread {
+    Q_OBJECT
+
+public:
+    static ScriptScheduler& getInstance();
+    static qint64 nowNs();
+
+    // For the script controls, apply to every timeline
+    void pauseAll();
+    void resumeAll();
+    void cancelAll();
+
+    // Prints how far waits overshoot, compared with QThread::msleep
+    static void runBenchmark();
+
+protected:
+    void run() override;
+
+private:
+    friend class ScriptTimeline;
+    static const qint64 TICK_NS = 1000000;
+    static const int SLOT_COUNT = 1024;
+    // Leaves the wheel this much before the deadline for a precise timed wait
+    static const qint64 EARLY_WAKE_NS = 1500000;
+    // The timed wait ends this much before the deadline, the rest is yielded
+    static const qint64 SPIN_NS = 200000;
+
+    ScriptScheduler();
+    ~ScriptScheduler();
+
+    // Moves deadlineNs by the time spent paused, false when cancelled
+    bool waitUntil(ScriptTimeline* timeline, qint64& deadlineNs);
+    void setState(ScriptTimeline* timeline, ScriptTimeline::State state);
+    // With m_mutex held
+    void schedule(ScriptTimeline* timeline, qint64 wakeNs);
+    void unschedule(ScriptTimeline* timeline);
+
+    QMutex m_mutex;
+    QWaitCondition m_wheelCondition;
+    std::array<std::vector<ScriptTimeline*>, SLOT_COUNT> m_slots;
+    std::vector<ScriptTimeline*> m_timelines;
+    qint64 m_currentTick = 0;       // Every slot up to this tick has been served
+    qint64 m_wakeTick = -1;         // The tick the wheel sleeps until, -1 when idle
+    int m_pending = 0;
+    bool m_stop = false;
+};
+
+#endif // SCRIPTSCHEDULER_H
@@ -25,6 +25,7 @@
 #define TOKEN_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <iostream>
@@ -55,17 +56,19 @@ enum class AHKTokenType {
 
 struct Token {
     AHKTokenType type;
-    std::string value;
+    std::string_view value;     // Slice of the lexer's source
+    int line = 0;               // From 1
+    int column = 0;             // From 1, in bytes
 };
 
 const std::set<std::string> keywords = {
 	"If", "Else", "Loop", "While", "For", "Try", "Catch", "Finally", "Throw",
-	"Switch", "Return", "Goto", "Continue", "Until"
+	"Switch", "Return", "Goto", "Continue", "Until", "Break"
 };
 
 const std::vector<std::string> operators = {
 	":=", "=", "+=", "-=", "*=", "/=", ".=", "|=", "&=", "^=", ">>=", "<<=", "+", "++", "-", "--", "*", "**", "/", "//",
-	">", "<", "!", "==", "!=", "<>", "|", "||", "&", "&&",
+	">", "<", ">=", "<=", "!", "==", "!=", "<>", "|", "||", "&", "&&",
     "%", ".", "()",
 };
 
@@ -73,7 +76,7 @@ const std::set<std::string> mouse_keyboard = {
 	"BlockInput", "Click", "ControlClick", "ControlSend", "CoordMode","GetKeyName", "GetKeySC", "GetKeyState",
 	"GetKeyVK", "List of Keys", "KeyHistory", "KeyWait", "Input", "InputHook", "MouseClick", "MouseClickDrag",
 	"MouseGetPos", "MouseMove", "Send", "SendLevel", "SendMode", "SetCapsLockState", "SetDefaultMouseSpeed",
-	"SetKeyDelay", "SetNumLockState", "SetScrollLockState", "SetStoreCapsLockMode", "Sleep", "FullScreenCapture","AreaScreenCapture"
+	"SetKeyDelay", "SetMouseDelay", "SetNumLockState", "SetScrollLockState", "SetStoreCapsLockMode", "Sleep", "FullScreenCapture","AreaScreenCapture", "ImageSearch", "PixelGetColor", "PixelSearch", "SaveRecentVideo", "AudioLevel", "WaitForBeep"
 };
 
 
@@ -22,16 +22,120 @@
 
 
 #include "semanticAnalyzer.h"
+#include "Compiler.h"
 #include <stdexcept>
 #include <QDebug>
 #include <QString>
 #include "AHKKeyboard.h"
 #include "KeyboardMouse.h"
 #include "global.h"
+#include "video/framedistributor.h"
+#include "video/frameconverter.h"
+#include "video/imagesearch.h"
+#include "video/pixelsearch.h"
+#include "host/audiometer.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <cmath>
 
 
 Q_LOGGING_CATEGORY(log_script, "opf.scripts")
 
+namespace {
+
+ScriptValue compare(ExprOp op, const ScriptValue& left, const ScriptValue& right)
+{
+    int order;
+    if (left.isNumber && right.isNumber) {
+        order = left.number < right.number ? -1 : (left.number > right.number ? 1 : 0);
+    } else {
+        order = QString::compare(left.toText(), right.toText(),
+                                 op == ExprOp::CaseEqual ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    }
+    switch (op) {
+        case ExprOp::NotEqual: return ScriptValue::fromNumber(order != 0);
+        case ExprOp::Less: return ScriptValue::fromNumber(order < 0);
+        case ExprOp::LessEqual: return ScriptValue::fromNumber(order <= 0);
+        case ExprOp::Greater: return ScriptValue::fromNumber(order > 0);
+        case ExprOp::GreaterEqual: return ScriptValue::fromNumber(order >= 0);
+        default: return ScriptValue::fromNumber(order == 0);
+    }
+}
+
+ScriptValue applyBinary(ExprOp op, const ScriptValue& left, const ScriptValue& right)
+{
+    switch (op) {
+        case ExprOp::Concat:
+            return ScriptValue::fromText(left.toText() + right.toText());
+        case ExprOp::And:
+            return ScriptValue::fromNumber(left.isTrue() && right.isTrue());
+        case ExprOp::Or:
+            return ScriptValue::fromNumber(left.isTrue() || right.isTrue());
+        case ExprOp::Equal:
+        case ExprOp::CaseEqual:
+        case ExprOp::NotEqual:
+        case ExprOp::Less:
+        case ExprOp::LessEqual:
+        case ExprOp::Greater:
+        case ExprOp::GreaterEqual:
+            return compare(op, left, right);
+        default:
+            break;
+    }
+
+    // Arithmetic on text or a division by zero gives an empty string, as in AHK
+    if (!left.isNumber || !right.isNumber) {
+        return ScriptValue();
+    }
+    switch (op) {
+        case ExprOp::Add: return ScriptValue::fromNumber(left.number + right.number);
+        case ExprOp::Subtract: return ScriptValue::fromNumber(left.number - right.number);
+        case ExprOp::Multiply: return ScriptValue::fromNumber(left.number * right.number);
+        case ExprOp::Divide:
+            return right.number != 0 ? ScriptValue::fromNumber(left.number / right.number) : ScriptValue();
+        case ExprOp::FloorDivide:
+            return right.number != 0 ? ScriptValue::fromNumber(std::floor(left.number / right.number)) : ScriptValue();
+        case ExprOp::Power: return ScriptValue::fromNumber(std::pow(left.number, right.number));
+        default: return ScriptValue();
+    }
+}
+
+}
+
+ScriptValue ScriptValue::fromText(const QString& text)
+{
+    ScriptValue value;
+    value.text = text;
+    value.number = text.toDouble(&value.isNumber);
+    if (!value.isNumber && text.trimmed().startsWith("0x", Qt::CaseInsensitive)) {
+        value.number = double(text.trimmed().toLongLong(&value.isNumber, 16));
+    }
+    if (value.isNumber && !std::isfinite(value.number)) {
+        value.isNumber = false;
+    }
+    return value;
+}
+
+ScriptValue ScriptValue::fromNumber(double number)
+{
+    ScriptValue value;
+    value.number = number;
+    value.isNumber = true;
+    return value;
+}
+
+QString ScriptValue::toText() const
+{
+    if (!isNumber || !text.isNull()) {
+        return text;
+    }
+    // Whole numbers are printed without a decimal point
+    if (std::floor(number) == number && std::fabs(number) < 1e15) {
+        return QString::number(qint64(number));
+    }
+    return QString::number(number, 'g', 15);
+}
+
 SemanticAnalyzer::SemanticAnalyzer(MouseManager* mouseManager, KeyboardMouse* keyboardMouse, QObject* parent)
     : QObject(parent), mouseManager(mouseManager), keyboardMouse(keyboardMouse) {
     if (!mouseManager) {
@@ -39,37 +143,264 @@ SemanticAnalyzer::SemanticAnalyzer(MouseManager* mouseManager, KeyboardMouse* ke
     }
 }
 
-void SemanticAnalyzer::analyze(const ASTNode* node) {
-    if (!node) {
-        qDebug(log_script) << "Received null node in analyze method.";
-        return;
+void SemanticAnalyzer::run(const Program& program, const CancellationToken& token) {
+    variables.assign(size_t(program.variables.size()), ScriptValue());
+    variableSlots.clear();
+    for (int i = 0; i < program.variables.size(); i++) {
+        variableSlots.insert(program.variables[i], i);
+    }
+    otherVariables.clear();
+    dynamicPrograms.clear();
+    loops.assign(size_t(program.loopCount), LoopState());
+    timeline.start();
+    // Cancelling the task also ends a wait in the middle
+    const int callback = token.addCallback([this] { timeline.cancel(); });
+    runProgram(program);
+    token.removeCallback(callback);
+    if (timeline.isCancelled()) {
+        qCDebug(log_script) << "Script cancelled";
     }
-    
-    switch (node->getType()) {
-        case ASTNodeType::StatementList:
-            // Process each statement in the list
-            for (const auto& child : node->getChildren()) {
-                qDebug(log_script) << "Analyzing child node.";
-                analyze(child.get());
-                // resetParameters(); // Reset after each statement
+}
+
+void SemanticAnalyzer::setVariable(const QString& name, const QString& value) {
+    const QString lower = name.toLower();
+    auto it = variableSlots.constFind(lower);
+    if (it != variableSlots.constEnd()) {
+        variables[it.value()] = ScriptValue::fromText(value);
+    } else {
+        otherVariables.insert(lower, value);
+    }
+}
+
+QString SemanticAnalyzer::variable(const QString& name) const {
+    const QString lower = name.toLower();
+    auto it = variableSlots.constFind(lower);
+    return it != variableSlots.constEnd() ? variables[it.value()].toText() : otherVariables.value(lower);
+}
+
+ScriptValue SemanticAnalyzer::loopIndex(int loop) const {
+    // Outside loops A_Index is empty
+    return loop >= 0 ? ScriptValue::fromNumber(double(loops[loop].index)) : ScriptValue();
+}
+
+void SemanticAnalyzer::runProgram(const Program& program) {
+    const int end = int(program.instructions.size());
+    int next = 0;
+    // Between instructions a paused script waits and a cancelled one stops
+    while (next < end && timeline.checkpoint()) {
+        const Instruction& instruction = program.instructions[next++];
+        switch (instruction.op) {
+            case Op::Jump:
+                next = instruction.a;
+                break;
+
+            case Op::JumpIf:
+                if (evaluate(program, instruction.b).isTrue() == (instruction.c != 0)) {
+                    next = instruction.a;
+                }
+                break;
+
+            case Op::LoopStart: {
+                LoopState& loop = loops[instruction.a];
+                loop.index = 0;
+                loop.count = -1;
+                if (instruction.b >= 0) {
+                    ScriptValue count = evaluate(program, instruction.b);
+                    loop.count = count.isNumber ? qMax<qint64>(0, qint64(count.number)) : 0;
+                }
+                break;
+            }
+
+            case Op::LoopNext: {
+                LoopState& loop = loops[instruction.b];
+                if (loop.count >= 0 && loop.index >= loop.count) {
+                    next = instruction.a;
+                    break;
+                }
+                loop.index++;
+                break;
+            }
+
+            default:
+                execute(program, instruction);
+                break;
+        }
+    }
+}
+
+/*
+ * Runs the postfix terms of an expression on a stack of values
+ */
+ScriptValue SemanticAnalyzer::evaluate(const Program& program, int expression) {
+    std::vector<ScriptValue>& stack = evaluationStack;
+    stack.clear();
+    for (const ExprTerm& term : program.expressions[expression]) {
+        switch (term.op) {
+            case ExprOp::Number:
+                stack.push_back(ScriptValue::fromNumber(term.number));
+                break;
+            case ExprOp::String:
+                stack.push_back(ScriptValue::fromText(program.strings[term.index]));
+                break;
+            case ExprOp::Variable:
+                stack.push_back(variables[term.index]);
+                break;
+            case ExprOp::LoopIndex:
+                stack.push_back(loopIndex(term.index));
+                break;
+            case ExprOp::Negate:
+                stack.back() = stack.back().isNumber ? ScriptValue::fromNumber(-stack.back().number) : ScriptValue();
+                break;
+            case ExprOp::Not:
+                stack.back() = ScriptValue::fromNumber(!stack.back().isTrue());
+                break;
+            default: {
+                ScriptValue right = std::move(stack.back());
+                stack.pop_back();
+                stack.back() = applyBinary(term.op, stack.back(), right);
+                break;
+            }
+        }
+    }
+    return stack.empty() ? ScriptValue() : stack.back();
+}
+
+void SemanticAnalyzer::execute(const Program& program, const Instruction& instruction) {
+    switch (instruction.op) {
+        case Op::SendReports:
+            for (int i = 0; i < instruction.b; i++) {
+                if (!keyboardMouse->sendReport(program.reports[instruction.a + i], &timeline)) {
+                    break;
+                }
             }
             break;
-            
-        case ASTNodeType::CommandStatement:
-            qDebug(log_script) << "Analyzing command statement.";
-            analyzeCommandStetement(static_cast<const CommandStatementNode*>(node));
+
+        case Op::Click:
+            click(instruction.a, instruction.b, instruction.c);
             break;
-            
-        default:
-            // Process any child nodes
-            for (const auto& child : node->getChildren()) {
-                qDebug(log_script) << "Analyzing default child node.";
-                analyze(child.get());
+
+        case Op::ClickAt: {
+            int coordinates[2] = {0, 0};
+            for (int i = 0; i < 2; i++) {
+                const int expression = i == 0 ? instruction.a : instruction.b;
+                if (expression >= 0) {
+                    ScriptValue value = evaluate(program, expression);
+                    coordinates[i] = value.isNumber ? int(value.number) : 0;
+                }
+            }
+            click(toHidCoordinate(coordinates[0], program.inputWidth),
+                  toHidCoordinate(coordinates[1], program.inputHeight), instruction.c);
+            break;
+        }
+
+        case Op::Sleep:
+            timeline.sleep(instruction.a);
+            break;
+
+        case Op::SleepFor: {
+            ScriptValue value = evaluate(program, instruction.a);
+            if (value.isNumber && value.number >= 0) {
+                timeline.sleep(int(value.number));
+            }
+            break;
+        }
+
+        case Op::SetLockState:
+            setLockState(static_cast<LockKey>(instruction.a), instruction.b != 0);
+            break;
+
+        case Op::SetDelay:
+            switch (static_cast<Delay>(instruction.a)) {
+                case Delay::Key:
+                    keyboardMouse->setKeyDelay(instruction.b);
+                    break;
+                case Delay::KeyPress:
+                    keyboardMouse->setKeyPressDuration(instruction.b);
+                    break;
+                case Delay::Mouse:
+                    keyboardMouse->setMouseDelay(instruction.b);
+                    break;
+            }
+            break;
+
+        case Op::Capture:
+            emit captureImg(program.strings[instruction.a]);
+            break;
+
+        case Op::CaptureArea:
+            emit captureAreaImg(program.strings[instruction.a], program.rects[instruction.b]);
+            break;
+
+        case Op::SaveRecentVideo:
+            emit saveRecentVideo(program.strings[instruction.a]);
+            break;
+
+        case Op::Command:
+            if (instruction.b < 0) {
+                analyzeCommandStetement(program.nodes[instruction.a]);
+            } else {
+                const CommandTemplate& command = program.templates[instruction.b];
+                CommandStatementNode expandedNode(expandTemplate(program, command));
+                expandedNode.setCommandName(command.node->getCommandName());
+                analyzeCommandStetement(&expandedNode);
+            }
+            break;
+
+        case Op::Dynamic: {
+            const CommandTemplate& command = program.templates[instruction.a];
+            auto key = std::make_pair(instruction.a, expandTemplate(program, command));
+            auto it = dynamicPrograms.find(key);
+            if (it == dynamicPrograms.end()) {
+                // Values the command has not run with, like a counter in a Send, are compiled once each
+                if (dynamicPrograms.size() >= MAX_DYNAMIC_PROGRAMS) {
+                    dynamicPrograms.clear();
+                }
+                CommandStatementNode expandedNode(key.second);
+                expandedNode.setCommandName(command.node->getCommandName());
+                Program expanded;
+                Compiler().compileCommand(&expandedNode, expanded);
+                it = dynamicPrograms.emplace(std::move(key), std::move(expanded)).first;
             }
+            runProgram(it->second);
+            break;
+        }
+
+        case Op::Assign: {
+            ScriptValue value = evaluate(program, instruction.b);
+            if (!value.isSet()) {
+                // An empty result still sets the variable
+                value.text = QStringLiteral("");
+            }
+            variables[instruction.a] = std::move(value);
+            break;
+        }
+
+        case Op::Jump:
+        case Op::JumpIf:
+        case Op::LoopStart:
+        case Op::LoopNext:
+            // Control flow is handled by run()
             break;
     }
 }
 
+/*
+ * Presses the lock key when the target's state differs from the wanted one
+ */
+void SemanticAnalyzer::setLockState(LockKey key, bool on) {
+    static const char* const names[] = {"CapsLock", "NumLock", "ScrollLock"};
+    keyboardMouse->updateNumCapsScrollLockState();
+    bool state = key == LockKey::CapsLock ? keyboardMouse->getCapsLockState_()
+                 : key == LockKey::NumLock ? keyboardMouse->getNumLockState_()
+                                           : keyboardMouse->getScrollLockState_();
+    qCDebug(log_script) << names[int(key)] << (on ? "on" : "off");
+    if (state != on) {
+        std::array<uint8_t, 6> general = {keydata.value(names[int(key)]), 0x00, 0x00, 0x00, 0x00, 0x00};
+        keyboardMouse->addKeyPacket(keyPacket(general));
+        keyboardMouse->dataSend(&timeline);
+    }
+}
+
 void SemanticAnalyzer::resetParameters() {
     if (mouseManager) {
         // Reset mouse manager state
@@ -80,447 +411,411 @@ void SemanticAnalyzer::resetParameters() {
     }
 }
 
+void SemanticAnalyzer::click(int x, int y, int mouseButton) {
+    try {
+        mouseManager->handleAbsoluteMouseAction(x, y, mouseButton, 0);
+    } catch (const std::exception& e) {
+        qDebug(log_script) << "Exception caught in handleAbsoluteMouseAction:" << e.what();
+    } catch (...) {
+        qDebug(log_script) << "Unknown exception caught in handleAbsoluteMouseAction.";
+    }
+    keyboardMouse->wait(keyboardMouse->getMouseDelay(), &timeline);
+}
+
+/*
+ * The options of a template with the variable values in place of the
+ * %name% references. Unset variables are left as they are.
+ */
+std::vector<std::string> SemanticAnalyzer::expandTemplate(const Program& program, const CommandTemplate& command)
+{
+    std::vector<std::string> expanded;
+    expanded.reserve(command.parts.size());
+    for (const CommandTemplate::Part& part : command.parts) {
+        if (part.expression < 0) {
+            expanded.push_back(part.text);
+            continue;
+        }
+        ScriptValue value = evaluate(program, part.expression);
+        if (value.isSet()) {
+            expanded.push_back(value.toText().toStdString());
+        } else {
+            expanded.insert(expanded.end(), {"%", part.text, "%"});
+        }
+    }
+    return expanded;
+}
+
 void SemanticAnalyzer::analyzeCommandStetement(const CommandStatementNode* node){
     QString commandName = node->getCommandName();
     
-    if(commandName == "Click"){
-        analyzeClickStatement(node);
-    }
-    if(commandName == "Send"){
-        analyzeSendStatement(node);
-    }
-    if(commandName == "Sleep"){
-        analyzeSleepStatement(node);
-    }
-    if(commandName == "SetCapsLockState"){
-        analyzeLockState(node, "CapsLock", &KeyboardMouse::getCapsLockState_);
+    if(commandName == "ImageSearch"){
+        analyzeImageSearch(node);
     }
-    if(commandName == "SetNumLockState"){
-        analyzeLockState(node, "NumLock", &KeyboardMouse::getNumLockState_);
+    if(commandName == "PixelGetColor"){
+        analyzePixelGetColor(node);
     }
-    if(commandName == "SetScrollLockState"){
-        analyzeLockState(node, "ScrollLcok", &KeyboardMouse::getScrollLockState_);
+    if(commandName == "PixelSearch"){
+        analyzePixelSearch(node);
     }
-    if(commandName == "FullScreenCapture"){
-        analyzeFullScreenCapture(node);
+    if(commandName == "AudioLevel"){
+        analyzeAudioLevel(node);
     }
-    if(commandName == "AreaScreenCapture"){
-        analyzeAreaScreenCapture(node);
+    if(commandName == "WaitForBeep"){
+        analyzeWaitForBeep(node);
     }
 }
 
-void SemanticAnalyzer::analyzeAreaScreenCapture(const CommandStatementNode* node){
-    const auto& options = node->getOptions();
-    if (options.empty()){
-        qCDebug(log_script) << "No param given";
-        return;
+QRect SemanticAnalyzer::targetToFrame(const QRect& rect, const QSize& frameSize) const
+{
+    int inputWidth = GlobalVar::instance().getInputWidth();
+    int inputHeight = GlobalVar::instance().getInputHeight();
+    if (inputWidth <= 0 || inputHeight <= 0) {
+        return rect;
     }
-    QString path;
-    QString tmpTxt;
-    QStringList numTmp;
-    qCDebug(log_script) << "Capturing area img";
-    for (const auto& token : options){
-        if (token != "\"") tmpTxt.append(QString::fromStdString(token));
-    }
-    path = extractFilePath(tmpTxt);
-    QRegularExpressionMatchIterator numMatchs = regex.numberRegex.globalMatch(tmpTxt);
-    while(numMatchs.hasNext()){
-        QRegularExpressionMatch nummatch = numMatchs.next();
-        numTmp.append(nummatch.captured(0));
-    }
-    std::vector<int> numData;
-    for (const QString & num : numTmp){
-        bool ok;
-        int value = num.toInt(&ok);
-        if (ok){
-            numData.push_back(value);
-        }
-    }
-    if (numData.size()<4) {
-        qCDebug(log_script) << "the param of area rect is x y width height";
-        return;
+    return QRect(rect.x() * frameSize.width() / inputWidth, rect.y() * frameSize.height() / inputHeight,
+                 rect.width() * frameSize.width() / inputWidth, rect.height() * frameSize.height() / inputHeight);
+}
+
+QPoint SemanticAnalyzer::frameToTarget(const QPoint& point, const QSize& frameSize) const
+{
+    int inputWidth = GlobalVar::instance().getInputWidth();
+    int inputHeight = GlobalVar::instance().getInputHeight();
+    if (inputWidth <= 0 || inputHeight <= 0 || frameSize.isEmpty()) {
+        return point;
     }
-    QRegularExpression regex("\\\\");
-    path.replace(regex, "/");
-    QRect area = QRect(numData[0], numData[1], numData[2], numData[3]);
-    emit captureAreaImg(path, area);
+    return QPoint(point.x() * inputWidth / frameSize.width(), point.y() * inputHeight / frameSize.height());
 }
 
-void SemanticAnalyzer::analyzeFullScreenCapture(const CommandStatementNode* node){
-    const auto& options = node->getOptions();
-    QString path;
-    QString tmpTxt;
-    if (options.empty()){
-        qCDebug(log_script) << "No path given";
-        QString path = "";
-        emit captureImg(path);
-        return;
+QImage SemanticAnalyzer::loadReferenceImage(const QString& path)
+{
+    // Scripts usually search the same few images in a loop, keep them decoded
+    QFileInfo info(path);
+    QString key = path + "|" + QString::number(info.lastModified().toMSecsSinceEpoch());
+    auto it = referenceImages.constFind(key);
+    if (it != referenceImages.constEnd()) {
+        return it.value();
     }
-    for (const auto& token : options){
-        if (token != "\"") tmpTxt.append(QString::fromStdString(token));
+    QImage image(path);
+    if (!image.isNull()) {
+        referenceImages.insert(key, image);
     }
-    path = extractFilePath(tmpTxt);
-    QRegularExpression regex("\\\\");
-    path.replace(regex, "/");
-    emit captureImg(path);
+    return image;
 }
 
-QString SemanticAnalyzer::extractFilePath(const QString& originText){
-    QRegularExpression regex(R"(([a-zA-Z]:[\\\/][^\s]+|\/[^\s]+))");
-    QRegularExpressionMatch match = regex.match(originText);
-    if (match.hasMatch()){
-        return match.captured(0);
+QStringList SemanticAnalyzer::commandParams(const CommandStatementNode* node) const
+{
+    QString text;
+    for (const auto& token : node->getOptions()){
+        if (token != "\"") text.append(QString::fromStdString(token));
+    }
+    QStringList params = text.split(',');
+    if (!params.isEmpty() && params.first().trimmed().isEmpty()) {
+        params.removeFirst();
     }
-    return QString();
+    return params;
 }
 
-void SemanticAnalyzer::analyzeLockState(const CommandStatementNode* node, const QString& keyName, bool (KeyboardMouse::*getStateFunc)()){
-    const auto& options = node->getOptions();
-    std::array<uint8_t, 6> general = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    if (options.empty()){
-        qCDebug(log_script) << "Please enter parameters.";
+/*
+ * ImageSearch, OutputVarX, OutputVarY, X1, Y1, X2, Y2, [*n] [*NCC] ImageFile
+ *
+ * Coordinates are target screen pixels. The image file is expected at the
+ * capture resolution, e.g. cut from a FullScreenCapture. ErrorLevel is 0 when
+ * found, 1 when not found and 2 when the search could not run.
+ */
+void SemanticAnalyzer::analyzeImageSearch(const CommandStatementNode* node){
+    QStringList params = commandParams(node);
+    if (params.size() < 7) {
+        qCDebug(log_script) << "ImageSearch needs OutputVarX, OutputVarY, X1, Y1, X2, Y2, ImageFile";
+        setVariable("ErrorLevel", "2");
         return;
     }
-    QString tmpKeys;
-    for (const auto& token : options){
-        if (token != "\"") tmpKeys.append(QString::fromStdString(token));
-    }
-    tmpKeys.remove(' ');
-    qCDebug(log_script) << tmpKeys;
-    if (regex.onRegex.match(tmpKeys).hasMatch()){
-        qCDebug(log_script) << keyName << " on";
-        keyboardMouse->updateNumCapsScrollLockState();
-        if (!(keyboardMouse->*getStateFunc)()){
-            general[0] = keydata.value(keyName);
-            keyPacket pack(general);
-            keyboardMouse->addKeyPacket(pack);
-            keyboardMouse->dataSend();
+
+    QString outX = params[0].trimmed();
+    QString outY = params[1].trimmed();
+    int coords[4];
+    for (int i = 0; i < 4; i++) {
+        bool ok;
+        coords[i] = params[2 + i].trimmed().toInt(&ok);
+        if (!ok) {
+            qCDebug(log_script) << "Invalid ImageSearch coordinate" << params[2 + i];
+            setVariable("ErrorLevel", "2");
+            return;
         }
     }
-    if (regex.offRegex.match(tmpKeys).hasMatch()){
-        qCDebug(log_script) << keyName << " off";
-        keyboardMouse->updateNumCapsScrollLockState();
-        if ((keyboardMouse->*getStateFunc)()) {
-            general[0] = keydata.value(keyName);
-            keyPacket pack(general);
-            keyboardMouse->addKeyPacket(pack);
-            keyboardMouse->dataSend();
+
+    ImageSearch::Options options;
+    QStringList imageSpec = params.mid(6).join(',').trimmed().split(' ', Qt::SkipEmptyParts);
+    while (!imageSpec.isEmpty() && imageSpec.first().startsWith('*')) {
+        QString option = imageSpec.takeFirst().mid(1);
+        if (option.compare("NCC", Qt::CaseInsensitive) == 0) {
+            options.method = ImageSearch::Method::Ncc;
+        } else if (option.toInt() > 0 || option == "0") {
+            options.variation = option.toInt();
         }
     }
-}
-
-void SemanticAnalyzer::analyzeSleepStatement(const CommandStatementNode* node){
-    const auto& options = node->getOptions();
+    QString path = imageSpec.join(' ');
+    path.replace('\\', '/');
 
-    if (options.empty()){
-        qDebug(log_script) << "No sleep time set";
+    QImage reference = loadReferenceImage(path);
+    if (reference.isNull()) {
+        qCDebug(log_script) << "Failed to load image" << path;
+        setVariable("ErrorLevel", "2");
         return;
     }
-    for (const auto& token : options){
-        // Assuming the first option is the sleep time in milliseconds
-        bool ok;
-        int sleepTime = QString::fromStdString(token).toInt(&ok);
-        
-        if (!ok || sleepTime < 0) {
-            continue; // Exit if the sleep time is invalid
-        }else{
-            qDebug(log_script) << "Sleeping for" << sleepTime << "milliseconds";
-            QThread::msleep(sleepTime); // Introduce the delay
-        }
-    }
-}
 
-void SemanticAnalyzer::analyzeSendStatement(const CommandStatementNode* node) {
-    const auto& options = node->getOptions();
-    
-    if (options.empty()) {
-        qDebug(log_script) << "No keys provided for Send command";
+    FrameDistributor::Frame frame = FrameDistributor::getInstance().latestFrame();
+    if (!frame.isValid()) {
+        qCDebug(log_script) << "No video frame available for ImageSearch";
+        setVariable("ErrorLevel", "2");
         return;
     }
 
-    // Combine all tokens into a single string, excluding quotes
-    QString tmpKeys;
-    bool append = false;
-    for (const auto& token : options) {
-        if (token =="\"")append = true;
-        if (append) tmpKeys.append(QString::fromStdString(token));
-    }
-
-    tmpKeys.replace(QRegularExpression("^\"|\"$"), "");
-
-    qCDebug(log_script) << "Processing keys:" << tmpKeys;
-
-    int pos = 0;
-    while (pos < tmpKeys.length()) {
-        std::array<uint8_t, 6> general = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-        uint8_t control = 0x00;
-        
-        // Check for control characters first
-        QRegularExpressionMatch controlMatch = regex.controlKeyRegex.match(tmpKeys, pos);
-        if (controlMatch.hasMatch() && controlMatch.capturedStart() == pos) {
-            // Process control key sequence
-            QString controlChar = controlMatch.captured(1);
-            QString keys = controlMatch.captured(2);
-            control = controldata.value(controlChar[0]);
-            
-            // Process the keys after the control character
-            int keyIndex = 0;
-            int keyPos = 0;
-            while (keyPos < keys.length() && keyIndex < 6) {
-                if (keys[keyPos] == '{') {
-                    // Handle braced key
-                    QRegularExpressionMatch braceMatch = regex.braceKeyRegex.match(keys, keyPos);
-                    QRegularExpressionMatch clickMatch;
-                    if (braceMatch.hasMatch()) {
-                        QString keyName = braceMatch.captured(1);
-                        if (keydata.value(keyName)){
-                            general[keyIndex++] = keydata.value(keyName);
-                            keyPos = braceMatch.capturedEnd();
-                            continue;
-                        }else {
-                            clickMatch = regex.sendEmbedRegex.match(keyName);
-                            keyName.remove("Click");
-                            MouseParams params =  parserClickParam(keyName);
-                            keyPacket pack(general, control, params.mode, params.mouseButton, params.wheelDelta, params.coord);
-                            keyboardMouse->addKeyPacket(pack);
-                            pos = tmpKeys.length();
-                            keyPos = braceMatch.capturedEnd();
-                            qCDebug(log_script) << "position of mouse key last" << braceMatch.capturedEnd();
-                            break;
-                        }
-                    }
-                }
-                // Handle single character
-                general[keyIndex++] = keydata.value(keys[keyPos]);
-                keyPos++;
-                qCDebug(log_script) << "test for the position";
-            }
-            
-            keyPacket pack(general, control);
-            keyboardMouse->addKeyPacket(pack);
-            
-            pos = controlMatch.capturedEnd();
-        } else {
-            // Check for braced keys
-            QRegularExpressionMatch braceMatch = regex.braceKeyRegex.match(tmpKeys, pos);
-            QRegularExpressionMatch clickMatch;
-            if (braceMatch.hasMatch() && braceMatch.capturedStart() == pos) {
-                
-                QString keyName = braceMatch.captured(1);
-                if (keydata.value(keyName)){
-                    general[0] = keydata.value(keyName);
-                    keyPacket pack(general, control);
-                    keyboardMouse->addKeyPacket(pack);
-                } 
-                else {
-                    clickMatch = regex.sendEmbedRegex.match(keyName);
-                    keyName.remove("Click");
-                    qDebug(log_script) << "key: " << keyName;
-                    MouseParams params =  parserClickParam(keyName);
-                    keyPacket pack(params.mode, params.mouseButton, params.wheelDelta, params.coord); // Last param 0x00 is mouseRollWheel
-                    qCDebug(log_script) << "after key packet";
-                    keyboardMouse->addKeyPacket(pack);
-                }
-                
-                pos = braceMatch.capturedEnd();
-            } else {
-                // Handle single character
-                if (tmpKeys[pos].isUpper()){
-                    control = 0x02;     // shift press let the char become upper while send data
-                }else{
-                    general[0] = keydata.value(tmpKeys[pos]);
-                    pos++;
-                }
-                keyPacket pack(general, control);
-                keyboardMouse->addKeyPacket(pack);
-            }
-        }
-
-        // keyPacket pack(general, control);
-        // keyboardMouse->addKeyPacket(pack);
+    QSize frameSize = frame.frame.size();
+    QRect area = targetToFrame(QRect(QPoint(coords[0], coords[1]), QPoint(coords[2], coords[3])), frameSize)
+                     .intersected(QRect(QPoint(0, 0), frameSize));
+    LumaSpec spec;
+    QImage haystack = FrameConverter::toGray(frame.frame, area, &spec);
+    QImage needle = FrameConverter::rgbToGray(reference, spec);
+
+    ImageSearch::Result result = ImageSearch::find(haystack, needle, options);
+    if (result.found) {
+        QPoint found = frameToTarget(area.topLeft() + result.position, frameSize);
+        setVariable(outX, QString::number(found.x()));
+        setVariable(outY, QString::number(found.y()));
+        setVariable("ErrorLevel", "0");
+        qCDebug(log_script) << "ImageSearch found" << path << "at" << found << "in" << result.elapsedUs << "us";
+    } else {
+        setVariable(outX, "");
+        setVariable(outY, "");
+        setVariable("ErrorLevel", "1");
+        qCDebug(log_script) << "ImageSearch did not find" << path << "best score" << result.score;
     }
+}
 
-    keyboardMouse->dataSend();
-    qCDebug(log_script) << "test";
+bool SemanticAnalyzer::parseColor(const QString& text, bool rgb, QRgb* color) const
+{
+    bool ok;
+    uint value = text.trimmed().toUInt(&ok, 0);
+    if (!ok || value > 0xFFFFFF) {
+        return false;
+    }
+    // AHK colours are 0xBBGGRR unless the RGB option is given
+    *color = rgb ? qRgb((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF)
+                 : qRgb(value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF);
+    return true;
 }
 
-void SemanticAnalyzer::analyzeClickStatement(const CommandStatementNode* node) {
-    const auto& options = node->getOptions();
-    if (options.empty()) {
-        qDebug(log_script) << "No coordinates provided for Click command";
+QString SemanticAnalyzer::formatColor(QRgb color, bool rgb) const
+{
+    uint value = rgb ? (qRed(color) << 16) | (qGreen(color) << 8) | qBlue(color)
+                     : (qBlue(color) << 16) | (qGreen(color) << 8) | qRed(color);
+    return "0x" + QString("%1").arg(value, 6, 16, QChar('0')).toUpper();
+}
+
+/*
+ * PixelGetColor, OutputVar, X, Y [, RGB]
+ *
+ * Reads the pixel from the latest video frame. ErrorLevel is 0 on success
+ * and 1 when there is no frame or the point is outside of it.
+ */
+void SemanticAnalyzer::analyzePixelGetColor(const CommandStatementNode* node){
+    QStringList params = commandParams(node);
+    if (params.size() < 3) {
+        qCDebug(log_script) << "PixelGetColor needs OutputVar, X, Y";
+        setVariable("ErrorLevel", "1");
         return;
     }
-    for(const auto& token : options){
-        
-    }
-    // Parse coordinates and mouse button from options
-    QPoint coords = parseCoordinates(options);
-    int mouseButton = parseMouseButton(options);  // This will be fresh for each statement
 
-    qDebug(log_script) << "Executing click at:" << coords.x() << "," << coords.y() 
-             << "with button:" << mouseButton;
+    QString outVar = params[0].trimmed();
+    bool okX, okY;
+    int x = params[1].trimmed().toInt(&okX);
+    int y = params[2].trimmed().toInt(&okY);
+    bool rgb = params.value(3).contains("RGB", Qt::CaseInsensitive);
 
-    try {
-        mouseManager->handleAbsoluteMouseAction(coords.x(), coords.y(), mouseButton, 0);
-    } catch (const std::exception& e) {
-        qDebug(log_script) << "Exception caught in handleAbsoluteMouseAction:" << e.what();
-    } catch (...) {
-        qDebug(log_script) << "Unknown exception caught in handleAbsoluteMouseAction.";
+    FrameDistributor::Frame frame = FrameDistributor::getInstance().latestFrame();
+    QRgb color;
+    if (!okX || !okY || !frame.isValid()
+        || !PixelSearch::colorAt(frame.frame, targetToFrame(QRect(x, y, 1, 1), frame.frame.size()).topLeft(), &color)) {
+        qCDebug(log_script) << "PixelGetColor failed at" << params[1] << params[2];
+        setVariable(outVar, "");
+        setVariable("ErrorLevel", "1");
+        return;
     }
+    setVariable(outVar, formatColor(color, rgb));
+    setVariable("ErrorLevel", "0");
 }
 
-QPoint SemanticAnalyzer::parseCoordinates(const std::vector<std::string>& options) {
-    if (options.empty()) {
-        qDebug(log_script) << "No coordinate components";
-        return QPoint(0, 0);
+/*
+ * PixelSearch, OutputVarX, OutputVarY, X1, Y1, X2, Y2, ColorID [, Variation, Fast|RGB]
+ *
+ * Scans the region of the latest video frame left to right, top to bottom.
+ * Only the region is converted, so polling a small area costs microseconds.
+ * ErrorLevel is 0 when found, 1 when not found and 2 when the search could
+ * not run.
+ */
+void SemanticAnalyzer::analyzePixelSearch(const CommandStatementNode* node){
+    QStringList params = commandParams(node);
+    if (params.size() < 7) {
+        qCDebug(log_script) << "PixelSearch needs OutputVarX, OutputVarY, X1, Y1, X2, Y2, ColorID";
+        setVariable("ErrorLevel", "2");
+        return;
     }
-    
-    int x = 0, y = 0;
-    bool foundComma = false;
-    bool beforeComma = true;
-    bool okX = false, okY = false;
-    
-    for (const auto& token : options) {
-        if (token == ",") {
-            foundComma = true;
-            beforeComma = false;
-            continue;
-        }
-        
-        // Try to parse the token as a number
-        bool ok = false;
-        int value = QString::fromStdString(token).toInt(&ok);
-        if (ok) {
-            if (beforeComma) {
-                x = value;
-                okX = true;
-            } else {
-                y = value;
-                okY = true;
-            }
+
+    QString outX = params[0].trimmed();
+    QString outY = params[1].trimmed();
+    int coords[4];
+    for (int i = 0; i < 4; i++) {
+        bool ok;
+        coords[i] = params[2 + i].trimmed().toInt(&ok);
+        if (!ok) {
+            qCDebug(log_script) << "Invalid PixelSearch coordinate" << params[2 + i];
+            setVariable("ErrorLevel", "2");
+            return;
         }
     }
-    
-    if (!foundComma || (!okX && !okY)) {
-        qDebug(log_script) << "Invalid coordinate format, using defaults";
-        return QPoint(0, 0);
+
+    // Fast is accepted for compatibility, the scan is always the fast one
+    bool rgb = params.value(8).contains("RGB", Qt::CaseInsensitive);
+    QRgb color;
+    if (!parseColor(params[6], rgb, &color)) {
+        qCDebug(log_script) << "Invalid PixelSearch color" << params[6];
+        setVariable("ErrorLevel", "2");
+        return;
     }
-    
-    qDebug(log_script) << "Parsed coordinates:" << x << "," << y;
-    return QPoint(x, y);
-}
+    int variation = qBound(0, params.value(7).trimmed().toInt(), 255);
 
-int SemanticAnalyzer::parseMouseButton(const std::vector<std::string>& options) {
-    // Default to left click for each new statement 
-    int mouseButton = Qt::LeftButton;
-    
-    // Look for button specification in options
-    for (const auto& option : options) {
-        QString opt = QString::fromStdString(option).toLower();  // Convert to lowercase for case-insensitive comparison
-        if (opt == "right" || opt == "r") {
-            mouseButton = Qt::RightButton;
-            break;  // Exit once we find a button specification
-        } else if (opt == "middle" || opt == "m") {
-            mouseButton = Qt::MiddleButton;
-            break;  // Exit once we find a button specification
-        }
+    FrameDistributor::Frame frame = FrameDistributor::getInstance().latestFrame();
+    if (!frame.isValid()) {
+        qCDebug(log_script) << "No video frame available for PixelSearch";
+        setVariable("ErrorLevel", "2");
+        return;
     }
-    
-    // qDebug(log_script) << "Parsed mouse button:" << mouseButton << "from options:" << options;
 
-    return mouseButton;
-}
+    QSize frameSize = frame.frame.size();
+    QRect area = targetToFrame(QRect(QPoint(coords[0], coords[1]), QPoint(coords[2], coords[3])), frameSize)
+                     .intersected(QRect(QPoint(0, 0), frameSize));
+    QImage region = FrameConverter::toImage(frame.frame, area);
 
-void SemanticAnalyzer::analyzeMouseMove(const CommandStatementNode* node) {
-    const auto& options = node->getOptions();
-    if (options.empty()) {
-        qDebug(log_script) << "No coordinates provided for MouseMove command";
-        return;
+    QPoint position;
+    if (!region.isNull() && PixelSearch::find(region, color, variation, &position)) {
+        QPoint found = frameToTarget(area.topLeft() + position, frameSize);
+        setVariable(outX, QString::number(found.x()));
+        setVariable(outY, QString::number(found.y()));
+        setVariable("ErrorLevel", "0");
+    } else {
+        setVariable(outX, "");
+        setVariable(outY, "");
+        setVariable("ErrorLevel", region.isNull() ? "2" : "1");
     }
-    
-    // Parse coordinates and speed from options
-    QPoint coords = parseCoordinates(options);
 }
 
-MouseParams SemanticAnalyzer::parserClickParam(const QString& command) {
-    // match the number param
-    QStringList numTmp;
-    bool relative = false;
-    QString button;
-    QString downOrUp;
-    MouseParams params = {0x02, 0x00, 0x00, {}}; // Default to absolute mode
+/*
+ * AudioLevel, OutputVar [, DurationMs, Peak|RMS]
+ *
+ * Meters the target's audio for DurationMs, 200 by default, and stores the
+ * level in dBFS, the peak unless RMS is given. ErrorLevel is 0 on success and
+ * 1 when no audio arrived in that time.
+ */
+void SemanticAnalyzer::analyzeAudioLevel(const CommandStatementNode* node){
+    QStringList params = commandParams(node);
+    if (params.isEmpty() || params[0].trimmed().isEmpty()) {
+        qCDebug(log_script) << "AudioLevel needs OutputVar";
+        setVariable("ErrorLevel", "1");
+        return;
+    }
 
-    QRegularExpressionMatch relativeMatch = regex.relativeRegex.match(command);
-    if(relativeMatch.hasMatch()){
-        relative = true;
-        params.mode = 0x01; // Relative mode
-        qCDebug(log_script) << "Matched relative:" << relative;
+    QString outVar = params[0].trimmed();
+    bool ok;
+    int durationMs = params.value(1).trimmed().toInt(&ok);
+    if (!ok || durationMs <= 0) {
+        durationMs = 200;
     }
+    bool rms = params.value(2).contains("RMS", Qt::CaseInsensitive);
 
-    QRegularExpressionMatchIterator numMatchs = regex.numberRegex.globalMatch(command);
-    while(numMatchs.hasNext()){
-        QRegularExpressionMatch nummatch = numMatchs.next();
-        numTmp.append(nummatch.captured(0));
+    const AudioMeter &meter = AudioMeter::getInstance();
+    quint64 start = meter.levelCount();
+    if (!timeline.sleep(durationMs)) {
+        return;
     }
-    qCDebug(log_script) << "Matched numbers:" << numTmp;
-    
-    // check the "" content
-    QRegularExpressionMatch buttonMatch = regex.buttonRegex.match(command);
-    if(buttonMatch.hasMatch()){
-        button = buttonMatch.captured(0);
-        qCDebug(log_script) << "Matched button:" << button;
+    AudioMeter::Level level;
+    if (!meter.levelSince(start, &level)) {
+        qCDebug(log_script) << "No audio for AudioLevel";
+        setVariable(outVar, "");
+        setVariable("ErrorLevel", "1");
+        return;
     }
-    QRegularExpressionMatch downUpMatch = regex.downUpRegex.match(command);
-    if(downUpMatch.hasMatch()){
-        downOrUp = downUpMatch.captured(0);
-        qCDebug(log_script) << "Matched downOrUp:" << downOrUp;
+    setVariable(outVar, QString::number(AudioMeter::toDb(rms ? level.rms : level.peak), 'f', 1));
+    setVariable("ErrorLevel", "0");
+}
+
+/*
+ * WaitForBeep, OutputVar [, TimeoutMs, FrequencyHz, MinDurationMs, Count]
+ *
+ * Waits until the target has beeped Count times, 1 by default, for at least
+ * MinDurationMs each, 100 by default. FrequencyHz picks one of the meter's
+ * tones, the nearest one within 10 percent, and 0 or nothing takes any of
+ * them. Only beeps that start after the command count. OutputVar gets the
+ * number of beeps heard. ErrorLevel is 0 when Count was reached, 1 on
+ * timeout, 10000 ms by default, and 2 for an unsupported frequency.
+ */
+void SemanticAnalyzer::analyzeWaitForBeep(const CommandStatementNode* node){
+    QStringList params = commandParams(node);
+    if (params.isEmpty() || params[0].trimmed().isEmpty()) {
+        qCDebug(log_script) << "WaitForBeep needs OutputVar";
+        setVariable("ErrorLevel", "2");
+        return;
     }
-    
-    // Convert numbers to integers
-    std::vector<int> numData;
-    for (const QString & num : numTmp){
-        bool ok;
-        int value = num.toInt(&ok);
-        if (ok){
-            numData.push_back(value);
-        }
+
+    QString outVar = params[0].trimmed();
+    bool ok;
+    int timeoutMs = params.value(1).trimmed().toInt(&ok);
+    if (!ok || timeoutMs <= 0) {
+        timeoutMs = 10000;
     }
-    
-    // Set mouse button based on parsed button string
-    if (button.toLower().startsWith('r')) {
-        params.mouseButton = 0x02; // Right button
-    } else if (button.toLower().startsWith('m')) {
-        params.mouseButton = 0x04; // Middle button
-    } else {
-        params.mouseButton = 0x01; // Left button (default)
+    double frequency = params.value(2).trimmed().toDouble();
+    int minDurationMs = params.value(3).trimmed().toInt(&ok);
+    if (!ok || minDurationMs <= 0) {
+        minDurationMs = 100;
     }
+    int count = qMax(1, params.value(4).trimmed().toInt());
 
-    // Set coordinates
-    if (numData.size() >= 2) {
-        if (relative) {
-            // Relative coordinates are single bytes
-            params.coord.rel.x = static_cast<uint8_t>(std::min(std::max(numData[0], -128), 127) & 0xFF);
-            params.coord.rel.y = static_cast<uint8_t>(std::min(std::max(numData[1], -128), 127) & 0xFF);
-            qDebug(log_script) << "rel coordinates: " << (int)params.coord.rel.x << ", " << (int)params.coord.rel.y;
-        } else {
-            // Absolute coordinates are 2 bytes each
-            int x = (numData[0] * 4096) / GlobalVar::instance().getInputWidth();
-            int y = (numData[1] * 4096) / GlobalVar::instance().getInputHeight();
-            
-            params.coord.abs.x[0] = static_cast<uint8_t>(x & 0xFF);
-            params.coord.abs.x[1] = static_cast<uint8_t>((x >> 8) & 0xFF);
-            params.coord.abs.y[0] = static_cast<uint8_t>(y & 0xFF);
-            params.coord.abs.y[1] = static_cast<uint8_t>((y >> 8) & 0xFF);
-            qDebug(log_script) << "abs coordinates: " << x << " " << GlobalVar::instance().getInputWidth() 
-                             << ", " << y << " " << GlobalVar::instance().getInputHeight();
+    float tone = 0;
+    if (frequency > 0) {
+        for (float candidate : AudioMeter::TONE_FREQUENCIES) {
+            if (qAbs(candidate - frequency) < qAbs(tone - frequency)) {
+                tone = candidate;
+            }
+        }
+        if (qAbs(tone - frequency) > AudioMeter::TONE_TOLERANCE_HZ) {
+            qCDebug(log_script) << "WaitForBeep does not detect" << frequency << "Hz, the nearest tone is" << tone << "Hz";
+            setVariable(outVar, "0");
+            setVariable("ErrorLevel", "2");
+            return;
         }
     }
 
-    qCDebug(log_script) << "mouse mode" << params.mode << "mouse button" << params.mouseButton;
-    return params;
-
-    // Create and add the key packet
-    // keyPacket pack(Mode, _mouseButton, 0x00, coord); // Last param 0x00 is mouseRollWheel
-    // qCDebug(log_script) << "after key packet";
-    // keyboardMouse->addKeyPacket(pack);
+    const AudioMeter &meter = AudioMeter::getInstance();
+    quint64 seen = meter.beepCount();
+    int heard = 0;
+    // On the timeline's clock, so a dry run does not wait out the timeout
+    const qint64 startNs = timeline.nowNs();
+    while (heard < count) {
+        for (quint64 newest = meter.beepCount(); seen < newest; ) {
+            AudioMeter::Beep beep;
+            if (meter.beep(++seen, &beep) && beep.durationMs >= minDurationMs
+                && (tone == 0 || beep.frequency == tone)) {
+                qCDebug(log_script) << "Beep" << beep.frequency << "Hz for" << beep.durationMs << "ms";
+                heard++;
+            }
+        }
+        if (heard >= count || timeline.nowNs() - startNs >= qint64(timeoutMs) * 1000000) {
+            break;
+        }
+        if (!timeline.sleep(AudioMeter::BLOCK_MS)) {
+            break;
+        }
+    }
+    setVariable(outVar, QString::number(heard));
+    setVariable("ErrorLevel", heard >= count ? "0" : "1");
 }
+
@@ -28,46 +28,86 @@
 #include "regex/RegularExpression.h"
 // #include "target/KeyboardManager.h"
 #include "KeyboardMouse.h"
+#include "Bytecode.h"
+#include "ui/TaskManager.h"
+#include <map>
 #include <memory>
 #include <QPoint>
 #include <QString>
 #include <QRegularExpression>
 #include <QObject>
+#include <QHash>
+#include <QImage>
+#include <QRgb>
+#include <QStringList>
+#include <QSize>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(log_script)
 
-struct MouseParams{
-    uint8_t mode;
-    uint8_t mouseButton;
-    uint8_t wheelDelta;
-    Coordinate coord;
-};
 class SemanticAnalyzer : public QObject {
     Q_OBJECT
 
 public:
     SemanticAnalyzer(MouseManager* mouseManager, KeyboardMouse* keyboardMouse, QObject* parent = nullptr);
-    void analyze(const ASTNode* node);
+    // Runs a program from the Compiler, blocks until the script is done or cancelled
+    void run(const Program& program, const CancellationToken& token = CancellationToken());
+    // Pause, resume or cancel the running script, from any thread
+    ScriptTimeline& scriptTimeline() { return timeline; }
+
+    // Variables by name, for commands that write them. Names are case insensitive like in AHK.
+    void setVariable(const QString& name, const QString& value);
+    QString variable(const QString& name) const;
 
 
 signals:
     void captureImg(const QString& path = "");
     void captureAreaImg(const QString& path = "", const QRect& captureArea = QRect());
+    void saveRecentVideo(const QString& path = "");
     
 private:
     MouseManager* mouseManager;
     KeyboardMouse* keyboardMouse;
+    // Sleeps, key and click intervals of the script wait on it
+    ScriptTimeline timeline;
+    struct LoopState {
+        qint64 index = 0;
+        qint64 count = -1;      // -1 for an endless loop
+    };
+
+    void runProgram(const Program& program);
+    void execute(const Program& program, const Instruction& instruction);
+    ScriptValue evaluate(const Program& program, int expression);
+    void setLockState(LockKey key, bool on);
+    void click(int x, int y, int mouseButton);
     void analyzeCommandStetement(const CommandStatementNode* node);
-    void analyzeClickStatement(const CommandStatementNode* node);
-    void analyzeSendStatement(const CommandStatementNode* node);
-    QPoint parseCoordinates(const std::vector<std::string>& options);
-    int parseMouseButton(const std::vector<std::string>& options);
     void resetParameters();
-    
-    void analyzeSleepStatement(const CommandStatementNode* node);
-    void analyzeMouseMove(const CommandStatementNode* node);
-    void analyzeLockState(const CommandStatementNode* node, const QString& keyName, bool (KeyboardMouse::*getStateFunc)());
-    void analyzeFullScreenCapture(const CommandStatementNode* node);
-    void analyzeAreaScreenCapture(const CommandStatementNode* node);
-    QString extractFilePath(const QString& originText);
+
+    void analyzeImageSearch(const CommandStatementNode* node);
+    void analyzePixelGetColor(const CommandStatementNode* node);
+    void analyzePixelSearch(const CommandStatementNode* node);
+    void analyzeAudioLevel(const CommandStatementNode* node);
+    void analyzeWaitForBeep(const CommandStatementNode* node);
+    QStringList commandParams(const CommandStatementNode* node) const;
+    bool parseColor(const QString& text, bool rgb, QRgb* color) const;
+    QString formatColor(QRgb color, bool rgb) const;
+
+    // Variable values by slot and loop states by loop, numbered like in the running Program
+    std::vector<ScriptValue> variables;
+    QHash<QString, int> variableSlots;
+    std::vector<LoopState> loops;
+    // Variables the program never names, only set by commands
+    QHash<QString, QString> otherVariables;
+    std::vector<ScriptValue> evaluationStack;
+    ScriptValue loopIndex(int loop) const;
+    std::vector<std::string> expandTemplate(const Program& program, const CommandTemplate& command);
+    // Dynamic commands compiled for the values they ran with, by template
+    static const size_t MAX_DYNAMIC_PROGRAMS = 256;
+    std::map<std::pair<int, std::vector<std::string>>, Program> dynamicPrograms;
+    QImage loadReferenceImage(const QString& path);
+    QHash<QString, QImage> referenceImages;
+    QRect targetToFrame(const QRect& rect, const QSize& frameSize) const;
+    QPoint frameToTarget(const QPoint& point, const QSize& frameSize) const;
 
     RegularExpression& regex = RegularExpression::instance();
     // QRegularExpression onRegex{QString("^(1|True|On)$"), QRegularExpression::CaseInsensitiveOption};
@@ -79,8 +119,7 @@ private:
     // QRegularExpression relativeRegex{QString(R"((?<![a-zA-Z])(rel|relative)(?![a-zA-Z]))"), QRegularExpression::CaseInsensitiveOption};
     // QRegularExpression braceKeyRegex{QString(R"(\{([^}]+)\})"), QRegularExpression::CaseInsensitiveOption};
     // QRegularExpression controlKeyRegex{QString(R"(([!^+#])((?:\{[^}]+\}|[^{])+))")};
-    
-    MouseParams parserClickParam(const QString& command);
+
 };
 
 #endif // SEMANTIC_ANALYZER_H
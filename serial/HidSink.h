@@ -0,0 +1,44 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef HIDSINK_H
+#define HIDSINK_H
+
+#include <QByteArray>
+#include <cstdint>
+
+/*
+ * Takes the HID chip frames of a script instead of the serial port, e.g. to
+ * record them in a dry run. KeyboardMouse and MouseManager hand every frame
+ * to their sink when one is set, as they would to
+ * SerialPortManager::sendCommandAsync.
+ */
+class HidSink {
+public:
+    virtual ~HidSink() = default;
+
+    virtual void send(const QByteArray &frame) = 0;
+    // The target's lock LEDs as CMD_GET_INFO reports them: bit 0 Num, 1 Caps, 2 Scroll
+    virtual uint8_t lockIndicators() const = 0;
+};
+
+#endif // HIDSINK_H
@@ -29,10 +29,33 @@
 #include <QFuture>
 #include <QtSerialPort>
 #include <QElapsedTimer>
+#include <QDeadlineTimer>
 
 
 Q_LOGGING_CATEGORY(log_core_serial, "opf.core.serial")
 
+namespace {
+// Answers to keyboard and mouse reports in data, which may hold several frames
+int countHidAnswers(const QByteArray &data)
+{
+    int count = 0;
+    int i = 0;
+    while (i + 4 < data.size()) {
+        if (uchar(data[i]) != 0x57 || uchar(data[i + 1]) != 0xAB) {
+            i++;
+            continue;
+        }
+        // Errors come back as 0xC0 | command
+        const uchar command = uchar(data[i + 3]) & 0x3F;
+        if ((uchar(data[i + 3]) & 0x80) && (command == 0x02 || command == 0x04 || command == 0x05)) {
+            count++;
+        }
+        i += 6 + uchar(data[i + 4]);
+    }
+    return count;
+}
+}
+
 SerialPortManager::SerialPortManager(QObject *parent) : QObject(parent), serialThread(new QThread(nullptr)), serialTimer(new QTimer(nullptr)){
     qCDebug(log_core_serial) << "Initialize serial port.";
 
@@ -413,6 +436,9 @@ void SerialPortManager::updateSpecialKeyState(uint8_t data){
  */
 void SerialPortManager::readData() {
     QByteArray data = serialPort->readAll();
+    if (int answers = countHidAnswers(data)) {
+        releaseAckSlots(answers);
+    }
     if (data.size() >= 6) {
 
         unsigned char status = data[5];
@@ -696,8 +722,28 @@ void SerialPortManager::changeUSBDescriptor() {
 
 void SerialPortManager::sendCommand(const QByteArray &command, bool waitForAck) {
     // qCDebug(log_core_serial)  << "sendCommand:" << command.toHex(' ');
-    sendAsyncCommand(command, false);
+    if (!sendAsyncCommand(command, false) && waitForAck) {
+        // No answer will come for a report that was not written
+        releaseAckSlots(1);
+    }
+}
+
+void SerialPortManager::acquireAckSlot() {
+    QMutexLocker locker(&m_ackMutex);
+    QDeadlineTimer deadline(ACK_TIMEOUT_MS);
+    while (m_acksPending >= ACK_WINDOW) {
+        if (!m_ackCondition.wait(&m_ackMutex, deadline)) {
+            qCDebug(log_core_serial) << "No answer to" << m_acksPending << "HID reports, sending on";
+            m_acksPending = 0;
+        }
+    }
+    m_acksPending++;
+}
 
+void SerialPortManager::releaseAckSlots(int count) {
+    QMutexLocker locker(&m_ackMutex);
+    m_acksPending = qMax(0, m_acksPending - count);
+    m_ackCondition.wakeAll();
 }
 
 bool SerialPortManager::setBaudRate(int baudRate) {
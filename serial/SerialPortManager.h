@@ -31,6 +31,8 @@
 #include <QLoggingCategory>
 #include <QDateTime>
 #include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include "ch9329.h"
 
@@ -43,6 +45,10 @@ class SerialPortManager : public QObject
 public:
     static const int ORIGINAL_BAUDRATE = 9600;
     static const int DEFAULT_BAUDRATE = 115200;
+    // HID reports sent with waitForAck that may wait for the chip's answer at once
+    static const int ACK_WINDOW = 4;
+    // An answer not coming in this time is taken as lost
+    static const int ACK_TIMEOUT_MS = 100;
 
     static SerialPortManager& getInstance() {
         static SerialPortManager instance; // Guaranteed to be destroyed, instantiated on first use.
@@ -79,6 +85,11 @@ public:
     void changeUSBDescriptor();
     bool setBaudRate(int baudrate);
     void setCommandDelay(int delayMs);  // New method to set the delay
+    // Blocks while ACK_WINDOW reports are unanswered, then takes a place in the
+    // window for a report emitted with waitForAck. Safe from any thread.
+    void acquireAckSlot();
+    // False on the thread that reads the answers, waiting there would block them
+    bool canWaitForAck() const { return QThread::currentThread() != thread(); }
     
 signals:
     void dataReceived(const QByteArray &data);
@@ -141,6 +152,13 @@ private:
     QElapsedTimer m_lastCommandTime;  // New member for timing
     int m_commandDelayMs;  // New member for configurable delay
 
+    // Reports in the ACK window, answers to reports sent without waitForAck
+    // also free a place, so the count only errs towards sending sooner
+    QMutex m_ackMutex;
+    QWaitCondition m_ackCondition;
+    int m_acksPending = 0;
+    void releaseAckSlots(int count);
+
     void enableNotifier();
     
 };
@@ -0,0 +1,142 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef SIMD_H
+#define SIMD_H
+
+/*
+ * Compile time and run time detection for the hand vectorized kernels.
+ *
+ * SSE2 is part of the x86-64 baseline and is used unconditionally there.
+ * AVX2 kernels are compiled with a per-function target attribute and only
+ * called after checking the CPU at run time, so the binary still runs on
+ * older machines. Other architectures use the scalar kernels.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OPF_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(OPF_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define OPF_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(OPF_HAVE_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define OPF_TARGET_AVX2 __attribute__((target("avx2")))
+#define OPF_TARGET_SSE41 __attribute__((target("sse4.1")))
+#else
+#define OPF_TARGET_AVX2
+#define OPF_TARGET_SSE41
+#endif
+
+#if defined(_MSC_VER) && defined(OPF_HAVE_AVX2)
+#include <intrin.h>
+#endif
+
+namespace Simd {
+
+enum class Level {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+inline const char *levelName(Level level)
+{
+    switch (level) {
+    case Level::Avx2: return "avx2";
+    case Level::Sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+inline bool cpuHasAvx2()
+{
+#if defined(OPF_HAVE_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#elif defined(OPF_HAVE_AVX2) && defined(_MSC_VER)
+    static const bool has = [] {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        // OSXSAVE and AVX, then check the OS saves the YMM state
+        bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+        __cpuidex(info, 7, 0);
+        return osAvx && (info[1] & (1 << 5));
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
+
+inline bool cpuHasSse41()
+{
+#if defined(OPF_HAVE_SSE2) && (defined(__GNUC__) || defined(__clang__))
+    static const bool has = __builtin_cpu_supports("sse4.1");
+    return has;
+#elif defined(OPF_HAVE_SSE2) && defined(_MSC_VER)
+    static const bool has = [] {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 19)) != 0;
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
+
+// Best level the build and the CPU both support
+inline Level bestLevel()
+{
+    if (cpuHasAvx2()) {
+        return Level::Avx2;
+    }
+#ifdef OPF_HAVE_SSE2
+    return Level::Sse2;
+#else
+    return Level::Scalar;
+#endif
+}
+
+inline bool isSupported(Level level)
+{
+    switch (level) {
+    case Level::Avx2: return cpuHasAvx2();
+#ifdef OPF_HAVE_SSE2
+    case Level::Sse2: return true;
+#endif
+    case Level::Scalar: return true;
+    default: return false;
+    }
+}
+
+} // namespace Simd
+
+#endif // SIMD_H
@@ -30,6 +30,13 @@ MouseManager::MouseManager(QObject *parent) : QObject(parent), mouseMoverThread(
     connect(mouseMoverThread, &MouseMoverThread::finished, mouseMoverThread, &MouseMoverThread::deleteLater);
 }
 
+MouseManager::~MouseManager() {
+    // Every script run has its own manager, its mover goes with it
+    stopAutoMoveMouse();
+    mouseMoverThread->wait();
+    delete mouseMoverThread;
+}
+
 void MouseManager::setEventCallback(StatusEventCallback* callback) {
     statusEventCallback = callback;
 }
@@ -49,8 +56,7 @@ void MouseManager::handleAbsoluteMouseAction(int x, int y, int mouse_event, int
     data.append(static_cast<char>((y >> 8) & 0xFF));
     data.append(static_cast<char>(mappedWheelMovement & 0xFF));
 
-    // send the data to serial
-    SerialPortManager::getInstance().sendCommandAsync(data, false);
+    sendFrame(data);
 
     QString mouseEventStr;
     if(mouse_event == Qt::LeftButton){
@@ -77,8 +83,7 @@ void MouseManager::handleRelativeMouseAction(int dx, int dy, int mouse_event, in
     data.append(static_cast<char>(dy & 0xFF));
     data.append(static_cast<char>(mappedWheelMovement & 0xFF));
 
-    // send the data to serial
-    SerialPortManager::getInstance().sendCommandAsync(data, false);
+    sendFrame(data);
 
     QString mouseEventStr;
     if(mouse_event == Qt::LeftButton){
@@ -94,6 +99,22 @@ void MouseManager::handleRelativeMouseAction(int dx, int dy, int mouse_event, in
     if (statusEventCallback) statusEventCallback->onLastMouseLocation(QPoint(dx, dy), mouseEventStr);
 }
 
+void MouseManager::sendFrame(const QByteArray& data){
+    if (sink) {
+        sink->send(data);
+        return;
+    }
+    SerialPortManager &serial = SerialPortManager::getInstance();
+    if (!paced || !serial.canWaitForAck()) {
+        // send the data to serial
+        serial.sendCommandAsync(data, false);
+        return;
+    }
+    // Paced by the ACK window like the keyboard reports, a click cannot overtake the keys before it
+    serial.acquireAckSlot();
+    emit serial.sendCommandAsync(data, true);
+}
+
 uint8_t MouseManager::mapScrollWheel(int delta){
     if(delta == 0){
         return 0;
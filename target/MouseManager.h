@@ -25,6 +25,7 @@
 
 
 #include "serial/SerialPortManager.h"
+#include "serial/HidSink.h"
 #include "ui/statusevents.h"
 
 #include <QObject>
@@ -124,10 +125,15 @@ class MouseManager : public QObject
 
 public:
     explicit MouseManager(QObject *parent = nullptr);
+    ~MouseManager();
 
     void handleAbsoluteMouseAction(int x, int y, int mouse_event, int wheelMovement);
     void handleRelativeMouseAction(int dx, int dy, int mouse_event, int wheelMovement);
     void setEventCallback(StatusEventCallback* callback);
+    // Frames go to the sink instead of the serial port, nullptr for the port
+    void setSink(HidSink* sink) { this->sink = sink; }
+    // Script runs wait for the serial ACK window, the interactive mouse never does
+    void setPaced(bool paced) { this->paced = paced; }
     void startAutoMoveMouse();
     void stopAutoMoveMouse();
 
@@ -140,7 +146,10 @@ public:
 private:
     bool isDragging = false; 
     StatusEventCallback* statusEventCallback = nullptr;
+    HidSink* sink = nullptr;
+    bool paced = false;
 
+    void sendFrame(const QByteArray& data);
     uint8_t mapScrollWheel(int delta);
     MouseMoverThread* mouseMoverThread = nullptr;
 };
@@ -1,4 +1,58 @@
 #include "TaskManager.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QString>
+#include <algorithm>
+
+namespace {
+qint64 nowNs()
+{
+    static QElapsedTimer timer = [] {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return timer.nsecsElapsed();
+}
+}
+
+thread_local TaskManager::Worker* TaskManager::s_currentWorker = nullptr;
+
+CancellationToken::CancellationToken() : m_state(std::make_shared<State>())
+{
+}
+
+void CancellationToken::cancel() const
+{
+    QMutexLocker locker(&m_state->mutex);
+    if (m_state->cancelled.exchange(true, std::memory_order_acq_rel)) {
+        return;
+    }
+    for (const auto& callback : m_state->callbacks) {
+        callback.second();
+    }
+}
+
+int CancellationToken::addCallback(std::function<void()> callback) const
+{
+    QMutexLocker locker(&m_state->mutex);
+    if (isCancelled()) {
+        callback();
+    }
+    const int id = m_state->nextId++;
+    m_state->callbacks.emplace_back(id, std::move(callback));
+    return id;
+}
+
+void CancellationToken::removeCallback(int id) const
+{
+    // Waits for a cancel() calling it right now
+    QMutexLocker locker(&m_state->mutex);
+    auto& callbacks = m_state->callbacks;
+    callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                   [id](const auto& callback) { return callback.first == id; }),
+                    callbacks.end());
+}
 
 TaskManager* TaskManager::instance()
 {
@@ -6,35 +60,178 @@ TaskManager* TaskManager::instance()
     return &instance;
 }
 
-TaskManager::TaskManager() : m_worker(new Worker()), m_workerThread()
+TaskManager::TaskManager(int workerCount)
 {
-    m_worker->moveToThread(&m_workerThread);
-    connect(&m_workerThread, &QThread::started, m_worker, &Worker::onProcessTasks);
-    m_workerThread.start();
+    if (workerCount <= 0) {
+        workerCount = qBound(2, QThread::idealThreadCount(), 4);
+    }
+    for (int i = 0; i < workerCount; i++) {
+        Worker* worker = new Worker(this, i);
+        QThread* thread = new QThread();
+        worker->moveToThread(thread);
+        connect(thread, &QThread::started, worker, &Worker::onProcessTasks);
+        m_workers.push_back(worker);
+        m_threads.push_back(thread);
+    }
+    for (QThread* thread : m_threads) {
+        thread->start();
+    }
 }
 
 TaskManager::~TaskManager()
 {
+    m_exit = true;
+    cancelAll();
     {
-        QMutexLocker locker(&m_worker->m_mutex);
-        m_worker->m_exit = true;
+        QMutexLocker locker(&m_idleMutex);
+        m_wakeups++;
+    }
+    m_idleCondition.wakeAll();
+    for (QThread* thread : m_threads) {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+    for (Worker* worker : m_workers) {
+        delete worker;
     }
-    m_worker->m_condition.wakeOne();
-    m_workerThread.quit();
-    m_workerThread.wait();
-    delete m_worker;
 }
 
-void TaskManager::addTask(std::function<void()> task)
+CancellationToken TaskManager::addTask(std::function<void()> task, Priority priority)
+{
+    return addTask([task = std::move(task)](const CancellationToken&) { task(); }, priority);
+}
+
+CancellationToken TaskManager::addTask(std::function<void(const CancellationToken&)> task, Priority priority)
 {
+    Task entry;
+    entry.run = std::move(task);
+    entry.priority = priority;
+    entry.queuedNs = nowNs();
+    CancellationToken token = entry.token;
+
+    // Spread over the workers, a task added by a task stays on its worker
+    Worker* worker = s_currentWorker && s_currentWorker->m_manager == this
+                         ? s_currentWorker
+                         : m_workers[size_t(m_nextWorker++ % int(m_workers.size()))];
+    {
+        QMutexLocker locker(&worker->m_mutex);
+        worker->m_queues[int(priority)].push_back(std::move(entry));
+        m_queuedPerPriority[int(priority)]++;
+    }
     {
-        QMutexLocker locker(&m_worker->m_mutex);
-        m_worker->m_taskQueue.enqueue(task);
+        QMutexLocker locker(&m_idleMutex);
+        m_wakeups++;
     }
-    m_worker->m_condition.wakeOne();
+    m_idleCondition.wakeOne();
+    return token;
 }
 
-TaskManager::Worker::Worker() : m_exit(false)
+void TaskManager::cancelAll()
+{
+    // Cancelled outside the worker locks, a callback may add a task
+    std::vector<CancellationToken> tokens;
+    for (Worker* worker : m_workers) {
+        QMutexLocker locker(&worker->m_mutex);
+        if (worker->m_busy) {
+            tokens.push_back(worker->m_current);
+        }
+        for (int p = 0; p < PRIORITY_COUNT; p++) {
+            for (const Task& task : worker->m_queues[p]) {
+                tokens.push_back(task.token);
+            }
+            m_queuedPerPriority[p] -= int(worker->m_queues[p].size());
+            worker->m_queues[p].clear();
+        }
+    }
+    for (const CancellationToken& token : tokens) {
+        token.cancel();
+    }
+}
+
+TaskManager::Metrics TaskManager::metrics() const
+{
+    Metrics metrics;
+    metrics.workers = int(m_workers.size());
+    metrics.running = m_running;
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        metrics.queued[p] = m_queuedPerPriority[p];
+    }
+    metrics.completed = m_completed;
+    if (metrics.completed > 0) {
+        metrics.averageWaitMs = m_waitTotalNs / 1e6 / double(metrics.completed);
+        metrics.averageRunMs = m_runTotalNs / 1e6 / double(metrics.completed);
+    }
+    metrics.maxWaitMs = m_waitMaxNs / 1e6;
+    return metrics;
+}
+
+bool TaskManager::take(Worker* worker, Task& task)
+{
+    const int count = int(m_workers.size());
+    for (int p = 0; p < PRIORITY_COUNT; p++) {
+        if (m_queuedPerPriority[p].load(std::memory_order_acquire) <= 0) {
+            continue;
+        }
+        const bool background = p == int(Priority::Background);
+        if (background) {
+            // Keeps one worker for everything else
+            const int limit = std::max(1, count - 1);
+            int running = m_backgroundRunning.load();
+            do {
+                if (running >= limit) {
+                    return false;
+                }
+            } while (!m_backgroundRunning.compare_exchange_weak(running, running + 1));
+        }
+        if (takeFrom(worker, p, false, task)) {
+            return true;
+        }
+        for (int i = 1; i < count; i++) {
+            if (takeFrom(m_workers[size_t((worker->m_index + i) % count)], p, true, task)) {
+                return true;
+            }
+        }
+        if (background) {
+            m_backgroundRunning--;
+        }
+    }
+    return false;
+}
+
+bool TaskManager::takeFrom(Worker* worker, int priority, bool steal, Task& task)
+{
+    QMutexLocker locker(&worker->m_mutex);
+    std::deque<Task>& queue = worker->m_queues[priority];
+    if (queue.empty()) {
+        return false;
+    }
+    if (steal) {
+        task = std::move(queue.back());
+        queue.pop_back();
+    } else {
+        task = std::move(queue.front());
+        queue.pop_front();
+    }
+    m_queuedPerPriority[priority]--;
+    return true;
+}
+
+void TaskManager::finished(const Task& task, qint64 startNs)
+{
+    const qint64 waitNs = startNs - task.queuedNs;
+    m_waitTotalNs += waitNs;
+    qint64 maxNs = m_waitMaxNs.load();
+    while (waitNs > maxNs && !m_waitMaxNs.compare_exchange_weak(maxNs, waitNs)) {
+    }
+    m_runTotalNs += nowNs() - startNs;
+    m_completed++;
+    if (task.priority == Priority::Background) {
+        m_backgroundRunning--;
+    }
+}
+
+TaskManager::Worker::Worker(TaskManager* manager, int index) : m_manager(manager), m_index(index)
 {
 }
 
@@ -44,19 +241,91 @@ TaskManager::Worker::~Worker()
 
 void TaskManager::Worker::onProcessTasks()
 {
-    while (!m_exit) {
-        std::function<void()> task;
+    s_currentWorker = this;
+    while (!m_manager->m_exit) {
+        // Read before looking, a task added after this wakes the wait below
+        const quint64 wakeups = m_manager->m_wakeups.load(std::memory_order_acquire);
+        Task task;
+        if (!m_manager->take(this, task)) {
+            QMutexLocker locker(&m_manager->m_idleMutex);
+            if (m_manager->m_wakeups.load() == wakeups && !m_manager->m_exit) {
+                m_manager->m_idleCondition.wait(&m_manager->m_idleMutex);
+            }
+            continue;
+        }
+
         {
             QMutexLocker locker(&m_mutex);
-            if (m_taskQueue.isEmpty()) {
-                m_condition.wait(&m_mutex);
-            }
-            if (!m_taskQueue.isEmpty()) {
-                task = m_taskQueue.dequeue();
-            }
+            m_current = task.token;
+            m_busy = true;
         }
-        if (task) {
-            task();
+        m_manager->m_running++;
+        const qint64 startNs = nowNs();
+        // A task cancelled while queued is dropped
+        if (!task.token.isCancelled()) {
+            task.run(task.token);
+        }
+        m_manager->finished(task, startNs);
+        m_manager->m_running--;
+        {
+            QMutexLocker locker(&m_mutex);
+            m_busy = false;
         }
     }
-}
\ No newline at end of file
+    s_currentWorker = nullptr;
+}
+
+void TaskManager::runBenchmark()
+{
+    const int scripts = 3;
+    const int clicks = 200;
+    for (int workers : {1, 0}) {
+        TaskManager manager(workers);
+        for (int i = 0; i < scripts; i++) {
+            manager.addTask([](const CancellationToken& token) {
+                const qint64 start = nowNs();
+                while (!token.isCancelled() && nowNs() - start < 1000000000LL) {
+                    QThread::msleep(1);
+                }
+            }, Priority::Background);
+        }
+        QThread::msleep(20);
+
+        std::vector<qint64> waits(size_t(clicks), 0);
+        std::atomic<int> done{0};
+        for (int i = 0; i < clicks; i++) {
+            const qint64 queuedNs = nowNs();
+            manager.addTask([&waits, &done, i, queuedNs] {
+                waits[size_t(i)] = nowNs() - queuedNs;
+                done++;
+            }, Priority::Interactive);
+            QThread::usleep(500);
+        }
+        // The single worker only gets to them after the scripts
+        while (done < clicks) {
+            QThread::msleep(1);
+        }
+
+        const qint64 cancelStart = nowNs();
+        manager.cancelAll();
+        while (manager.metrics().running > 0) {
+            QThread::usleep(100);
+        }
+        const qint64 cancelNs = nowNs() - cancelStart;
+
+        std::sort(waits.begin(), waits.end());
+        qint64 total = 0;
+        for (qint64 wait : waits) {
+            total += wait;
+        }
+        qInfo().noquote() << QString("taskmanager %1 worker(s), %2 interactive tasks beside %3 scripts: "
+                                     "wait %4 ms on average, %5 ms p99, %6 ms at most; cancel took %7 ms")
+                                 .arg(manager.metrics().workers)
+                                 .arg(clicks)
+                                 .arg(scripts)
+                                 .arg(total / clicks / 1e6, 0, 'f', 3)
+                                 .arg(waits[size_t(clicks * 99 / 100)] / 1e6, 0, 'f', 3)
+                                 .arg(waits.back() / 1e6, 0, 'f', 3)
+                                 .arg(cancelNs / 1e6, 0, 'f', 1);
+    }
+}
@@ -7,23 +7,113 @@
 #include <QThread>
 #include <QMutex>
 #include <QWaitCondition>
-#include <QQueue>
+#include <array>
+#include <atomic>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <vector>
 
+/*
+ * Asks a task to stop. Copies share one flag, the task checks it between
+ * steps. A callback runs once on cancel(), or at once when added to a
+ * cancelled token, and is not running any more when removeCallback() returns.
+ */
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void cancel() const;
+    bool isCancelled() const { return m_state->cancelled.load(std::memory_order_acquire); }
+
+    int addCallback(std::function<void()> callback) const;
+    void removeCallback(int id) const;
+
+private:
+    struct State {
+        std::atomic<bool> cancelled{false};
+        QMutex mutex;
+        std::vector<std::pair<int, std::function<void()>>> callbacks;
+        int nextId = 0;
+    };
+    std::shared_ptr<State> m_state;
+};
+
+/*
+ * Runs tasks off the UI thread on a few workers. Each worker has a queue per
+ * priority and an idle worker steals from the others, so a long task only
+ * holds up its own worker. A free worker takes the highest priority task of
+ * any queue first, and background tasks never take the last worker, so an
+ * interactive task starts at once while scripts run.
+ */
 class TaskManager : public QObject
 {
     Q_OBJECT
 public:
+    enum class Priority {
+        Interactive,        // Started by the user and waited for, e.g. a paste
+        Normal,
+        Background,         // Long running, e.g. a script
+    };
+    static const int PRIORITY_COUNT = 3;
+
+    struct Metrics {
+        int workers = 0;
+        int running = 0;
+        std::array<int, PRIORITY_COUNT> queued{};   // Per priority
+        quint64 completed = 0;
+        double averageWaitMs = 0;                   // From addTask() to the start
+        double maxWaitMs = 0;
+        double averageRunMs = 0;
+    };
+
     static TaskManager* instance();
-    void addTask(std::function<void()> task);
+    // The returned token cancels the task, a queued one does not start
+    CancellationToken addTask(std::function<void()> task, Priority priority = Priority::Normal);
+    // For tasks that check the token themselves
+    CancellationToken addTask(std::function<void(const CancellationToken&)> task, Priority priority = Priority::Normal);
+    // Cancels every running and queued task
+    void cancelAll();
+    Metrics metrics() const;
+
+    // Prints how long interactive tasks wait while background tasks run
+    static void runBenchmark();
 
 private:
-    TaskManager();
+    explicit TaskManager(int workerCount = 0);
     ~TaskManager();
 
+    struct Task {
+        std::function<void(const CancellationToken&)> run;
+        CancellationToken token;
+        Priority priority = Priority::Normal;
+        qint64 queuedNs = 0;
+    };
+
     class Worker;
-    Worker *m_worker;
-    QThread m_workerThread;
+    CancellationToken enqueue(Task task);
+    // Own queue first, then the others, priority by priority
+    bool take(Worker* worker, Task& task);
+    bool takeFrom(Worker* worker, int priority, bool steal, Task& task);
+    void finished(const Task& task, qint64 startNs);
+
+    std::vector<Worker*> m_workers;
+    std::vector<QThread*> m_threads;
+    QMutex m_idleMutex;
+    QWaitCondition m_idleCondition;
+    std::atomic<quint64> m_wakeups{0};  // Bumped under m_idleMutex for every new task
+    std::atomic<int> m_nextWorker{0};
+    std::atomic<bool> m_exit{false};
+    // The worker running on this thread, so tasks added by a task stay local
+    static thread_local Worker* s_currentWorker;
+
+    std::array<std::atomic<int>, PRIORITY_COUNT> m_queuedPerPriority{};
+    std::atomic<int> m_running{0};
+    std::atomic<int> m_backgroundRunning{0};
+    std::atomic<quint64> m_completed{0};
+    std::atomic<qint64> m_waitTotalNs{0};
+    std::atomic<qint64> m_waitMaxNs{0};
+    std::atomic<qint64> m_runTotalNs{0};
 };
 
 class TaskManager::Worker : public QObject
@@ -32,17 +122,20 @@ class TaskManager::Worker : public QObject
     friend class TaskManager;
 
 public:
-    Worker();
+    Worker(TaskManager* manager, int index);
     ~Worker();
 
 private slots:
     void onProcessTasks();
 
 private:
-    QQueue<std::function<void()>> m_taskQueue;
+    TaskManager* m_manager;
+    int m_index;
+    // Guarded by m_mutex, the owner takes from the front and thieves from the back
+    std::array<std::deque<Task>, PRIORITY_COUNT> m_queues;
+    CancellationToken m_current;
+    bool m_busy = false;
     QMutex m_mutex;
-    QWaitCondition m_condition;
-    bool m_exit = false;
 };
 
-#endif // TASKMANAGER_H
\ No newline at end of file
+#endif // TASKMANAGER_H
@@ -21,6 +21,8 @@
 */ 
 
 #include "audiopage.h"
+#include "globalsetting.h"
+#include "host/audiothread.h"
 #include <QWidget>
 #include <QLabel>
 #include <QComboBox>
@@ -68,6 +70,23 @@ void AudioPage::setupUI()
     QComboBox *containerFormatBox = new QComboBox();
     containerFormatBox->setObjectName("containerFormatBox");
 
+    QLabel *latencyLabel = new QLabel("Passthrough Latency: ");
+    latencyLabel->setStyleSheet(smallLabelFontSize);
+    QSpinBox *latencyBox = new QSpinBox();
+    latencyBox->setObjectName("audioLatencyBox");
+    latencyBox->setRange(AudioThread::MIN_LATENCY_MS, AudioThread::MAX_LATENCY_MS);
+    latencyBox->setSuffix(" ms");
+    latencyBox->setToolTip("Audio buffered between the capture card and the speakers. "
+                           "Lower values react faster but may crackle. Applies when the audio restarts.");
+
+    QLabel *volumeLabel = new QLabel("Volume: ");
+    volumeLabel->setStyleSheet(smallLabelFontSize);
+    QSlider *volumeSlider = new QSlider();
+    volumeSlider->setObjectName("audioVolumeSlider");
+    volumeSlider->setOrientation(Qt::Horizontal);
+    volumeSlider->setRange(0, 100);
+    volumeSlider->setToolTip("Volume of the target audio on the host speakers");
+
     QVBoxLayout *audioLayout = new QVBoxLayout(this);
     audioLayout->addWidget(audioLabel);
     audioLayout->addWidget(audioCodecLabel);
@@ -78,5 +97,26 @@ void AudioPage::setupUI()
     audioLayout->addWidget(qualitySlider);
     audioLayout->addWidget(fileFormatLabel);
     audioLayout->addWidget(containerFormatBox);
+    audioLayout->addWidget(latencyLabel);
+    audioLayout->addWidget(latencyBox);
+    audioLayout->addWidget(volumeLabel);
+    audioLayout->addWidget(volumeSlider);
     audioLayout->addStretch();
 }
+
+void AudioPage::initAudioSettings()
+{
+    QSpinBox *latencyBox = this->findChild<QSpinBox*>("audioLatencyBox");
+    latencyBox->setValue(GlobalSetting::instance().getAudioLatency());
+    QSlider *volumeSlider = this->findChild<QSlider*>("audioVolumeSlider");
+    volumeSlider->setValue(GlobalSetting::instance().getAudioVolume());
+}
+
+void AudioPage::applyAudioSettings()
+{
+    QSpinBox *latencyBox = this->findChild<QSpinBox*>("audioLatencyBox");
+    GlobalSetting::instance().setAudioLatency(latencyBox->value());
+    QSlider *volumeSlider = this->findChild<QSlider*>("audioVolumeSlider");
+    GlobalSetting::instance().setAudioVolume(volumeSlider->value());
+    emit volumeApplied(volumeSlider->value());
+}
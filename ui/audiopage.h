@@ -39,6 +39,13 @@ public:
     explicit AudioPage(QWidget *parent = nullptr);
     ~AudioPage();
     void setupUI();
+    void initAudioSettings();
+    void applyAudioSettings();
+
+signals:
+    // The saved volume in percent
+    void volumeApplied(int percent);
+
 private:
     QLabel *audioLabel;
     QLabel *audioCodecLabel;
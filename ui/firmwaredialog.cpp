@@ -0,0 +1,160 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "firmwaredialog.h"
+#include "video/firmwaretransfer.h"
+#include "video/videohid.h"
+#include "video/ms2109.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFileDialog>
+#include <QMessageBox>
+
+FirmwareDialog::FirmwareDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Capture Card Firmware"));
+    resize(480, 160);
+
+    filePathEdit = new QLineEdit(this);
+    filePathEdit->setPlaceholderText(tr("Firmware image file..."));
+    browseButton = new QPushButton(tr("Browse"), this);
+    readButton = new QPushButton(tr("Read From Device"), this);
+    writeButton = new QPushButton(tr("Write To Device"), this);
+    cancelButton = new QPushButton(tr("Cancel"), this);
+    cancelButton->setEnabled(false);
+    progressBar = new QProgressBar(this);
+    progressBar->setRange(0, 100);
+    progressBar->setValue(0);
+    statusLabel = new QLabel(this);
+
+    QHBoxLayout *fileLayout = new QHBoxLayout();
+    fileLayout->addWidget(filePathEdit);
+    fileLayout->addWidget(browseButton);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    buttonLayout->addWidget(readButton);
+    buttonLayout->addWidget(writeButton);
+    buttonLayout->addWidget(cancelButton);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->addLayout(fileLayout);
+    mainLayout->addWidget(progressBar);
+    mainLayout->addWidget(statusLabel);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(browseButton, &QPushButton::clicked, this, &FirmwareDialog::selectFile);
+    connect(readButton, &QPushButton::clicked, this, &FirmwareDialog::readFirmware);
+    connect(writeButton, &QPushButton::clicked, this, &FirmwareDialog::writeFirmware);
+    connect(cancelButton, &QPushButton::clicked, this, &FirmwareDialog::cancelTransfer);
+
+    m_transfer = new FirmwareTransfer(&VideoHid::getInstance());
+    m_transfer->moveToThread(&m_transferThread);
+    connect(&m_transferThread, &QThread::finished, m_transfer, &QObject::deleteLater);
+    connect(m_transfer, &FirmwareTransfer::progress, this, &FirmwareDialog::onProgress);
+    connect(m_transfer, &FirmwareTransfer::finished, this, &FirmwareDialog::onFinished);
+    m_transferThread.start();
+}
+
+FirmwareDialog::~FirmwareDialog()
+{
+    m_transfer->cancel();
+    m_transferThread.quit();
+    m_transferThread.wait();
+}
+
+void FirmwareDialog::selectFile()
+{
+    QString filePath = QFileDialog::getSaveFileName(this,
+        tr("Select firmware image"),
+        filePathEdit->text(),
+        tr("Firmware Images (*.bin);;All Files (*)"),
+        nullptr,
+        QFileDialog::DontConfirmOverwrite);
+    if (!filePath.isEmpty()) {
+        filePathEdit->setText(filePath);
+    }
+}
+
+void FirmwareDialog::readFirmware()
+{
+    if (filePathEdit->text().isEmpty()) {
+        QMessageBox::warning(this, tr("Error"), tr("Please select a firmware image file first."));
+        return;
+    }
+    m_transfer->setReadJob(filePathEdit->text(), MS2109_EEPROM_SIZE);
+    startTransfer();
+}
+
+void FirmwareDialog::writeFirmware()
+{
+    if (filePathEdit->text().isEmpty()) {
+        QMessageBox::warning(this, tr("Error"), tr("Please select a firmware image file first."));
+        return;
+    }
+    if (QMessageBox::warning(this, tr("Write Firmware"),
+            tr("Writing a wrong image leaves the capture card without video. Continue?"),
+            QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+        return;
+    }
+    m_transfer->setWriteJob(filePathEdit->text());
+    startTransfer();
+}
+
+void FirmwareDialog::startTransfer()
+{
+    setBusy(true);
+    statusLabel->clear();
+    progressBar->setValue(0);
+    QMetaObject::invokeMethod(m_transfer, &FirmwareTransfer::process, Qt::QueuedConnection);
+}
+
+void FirmwareDialog::cancelTransfer()
+{
+    m_transfer->cancel();
+    cancelButton->setEnabled(false);
+}
+
+void FirmwareDialog::onProgress(qint64 done, qint64 total)
+{
+    progressBar->setValue(total > 0 ? static_cast<int>(done * 100 / total) : 0);
+}
+
+void FirmwareDialog::onFinished(bool success, const QString &message, quint32 crc)
+{
+    Q_UNUSED(crc);
+    setBusy(false);
+    statusLabel->setText(message);
+    if (success) {
+        progressBar->setValue(100);
+    }
+}
+
+void FirmwareDialog::setBusy(bool busy)
+{
+    browseButton->setEnabled(!busy);
+    readButton->setEnabled(!busy);
+    writeButton->setEnabled(!busy);
+    filePathEdit->setEnabled(!busy);
+    cancelButton->setEnabled(busy);
+}
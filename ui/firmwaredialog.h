@@ -0,0 +1,67 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef FIRMWAREDIALOG_H
+#define FIRMWAREDIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QProgressBar>
+#include <QLabel>
+#include <QThread>
+
+class FirmwareTransfer;
+
+class FirmwareDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FirmwareDialog(QWidget *parent = nullptr);
+    ~FirmwareDialog();
+
+private slots:
+    void selectFile();
+    void readFirmware();
+    void writeFirmware();
+    void cancelTransfer();
+    void onProgress(qint64 done, qint64 total);
+    void onFinished(bool success, const QString &message, quint32 crc);
+
+private:
+    QLineEdit *filePathEdit;
+    QPushButton *browseButton;
+    QPushButton *readButton;
+    QPushButton *writeButton;
+    QPushButton *cancelButton;
+    QProgressBar *progressBar;
+    QLabel *statusLabel;
+
+    QThread m_transferThread;
+    FirmwareTransfer *m_transfer = nullptr;
+
+    void startTransfer();
+    void setBusy(bool busy);
+};
+
+#endif // FIRMWAREDIALOG_H
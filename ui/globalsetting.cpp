@@ -23,6 +23,7 @@
 
 #include "globalsetting.h"
 #include "global.h"
+#include "host/audiothread.h"
 #include <QMutex>
 #include <QFile>
 #include <QDateTime>
@@ -95,6 +96,44 @@ void GlobalSetting::loadVideoSettings(){
     GlobalVar::instance().setCaptureFps(m_settings.value("video/fps", 30).toInt());
 }
 
+void GlobalSetting::setScreenshotSettings(QString format, int pngLevel, int jpegQuality){
+    m_settings.setValue("screenshot/format", format);
+    m_settings.setValue("screenshot/pngLevel", pngLevel);
+    m_settings.setValue("screenshot/jpegQuality", jpegQuality);
+}
+
+void GlobalSetting::setSoftwarePresenter(bool enabled){
+    m_settings.setValue("video/softwarePresenter", enabled);
+}
+
+bool GlobalSetting::getSoftwarePresenter(){
+    return m_settings.value("video/softwarePresenter", false).toBool();
+}
+
+void GlobalSetting::setAudioLatency(int milliseconds){
+    m_settings.setValue("audio/latencyMs", milliseconds);
+}
+
+int GlobalSetting::getAudioLatency(){
+    return m_settings.value("audio/latencyMs", AudioThread::DEFAULT_LATENCY_MS).toInt();
+}
+
+void GlobalSetting::setAudioVolume(int percent){
+    m_settings.setValue("audio/volume", percent);
+}
+
+int GlobalSetting::getAudioVolume(){
+    return m_settings.value("audio/volume", 100).toInt();
+}
+
+void GlobalSetting::setAudioMuted(bool muted){
+    m_settings.setValue("audio/muted", muted);
+}
+
+bool GlobalSetting::getAudioMuted(){
+    return m_settings.value("audio/muted", false).toBool();
+}
+
 void GlobalSetting::setCameraDeviceSetting(QString deviceDescription){
     m_settings.setValue("camera/device", deviceDescription);
 }
@@ -50,6 +50,24 @@ public:
     void setVideoSettings(int width, int height, int fps);
 
     void loadVideoSettings();
+
+    void setScreenshotSettings(QString format, int pngLevel, int jpegQuality);
+
+    void setSoftwarePresenter(bool enabled);
+
+    bool getSoftwarePresenter();
+
+    void setAudioLatency(int milliseconds);
+
+    int getAudioLatency();
+
+    void setAudioVolume(int percent);
+
+    int getAudioVolume();
+
+    void setAudioMuted(bool muted);
+
+    bool getAudioMuted();
     
     void setCameraDeviceSetting(QString deviceDescription);
 
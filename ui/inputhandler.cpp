@@ -39,8 +39,10 @@ MouseEventDTO* InputHandler::calculateRelativePosition(QMouseEvent *event) {
 }
 
 MouseEventDTO* InputHandler::calculateAbsolutePosition(QMouseEvent *event) {
-    qreal absoluteX = static_cast<qreal>(event->pos().x()) / m_videoPane->width() * 4096;
-    qreal absoluteY = static_cast<qreal>(event->pos().y()) / m_videoPane->height() * 4096;
+    // Goes through the pane's viewport, so a zoomed view still hits the right target pixel
+    QPointF source = m_videoPane->mapToSource(event->position());
+    qreal absoluteX = source.x() * 4096;
+    qreal absoluteY = source.y() * 4096;
     lastX = static_cast<int>(absoluteX);
     lastY = static_cast<int>(absoluteY);
     return new MouseEventDTO(lastX, lastY, true);
@@ -35,9 +35,13 @@
 #include "ui/serialportdebugdialog.h"
 #include "ui/videopane.h"
 #include "video/videohid.h"
+#include "video/framemetrics.h"
+#include "host/audiometer.h"
+#include "host/mediaclock.h"
 #include "ui/versioninfomanager.h"
 #include "ui/cameraajust.h"
 #include "ui/TaskManager.h"
+#include "scripts/Compiler.h"
 
 #include <QCameraDevice>
 #include <QMediaDevices>
@@ -73,6 +77,10 @@
 #include <QGuiApplication>
 #include <QToolTip>
 #include <QScreen>
+#include <QFileDialog>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QThread>
 
 Q_LOGGING_CATEGORY(log_ui_mainwindow, "opf.ui.mainwindow")
 
@@ -212,8 +220,37 @@ MainWindow::MainWindow() :  ui(new Ui::MainWindow),
     
     connect(m_cameraManager, &CameraManager::cameraActiveChanged, this, &MainWindow::updateCameraActive);
     connect(m_cameraManager, &CameraManager::cameraError, this, &MainWindow::displayCameraError);
-    connect(m_cameraManager, &CameraManager::imageCaptured, this, &MainWindow::processCapturedImage);                                         
+    connect(m_cameraManager, &CameraManager::imageCaptured, this, &MainWindow::processCapturedImage);
+    // Screenshots taken from the latest frame never go through QImageCapture
+    connect(m_cameraManager, &CameraManager::screenshotSaved, this, [this](const QString& path, bool success) {
+        if (success) {
+            imageSaved(0, path);
+        } else {
+            ui->statusbar->showMessage(tr("Failed to save %1").arg(QDir::toNativeSeparators(path)), 5000);
+            m_isCapturingImage = false;
+        }
+    });
     connect(m_cameraManager, &CameraManager::resolutionsUpdated, this, &MainWindow::onResolutionsUpdated);
+    connect(m_cameraManager, &CameraManager::softwarePresenterChanged, this, [this](bool enabled) {
+        videoPane->setSoftwarePresenter(enabled);
+        if (!enabled) {
+            m_statusBarManager->setPresentTime(-1, -1);
+        }
+    });
+    connect(videoPane, &VideoPane::presenterStatsUpdated, this,
+            [this](double fps, double averageUs, qint64 maxUs, double dirtyPercent) {
+        Q_UNUSED(fps);
+        Q_UNUSED(dirtyPercent);
+        m_statusBarManager->setPresentTime(averageUs / 1000.0, maxUs / 1000.0);
+    });
+    connect(videoPane, &VideoPane::viewportChanged, this, [this](const QRectF &viewport) {
+        Q_UNUSED(viewport);
+        // Zooming back out hands the drawing back to the backend renderer
+        if (!videoPane->isZoomed() && !videoPane->isSoftwarePresenter()) {
+            m_statusBarManager->setPresentTime(-1, -1);
+        }
+    });
+    m_cameraManager->setSoftwarePresenter(GlobalSetting::instance().getSoftwarePresenter());
 
     qDebug() << "Init camera...";
     checkInitSize();
@@ -261,11 +298,6 @@ MainWindow::MainWindow() :  ui(new Ui::MainWindow),
 
     // Add this line after ui->setupUi(this)
     connect(ui->actionScriptTool, &QAction::triggered, this, &MainWindow::showScriptTool);
-    mouseManager = std::make_unique<MouseManager>();
-    keyboardMouse = std::make_unique<KeyboardMouse>();
-    semanticAnalyzer = std::make_unique<SemanticAnalyzer>(mouseManager.get(), keyboardMouse.get());
-    connect(semanticAnalyzer.get(), &SemanticAnalyzer::captureImg, this, &MainWindow::takeImage);
-    connect(semanticAnalyzer.get(), &SemanticAnalyzer::captureAreaImg, this, &MainWindow::takeAreaImage);
     ScriptTool *scriptTool = new ScriptTool(this);
     connect(scriptTool, &ScriptTool::syntaxTreeReady, this, &MainWindow::handleSyntaxTree);
     setTooltip();
@@ -274,6 +306,24 @@ MainWindow::MainWindow() :  ui(new Ui::MainWindow),
     connect(toolbarManager, &ToolbarManager::toolbarVisibilityChanged,
             this, &MainWindow::onToolbarVisibilityChanged);
     connect(ui->actionTCPServer, &QAction::triggered, this, &MainWindow::startServer);
+    connect(ui->actionFirmware, &QAction::triggered, this, &MainWindow::showFirmwareDialog);
+    connect(ui->actionSaveRecentVideo, &QAction::triggered, this, [this]() { saveRecentVideo(); });
+    connect(m_cameraManager, &CameraManager::recentVideoSaved, this, [this](const QString& path, bool success) {
+        ui->statusbar->showMessage(success ? tr("Saved %1").arg(path) : tr("Failed to save %1").arg(path), 5000);
+    });
+    connect(m_cameraManager, &CameraManager::recordingSegmentStarted, m_audioManager, &AudioManager::startRecording);
+    connect(m_cameraManager, &CameraManager::recordingStopped, m_audioManager, &AudioManager::stopRecording);
+    connect(ui->actionVideoMetrics, &QAction::toggled, this, &MainWindow::showVideoMetrics);
+    ui->actionMute->setChecked(GlobalSetting::instance().getAudioMuted());
+    connect(ui->actionMute, &QAction::toggled, this, &MainWindow::setMuted);
+    connect(ui->actionExportVideoMetrics, &QAction::triggered, this, &MainWindow::exportVideoMetrics);
+    connect(&FrameMetrics::getInstance(), &FrameMetrics::summaryUpdated, this, [this](const FrameMetricsSummary& summary) {
+        m_statusBarManager->setVideoMetrics(summary);
+    });
+
+    audioLevelTimer = new QTimer(this);
+    connect(audioLevelTimer, &QTimer::timeout, this, &MainWindow::updateAudioLevel);
+    audioLevelTimer->start(100);
 }
 
 void MainWindow::startServer(){
@@ -294,37 +344,27 @@ void MainWindow::setTooltip(){
 
 void MainWindow::onZoomIn()
 {
-    factorScale = 1.1 * factorScale;
-    QSize currentSize = videoPane->size() * 1.1;
-    videoPane->resize(currentSize.width(), currentSize.height());
-    qDebug() << "video pane size:" << videoPane->geometry();
-    if (videoPane->width() > scrollArea->width() || videoPane->height() > scrollArea->height()) {
-        scrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-        scrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-    }
+    // The pane keeps its size, only the visible part of the frame is rendered
+    videoPane->zoomBy(1.1);
+    factorScale = videoPane->zoom();
+    qDebug() << "video zoom:" << factorScale << "viewport:" << videoPane->viewport();
 
     mouseEdgeTimer->start(edgeDuration); // Check every edge Duration
 }
 
 void MainWindow::onZoomOut()
 {
-    if (videoPane->width() != this->width()){
-        factorScale = 0.9 * factorScale;
-        QSize currentSize = videoPane->size() * 0.9;
-        videoPane->resize(currentSize.width(), currentSize.height());
-        if (videoPane->width() <= scrollArea->width() && videoPane->height() <= scrollArea->height()) {
-            scrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-            scrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
-        }
+    videoPane->zoomBy(1 / 1.1);
+    factorScale = videoPane->zoom();
+    if (!videoPane->isZoomed() && mouseEdgeTimer->isActive()) {
+        mouseEdgeTimer->stop();
     }
-
 }
 
 void MainWindow::onZoomReduction()
 {
-    videoPane->resize(this->width() * 0.9, (this->height() - ui->statusbar->height() - ui->menubar->height()) * 0.9);
-    scrollArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
-    scrollArea->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    videoPane->resetZoom();
+    factorScale = 1;
     if (mouseEdgeTimer->isActive()) {
         mouseEdgeTimer->stop();
     }
@@ -333,6 +373,10 @@ void MainWindow::onZoomReduction()
 void MainWindow::initCamera()
 {
     qCDebug(log_ui_mainwindow) << "Camera init...";
+    // A test pattern or file source replaces the capture card, e.g. on a machine without one
+    if (m_cameraManager->startSyntheticSource(videoPane)) {
+        return;
+    }
 #ifdef QT_FEATURE_permissions //Permissions API not compatible with Qt < 6.5 and will cause compilation failure on expanding macro in qtconfigmacros.h
 #if QT_CONFIG(permissions)
     // camera 
@@ -681,6 +725,7 @@ void MainWindow::onResolutionChange(const int& width, const int& height, const f
 {
     GlobalVar::instance().setInputWidth(width);
     GlobalVar::instance().setInputHeight(height);
+    GlobalVar::instance().setInputFps(fps);
     m_statusBarManager->setInputResolution(width, height, fps);
 }
 
@@ -773,10 +818,7 @@ void MainWindow::updateRecordTime()
 void MainWindow::processCapturedImage(int requestId, const QImage &img)
 {
     Q_UNUSED(requestId);
-    QImage scaledImage =
-            img.scaled(ui->centralwidget->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
-
-   // ui->lastImagePreviewLabel->setPixmap(QPixmap::fromImage(scaledImage));
+    Q_UNUSED(img);
 
     // Display captured image for 4 seconds.
     displayCapturedImage();
@@ -793,6 +835,9 @@ void MainWindow::configureSettings() {
         connect(hardwarePage, &HardwarePage::cameraSettingsApplied, m_cameraManager, &CameraManager::loadCameraSettingAndSetCamera);
         // connect(settingDialog, &SettingDialog::cameraSettingsApplied, m_cameraManager, &CameraManager::loadCameraSettingAndSetCamera);
         connect(videoPage, &VideoPage::videoSettingsChanged, this, &MainWindow::onVideoSettingsChanged);
+        connect(settingDialog->getAudioPage(), &AudioPage::volumeApplied, this, [this](int percent) {
+            m_audioManager->setVolume(percent / 100.0);
+        });
         // connect the finished signal to the set the dialog pointer to nullptr
         connect(settingDialog, &QDialog::finished, this, [this](){
             settingDialog = nullptr;
@@ -881,9 +926,10 @@ void MainWindow::pause()
     m_cameraManager->stopRecording();
 }
 
-void MainWindow::setMuted(bool /*muted*/)
+void MainWindow::setMuted(bool muted)
 {
-    // Your implementation here
+    GlobalSetting::instance().setAudioMuted(muted);
+    m_audioManager->setMuted(muted);
 }
 
 void MainWindow::takeImageDefault(){
@@ -895,6 +941,58 @@ void MainWindow::takeImage(const QString& path)
     m_cameraManager->takeImage(path);
 }
 
+void MainWindow::saveRecentVideo(const QString& path)
+{
+    m_cameraManager->saveRecentVideo(path);
+}
+
+void MainWindow::showVideoMetrics(bool show)
+{
+    FrameMetrics::getInstance().setEnabled(show);
+    if (!show) {
+        m_statusBarManager->clearVideoMetrics();
+    }
+}
+
+/*
+ * Shows the loudest of the blocks metered since the last update, the meter
+ * hides once the audio thread has not delivered a block for a second
+ */
+void MainWindow::updateAudioLevel()
+{
+    const AudioMeter &meter = AudioMeter::getInstance();
+    const quint64 newest = meter.levelCount();
+    AudioMeter::Level level;
+    if (meter.levelSince(m_audioLevelCount, &level)) {
+        m_audioLevelCount = newest;
+        m_statusBarManager->setAudioLevel(AudioMeter::toDb(level.peak), AudioMeter::toDb(level.rms));
+    } else if (!meter.latestLevel(&level) || MediaClock::nowUs() - level.timestampUs > 1000000) {
+        m_statusBarManager->clearAudioLevel();
+    }
+}
+
+void MainWindow::exportVideoMetrics()
+{
+    if (FrameMetrics::getInstance().records().isEmpty()) {
+        QMessageBox::information(this, tr("Export Video Metrics"),
+                                 tr("No frames recorded yet, enable Show Video Metrics first."));
+        return;
+    }
+    QString defaultPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)
+                          + "/video_metrics_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".csv";
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Export Video Metrics"), defaultPath,
+                                                    tr("CSV Files (*.csv)"));
+    if (filePath.isEmpty()) {
+        return;
+    }
+    QString error;
+    if (FrameMetrics::getInstance().exportCsv(filePath, &error)) {
+        ui->statusbar->showMessage(tr("Saved %1").arg(filePath), 5000);
+    } else {
+        QMessageBox::warning(this, tr("Export Video Metrics"), tr("Failed to save %1: %2").arg(filePath, error));
+    }
+}
+
 void MainWindow::takeAreaImage(const QString& path, const QRect& captureArea){
     qCDebug(log_ui_mainwindow) << "mainwindow capture area image";
     m_cameraManager->takeAreaImage(path, captureArea);
@@ -994,6 +1092,9 @@ void MainWindow::closeEvent(QCloseEvent *event)
 void MainWindow::updateCameras()
 {
     qCDebug(log_ui_mainwindow) << "Update cameras...";
+    if (m_cameraManager->hasSyntheticSource()) {
+        return;
+    }
     const QList<QCameraDevice> availableCameras = QMediaDevices::videoInputs();
     qCDebug(log_ui_mainwindow) << "Available cameras size: " << availableCameras.size();
 
@@ -1097,10 +1198,11 @@ void MainWindow::onSwitchableUsbToggle(const bool isToTarget) {
 
 void MainWindow::checkMousePosition()
 {
-    if (!scrollArea || !videoPane) return;
+    if (!videoPane || !videoPane->isZoomed()) return;
 
-    QPoint mousePos = mapFromGlobal(QCursor::pos());
-    QRect viewRect = scrollArea->viewport()->rect();
+    QPoint mousePos = videoPane->mapFromGlobal(QCursor::pos());
+    QRect viewRect = videoPane->rect();
+    if (!viewRect.contains(mousePos)) return;
 
     int deltaX = 0;
     int deltaY = 0;
@@ -1125,8 +1227,8 @@ void MainWindow::checkMousePosition()
     }
 
     if (deltaX != 0 || deltaY != 0) {
-        scrollArea->horizontalScrollBar()->setValue(scrollArea->horizontalScrollBar()->value() + deltaX);
-        scrollArea->verticalScrollBar()->setValue(scrollArea->verticalScrollBar()->value() + deltaY);
+        // Pans the zoomed viewport, the pane itself never outgrows the window
+        videoPane->panBy(QPointF(deltaX, deltaY));
     }
 }
 
@@ -1164,20 +1266,41 @@ void MainWindow::showScriptTool()
     scriptTool->show();  // Change exec() to show() for non-modal dialog
 }
 
+void MainWindow::showFirmwareDialog()
+{
+    FirmwareDialog *firmwareDialog = new FirmwareDialog(this);
+    firmwareDialog->setAttribute(Qt::WA_DeleteOnClose);
+    firmwareDialog->show();
+}
+
 // run the sematic analyzer
 void MainWindow::handleSyntaxTree(std::shared_ptr<ASTNode> syntaxTree) {
     // Handle the received syntaxTree here
     qCDebug(log_ui_mainwindow) << "Received syntaxTree in MainWindow";
     // Process the syntaxTree as needed
     qCDebug(log_ui_mainwindow) << syntaxTree.get();
-    taskmanager->addTask([this, syntaxTree]() {
-        semanticAnalyzer->analyze(syntaxTree.get());
-    });
+    // Scripts run beside each other, each with its own variables, key queue and mouse
+    taskmanager->addTask([this, syntaxTree](const CancellationToken& token) {
+        KeyboardMouse keyboardMouse;
+        MouseManager mouseManager;
+        mouseManager.setPaced(true);
+        SemanticAnalyzer semanticAnalyzer(&mouseManager, &keyboardMouse);
+        connect(&semanticAnalyzer, &SemanticAnalyzer::captureImg, this, &MainWindow::takeImage);
+        connect(&semanticAnalyzer, &SemanticAnalyzer::captureAreaImg, this, &MainWindow::takeAreaImage);
+        connect(&semanticAnalyzer, &SemanticAnalyzer::saveRecentVideo, this, &MainWindow::saveRecentVideo);
+        semanticAnalyzer.run(Compiler().compile(syntaxTree), token);
+    }, TaskManager::Priority::Background);
 } 
 
 MainWindow::~MainWindow()
 {
     qCDebug(log_ui_mainwindow) << "MainWindow destructor called";
+
+    // Running scripts connect to this window, they have to end before it goes
+    taskmanager->cancelAll();
+    while (taskmanager->metrics().running > 0) {
+        QThread::msleep(10);
+    }
     
     // Stop all camera operations
     stop();
@@ -43,6 +43,7 @@
 #include "host/usbcontrol.h"
 #include "ui/cameraajust.h"
 #include "ui/scripttool.h"
+#include "ui/firmwaredialog.h"
 #include "ui/TaskManager.h"
 #include "../scripts/semanticAnalyzer.h"
 #include "../scripts/AST.h"
@@ -117,6 +118,10 @@ private slots:
     void takeImage(const QString& path = "");
     void takeAreaImage(const QString& path, const QRect& captureArea);
     void takeImageDefault();
+    void saveRecentVideo(const QString& path = "");
+    void showVideoMetrics(bool show);
+    void exportVideoMetrics();
+    void updateAudioLevel();
     void displayCaptureError(int, QImageCapture::Error, const QString &errorString);
 
     void versionInfo();
@@ -268,6 +273,8 @@ private:
 
     double factorScale = 1;
     QTimer *mouseEdgeTimer; // Add this line
+    QTimer *audioLevelTimer;
+    quint64 m_audioLevelCount = 0;
     const int edgeThreshold = 50; // Adjust this value as needed
     const int edgeDuration = 125; // Reduced duration for more frequent checks
     const int maxScrollSpeed = 50; // Maximum scroll speed
@@ -277,11 +284,9 @@ private:
     USBControl *usbControl;
 
     // CameraAdjust *cameraAdjust;
-    std::unique_ptr<MouseManager> mouseManager;
-    std::unique_ptr<KeyboardMouse> keyboardMouse;
-    std::unique_ptr<SemanticAnalyzer> semanticAnalyzer;
     TaskManager* taskmanager;
     void showScriptTool();
+    void showFirmwareDialog();
 
     void onToolbarVisibilityChanged(bool visible);
 
@@ -0,0 +1,138 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "scripthighlighter.h"
+
+ScriptHighlighter::ScriptHighlighter(QTextDocument *parent)
+    : QSyntaxHighlighter(parent)
+{
+    m_keywordFormat.setForeground(QColor("green"));
+    m_commandFormat.setForeground(QColor("purple"));
+    m_numberFormat.setForeground(QColor("DarkGoldenRod"));
+    m_commentFormat.setForeground(QColor("grey"));
+}
+
+void ScriptHighlighter::highlightBlock(const QString &text)
+{
+    const QByteArray utf8 = text.toUtf8();
+    m_textIndex.clear();
+    if (utf8.size() != text.size()) {
+        // Lead bytes start a character, four byte characters are surrogate pairs
+        m_textIndex.reserve(size_t(utf8.size()) + 1);
+        int index = 0;
+        for (int i = 0; i < utf8.size(); i++) {
+            const uchar c = uchar(utf8[i]);
+            m_textIndex.push_back(index);
+            if ((c & 0xC0) != 0x80) {
+                index += c >= 0xF0 ? 2 : 1;
+            }
+        }
+        m_textIndex.push_back(text.size());
+    }
+
+    setCurrentBlockState(Normal);
+    int start = 0;
+    if (previousBlockState() == BlockComment) {
+        const int end = utf8.indexOf("*/");
+        if (end < 0) {
+            setByteFormat(0, int(utf8.size()), m_commentFormat);
+            setCurrentBlockState(BlockComment);
+            return;
+        }
+        start = end + 2;
+        setByteFormat(0, start, m_commentFormat);
+    } else {
+        // Like in AHK, a block comment starts at the beginning of a line
+        const QByteArray trimmed = utf8.trimmed();
+        if (trimmed.startsWith("/*")) {
+            const int open = utf8.indexOf("/*");
+            const int end = utf8.indexOf("*/", open + 2);
+            if (end < 0) {
+                setByteFormat(open, int(utf8.size()), m_commentFormat);
+                setCurrentBlockState(BlockComment);
+                return;
+            }
+            start = end + 2;
+            setByteFormat(open, start, m_commentFormat);
+        }
+    }
+    highlightCode(utf8, start);
+}
+
+void ScriptHighlighter::highlightCode(const QByteArray &utf8, int start)
+{
+    if (start >= utf8.size()) {
+        return;
+    }
+    m_lexer.setSource(std::string(utf8.constData() + start, size_t(utf8.size() - start)));
+    bool inString = false;
+    // The line start, or the end of a block comment, counts as a blank
+    bool blankBefore = true;
+    for (const Token &token : m_lexer.tokenize()) {
+        if (token.type == AHKTokenType::ENDOFFILE) {
+            break;
+        }
+        const int from = start + token.column - 1;
+        const int to = from + int(token.value.size());
+        // A comment needs a blank before it, so "a;b" stays code
+        const bool commentStart = blankBefore && token.value == ";";
+        blankBefore = token.type == AHKTokenType::WHITESPACE;
+
+        if (token.value == "\"") {
+            // A doubled quote inside a string is an escaped quote, it toggles twice
+            inString = !inString;
+            continue;
+        }
+        if (inString) {
+            continue;
+        }
+        if (commentStart) {
+            setByteFormat(from, int(utf8.size()), m_commentFormat);
+            return;
+        }
+        switch (token.type) {
+            case AHKTokenType::KEYWORD:
+                setByteFormat(from, to, m_keywordFormat);
+                break;
+            case AHKTokenType::COMMAND:
+                setByteFormat(from, to, m_commandFormat);
+                break;
+            case AHKTokenType::INTEGER:
+            case AHKTokenType::FLOAT:
+                setByteFormat(from, to, m_numberFormat);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int ScriptHighlighter::toTextIndex(int byteOffset) const
+{
+    return m_textIndex.empty() ? byteOffset : m_textIndex[size_t(byteOffset)];
+}
+
+void ScriptHighlighter::setByteFormat(int from, int to, const QTextCharFormat &format)
+{
+    const int begin = toTextIndex(from);
+    setFormat(begin, toTextIndex(to) - begin, format);
+}
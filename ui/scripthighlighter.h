@@ -0,0 +1,69 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef SCRIPTHIGHLIGHTER_H
+#define SCRIPTHIGHLIGHTER_H
+
+#include <QSyntaxHighlighter>
+#include <QTextCharFormat>
+#include <vector>
+#include "../scripts/Lexer.h"
+
+/*
+ * Colors the script in the Script Tool one line at a time. Qt calls
+ * highlightBlock() only for the lines an edit touched, and for the lines
+ * after them as long as the state a line ends in changes, so typing in a
+ * long script lexes a single line. The only state carried from one line
+ * to the next is being inside a block comment.
+ */
+class ScriptHighlighter : public QSyntaxHighlighter
+{
+    Q_OBJECT
+
+public:
+    explicit ScriptHighlighter(QTextDocument *parent = nullptr);
+
+protected:
+    void highlightBlock(const QString &text) override;
+
+private:
+    enum BlockState {
+        Normal = 0,
+        BlockComment = 1,
+    };
+
+    // Colors the line from byte offset start, after any block comment
+    void highlightCode(const QByteArray &utf8, int start);
+    // Token columns are in bytes of the UTF-8 line, formats in UTF-16 units
+    int toTextIndex(int byteOffset) const;
+    void setByteFormat(int from, int to, const QTextCharFormat &format);
+
+    Lexer m_lexer;
+    std::vector<int> m_textIndex;   // Empty for plain ASCII lines
+
+    QTextCharFormat m_keywordFormat;
+    QTextCharFormat m_commandFormat;
+    QTextCharFormat m_numberFormat;
+    QTextCharFormat m_commentFormat;
+};
+
+#endif // SCRIPTHIGHLIGHTER_H
@@ -32,6 +32,7 @@
 #include "../scripts/Parser.h"
 // #include "../scripts/semanticAnalyzer.h"
 #include "../scripts/KeyboardMouse.h"
+#include "../scripts/ScriptScheduler.h"
 
 Q_DECLARE_LOGGING_CATEGORY(log_script)
 
@@ -52,10 +53,16 @@ ScriptTool::ScriptTool(QWidget *parent)
     saveButton = new QPushButton(tr("Save Script"), this);
     saveButton->setEnabled(false);
 
-    scriptEdit = new QTextEdit(this);
+    // Act on every running script, also in the middle of a Sleep
+    pauseButton = new QPushButton(tr("Pause"), this);
+    stopButton = new QPushButton(tr("Stop"), this);
+
+    scriptEdit = new QPlainTextEdit(this);
     scriptEdit->setReadOnly(true);
     scriptEdit->setFont(QFont("Courier", 10));
-    scriptEdit->setLineWrapMode(QTextEdit::NoWrap);
+    scriptEdit->setLineWrapMode(QPlainTextEdit::NoWrap);
+    // Colors only the lines an edit touches
+    highlighter = new ScriptHighlighter(scriptEdit->document());
 
     QVBoxLayout *mainLayout = new QVBoxLayout(this);
     
@@ -70,6 +77,8 @@ ScriptTool::ScriptTool(QWidget *parent)
     QHBoxLayout *buttonLayout = new QHBoxLayout();
     buttonLayout->addWidget(selectButton);
     buttonLayout->addWidget(runButton);
+    buttonLayout->addWidget(pauseButton);
+    buttonLayout->addWidget(stopButton);
     buttonLayout->addWidget(saveButton);
     buttonLayout->addWidget(cancelButton);
 
@@ -80,6 +89,8 @@ ScriptTool::ScriptTool(QWidget *parent)
     connect(selectButton, &QPushButton::clicked, this, &ScriptTool::selectFile);
     connect(runButton, &QPushButton::clicked, this, &ScriptTool::runScript);
     connect(saveButton, &QPushButton::clicked, this, &ScriptTool::saveScript);
+    connect(pauseButton, &QPushButton::clicked, this, &ScriptTool::togglePause);
+    connect(stopButton, &QPushButton::clicked, this, &ScriptTool::stopScript);
     connect(cancelButton, &QPushButton::clicked, this, &ScriptTool::close);
 
 }
@@ -106,13 +117,7 @@ void ScriptTool::selectFile()
             QTextStream in(&file);
             fileContents = in.readAll();
             file.close();
-            lexer.setSource(fileContents.toStdString());
-            tokens = lexer.tokenize();
-            QString styledText = highlightTokens(tokens);
-
-            // qDebug(log_script) << "Token Type:" << static_cast<int>(token.type) << "Value:" << tokenText;
-            
-            scriptEdit->setText(styledText);
+            scriptEdit->setPlainText(fileContents);
             scriptEdit->setReadOnly(false);
             saveButton->setEnabled(true);
         } else {
@@ -143,6 +148,23 @@ void ScriptTool::runScript()
     //     tr("Script execution will be implemented here.\nSelected file: %1").arg(filePath));
 }
 
+void ScriptTool::togglePause()
+{
+    if (pauseButton->text() == tr("Pause")) {
+        ScriptScheduler::getInstance().pauseAll();
+        pauseButton->setText(tr("Resume"));
+    } else {
+        ScriptScheduler::getInstance().resumeAll();
+        pauseButton->setText(tr("Pause"));
+    }
+}
+
+void ScriptTool::stopScript()
+{
+    ScriptScheduler::getInstance().cancelAll();
+    pauseButton->setText(tr("Pause"));
+}
+
 void ScriptTool::processAST(ASTNode* node)
 {
     if (!node) return;
@@ -165,44 +187,3 @@ void ScriptTool::saveScript()
         }
     }
 }
-
-QString ScriptTool::highlightTokens(const std::vector<Token>& tokens) {
-    QString styledText;
-    for (const auto& token : tokens) {
-        QString tokenText = QString::fromStdString(token.value);
-        QString color;
-        if (tokenText == "\\n") {
-            tokenText = tokenText.replace("\\n", "<br>");
-        }
-        switch (token.type) {
-            case AHKTokenType::KEYWORD:
-                color = "green";
-                break;
-            case AHKTokenType::FUNCTION:
-                color = "blue";
-                break;
-            case AHKTokenType::VARIABLE:
-                color = "white";
-                break;
-            case AHKTokenType::INTEGER:
-            case AHKTokenType::FLOAT:
-                color = "DarkGoldenRod";
-                break;
-            case AHKTokenType::COMMAND:
-                color = "purple";
-                break;
-            case AHKTokenType::COMMENT:
-                color = "grey";
-                break;
-            default:
-                if (QGuiApplication::palette().color(QPalette::Window).lightness() < 128) {
-                    color = "white";
-                } else {
-                    color = "black";
-                }
-                break;
-        }
-        styledText += QString("<span style='color:%1;'>%2</span>").arg(color, tokenText);
-    }
-    return styledText;
-}
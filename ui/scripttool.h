@@ -28,7 +28,7 @@
 #include <QPushButton>
 #include <QVBoxLayout>
 #include <QFileDialog>
-#include <QTextEdit>
+#include <QPlainTextEdit>
 #include <QThread>
 #include <QFile>
 #include <QGuiApplication>
@@ -37,6 +37,7 @@
 #include "../scripts/Parser.h"
 #include "../scripts/semanticAnalyzer.h"
 #include "../target/MouseManager.h"
+#include "scripthighlighter.h"
 
 class ScriptTool : public QDialog
 {
@@ -53,21 +54,25 @@ private slots:
     void selectFile();
     void runScript();
     void saveScript();
+    void togglePause();
+    void stopScript();
 
 private:
     QLineEdit *filePathEdit;
     QPushButton *selectButton;
     QPushButton *runButton;
     QPushButton *saveButton;
+    QPushButton *pauseButton;
+    QPushButton *stopButton;
     QPushButton *cancelButton;
-    QTextEdit *scriptEdit;
+    QPlainTextEdit *scriptEdit;
+    ScriptHighlighter *highlighter;
     QFile currentFile;
     Lexer lexer;
     std::vector<Token> tokens;
     QString fileContents;
     
     void processAST(ASTNode *node);
-    QString highlightTokens(const std::vector<Token>& tokens);
 };
 
 #endif // SCRIPTTOOL_H
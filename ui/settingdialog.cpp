@@ -77,6 +77,7 @@ SettingDialog::SettingDialog(CameraManager *cameraManager, QWidget *parent)
     // loadLogSettings();
     logPage->initLogSettings();
     videoPage->initVideoSettings();
+    audioPage->initAudioSettings();
     hardwarePage->initHardwareSetting();
     // Connect the tree widget's currentItemChanged signal to a slot
     connect(settingTree, &QTreeWidget::currentItemChanged, this, &SettingDialog::changePage);
@@ -191,6 +192,7 @@ void SettingDialog::applyAccrodingPage(){
         videoPage->applyVideoSettings();
         break;
     case 2:
+        audioPage->applyAudioSettings();
         break;
     case 3:
         hardwarePage->applyHardwareSetting();
@@ -203,6 +205,7 @@ void SettingDialog::applyAccrodingPage(){
 void SettingDialog::handleOkButton() {
     logPage->applyLogsettings();
     videoPage->applyVideoSettings();
+    audioPage->applyAudioSettings();
     hardwarePage->applyHardwareSetting();
     accept();
 }
@@ -214,3 +217,7 @@ HardwarePage* SettingDialog::getHardwarePage() {
 VideoPage* SettingDialog::getVideoPage() {
     return videoPage;
 }
+
+AudioPage* SettingDialog::getAudioPage() {
+    return audioPage;
+}
@@ -61,6 +61,7 @@ public:
     ~SettingDialog();
     HardwarePage* getHardwarePage();
     VideoPage* getVideoPage();
+    AudioPage* getAudioPage();
 // signals:
 //     // void serialSettingsApplied();
     
@@ -71,7 +72,7 @@ private:
     QTreeWidget *settingTree;
     QStackedWidget *stackedWidget;
     LogPage *logPage;
-    QWidget *audioPage;
+    AudioPage *audioPage;
     VideoPage *videoPage;
     HardwarePage *hardwarePage;
 
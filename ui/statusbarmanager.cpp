@@ -92,6 +92,64 @@ void StatusBarManager::setCaptureResolution(int width, int height, int fps)
     m_statusWidget->setCaptureResolution(width, height, fps);
 }
 
+void StatusBarManager::setPresentTime(double averageMs, double maxMs)
+{
+    m_statusWidget->setPresentTime(averageMs, maxMs);
+}
+
+void StatusBarManager::setVideoMetrics(const FrameMetricsSummary &summary)
+{
+    auto ms = [](double us) {
+        return us < 0 ? QString("-") : QString::number(us / 1000.0, 'f', 1);
+    };
+    // Camera latencies are relative to the fastest frame, marked with a plus
+    QString latency = summary.totalLatencyUs < 0 ? QString("-")
+                      : (summary.captureLatencyRelative ? "+" : "") + ms(summary.totalLatencyUs);
+    QString fps = summary.presentFps >= 0
+                      ? QString("%1/%2").arg(summary.presentFps, 0, 'f', 1).arg(summary.arrivalFps, 0, 'f', 1)
+                      : QString::number(summary.arrivalFps, 'f', 1);
+    QString text = QString(" | LAT %1ms FPS %2 (IN %3) DROP %4 DUP %5 JIT %6ms")
+                       .arg(latency, fps)
+                       .arg(summary.inputFps, 0, 'f', 1)
+                       .arg(summary.dropped + summary.notPresented)
+                       .arg(summary.duplicated)
+                       .arg(ms(summary.jitterUs));
+    QString details = QString("Capture to sink: %1 ms%2\nDecode: %3 ms\nSink to paint: %4 ms\nDraw: %5 ms\n"
+                              "Arrived: %6 fps, painted: %7 fps, capture format: %8 fps, input signal: %9 fps\n"
+                              "Dropped in the stream: %10, not painted: %11, duplicated: %12")
+                          .arg(ms(summary.captureLatencyUs), QString(summary.captureLatencyRelative ? " (relative)" : ""))
+                          .arg(ms(summary.decodeUs), ms(summary.presentLatencyUs), ms(summary.drawUs))
+                          .arg(summary.arrivalFps, 0, 'f', 1)
+                          .arg(summary.presentFps < 0 ? QString("-") : QString::number(summary.presentFps, 'f', 1))
+                          .arg(summary.captureFps, 0, 'f', 0)
+                          .arg(summary.inputFps, 0, 'f', 1)
+                          .arg(summary.dropped)
+                          .arg(summary.notPresented)
+                          .arg(summary.duplicated);
+    m_statusWidget->setVideoMetrics(text, details);
+}
+
+void StatusBarManager::clearVideoMetrics()
+{
+    m_statusWidget->setVideoMetrics(QString());
+}
+
+void StatusBarManager::setAudioLevel(double peakDb, double rmsDb)
+{
+    // Ten steps of 6 dB, anything below -60 dBFS shows as silence
+    const int steps = qBound(0, int((peakDb + 60.0) / 6.0 + 0.5), 10);
+    QString text = QString(" | 🔊 %1%2 %3dB")
+                       .arg(QString(steps, QChar(0x2588)), QString(10 - steps, QChar(0x2591)))
+                       .arg(peakDb, 0, 'f', 0);
+    QString details = QString("Target audio, peak %1 dBFS, RMS %2 dBFS").arg(peakDb, 0, 'f', 1).arg(rmsDb, 0, 'f', 1);
+    m_statusWidget->setAudioLevel(text, details);
+}
+
+void StatusBarManager::clearAudioLevel()
+{
+    m_statusWidget->setAudioLevel(QString());
+}
+
 QPixmap StatusBarManager::recolorSvg(const QString &svgPath, const QColor &color, const QSize &size)
 {
     QSvgRenderer svgRenderer(svgPath);
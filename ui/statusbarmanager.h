@@ -7,6 +7,7 @@
 #include <QHBoxLayout>
 #include <QWidget>
 #include "statuswidget.h"
+#include "video/framemetrics.h"
 
 class StatusBarManager : public QObject
 {
@@ -22,6 +23,12 @@ public:
     void setStatusUpdate(const QString& status);
     void setInputResolution(int width, int height, float fps);
     void setCaptureResolution(int width, int height, int fps);
+    void setPresentTime(double averageMs, double maxMs);
+    void setVideoMetrics(const FrameMetricsSummary &summary);
+    void clearVideoMetrics();
+    // Levels in dBFS
+    void setAudioLevel(double peakDb, double rmsDb);
+    void clearAudioLevel();
     void setTargetUsbConnected(bool isConnected);
     void updateIconColor();
 
@@ -30,6 +30,12 @@ StatusWidget::StatusWidget(QWidget *parent) : QWidget(parent) {
     resolutionLabel = new QLabel("💻:", this);
     inputResolutionLabel = new QLabel("INPUT(NA),", this);
     captureResolutionLabel = new QLabel("CAPTURE(NA)", this);
+    presentTimeLabel = new QLabel("", this);
+    presentTimeLabel->hide();
+    videoMetricsLabel = new QLabel("", this);
+    videoMetricsLabel->hide();
+    audioLevelLabel = new QLabel("", this);
+    audioLevelLabel->hide();
     connectedPortLabel = new QLabel("🔌: N/A", this);
 
     QHBoxLayout *layout = new QHBoxLayout(this);
@@ -45,6 +51,9 @@ StatusWidget::StatusWidget(QWidget *parent) : QWidget(parent) {
     layout->addWidget(resolutionLabel);
     layout->addWidget(inputResolutionLabel);
     layout->addWidget(captureResolutionLabel);
+    layout->addWidget(presentTimeLabel);
+    layout->addWidget(videoMetricsLabel);
+    layout->addWidget(audioLevelLabel);
 
     setLayout(layout);
     setMinimumHeight(30);
@@ -68,6 +77,30 @@ void StatusWidget::setCaptureResolution(const int &width, const int &height, con
     update(); 
 }
 
+void StatusWidget::setPresentTime(const double &averageMs, const double &maxMs) {
+    if (averageMs < 0) {
+        presentTimeLabel->hide();
+        return;
+    }
+    presentTimeLabel->setText(QString(", DRAW(%1/%2ms)").arg(averageMs, 0, 'f', 2).arg(maxMs, 0, 'f', 2));
+    presentTimeLabel->show();
+    update();
+}
+
+void StatusWidget::setVideoMetrics(const QString &metrics, const QString &details) {
+    videoMetricsLabel->setText(metrics);
+    videoMetricsLabel->setToolTip(details);
+    videoMetricsLabel->setVisible(!metrics.isEmpty());
+    update();
+}
+
+void StatusWidget::setAudioLevel(const QString &level, const QString &details) {
+    audioLevelLabel->setText(level);
+    audioLevelLabel->setToolTip(details);
+    audioLevelLabel->setVisible(!level.isEmpty());
+    update();
+}
+
 void StatusWidget::setConnectedPort(const QString &port, const int &baudrate) {
     if(baudrate > 0){
         connectedPortLabel->setText(QString("🔌: %1@%2").arg(port).arg(baudrate));
@@ -39,6 +39,12 @@ public:
     void setConnectedPort(const QString &port, const int &baudrate);
     void setStatusUpdate(const QString &status);
     void setTargetUsbConnected(const bool isConnected);
+    // Negative values hide the present time
+    void setPresentTime(const double &averageMs, const double &maxMs);
+    // An empty text hides the video metrics
+    void setVideoMetrics(const QString &metrics, const QString &details = QString());
+    // An empty text hides the audio level
+    void setAudioLevel(const QString &level, const QString &details = QString());
     int getCaptureWidth() const;
     int getCaptureHeight() const;
 
@@ -51,6 +57,9 @@ private:
     QLabel *resolutionLabel;
     QLabel *inputResolutionLabel;
     QLabel *captureResolutionLabel;
+    QLabel *presentTimeLabel;
+    QLabel *videoMetricsLabel;
+    QLabel *audioLevelLabel;
     QLabel *connectedPortLabel;
     int m_captureWidth;
     int m_captureHeight;
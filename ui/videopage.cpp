@@ -29,6 +29,9 @@
 #include <QLabel>
 #include <QVariant>
 #include <QMediaFormat>
+#include <QSpinBox>
+#include <QCheckBox>
+#include "video/screenshotwriter.h"
 
 
 VideoPage::VideoPage(CameraManager *cameraManager, QWidget *parent) : QWidget(parent)
@@ -78,6 +81,47 @@ void VideoPage::setupUI()
     videoLayout->addLayout(hBoxLayout);
     videoLayout->addWidget(formatLabel);
     videoLayout->addWidget(pixelFormatBox);
+
+    QCheckBox *softwarePresenterCheckBox = new QCheckBox("Software rendering (redraw only changed areas)");
+    softwarePresenterCheckBox->setObjectName("softwarePresenterCheckBox");
+    videoLayout->addWidget(softwarePresenterCheckBox);
+
+    QLabel *screenshotLabel = new QLabel(
+        "<span style=' font-weight: bold;'>Screenshot</span>");
+    screenshotLabel->setStyleSheet(bigLabelFontSize);
+    screenshotLabel->setTextFormat(Qt::RichText);
+
+    QLabel *screenshotFormatLabel = new QLabel("Image format: ");
+    screenshotFormatLabel->setStyleSheet(smallLabelFontSize);
+    QComboBox *screenshotFormatBox = new QComboBox();
+    screenshotFormatBox->setObjectName("screenshotFormatBox");
+    screenshotFormatBox->addItem("PNG", "png");
+    screenshotFormatBox->addItem("JPEG", "jpg");
+    screenshotFormatBox->addItem("PPM (raw)", "ppm");
+    screenshotFormatBox->addItem("QOI (fast lossless)", "qoi");
+
+    QLabel *pngLevelLabel = new QLabel("PNG compression level: ");
+    pngLevelLabel->setStyleSheet(smallLabelFontSize);
+    QSpinBox *pngLevelSpinBox = new QSpinBox();
+    pngLevelSpinBox->setObjectName("pngLevelSpinBox");
+    pngLevelSpinBox->setRange(0, 9);
+
+    QLabel *jpegQualityLabel = new QLabel("JPEG quality: ");
+    jpegQualityLabel->setStyleSheet(smallLabelFontSize);
+    QSpinBox *jpegQualitySpinBox = new QSpinBox();
+    jpegQualitySpinBox->setObjectName("jpegQualitySpinBox");
+    jpegQualitySpinBox->setRange(1, 100);
+
+    QHBoxLayout *screenshotLayout = new QHBoxLayout();
+    screenshotLayout->addWidget(pngLevelLabel);
+    screenshotLayout->addWidget(pngLevelSpinBox);
+    screenshotLayout->addWidget(jpegQualityLabel);
+    screenshotLayout->addWidget(jpegQualitySpinBox);
+
+    videoLayout->addWidget(screenshotLabel);
+    videoLayout->addWidget(screenshotFormatLabel);
+    videoLayout->addWidget(screenshotFormatBox);
+    videoLayout->addLayout(screenshotLayout);
     videoLayout->addStretch();
 
     if (m_cameraManager && m_cameraManager->getCamera()) {
@@ -201,6 +245,18 @@ QVariant VideoPage::boxValue(const QComboBox *box) const
 }
 
 void VideoPage::applyVideoSettings() {
+    QComboBox *screenshotFormatBox = this->findChild<QComboBox*>("screenshotFormatBox");
+    QSpinBox *pngLevelSpinBox = this->findChild<QSpinBox*>("pngLevelSpinBox");
+    QSpinBox *jpegQualitySpinBox = this->findChild<QSpinBox*>("jpegQualitySpinBox");
+    GlobalSetting::instance().setScreenshotSettings(screenshotFormatBox->currentData().toString(),
+                                                    pngLevelSpinBox->value(), jpegQualitySpinBox->value());
+
+    bool softwarePresenter = this->findChild<QCheckBox*>("softwarePresenterCheckBox")->isChecked();
+    GlobalSetting::instance().setSoftwarePresenter(softwarePresenter);
+    if (m_cameraManager) {
+        m_cameraManager->setSoftwarePresenter(softwarePresenter);
+    }
+
     QComboBox *fpsComboBox = this->findChild<QComboBox*>("fpsComboBox");
     int fps = fpsComboBox->currentData().toInt();
     qDebug() << "fpsComboBox current data:" << fpsComboBox->currentData();
@@ -275,6 +331,17 @@ void VideoPage::initVideoSettings() {
     if (index != -1) {
         fpsComboBox->setCurrentIndex(index);
     }
+
+    ScreenshotWriter::Options screenshotOptions = ScreenshotWriter::loadOptions();
+    QComboBox *screenshotFormatBox = this->findChild<QComboBox*>("screenshotFormatBox");
+    int formatIndex = screenshotFormatBox->findData(ScreenshotWriter::formatToString(screenshotOptions.format));
+    if (formatIndex != -1) {
+        screenshotFormatBox->setCurrentIndex(formatIndex);
+    }
+    this->findChild<QSpinBox*>("pngLevelSpinBox")->setValue(screenshotOptions.pngLevel);
+    this->findChild<QSpinBox*>("jpegQualitySpinBox")->setValue(screenshotOptions.jpegQuality);
+
+    this->findChild<QCheckBox*>("softwarePresenterCheckBox")->setChecked(GlobalSetting::instance().getSoftwarePresenter());
 }
 
 QCameraFormat VideoPage::getVideoFormat(const QSize &resolution, int desiredFrameRate, QVideoFrameFormat::PixelFormat pixelFormat) const {
@@ -21,6 +21,7 @@
 */
 
 #include "videopane.h"
+#include "videopresenter.h"
 #include "host/HostManager.h"
 #include "inputhandler.h"
 #include "../global.h"
@@ -35,6 +36,7 @@ VideoPane::VideoPane(QWidget *parent) : QVideoWidget(parent), escTimer(new QTime
 {
     qDebug() << "VideoPane init...";
     QWidget* childWidget = qobject_cast<QWidget*>(this->children()[0]);
+    m_renderWidget = childWidget;
     if(childWidget) {
         qDebug() << "Child widget:" << childWidget << "type:" << childWidget->metaObject()->className();
         childWidget->setMouseTracking(true);
@@ -95,4 +97,95 @@ void VideoPane::stopEscTimer()
     escTimer->stop();
 }
 
+void VideoPane::setSoftwarePresenter(bool enable)
+{
+    m_softwarePresenter = enable;
+    updatePresenter();
+}
+
+void VideoPane::updatePresenter()
+{
+    const bool needed = m_softwarePresenter || isZoomed();
+    if (needed && !m_presenter) {
+        m_presenter = new VideoPresenter(this);
+        m_presenter->setGeometry(rect());
+        m_presenter->setViewport(m_viewport);
+        connect(m_presenter, &VideoPresenter::statsUpdated, this, &VideoPane::presenterStatsUpdated);
+        m_presenter->show();
+        m_presenter->start();
+        if (m_renderWidget) {
+            m_renderWidget->hide();
+        }
+    } else if (!needed && m_presenter) {
+        delete m_presenter;
+        m_presenter = nullptr;
+        if (m_renderWidget) {
+            m_renderWidget->show();
+        }
+    } else if (m_presenter) {
+        m_presenter->setViewport(m_viewport);
+    }
+}
+
+void VideoPane::setZoom(double zoom, const QPointF &anchor)
+{
+    zoom = qBound(1.0, zoom, MAX_ZOOM);
+    if (zoom < 1.001) {
+        // Repeated steps in and out do not land exactly on 1
+        zoom = 1.0;
+    }
+    const QPointF source = mapToSource(anchor);
+    const double fx = width() > 0 ? anchor.x() / width() : 0.5;
+    const double fy = height() > 0 ? anchor.y() / height() : 0.5;
+    const double size = 1.0 / zoom;
+    setViewport(QRectF(source.x() - fx * size, source.y() - fy * size, size, size));
+}
+
+void VideoPane::zoomBy(double factor)
+{
+    setZoom(zoom() * factor, QPointF(width() / 2.0, height() / 2.0));
+}
+
+void VideoPane::resetZoom()
+{
+    setViewport(QRectF(0, 0, 1, 1));
+}
 
+void VideoPane::panBy(const QPointF &delta)
+{
+    if (!isZoomed() || width() <= 0 || height() <= 0) {
+        return;
+    }
+    setViewport(m_viewport.translated(delta.x() / width() * m_viewport.width(),
+                                      delta.y() / height() * m_viewport.height()));
+}
+
+QPointF VideoPane::mapToSource(const QPointF &pos) const
+{
+    if (width() <= 0 || height() <= 0) {
+        return QPointF();
+    }
+    return QPointF(m_viewport.x() + pos.x() / width() * m_viewport.width(),
+                   m_viewport.y() + pos.y() / height() * m_viewport.height());
+}
+
+void VideoPane::setViewport(QRectF viewport)
+{
+    // Keep the viewport inside the frame
+    viewport.moveLeft(qBound(0.0, viewport.x(), 1.0 - viewport.width()));
+    viewport.moveTop(qBound(0.0, viewport.y(), 1.0 - viewport.height()));
+    if (viewport == m_viewport) {
+        return;
+    }
+    m_viewport = viewport;
+    updatePresenter();
+    emit viewportChanged(m_viewport);
+}
+
+void VideoPane::resizeEvent(QResizeEvent *event)
+{
+    QVideoWidget::resizeEvent(event);
+    if (m_presenter) {
+        m_presenter->setGeometry(rect());
+    }
+}
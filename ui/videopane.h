@@ -29,6 +29,8 @@
 #include <QVideoWidget>
 #include <QMouseEvent>
 
+class VideoPresenter;
+
 
 class VideoPane : public QVideoWidget
 {
@@ -48,12 +50,45 @@ public:
     bool isRelativeModeEnabled() const { return relativeModeEnable; }
     void setRelativeModeEnabled(bool enable) { relativeModeEnable = enable; }
 
+    // Draw the frames with VideoPresenter instead of the backend renderer.
+    // The CameraManager must feed the FrameDistributor from its own sink then.
+    void setSoftwarePresenter(bool enable);
+    bool isSoftwarePresenter() const { return m_softwarePresenter; }
+
+    // Zoom keeps the pane at its size and shows a viewport of the frame,
+    // which the backend renderer cannot crop, so the VideoPresenter draws
+    // while zoomed even if the software presenter is off.
+    static constexpr double MAX_ZOOM = 16.0;
+    double zoom() const { return 1.0 / m_viewport.width(); }
+    bool isZoomed() const { return m_viewport.width() < 1.0; }
+    // The source point under anchor, in widget coordinates, stays in place
+    void setZoom(double zoom, const QPointF &anchor);
+    void zoomBy(double factor);
+    void resetZoom();
+    // Moves the viewport by a distance in widget pixels
+    void panBy(const QPointF &delta);
+    // Visible part of the frame, normalized to 0..1 on both axes
+    QRectF viewport() const { return m_viewport; }
+    // Frame position under a widget position, normalized to 0..1
+    QPointF mapToSource(const QPointF &pos) const;
+
+signals:
+    void presenterStatsUpdated(double fps, double averageUs, qint64 maxUs, double dirtyPercent);
+    void viewportChanged(const QRectF &viewport);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
 private:
     int lastX=0;
     int lastY=0;
     bool relativeModeEnable;
     
     InputHandler *m_inputHandler;
+    QWidget *m_renderWidget = nullptr;
+    VideoPresenter *m_presenter = nullptr;
+    bool m_softwarePresenter = false;
+    QRectF m_viewport{0, 0, 1, 1};
 
     QTimer *escTimer;
     bool holdingEsc=false;
@@ -61,6 +96,9 @@ private:
     MouseEventDTO* calculateRelativePosition(QMouseEvent *event);
     MouseEventDTO* calculateAbsolutePosition(QMouseEvent *event);
     MouseEventDTO* calculateMouseEventDto(QMouseEvent *event);
+
+    void setViewport(QRectF viewport);
+    void updatePresenter();
 };
 
 #endif
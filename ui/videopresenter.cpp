@@ -0,0 +1,314 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "videopresenter.h"
+#include "video/frameconverter.h"
+#include "video/framediff.h"
+#include "video/framemetrics.h"
+#include "host/mediaclock.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QRegion>
+#include <QResizeEvent>
+#include <QDebug>
+
+Q_LOGGING_CATEGORY(log_ui_presenter, "opf.ui.presenter")
+
+namespace {
+
+// Layout of the chroma planes of a planar format, false for single plane formats
+bool chromaLayout(QVideoFrameFormat::PixelFormat format, int *xFactor, int *yFactor, int *bytesPerPixel)
+{
+    switch (format) {
+    case QVideoFrameFormat::Format_NV12:
+    case QVideoFrameFormat::Format_NV21:
+        *xFactor = 2;
+        *yFactor = 2;
+        *bytesPerPixel = 2;     // Interleaved U and V
+        return true;
+    case QVideoFrameFormat::Format_YUV420P:
+    case QVideoFrameFormat::Format_YV12:
+        *xFactor = 2;
+        *yFactor = 2;
+        *bytesPerPixel = 1;
+        return true;
+    case QVideoFrameFormat::Format_YUV422P:
+        *xFactor = 2;
+        *yFactor = 1;
+        *bytesPerPixel = 1;
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+VideoPresenter::VideoPresenter(QWidget *parent)
+    : QWidget(parent)
+{
+    // Every pixel is drawn from the buffer, and the VideoPane handles the input
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setAttribute(Qt::WA_NoSystemBackground);
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+}
+
+VideoPresenter::~VideoPresenter()
+{
+    stop();
+}
+
+void VideoPresenter::start()
+{
+    if (isRunning()) {
+        return;
+    }
+    m_fullRedraw = true;
+    m_statsTimer.start();
+    m_subscription = FrameDistributor::getInstance().subscribe(this, [this](const FrameDistributor::Frame &frame) {
+        present(frame);
+    });
+    FrameMetrics::getInstance().setPresenterActive(true);
+    qCDebug(log_ui_presenter) << "Software presenter started, simd level" << Simd::levelName(Simd::bestLevel());
+}
+
+void VideoPresenter::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    FrameDistributor::getInstance().unsubscribe(m_subscription);
+    FrameMetrics::getInstance().setPresenterActive(false);
+    m_subscription = 0;
+    if (m_previous.isMapped()) {
+        m_previous.unmap();
+    }
+    m_previous = QVideoFrame();
+}
+
+bool VideoPresenter::ensureBuffer()
+{
+    const qreal dpr = devicePixelRatioF();
+    const QSize target = (QSizeF(size()) * dpr).toSize();
+    if (target.isEmpty()) {
+        return false;
+    }
+    if (m_buffer.size() != target) {
+        m_buffer = QImage(target, QImage::Format_RGB32);
+        m_buffer.fill(Qt::black);
+        m_fullRedraw = true;
+    }
+    m_buffer.setDevicePixelRatio(dpr);
+    return true;
+}
+
+void VideoPresenter::setViewport(const QRectF &viewport)
+{
+    if (viewport == m_viewport) {
+        return;
+    }
+    m_viewport = viewport;
+    m_fullRedraw = true;
+    if (isRunning()) {
+        present(FrameDistributor::getInstance().latestFrame());
+    }
+}
+
+QRect VideoPresenter::cropFor(const QSize &source) const
+{
+    return QRectF(m_viewport.x() * source.width(), m_viewport.y() * source.height(),
+                  m_viewport.width() * source.width(), m_viewport.height() * source.height()).toRect();
+}
+
+QRect VideoPresenter::toWidget(const QRect &bufferRect) const
+{
+    const qreal dpr = m_buffer.devicePixelRatio();
+    return QRectF(bufferRect.x() / dpr, bufferRect.y() / dpr,
+                  bufferRect.width() / dpr, bufferRect.height() / dpr).toAlignedRect();
+}
+
+void VideoPresenter::present(const FrameDistributor::Frame &frame)
+{
+    if (!frame.isValid() || !ensureBuffer()) {
+        return;
+    }
+
+    QVideoFrame current(frame.frame);
+    if (!FrameScaler::isSupported(current.pixelFormat())) {
+        presentConverted(current, frame.sequence);
+        return;
+    }
+    if (!current.map(QVideoFrame::ReadOnly)) {
+        qCWarning(log_ui_presenter) << "Failed to map frame" << frame.sequence;
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    m_scaler.setGeometry(current.size(), m_buffer.size(), cropFor(current.size()));
+
+    const bool comparable = m_previous.isMapped() && m_previous.size() == current.size()
+                            && m_previous.pixelFormat() == current.pixelFormat();
+    QVector<QRect> targets;
+    if (m_fullRedraw || !comparable) {
+        targets.append(m_buffer.rect());
+    } else {
+        // No noise floor, any changed byte has to reach the screen
+        FrameDiffResult diff = FrameDiff::compare(m_previous.bits(0), m_previous.bytesPerLine(0),
+                                                  current.bits(0), current.bytesPerLine(0),
+                                                  current.width(), current.height(),
+                                                  FrameDiff::bytesPerPixelOfPlane0(current.pixelFormat()),
+                                                  TILE_SIZE, 0.0);
+        QRegion changed;
+        for (const QRect &region : diff.regions) {
+            changed += region;
+        }
+        // A change of colour alone only shows in the chroma planes
+        int xFactor, yFactor, chromaBytes;
+        if (chromaLayout(current.pixelFormat(), &xFactor, &yFactor, &chromaBytes)) {
+            const QRect bounds(QPoint(0, 0), current.size());
+            const int chromaWidth = (current.width() + xFactor - 1) / xFactor;
+            const int chromaHeight = (current.height() + yFactor - 1) / yFactor;
+            for (int plane = 1; plane < current.planeCount(); plane++) {
+                FrameDiffResult chroma = FrameDiff::compare(m_previous.bits(plane), m_previous.bytesPerLine(plane),
+                                                            current.bits(plane), current.bytesPerLine(plane),
+                                                            chromaWidth, chromaHeight, chromaBytes,
+                                                            TILE_SIZE / 2, 0.0);
+                for (const QRect &region : chroma.regions) {
+                    changed += QRect(region.x() * xFactor, region.y() * yFactor,
+                                     region.width() * xFactor, region.height() * yFactor).intersected(bounds);
+                }
+            }
+        }
+        for (const QRect &region : changed) {
+            // Changes outside a zoomed viewport map to nothing
+            const QRect target = m_scaler.targetRectFor(region);
+            if (!target.isEmpty()) {
+                targets.append(target);
+            }
+        }
+    }
+
+    qint64 dirtyPixels = 0;
+    for (const QRect &target : targets) {
+        m_scaler.convert(current, target, &m_buffer);
+        update(toWidget(target));
+        dirtyPixels += qint64(target.width()) * target.height();
+    }
+    m_fullRedraw = false;
+    qint64 elapsedNs = timer.nsecsElapsed();
+    record(elapsedNs, dirtyPixels);
+    if (targets.isEmpty()) {
+        // Nothing changed, the screen already shows this frame
+        FrameMetrics::getInstance().framePresented(frame.sequence, MediaClock::nowUs(), elapsedNs / 1000);
+    } else {
+        m_pendingSequence = frame.sequence;
+        m_pendingDrawUs = elapsedNs / 1000;
+    }
+
+    if (m_previous.isMapped()) {
+        m_previous.unmap();
+    }
+    m_previous = current;
+}
+
+void VideoPresenter::presentConverted(const QVideoFrame &frame, quint64 sequence)
+{
+    // Compressed frames go through Qt's conversion and a smooth scale
+    QElapsedTimer timer;
+    timer.start();
+    QImage image = FrameConverter::toImage(frame);
+    if (image.isNull()) {
+        return;
+    }
+    QPainter painter(&m_buffer);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage(QRectF(QPointF(0, 0), QSizeF(size())), image, cropFor(image.size()));
+    painter.end();
+    update();
+    if (m_previous.isMapped()) {
+        m_previous.unmap();
+    }
+    m_previous = QVideoFrame();
+    qint64 elapsedNs = timer.nsecsElapsed();
+    record(elapsedNs, qint64(m_buffer.width()) * m_buffer.height());
+    m_pendingSequence = sequence;
+    m_pendingDrawUs = elapsedNs / 1000;
+}
+
+void VideoPresenter::record(qint64 elapsedNs, qint64 dirtyPixels)
+{
+    m_statsFrames++;
+    m_statsTotalNs += elapsedNs;
+    m_statsMaxNs = qMax(m_statsMaxNs, elapsedNs);
+    m_statsDirtyPixels += dirtyPixels;
+
+    qint64 elapsedMs = m_statsTimer.elapsed();
+    if (elapsedMs < 1000) {
+        return;
+    }
+    const double fps = m_statsFrames * 1000.0 / elapsedMs;
+    const double averageUs = m_statsTotalNs / 1000.0 / m_statsFrames;
+    const double dirtyPercent = 100.0 * m_statsDirtyPixels
+                                / (double(m_statsFrames) * m_buffer.width() * m_buffer.height());
+    qCDebug(log_ui_presenter).noquote() << QString("%1 fps, %2 us average, %3 us max, %4% redrawn")
+                                               .arg(fps, 0, 'f', 1)
+                                               .arg(averageUs, 0, 'f', 0)
+                                               .arg(m_statsMaxNs / 1000)
+                                               .arg(dirtyPercent, 0, 'f', 1);
+    emit statsUpdated(fps, averageUs, m_statsMaxNs / 1000, dirtyPercent);
+
+    m_statsTimer.restart();
+    m_statsFrames = 0;
+    m_statsTotalNs = 0;
+    m_statsMaxNs = 0;
+    m_statsDirtyPixels = 0;
+}
+
+void VideoPresenter::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    if (m_buffer.isNull()) {
+        painter.fillRect(event->rect(), Qt::black);
+        return;
+    }
+    // The buffer has the widget's device pixel size, so this is a plain copy
+    const QRect rect = event->rect();
+    const qreal dpr = m_buffer.devicePixelRatio();
+    painter.drawImage(rect, m_buffer, QRectF(rect.x() * dpr, rect.y() * dpr, rect.width() * dpr, rect.height() * dpr));
+
+    if (m_pendingSequence) {
+        FrameMetrics::getInstance().framePresented(m_pendingSequence, MediaClock::nowUs(), m_pendingDrawUs);
+        m_pendingSequence = 0;
+    }
+}
+
+void VideoPresenter::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    m_fullRedraw = true;
+    if (isRunning()) {
+        // Redraw right away rather than stretching the old buffer until the next frame
+        present(FrameDistributor::getInstance().latestFrame());
+    }
+}
@@ -0,0 +1,105 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef VIDEOPRESENTER_H
+#define VIDEOPRESENTER_H
+
+#include <QWidget>
+#include <QImage>
+#include <QElapsedTimer>
+#include <QVideoFrame>
+#include <QLoggingCategory>
+
+#include "video/framedistributor.h"
+#include "video/framescaler.h"
+
+Q_DECLARE_LOGGING_CATEGORY(log_ui_presenter)
+
+/*
+ * Draws the captured frames without the multimedia backend's renderer.
+ *
+ * Every frame is compared in tiles with the one before it, and only the
+ * target areas of changed tiles are converted and scaled into a buffer of
+ * the widget's device pixel size, then repainted. A static desktop costs the
+ * tile comparison and nothing else. Planar formats are compared on their
+ * chroma planes too, so a change of colour alone is redrawn. The buffer is
+ * redrawn completely on resize, on viewport changes and on format changes.
+ *
+ * The widget covers the VideoPane and lets mouse events through, so the
+ * input mapping is the same as with the backend renderer. When the pane is
+ * zoomed only its viewport of the frame is converted, so the cost depends
+ * on the widget size and not on the zoom level.
+ */
+class VideoPresenter : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit VideoPresenter(QWidget *parent = nullptr);
+    ~VideoPresenter();
+
+    void start();
+    void stop();
+    bool isRunning() const { return m_subscription != 0; }
+
+    // Part of the frame to show, normalized to 0..1 on both axes
+    void setViewport(const QRectF &viewport);
+    QRectF viewport() const { return m_viewport; }
+
+signals:
+    // Once a second while frames arrive. The times cover the tile comparison,
+    // conversion and scaling of one presented frame.
+    void statsUpdated(double fps, double averageUs, qint64 maxUs, double dirtyPercent);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    static const int TILE_SIZE = 32;
+
+    void present(const FrameDistributor::Frame &frame);
+    void presentConverted(const QVideoFrame &frame, quint64 sequence);
+    bool ensureBuffer();
+    QRect toWidget(const QRect &bufferRect) const;
+    QRect cropFor(const QSize &source) const;
+    void record(qint64 elapsedNs, qint64 dirtyPixels);
+
+    int m_subscription = 0;
+    FrameScaler m_scaler;
+    QImage m_buffer;
+    QRectF m_viewport{0, 0, 1, 1};
+    // Stays mapped until the next frame has been compared against it
+    QVideoFrame m_previous;
+    bool m_fullRedraw = true;
+    // Frame waiting for the paint that puts it on screen
+    quint64 m_pendingSequence = 0;
+    qint64 m_pendingDrawUs = 0;
+
+    QElapsedTimer m_statsTimer;
+    int m_statsFrames = 0;
+    qint64 m_statsTotalNs = 0;
+    qint64 m_statsMaxNs = 0;
+    qint64 m_statsDirtyPixels = 0;
+};
+
+#endif // VIDEOPRESENTER_H
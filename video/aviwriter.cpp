@@ -0,0 +1,214 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "aviwriter.h"
+
+#include <QtEndian>
+#include <cmath>
+
+namespace {
+
+const quint32 AVIF_HASINDEX = 0x10;
+const quint32 AVIIF_KEYFRAME = 0x10;
+const quint32 HEADER_BYTES = 224;
+// Chunk header of a frame and its idx1 entry
+const qint64 FRAME_OVERHEAD_BYTES = 8 + 16;
+
+void putFourcc(QByteArray &data, const char *fourcc)
+{
+    data.append(fourcc, 4);
+}
+
+void put32(QByteArray &data, quint32 value)
+{
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    data.append(bytes, 4);
+}
+
+void put16(QByteArray &data, quint16 value)
+{
+    char bytes[2];
+    qToLittleEndian(value, bytes);
+    data.append(bytes, 2);
+}
+
+} // namespace
+
+AviWriter::~AviWriter()
+{
+    if (m_file.isOpen()) {
+        close(0);
+    }
+}
+
+bool AviWriter::open(const QString &path, const QSize &size)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    m_size = size;
+    m_moviSize = 4;
+    m_maxFrameBytes = 0;
+    m_index.clear();
+    QByteArray placeholder = header(0);
+    return m_file.write(placeholder) == placeholder.size();
+}
+
+bool AviWriter::canAdd(qint64 jpegBytes) const
+{
+    const qint64 written = HEADER_BYTES + (m_moviSize - 4) + 8 + qint64(m_index.size()) * 16;
+    return written + FRAME_OVERHEAD_BYTES + jpegBytes + (jpegBytes & 1) <= MAX_FILE_BYTES;
+}
+
+qint64 AviWriter::fileSize(int frames, qint64 jpegBytes)
+{
+    return HEADER_BYTES + 8 + qint64(frames) * (FRAME_OVERHEAD_BYTES + 1) + jpegBytes;
+}
+
+bool AviWriter::addFrame(const QByteArray &jpeg)
+{
+    if (!canAdd(jpeg.size())) {
+        return false;
+    }
+    QByteArray chunk;
+    chunk.reserve(jpeg.size() + 9);
+    putFourcc(chunk, "00dc");
+    put32(chunk, static_cast<quint32>(jpeg.size()));
+    chunk.append(jpeg);
+    if (jpeg.size() & 1) {
+        chunk.append('\0');
+    }
+    if (m_file.write(chunk) != chunk.size()) {
+        return false;
+    }
+    m_index.append(qMakePair(m_moviSize, static_cast<quint32>(jpeg.size())));
+    m_moviSize += static_cast<quint32>(chunk.size());
+    m_maxFrameBytes = qMax(m_maxFrameBytes, static_cast<quint32>(jpeg.size()));
+    return true;
+}
+
+bool AviWriter::close(double fps)
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    QByteArray index;
+    index.reserve(8 + m_index.size() * 16);
+    putFourcc(index, "idx1");
+    put32(index, static_cast<quint32>(m_index.size() * 16));
+    for (const auto &entry : m_index) {
+        putFourcc(index, "00dc");
+        put32(index, AVIIF_KEYFRAME);
+        put32(index, entry.first);
+        put32(index, entry.second);
+    }
+    bool ok = m_file.write(index) == index.size();
+    ok = ok && m_file.seek(0);
+    QByteArray finalHeader = header(fps);
+    ok = ok && m_file.write(finalHeader) == finalHeader.size();
+    m_file.close();
+    return ok;
+}
+
+QByteArray AviWriter::header(double fps) const
+{
+    if (fps <= 0) {
+        fps = 30;
+    }
+    const quint32 rateScale = 1000;
+    const quint32 rate = static_cast<quint32>(std::lround(fps * rateScale));
+    const quint32 frames = static_cast<quint32>(m_index.size());
+    const quint32 idxSize = 8 + frames * 16;
+    const quint32 headerSize = HEADER_BYTES;
+
+    QByteArray data;
+    data.reserve(headerSize);
+    putFourcc(data, "RIFF");
+    put32(data, headerSize - 8 + m_moviSize - 4 + idxSize);
+    putFourcc(data, "AVI ");
+
+    putFourcc(data, "LIST");
+    put32(data, 192);
+    putFourcc(data, "hdrl");
+
+    putFourcc(data, "avih");
+    put32(data, 56);
+    put32(data, static_cast<quint32>(std::lround(1000000.0 / fps)));   // dwMicroSecPerFrame
+    put32(data, static_cast<quint32>(m_maxFrameBytes * fps));         // dwMaxBytesPerSec
+    put32(data, 0);                                                    // dwPaddingGranularity
+    put32(data, AVIF_HASINDEX);
+    put32(data, frames);
+    put32(data, 0);                                                    // dwInitialFrames
+    put32(data, 1);                                                    // dwStreams
+    put32(data, m_maxFrameBytes);
+    put32(data, static_cast<quint32>(m_size.width()));
+    put32(data, static_cast<quint32>(m_size.height()));
+    for (int i = 0; i < 4; i++) {
+        put32(data, 0);
+    }
+
+    putFourcc(data, "LIST");
+    put32(data, 116);
+    putFourcc(data, "strl");
+
+    putFourcc(data, "strh");
+    put32(data, 56);
+    putFourcc(data, "vids");
+    putFourcc(data, "MJPG");
+    put32(data, 0);                                                    // dwFlags
+    put16(data, 0);                                                    // wPriority
+    put16(data, 0);                                                    // wLanguage
+    put32(data, 0);                                                    // dwInitialFrames
+    put32(data, rateScale);
+    put32(data, rate);
+    put32(data, 0);                                                    // dwStart
+    put32(data, frames);
+    put32(data, m_maxFrameBytes);
+    put32(data, 0xFFFFFFFF);                                           // dwQuality, default
+    put32(data, 0);                                                    // dwSampleSize
+    put16(data, 0);
+    put16(data, 0);
+    put16(data, static_cast<quint16>(m_size.width()));
+    put16(data, static_cast<quint16>(m_size.height()));
+
+    putFourcc(data, "strf");
+    put32(data, 40);
+    put32(data, 40);                                                   // biSize
+    put32(data, static_cast<quint32>(m_size.width()));
+    put32(data, static_cast<quint32>(m_size.height()));
+    put16(data, 1);                                                    // biPlanes
+    put16(data, 24);                                                   // biBitCount
+    putFourcc(data, "MJPG");
+    put32(data, static_cast<quint32>(m_size.width() * m_size.height() * 3));
+    for (int i = 0; i < 4; i++) {
+        put32(data, 0);
+    }
+
+    putFourcc(data, "LIST");
+    put32(data, m_moviSize);
+    putFourcc(data, "movi");
+
+    Q_ASSERT(data.size() == static_cast<int>(headerSize));
+    return data;
+}
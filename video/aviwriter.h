@@ -0,0 +1,72 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef AVIWRITER_H
+#define AVIWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+/*
+ * Minimal AVI 1.0 writer for a single MJPEG video stream.
+ *
+ * The header is written with placeholder values on open() and rewritten in
+ * place on close(), when the frame count and the frame rate are known.
+ * AVI 1.0 is limited to 1 GB, addFrame() refuses a frame that would take the
+ * file, index included, past MAX_FILE_BYTES.
+ */
+class AviWriter
+{
+public:
+    static const qint64 MAX_FILE_BYTES = 1LL << 30;
+
+    ~AviWriter();
+
+    bool open(const QString &path, const QSize &size);
+    bool addFrame(const QByteArray &jpeg);
+    // Whether a frame of jpegBytes still fits below MAX_FILE_BYTES
+    bool canAdd(qint64 jpegBytes) const;
+    // Size of a closed file of frames totalling jpegBytes, at most a byte per frame high
+    static qint64 fileSize(int frames, qint64 jpegBytes);
+    // fps is the average rate of the written frames
+    bool close(double fps);
+
+    bool isOpen() const { return m_file.isOpen(); }
+    int frameCount() const { return m_index.size(); }
+    qint64 size() const { return m_file.size(); }
+    QString fileName() const { return m_file.fileName(); }
+    QString errorString() const { return m_file.errorString(); }
+
+private:
+    QByteArray header(double fps) const;
+
+    QFile m_file;
+    QSize m_size;
+    quint32 m_moviSize = 4;     // The 'movi' fourcc
+    quint32 m_maxFrameBytes = 0;
+    QVector<QPair<quint32, quint32>> m_index;   // Offset from 'movi' and size of every frame
+};
+
+#endif // AVIWRITER_H
@@ -0,0 +1,49 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef EEPROMACCESS_H
+#define EEPROMACCESS_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+/*
+ * Register level access to the capture chip EEPROM.
+ * VideoHid implements it over the HID feature reports, EepromSimulator
+ * implements it in memory to exercise FirmwareTransfer.
+ */
+class EepromAccess
+{
+public:
+    virtual ~EepromAccess() = default;
+
+    // Read 4 bytes starting from address into data
+    virtual bool eepromRead4Byte(quint16 address, QByteArray &data) = 0;
+    // Write up to 4 bytes starting from address
+    virtual bool eepromWrite4Byte(quint16 address, const QByteArray &data) = 0;
+
+    // Keep the device open for the duration of a bulk transfer
+    virtual bool beginTransfer() { return true; }
+    virtual void endTransfer() {}
+};
+
+#endif // EEPROMACCESS_H
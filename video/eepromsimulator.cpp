@@ -0,0 +1,181 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "eepromsimulator.h"
+#include "firmwaretransfer.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+
+EepromSimulator::EepromSimulator(quint32 size)
+    : m_image(static_cast<int>(size), char(0xFF))
+{
+}
+
+void EepromSimulator::resetCounters()
+{
+    m_reads = 0;
+    m_writes = 0;
+    m_failures = 0;
+}
+
+bool EepromSimulator::fails()
+{
+    m_requests++;
+    if ((m_unplugged && m_requests > m_failAfter) || (m_failEvery > 0 && m_requests % m_failEvery == 0)) {
+        m_failures++;
+        return true;
+    }
+    return false;
+}
+
+bool EepromSimulator::eepromRead4Byte(quint16 address, QByteArray &data)
+{
+    if (fails()) {
+        return false;
+    }
+    m_reads++;
+    data = m_image.mid(address, MS2109_TRANSFER_BYTES);
+    // Past the end reads as erased
+    data.append(QByteArray(MS2109_TRANSFER_BYTES - data.size(), char(0xFF)));
+    if (m_corruptAddress >= address && m_corruptAddress < address + MS2109_TRANSFER_BYTES) {
+        data[m_corruptAddress - address] = char(data[m_corruptAddress - address] ^ 0x01);
+        m_corruptAddress = -1;
+    }
+    return true;
+}
+
+bool EepromSimulator::eepromWrite4Byte(quint16 address, const QByteArray &data)
+{
+    if (fails()) {
+        return false;
+    }
+    m_writes++;
+    for (int i = 0; i < qMin<int>(data.size(), MS2109_TRANSFER_BYTES) && address + i < m_image.size(); i++) {
+        m_image[address + i] = data[i];
+    }
+    return true;
+}
+
+namespace {
+
+QByteArray randomImage(quint32 seed)
+{
+    QRandomGenerator random(seed);
+    QByteArray image(static_cast<int>(MS2109_EEPROM_SIZE), Qt::Uninitialized);
+    random.fillRange(reinterpret_cast<quint32 *>(image.data()), image.size() / int(sizeof(quint32)));
+    return image;
+}
+
+// Runs the transfer on this thread, finished() is delivered directly
+bool transfer(EepromSimulator &device, FirmwareTransfer::Direction direction, const QString &path)
+{
+    FirmwareTransfer transfer(&device);
+    if (direction == FirmwareTransfer::Direction::Read) {
+        transfer.setReadJob(path, quint32(device.image().size()));
+    } else {
+        transfer.setWriteJob(path);
+    }
+    bool success = false;
+    QObject::connect(&transfer, &FirmwareTransfer::finished, [&success](bool ok, const QString &, quint32) {
+        success = ok;
+    });
+    transfer.process();
+    return success;
+}
+
+void report(const QString &name, const EepromSimulator &device, const QElapsedTimer &timer, bool expected)
+{
+    qInfo().noquote() << QString("firmware %1: %2 ms, %3 reads, %4 writes, %5 failures injected, %6")
+                             .arg(name, -12)
+                             .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 1)
+                             .arg(device.reads())
+                             .arg(device.writes())
+                             .arg(device.failures())
+                             .arg(expected ? "ok" : "UNEXPECTED");
+}
+
+}
+
+void EepromSimulator::runBenchmark()
+{
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        qWarning() << "firmware: no temporary directory";
+        return;
+    }
+    const QString imagePath = dir.filePath("image.bin");
+    const QString dumpPath = dir.filePath("dump.bin");
+    const QByteArray image = randomImage(1);
+    QFile file(imagePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(image) != image.size()) {
+        qWarning() << "firmware: could not write" << imagePath;
+        return;
+    }
+    file.close();
+
+    EepromSimulator device;
+    device.image() = randomImage(2);
+    QElapsedTimer timer;
+
+    // Every 7th request fails, the per request retries cover it
+    device.setFailEvery(7);
+    timer.start();
+    bool ok = transfer(device, FirmwareTransfer::Direction::Write, imagePath);
+    report("flash", device, timer, ok && device.image() == image);
+
+    // Nothing differs, so nothing is written
+    device.setFailEvery(0);
+    device.resetCounters();
+    timer.start();
+    ok = transfer(device, FirmwareTransfer::Direction::Write, imagePath);
+    report("reflash", device, timer, ok && device.writes() == 0);
+
+    // The device goes away halfway through the dump, the next run resumes from the last whole block
+    device.resetCounters();
+    device.setFailAfter(int(MS2109_EEPROM_SIZE) / MS2109_TRANSFER_BYTES / 2);
+    timer.start();
+    ok = transfer(device, FirmwareTransfer::Direction::Read, dumpPath);
+    report("dump cut", device, timer, !ok && QFile::exists(dumpPath + ".part"));
+
+    device.setFailAfter(-1);
+    device.resetCounters();
+    timer.start();
+    ok = transfer(device, FirmwareTransfer::Direction::Read, dumpPath);
+    QFile dump(dumpPath);
+    const bool same = dump.open(QIODevice::ReadOnly) && dump.readAll() == image;
+    dump.close();
+    // A dump from the start reads the image twice, once to verify
+    const int fullReads = 2 * int(MS2109_EEPROM_SIZE) / MS2109_TRANSFER_BYTES;
+    report("dump resume", device, timer, ok && same && device.reads() < fullReads);
+
+    // One flipped bit on the first pass is caught by the verification pass
+    QFile::remove(dumpPath);
+    device.resetCounters();
+    device.corruptNextRead(0x1234);
+    timer.start();
+    ok = transfer(device, FirmwareTransfer::Direction::Read, dumpPath);
+    report("dump corrupt", device, timer, !ok && !QFile::exists(dumpPath));
+}
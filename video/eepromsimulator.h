@@ -0,0 +1,75 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef EEPROMSIMULATOR_H
+#define EEPROMSIMULATOR_H
+
+#include "eepromaccess.h"
+#include "ms2109.h"
+
+/*
+ * EEPROM held in memory, for driving FirmwareTransfer without a capture card.
+ * Failures can be injected to exercise the retry, resume and verification
+ * paths: requests failing now and then, the device going away after a number
+ * of requests, and a read returning a flipped bit once.
+ */
+class EepromSimulator : public EepromAccess
+{
+public:
+    explicit EepromSimulator(quint32 size = MS2109_EEPROM_SIZE);
+
+    QByteArray &image() { return m_image; }
+    const QByteArray &image() const { return m_image; }
+
+    // Every n-th request fails, 0 never
+    void setFailEvery(int requests) { m_failEvery = requests; }
+    // Every request after the next n fails, as if the device was unplugged. -1 never.
+    void setFailAfter(int requests) { m_failAfter = m_requests + requests; m_unplugged = requests >= 0; }
+    // The next read covering address returns it with the lowest bit flipped
+    void corruptNextRead(quint16 address) { m_corruptAddress = address; }
+
+    int reads() const { return m_reads; }
+    int writes() const { return m_writes; }
+    int failures() const { return m_failures; }
+    void resetCounters();
+
+    bool eepromRead4Byte(quint16 address, QByteArray &data) override;
+    bool eepromWrite4Byte(quint16 address, const QByteArray &data) override;
+
+    // Dumps and flashes a 64KiB image with injected failures, prints the time and whether each case behaved
+    static void runBenchmark();
+
+private:
+    bool fails();
+
+    QByteArray m_image;
+    int m_failEvery = 0;
+    int m_failAfter = 0;
+    bool m_unplugged = false;
+    int m_corruptAddress = -1;
+    int m_requests = 0;
+    int m_reads = 0;
+    int m_writes = 0;
+    int m_failures = 0;
+};
+
+#endif // EEPROMSIMULATOR_H
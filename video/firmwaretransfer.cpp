@@ -0,0 +1,321 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "firmwaretransfer.h"
+#include "ms2109.h"
+
+#include <QFile>
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+Q_LOGGING_CATEGORY(log_core_firmware, "opf.core.firmware")
+
+FirmwareTransfer::FirmwareTransfer(EepromAccess *access, QObject *parent)
+    : QObject(parent), m_access(access)
+{
+}
+
+void FirmwareTransfer::setReadJob(const QString &filePath, quint32 size, quint16 address)
+{
+    m_direction = Direction::Read;
+    m_filePath = filePath;
+    m_size = size;
+    m_address = address;
+}
+
+void FirmwareTransfer::setWriteJob(const QString &filePath, quint16 address)
+{
+    m_direction = Direction::Write;
+    m_filePath = filePath;
+    m_size = 0; // Taken from the image file
+    m_address = address;
+}
+
+quint32 FirmwareTransfer::crc32(const QByteArray &data, quint32 crc)
+{
+    static const std::array<quint32, 256> table = [] {
+        std::array<quint32, 256> t{};
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (char byte : data) {
+        crc = table[(crc ^ static_cast<quint8>(byte)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void FirmwareTransfer::process()
+{
+    m_cancelled = false;
+    QString message;
+    quint32 crc = 0;
+
+    if (!m_access || !m_access->beginTransfer()) {
+        emit finished(false, tr("Failed to open the capture device"), 0);
+        return;
+    }
+
+    bool success = m_direction == Direction::Read ? readImage(message, crc) : writeImage(message, crc);
+    m_access->endTransfer();
+
+    if (success) {
+        qCDebug(log_core_firmware) << message;
+    } else {
+        qCWarning(log_core_firmware) << message;
+    }
+    emit finished(success, message, crc);
+}
+
+/*
+ * Read one block, every 4 byte request is retried on its own so a single
+ * failed report does not restart the whole block
+ */
+bool FirmwareTransfer::readBlock(quint32 offset, int length, QByteArray &block)
+{
+    block.resize(length);
+    QByteArray data;
+    for (int i = 0; i < length; i += MS2109_TRANSFER_BYTES) {
+        quint16 address = static_cast<quint16>(m_address + offset + i);
+        int attempt = 0;
+        while (!m_access->eepromRead4Byte(address, data)) {
+            if (++attempt > m_maxRetries) {
+                qCWarning(log_core_firmware) << "Read failed at address" << Qt::hex << address;
+                return false;
+            }
+        }
+        memcpy(block.data() + i, data.constData(), std::min({static_cast<int>(data.size()), MS2109_TRANSFER_BYTES, length - i}));
+    }
+    return true;
+}
+
+/*
+ * Write the chunks of a block that differ from the current device content
+ */
+bool FirmwareTransfer::writeBlock(quint32 offset, const QByteArray &block, const QByteArray &current)
+{
+    for (int i = 0; i < block.size(); i += MS2109_TRANSFER_BYTES) {
+        QByteArray chunk = block.mid(i, MS2109_TRANSFER_BYTES);
+        if (chunk == current.mid(i, MS2109_TRANSFER_BYTES)) {
+            continue;
+        }
+
+        quint16 address = static_cast<quint16>(m_address + offset + i);
+        if (chunk.size() < MS2109_TRANSFER_BYTES) {
+            // The last chunk of an odd sized image keeps the bytes that follow it
+            QByteArray tail;
+            if (!m_access->eepromRead4Byte(address, tail)) {
+                return false;
+            }
+            chunk.append(tail.mid(chunk.size()));
+        }
+
+        int attempt = 0;
+        while (!m_access->eepromWrite4Byte(address, chunk)) {
+            if (++attempt > m_maxRetries) {
+                qCWarning(log_core_firmware) << "Write failed at address" << Qt::hex << address;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool FirmwareTransfer::readRange(quint32 size, QByteArray &image, qint64 progressBase, qint64 progressTotal)
+{
+    image.clear();
+    image.reserve(size);
+    QByteArray block;
+    for (quint32 done = 0; done < size; done += BLOCK_SIZE) {
+        if (m_cancelled) {
+            return false;
+        }
+        int length = static_cast<int>(qMin<quint32>(BLOCK_SIZE, size - done));
+        if (!readBlock(done, length, block)) {
+            return false;
+        }
+        image.append(block);
+        emit progress(progressBase + done + length, progressTotal);
+    }
+    return true;
+}
+
+bool FirmwareTransfer::readImage(QString &message, quint32 &crc)
+{
+    if (m_size == 0 || m_address + m_size > MS2109_EEPROM_SIZE) {
+        message = tr("Invalid read range");
+        return false;
+    }
+
+    QString partPath = m_filePath + ".part";
+    QFile part(partPath);
+    if (!part.open(QIODevice::ReadWrite)) {
+        message = tr("Failed to open %1").arg(partPath);
+        return false;
+    }
+
+    // Only whole blocks of a previous run are trusted
+    quint32 done = static_cast<quint32>(part.size()) / BLOCK_SIZE * BLOCK_SIZE;
+    if (done > m_size) {
+        done = 0;
+    }
+    part.resize(done);
+    part.seek(done);
+    if (done > 0) {
+        qCDebug(log_core_firmware) << "Resuming dump at offset" << done;
+    }
+
+    qint64 total = m_verify ? 2 * qint64(m_size) : qint64(m_size);
+    emit progress(done, total);
+
+    QByteArray block;
+    while (done < m_size) {
+        if (m_cancelled) {
+            message = tr("Cancelled at offset %1, run again to resume").arg(done);
+            return false;
+        }
+        int length = static_cast<int>(qMin<quint32>(BLOCK_SIZE, m_size - done));
+        if (!readBlock(done, length, block)) {
+            message = tr("Read failed at offset %1").arg(done);
+            return false;
+        }
+        if (part.write(block) != length) {
+            message = tr("Failed to write %1").arg(partPath);
+            return false;
+        }
+        done += length;
+        emit progress(done, total);
+    }
+
+    part.flush();
+    part.seek(0);
+    QByteArray image = part.readAll();
+    part.close();
+    crc = crc32(image);
+
+    if (m_verify) {
+        QByteArray device;
+        if (!readRange(m_size, device, m_size, total)) {
+            message = m_cancelled ? tr("Cancelled during verification") : tr("Verification read failed");
+            return false;
+        }
+        if (crc32(device) != crc) {
+            QFile::remove(partPath);
+            message = tr("Verification failed, the device returned different data on the second pass");
+            return false;
+        }
+    }
+
+    QFile::remove(m_filePath);
+    if (!QFile::rename(partPath, m_filePath)) {
+        message = tr("Failed to rename %1").arg(partPath);
+        return false;
+    }
+
+    message = tr("Read %1 bytes, CRC32 %2").arg(m_size).arg(crc, 8, 16, QChar('0'));
+    return true;
+}
+
+bool FirmwareTransfer::writeImage(QString &message, quint32 &crc)
+{
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        message = tr("Failed to open %1").arg(m_filePath);
+        return false;
+    }
+    QByteArray image = file.readAll();
+    file.close();
+
+    if (image.isEmpty() || m_address + quint32(image.size()) > MS2109_EEPROM_SIZE) {
+        message = tr("Image does not fit the EEPROM");
+        return false;
+    }
+    m_size = static_cast<quint32>(image.size());
+    crc = crc32(image);
+
+    qint64 total = m_verify ? 2 * qint64(m_size) : qint64(m_size);
+    emit progress(0, total);
+
+    int blocksWritten = 0;
+    QByteArray current;
+    for (quint32 done = 0; done < m_size; done += BLOCK_SIZE) {
+        if (m_cancelled) {
+            message = tr("Cancelled at offset %1, run again to resume").arg(done);
+            return false;
+        }
+
+        int length = static_cast<int>(qMin<quint32>(BLOCK_SIZE, m_size - done));
+        QByteArray block = image.mid(done, length);
+        bool wrote = false;
+        for (int attempt = 0; ; attempt++) {
+            if (!readBlock(done, length, current)) {
+                message = tr("Read failed at offset %1").arg(done);
+                return false;
+            }
+            if (current == block) {
+                break;
+            }
+            if (attempt > m_maxRetries) {
+                message = tr("Block at offset %1 does not verify after %2 attempts").arg(done).arg(attempt);
+                return false;
+            }
+            if (!writeBlock(done, block, current)) {
+                message = tr("Write failed at offset %1").arg(done);
+                return false;
+            }
+            wrote = true;
+        }
+        if (wrote) {
+            blocksWritten++;
+        }
+        emit progress(done + length, total);
+    }
+
+    if (m_verify) {
+        QByteArray device;
+        if (!readRange(m_size, device, m_size, total)) {
+            message = m_cancelled ? tr("Cancelled during verification") : tr("Verification read failed");
+            return false;
+        }
+        if (crc32(device) != crc) {
+            message = tr("Verification failed, device CRC32 %1 expected %2")
+                          .arg(crc32(device), 8, 16, QChar('0'))
+                          .arg(crc, 8, 16, QChar('0'));
+            return false;
+        }
+    }
+
+    message = tr("Wrote %1 of %2 blocks, CRC32 %3")
+                  .arg(blocksWritten)
+                  .arg((m_size + BLOCK_SIZE - 1) / BLOCK_SIZE)
+                  .arg(crc, 8, 16, QChar('0'));
+    return true;
+}
@@ -0,0 +1,94 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef FIRMWARETRANSFER_H
+#define FIRMWARETRANSFER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QLoggingCategory>
+#include <atomic>
+
+#include "eepromaccess.h"
+
+Q_DECLARE_LOGGING_CATEGORY(log_core_firmware)
+
+/*
+ * Dumps or flashes the capture chip EEPROM image in blocks.
+ *
+ * Meant to be moved to a worker thread and started through process().
+ * A dump is written to "<file>.part" and renamed once complete, so an
+ * interrupted dump resumes from the last finished block. A flash compares
+ * every block with the device before writing it, so re-running an
+ * interrupted flash only writes what is still different.
+ */
+class FirmwareTransfer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Direction {
+        Read,
+        Write
+    };
+
+    static const int BLOCK_SIZE = 256;
+    static const int DEFAULT_RETRIES = 3;
+
+    explicit FirmwareTransfer(EepromAccess *access, QObject *parent = nullptr);
+
+    void setReadJob(const QString &filePath, quint32 size, quint16 address = 0);
+    void setWriteJob(const QString &filePath, quint16 address = 0);
+    void setMaxRetries(int retries) { m_maxRetries = retries; }
+    void setVerify(bool verify) { m_verify = verify; }
+
+    // Safe to call from any thread, the transfer stops after the current block
+    void cancel() { m_cancelled = true; }
+
+    static quint32 crc32(const QByteArray &data, quint32 crc = 0);
+
+public slots:
+    void process();
+
+signals:
+    void progress(qint64 done, qint64 total);
+    void finished(bool success, const QString &message, quint32 crc);
+
+private:
+    EepromAccess *m_access;
+    Direction m_direction = Direction::Read;
+    QString m_filePath;
+    quint16 m_address = 0;
+    quint32 m_size = 0;
+    int m_maxRetries = DEFAULT_RETRIES;
+    bool m_verify = true;
+    std::atomic<bool> m_cancelled{false};
+
+    bool readImage(QString &message, quint32 &crc);
+    bool writeImage(QString &message, quint32 &crc);
+    bool readBlock(quint32 offset, int length, QByteArray &block);
+    bool writeBlock(quint32 offset, const QByteArray &block, const QByteArray &current);
+    bool readRange(quint32 size, QByteArray &image, qint64 progressBase, qint64 progressTotal);
+};
+
+#endif // FIRMWARETRANSFER_H
@@ -0,0 +1,289 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "frameconverter.h"
+
+#include <cstring>
+
+Q_LOGGING_CATEGORY(log_video_convert, "opf.core.video.convert")
+
+namespace {
+
+// QImage formats that share the memory layout of a packed RGB video format
+QImage::Format imageFormatFor(QVideoFrameFormat::PixelFormat format)
+{
+    switch (format) {
+    case QVideoFrameFormat::Format_BGRX8888:
+        return QImage::Format_RGB32;
+    case QVideoFrameFormat::Format_BGRA8888:
+        return QImage::Format_ARGB32;
+    case QVideoFrameFormat::Format_BGRA8888_Premultiplied:
+        return QImage::Format_ARGB32_Premultiplied;
+    case QVideoFrameFormat::Format_RGBX8888:
+        return QImage::Format_RGBX8888;
+    case QVideoFrameFormat::Format_RGBA8888:
+        return QImage::Format_RGBA8888;
+    default:
+        return QImage::Format_Invalid;
+    }
+}
+
+} // namespace
+
+bool FrameConverter::isSupported(QVideoFrameFormat::PixelFormat format)
+{
+    switch (format) {
+    case QVideoFrameFormat::Format_YUYV:
+    case QVideoFrameFormat::Format_UYVY:
+    case QVideoFrameFormat::Format_NV12:
+    case QVideoFrameFormat::Format_NV21:
+    case QVideoFrameFormat::Format_YUV420P:
+    case QVideoFrameFormat::Format_YV12:
+    case QVideoFrameFormat::Format_YUV422P:
+        return true;
+    default:
+        return imageFormatFor(format) != QImage::Format_Invalid;
+    }
+}
+
+YuvCoefficients FrameConverter::coefficientsFor(const QVideoFrameFormat &format)
+{
+    bool full = format.colorRange() == QVideoFrameFormat::ColorRange_Full;
+    bool bt709 = format.colorSpace() == QVideoFrameFormat::ColorSpace_BT709;
+    if (bt709) {
+        return full ? YuvCoefficients{0, 65536, 103206, 12276, 30679, 121609}
+                    : YuvCoefficients{16, 76309, 117489, 13975, 34925, 138438};
+    }
+    return full ? YuvCoefficients{0, 65536, 91881, 22554, 46802, 116130}
+                : YuvCoefficients{16, 76309, 104597, 25675, 53279, 132201};
+}
+
+void FrameConverter::convertYuyvRow(const uchar *row, int x, int width, quint32 *dst,
+                                    const YuvCoefficients &c, bool uyvy)
+{
+    // YUYV: Y0 U Y1 V, UYVY: U Y0 V Y1
+    const int yIndex = uyvy ? 1 : 0;
+    const int uIndex = uyvy ? 0 : 1;
+    const int vIndex = uyvy ? 2 : 3;
+    for (int i = 0; i < width; i++) {
+        int p = x + i;
+        const uchar *m = row + (p >> 1) * 4;
+        dst[i] = yuvToRgb32(m[yIndex + (p & 1) * 2], m[uIndex], m[vIndex], c);
+    }
+}
+
+void FrameConverter::convertNv12Row(const uchar *yRow, const uchar *uvRow, int x, int width, quint32 *dst,
+                                    const YuvCoefficients &c, bool nv21)
+{
+    const int uIndex = nv21 ? 1 : 0;
+    const int vIndex = nv21 ? 0 : 1;
+    for (int i = 0; i < width; i++) {
+        int p = x + i;
+        const uchar *uv = uvRow + (p >> 1) * 2;
+        dst[i] = yuvToRgb32(yRow[p], uv[uIndex], uv[vIndex], c);
+    }
+}
+
+void FrameConverter::convertPlanarRow(const uchar *yRow, const uchar *uRow, const uchar *vRow, int x, int width,
+                                      quint32 *dst, const YuvCoefficients &c)
+{
+    for (int i = 0; i < width; i++) {
+        int p = x + i;
+        dst[i] = yuvToRgb32(yRow[p], uRow[p >> 1], vRow[p >> 1], c);
+    }
+}
+
+QImage FrameConverter::toImage(const QVideoFrame &frame, const QRect &area)
+{
+    if (!frame.isValid()) {
+        return QImage();
+    }
+
+    QRect frameRect(QPoint(0, 0), frame.size());
+    QRect rect = area.isEmpty() ? frameRect : area.intersected(frameRect);
+    if (rect.isEmpty()) {
+        qCWarning(log_video_convert) << "Area" << area << "is outside of the frame" << frame.size();
+        return QImage();
+    }
+
+    QVideoFrameFormat::PixelFormat pixelFormat = frame.pixelFormat();
+    if (!isSupported(pixelFormat)) {
+        // Compressed or exotic formats go through Qt, the crop happens after conversion
+        QImage image = frame.toImage();
+        return rect == frameRect ? image : image.copy(rect);
+    }
+
+    QVideoFrame mapped(frame);
+    if (!mapped.map(QVideoFrame::ReadOnly)) {
+        qCWarning(log_video_convert) << "Failed to map video frame";
+        return QImage();
+    }
+
+    QImage image;
+    QImage::Format packedFormat = imageFormatFor(pixelFormat);
+    if (packedFormat != QImage::Format_Invalid) {
+        const uchar *bits = mapped.bits(0) + rect.y() * mapped.bytesPerLine(0) + rect.x() * 4;
+        QImage view(bits, rect.width(), rect.height(), mapped.bytesPerLine(0), packedFormat);
+        image = view.convertToFormat(QImage::Format_RGB32);
+        if (image.constBits() == view.constBits()) {
+            // Same format, convertToFormat only made a shallow copy of the mapped memory
+            image = view.copy();
+        }
+    } else {
+        image = QImage(rect.size(), QImage::Format_RGB32);
+        YuvCoefficients c = coefficientsFor(frame.surfaceFormat());
+        for (int row = 0; row < rect.height(); row++) {
+            int y = rect.y() + row;
+            quint32 *dst = reinterpret_cast<quint32 *>(image.scanLine(row));
+            switch (pixelFormat) {
+            case QVideoFrameFormat::Format_YUYV:
+            case QVideoFrameFormat::Format_UYVY:
+                convertYuyvRow(mapped.bits(0) + y * mapped.bytesPerLine(0), rect.x(), rect.width(), dst, c,
+                               pixelFormat == QVideoFrameFormat::Format_UYVY);
+                break;
+            case QVideoFrameFormat::Format_NV12:
+            case QVideoFrameFormat::Format_NV21:
+                convertNv12Row(mapped.bits(0) + y * mapped.bytesPerLine(0),
+                               mapped.bits(1) + (y >> 1) * mapped.bytesPerLine(1),
+                               rect.x(), rect.width(), dst, c,
+                               pixelFormat == QVideoFrameFormat::Format_NV21);
+                break;
+            case QVideoFrameFormat::Format_YUV420P:
+            case QVideoFrameFormat::Format_YV12:
+            case QVideoFrameFormat::Format_YUV422P: {
+                // YV12 stores V before U, 4:2:2 has a chroma row for every luma row
+                int uPlane = pixelFormat == QVideoFrameFormat::Format_YV12 ? 2 : 1;
+                int vPlane = 3 - uPlane;
+                int chromaRow = pixelFormat == QVideoFrameFormat::Format_YUV422P ? y : y >> 1;
+                convertPlanarRow(mapped.bits(0) + y * mapped.bytesPerLine(0),
+                                 mapped.bits(uPlane) + chromaRow * mapped.bytesPerLine(uPlane),
+                                 mapped.bits(vPlane) + chromaRow * mapped.bytesPerLine(vPlane),
+                                 rect.x(), rect.width(), dst, c);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+
+    mapped.unmap();
+    return image;
+}
+
+QImage FrameConverter::toGray(const QVideoFrame &frame, const QRect &area, LumaSpec *spec)
+{
+    if (!frame.isValid()) {
+        return QImage();
+    }
+
+    QRect frameRect(QPoint(0, 0), frame.size());
+    QRect rect = area.isEmpty() ? frameRect : area.intersected(frameRect);
+    if (rect.isEmpty()) {
+        qCWarning(log_video_convert) << "Area" << area << "is outside of the frame" << frame.size();
+        return QImage();
+    }
+
+    QVideoFrameFormat::PixelFormat pixelFormat = frame.pixelFormat();
+    int step = 0;
+    int offset = 0;
+    switch (pixelFormat) {
+    case QVideoFrameFormat::Format_YUYV:
+        step = 2;
+        break;
+    case QVideoFrameFormat::Format_UYVY:
+        step = 2;
+        offset = 1;
+        break;
+    case QVideoFrameFormat::Format_NV12:
+    case QVideoFrameFormat::Format_NV21:
+    case QVideoFrameFormat::Format_YUV420P:
+    case QVideoFrameFormat::Format_YV12:
+    case QVideoFrameFormat::Format_YUV422P:
+        step = 1;
+        break;
+    default:
+        break;
+    }
+
+    if (step == 0) {
+        // RGB or compressed, derive luma from RGB
+        LumaSpec rgbSpec;
+        if (spec) {
+            *spec = rgbSpec;
+        }
+        return rgbToGray(toImage(frame, rect), rgbSpec);
+    }
+
+    if (spec) {
+        spec->limitedRange = frame.surfaceFormat().colorRange() != QVideoFrameFormat::ColorRange_Full;
+        spec->bt709 = frame.surfaceFormat().colorSpace() == QVideoFrameFormat::ColorSpace_BT709;
+    }
+
+    QVideoFrame mapped(frame);
+    if (!mapped.map(QVideoFrame::ReadOnly)) {
+        qCWarning(log_video_convert) << "Failed to map video frame";
+        return QImage();
+    }
+
+    QImage gray(rect.size(), QImage::Format_Grayscale8);
+    for (int row = 0; row < rect.height(); row++) {
+        const uchar *src = mapped.bits(0) + (rect.y() + row) * mapped.bytesPerLine(0) + rect.x() * step + offset;
+        uchar *dst = gray.scanLine(row);
+        if (step == 1) {
+            memcpy(dst, src, rect.width());
+        } else {
+            for (int x = 0; x < rect.width(); x++) {
+                dst[x] = src[x * 2];
+            }
+        }
+    }
+    mapped.unmap();
+    return gray;
+}
+
+QImage FrameConverter::rgbToGray(const QImage &image, const LumaSpec &spec)
+{
+    if (image.isNull()) {
+        return QImage();
+    }
+
+    // Kr, Kg, Kb in 16 bit fixed point, scaled to 219 levels for limited range
+    const int kr = spec.bt709 ? 13933 : 19595;
+    const int kb = spec.bt709 ? 4732 : 7471;
+    const int kg = 65536 - kr - kb;
+    const int scale = spec.limitedRange ? 219 : 255;
+    const int bias = spec.limitedRange ? 16 : 0;
+
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    QImage gray(rgb.size(), QImage::Format_Grayscale8);
+    for (int y = 0; y < rgb.height(); y++) {
+        const quint32 *src = reinterpret_cast<const quint32 *>(rgb.constScanLine(y));
+        uchar *dst = gray.scanLine(y);
+        for (int x = 0; x < rgb.width(); x++) {
+            quint32 px = src[x];
+            int luma = (kr * int((px >> 16) & 0xFF) + kg * int((px >> 8) & 0xFF) + kb * int(px & 0xFF) + (1 << 15)) >> 16;
+            dst[x] = static_cast<uchar>(bias + (luma * scale + 127) / 255);
+        }
+    }
+    return gray;
+}
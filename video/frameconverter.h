@@ -0,0 +1,102 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef FRAMECONVERTER_H
+#define FRAMECONVERTER_H
+
+#include <QImage>
+#include <QRect>
+#include <QVideoFrame>
+#include <QVideoFrameFormat>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_convert)
+
+/*
+ * Fixed point YUV to RGB coefficients, 16 fractional bits.
+ * R = y * (Y - yOffset) + rv * V
+ * G = y * (Y - yOffset) - gu * U - gv * V
+ * B = y * (Y - yOffset) + bu * U
+ * with U and V centered on zero.
+ */
+struct YuvCoefficients {
+    int yOffset;
+    int y;
+    int rv;
+    int gu;
+    int gv;
+    int bu;
+};
+
+// How luma values of a gray image relate to RGB, so a reference image can be
+// converted to gray the same way the video frame encodes its luma
+struct LumaSpec {
+    bool limitedRange = false;
+    bool bt709 = false;
+};
+
+/*
+ * Converts a mapped QVideoFrame, or only a region of it, straight into a
+ * QImage::Format_RGB32 image. Only the pixels inside the region are read and
+ * converted, which is what makes area screenshots cheap compared to
+ * QVideoFrame::toImage() followed by QImage::copy().
+ */
+class FrameConverter
+{
+public:
+    static bool isSupported(QVideoFrameFormat::PixelFormat format);
+
+    // An empty area converts the whole frame. The area is clipped to the frame.
+    static QImage toImage(const QVideoFrame &frame, const QRect &area = QRect());
+
+    // Gray image of the area. For YUV frames this is a copy of the luma
+    // samples, no colour conversion is done at all.
+    static QImage toGray(const QVideoFrame &frame, const QRect &area = QRect(), LumaSpec *spec = nullptr);
+    static QImage rgbToGray(const QImage &image, const LumaSpec &spec);
+
+    static YuvCoefficients coefficientsFor(const QVideoFrameFormat &format);
+
+    // One pixel, U and V as stored, i.e. centered on 128
+    static inline quint32 yuvToRgb32(int y, int u, int v, const YuvCoefficients &c)
+    {
+        int luma = (y - c.yOffset) * c.y + (1 << 15);
+        u -= 128;
+        v -= 128;
+        int r = (luma + c.rv * v) >> 16;
+        int g = (luma - c.gu * u - c.gv * v) >> 16;
+        int b = (luma + c.bu * u) >> 16;
+        r = r < 0 ? 0 : (r > 255 ? 255 : r);
+        g = g < 0 ? 0 : (g > 255 ? 255 : g);
+        b = b < 0 ? 0 : (b > 255 ? 255 : b);
+        return 0xFF000000u | (quint32(r) << 16) | (quint32(g) << 8) | quint32(b);
+    }
+
+    // Row converters, x is the first source pixel, width the number of pixels to write
+    static void convertYuyvRow(const uchar *row, int x, int width, quint32 *dst,
+                               const YuvCoefficients &c, bool uyvy = false);
+    static void convertNv12Row(const uchar *yRow, const uchar *uvRow, int x, int width, quint32 *dst,
+                               const YuvCoefficients &c, bool nv21 = false);
+    static void convertPlanarRow(const uchar *yRow, const uchar *uRow, const uchar *vRow, int x, int width,
+                                 quint32 *dst, const YuvCoefficients &c);
+};
+
+#endif // FRAMECONVERTER_H
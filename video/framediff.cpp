@@ -0,0 +1,408 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "framediff.h"
+#include "frameconverter.h"
+#include "host/mediaclock.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+Q_LOGGING_CATEGORY(log_video_diff, "opf.core.video.diff")
+
+namespace {
+
+/*
+ * Row kernels: add the SAD of one row to the accumulator of every tile
+ * column, skipping tiles already over the threshold.
+ */
+void sadRowScalar(const uchar *a, const uchar *b, int rowBytes, int tileBytes, quint32 *acc, quint32 threshold)
+{
+    for (int x = 0, t = 0; x < rowBytes; x += tileBytes, t++) {
+        if (acc[t] > threshold) {
+            continue;
+        }
+        int n = std::min(tileBytes, rowBytes - x);
+        quint32 sum = 0;
+        for (int i = 0; i < n; i++) {
+            sum += static_cast<quint32>(std::abs(int(a[x + i]) - int(b[x + i])));
+        }
+        acc[t] += sum;
+    }
+}
+
+#ifdef OPF_HAVE_SSE2
+void sadRowSse2(const uchar *a, const uchar *b, int rowBytes, int tileBytes, quint32 *acc, quint32 threshold)
+{
+    for (int x = 0, t = 0; x < rowBytes; x += tileBytes, t++) {
+        if (acc[t] > threshold) {
+            continue;
+        }
+        int n = std::min(tileBytes, rowBytes - x);
+        const uchar *pa = a + x;
+        const uchar *pb = b + x;
+        __m128i sum = _mm_setzero_si128();
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pa + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pb + i));
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(va, vb));
+        }
+        quint32 total = static_cast<quint32>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+        for (; i < n; i++) {
+            total += static_cast<quint32>(std::abs(int(pa[i]) - int(pb[i])));
+        }
+        acc[t] += total;
+    }
+}
+#endif
+
+#ifdef OPF_HAVE_AVX2
+OPF_TARGET_AVX2
+void sadRowAvx2(const uchar *a, const uchar *b, int rowBytes, int tileBytes, quint32 *acc, quint32 threshold)
+{
+    for (int x = 0, t = 0; x < rowBytes; x += tileBytes, t++) {
+        if (acc[t] > threshold) {
+            continue;
+        }
+        int n = std::min(tileBytes, rowBytes - x);
+        const uchar *pa = a + x;
+        const uchar *pb = b + x;
+        __m256i sum = _mm256_setzero_si256();
+        int i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pa + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pb + i));
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(va, vb));
+        }
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        quint32 total = static_cast<quint32>(_mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_srli_si128(half, 8)));
+        for (; i < n; i++) {
+            total += static_cast<quint32>(std::abs(int(pa[i]) - int(pb[i])));
+        }
+        acc[t] += total;
+    }
+}
+#endif
+
+using SadRowFn = void (*)(const uchar *, const uchar *, int, int, quint32 *, quint32);
+
+SadRowFn sadRowFor(Simd::Level level)
+{
+#ifdef OPF_HAVE_AVX2
+    if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+        return sadRowAvx2;
+    }
+#endif
+#ifdef OPF_HAVE_SSE2
+    if (level != Simd::Level::Scalar) {
+        return sadRowSse2;
+    }
+#endif
+    Q_UNUSED(level);
+    return sadRowScalar;
+}
+
+/*
+ * Merge the dirty tiles of each tile row into horizontal runs, then extend a
+ * run downwards while the next row has a run with the same span.
+ */
+QVector<QRect> mergeRegions(const FrameDiffResult &result, int width, int height)
+{
+    QVector<QRect> closed;
+    QVector<QRect> open;    // In tile units
+    for (int ty = 0; ty < result.tilesY; ty++) {
+        QVector<QRect> runs;
+        for (int tx = 0; tx < result.tilesX; tx++) {
+            if (!result.isDirty(tx, ty)) {
+                continue;
+            }
+            int start = tx;
+            while (tx + 1 < result.tilesX && result.isDirty(tx + 1, ty)) {
+                tx++;
+            }
+            runs.append(QRect(start, ty, tx - start + 1, 1));
+        }
+
+        QVector<QRect> next;
+        for (const QRect &run : runs) {
+            auto it = std::find_if(open.begin(), open.end(), [&run](const QRect &r) {
+                return r.left() == run.left() && r.width() == run.width();
+            });
+            if (it != open.end()) {
+                QRect grown = *it;
+                grown.setHeight(grown.height() + 1);
+                next.append(grown);
+                open.erase(it);
+            } else {
+                next.append(run);
+            }
+        }
+        closed += open;
+        open = next;
+    }
+    closed += open;
+
+    QRect frameRect(0, 0, width, height);
+    QVector<QRect> regions;
+    regions.reserve(closed.size());
+    for (const QRect &r : closed) {
+        regions.append(QRect(r.x() * result.tileSize, r.y() * result.tileSize,
+                             r.width() * result.tileSize, r.height() * result.tileSize).intersected(frameRect));
+    }
+    return regions;
+}
+
+} // namespace
+
+FrameDiff::FrameDiff(QObject *parent)
+    : QObject(parent)
+{
+    m_thread.setObjectName("FrameDiff");
+}
+
+FrameDiff::~FrameDiff()
+{
+    stop();
+}
+
+void FrameDiff::start()
+{
+    if (isRunning()) {
+        return;
+    }
+    m_worker = new QObject();
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.start(QThread::LowPriority);
+    m_subscription = FrameDistributor::getInstance().subscribe(m_worker, [this](const FrameDistributor::Frame &frame) {
+        process(frame);
+    });
+    qCDebug(log_video_diff) << "Frame diff started, tile size" << m_tileSize << "simd" << Simd::levelName(Simd::bestLevel());
+}
+
+void FrameDiff::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    FrameDistributor::getInstance().unsubscribe(m_subscription);
+    m_subscription = 0;
+    m_thread.quit();
+    m_thread.wait();
+    m_worker = nullptr;
+    if (m_previous.isMapped()) {
+        m_previous.unmap();
+    }
+    m_previous = QVideoFrame();
+    m_previousImage = QImage();
+}
+
+void FrameDiff::setTileSize(int pixels)
+{
+    // Keep tiles a multiple of 16 so rows split into whole vectors
+    m_tileSize = qMax(16, (pixels + 15) / 16 * 16);
+}
+
+qint64 FrameDiff::idleMs() const
+{
+    qint64 last = m_lastChangeUs.load();
+    return last == 0 ? -1 : (MediaClock::nowUs() - last) / 1000;
+}
+
+int FrameDiff::bytesPerPixelOfPlane0(QVideoFrameFormat::PixelFormat format)
+{
+    switch (format) {
+    case QVideoFrameFormat::Format_YUYV:
+    case QVideoFrameFormat::Format_UYVY:
+        return 2;
+    case QVideoFrameFormat::Format_NV12:
+    case QVideoFrameFormat::Format_NV21:
+    case QVideoFrameFormat::Format_YUV420P:
+    case QVideoFrameFormat::Format_YV12:
+    case QVideoFrameFormat::Format_YUV422P:
+        return 1;
+    case QVideoFrameFormat::Format_BGRX8888:
+    case QVideoFrameFormat::Format_BGRA8888:
+    case QVideoFrameFormat::Format_BGRA8888_Premultiplied:
+    case QVideoFrameFormat::Format_RGBX8888:
+    case QVideoFrameFormat::Format_RGBA8888:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+FrameDiffResult FrameDiff::compare(const uchar *previous, int previousStride,
+                                   const uchar *current, int currentStride,
+                                   int width, int height, int bytesPerPixel,
+                                   int tileSize, double noiseFloor, Simd::Level level)
+{
+    FrameDiffResult result;
+    result.tileSize = tileSize;
+    result.tilesX = (width + tileSize - 1) / tileSize;
+    result.tilesY = (height + tileSize - 1) / tileSize;
+    result.dirtyTiles.assign((result.tilesX * result.tilesY + 7) / 8, 0);
+
+    const int rowBytes = width * bytesPerPixel;
+    const int tileBytes = tileSize * bytesPerPixel;
+    const quint32 threshold = static_cast<quint32>(noiseFloor * tileBytes * tileSize);
+    SadRowFn sadRow = sadRowFor(level);
+    std::vector<quint32> acc(result.tilesX);
+
+    for (int ty = 0; ty < result.tilesY; ty++) {
+        std::fill(acc.begin(), acc.end(), 0);
+        int yEnd = std::min(height, (ty + 1) * tileSize);
+        for (int y = ty * tileSize; y < yEnd; y++) {
+            sadRow(previous + qsizetype(y) * previousStride, current + qsizetype(y) * currentStride,
+                   rowBytes, tileBytes, acc.data(), threshold);
+        }
+        for (int tx = 0; tx < result.tilesX; tx++) {
+            if (acc[tx] > threshold) {
+                int bit = ty * result.tilesX + tx;
+                result.dirtyTiles[bit >> 3] |= quint8(1u << (bit & 7));
+                result.dirtyCount++;
+            }
+        }
+    }
+
+    if (result.dirtyCount > 0) {
+        result.regions = mergeRegions(result, width, height);
+    }
+    return result;
+}
+
+void FrameDiff::process(const FrameDistributor::Frame &frame)
+{
+    QVideoFrame current(frame.frame);
+    int bytesPerPixel = bytesPerPixelOfPlane0(current.pixelFormat());
+
+    if (bytesPerPixel == 0) {
+        // Not a format we can read directly, compare converted images instead
+        if (m_previous.isMapped()) {
+            m_previous.unmap();
+        }
+        m_previous = QVideoFrame();
+        QImage image = FrameConverter::toImage(current);
+        if (image.isNull()) {
+            return;
+        }
+        if (m_previousImage.size() == image.size()) {
+            FrameDiffResult result = compare(m_previousImage.constBits(), m_previousImage.bytesPerLine(),
+                                             image.constBits(), image.bytesPerLine(),
+                                             image.width(), image.height(), 4, m_tileSize, m_noiseFloor);
+            report(result, frame.timestampUs);
+        }
+        m_previousImage = image;
+        return;
+    }
+
+    if (!current.map(QVideoFrame::ReadOnly)) {
+        qCWarning(log_video_diff) << "Failed to map frame" << frame.sequence;
+        return;
+    }
+
+    if (m_previous.isMapped() && m_previous.size() == current.size()
+        && m_previous.pixelFormat() == current.pixelFormat()) {
+        FrameDiffResult result = compare(m_previous.bits(0), m_previous.bytesPerLine(0),
+                                         current.bits(0), current.bytesPerLine(0),
+                                         current.width(), current.height(), bytesPerPixel,
+                                         m_tileSize, m_noiseFloor);
+        report(result, frame.timestampUs);
+    }
+
+    if (m_previous.isMapped()) {
+        m_previous.unmap();
+    }
+    // Stays mapped until the next frame has been compared against it
+    m_previous = current;
+    m_previousImage = QImage();
+}
+
+void FrameDiff::report(FrameDiffResult &result, qint64 timestampUs)
+{
+    result.timestampUs = timestampUs;
+    m_comparedFrames++;
+    if (result.hasChanges()) {
+        m_lastChangeUs = timestampUs;
+        emit screenChanged(result.regions, timestampUs);
+    } else if (m_lastChangeUs.load() == 0) {
+        // Idle time counts from the first compared frame
+        m_lastChangeUs = timestampUs;
+    }
+    emit frameCompared(result);
+}
+
+void FrameDiff::runBenchmark()
+{
+    const int width = 1920;
+    const int height = 1080;
+    const int bytesPerPixel = 2;    // YUYV, as delivered by the capture card
+    const int stride = width * bytesPerPixel;
+    const int iterations = 200;
+    const double megapixels = width * height / 1e6;
+
+    std::vector<uchar> previous(qsizetype(stride) * height);
+    for (size_t i = 0; i < previous.size(); i++) {
+        previous[i] = static_cast<uchar>((i * 2654435761u) >> 24);
+    }
+    std::vector<uchar> same = previous;
+    std::vector<uchar> changed = previous;
+    // A cursor sized change and a text line sized change
+    for (int y = 500; y < 532; y++) {
+        for (int x = 900 * bytesPerPixel; x < 932 * bytesPerPixel; x++) {
+            changed[qsizetype(y) * stride + x] ^= 0x80;
+        }
+    }
+    for (int y = 100; y < 116; y++) {
+        for (int x = 200 * bytesPerPixel; x < 1400 * bytesPerPixel; x++) {
+            changed[qsizetype(y) * stride + x] ^= 0x40;
+        }
+    }
+
+    const Simd::Level levels[] = {Simd::Level::Scalar, Simd::Level::Sse2, Simd::Level::Avx2};
+    for (Simd::Level level : levels) {
+        if (!Simd::isSupported(level)) {
+            continue;
+        }
+        for (int scenario = 0; scenario < 2; scenario++) {
+            const std::vector<uchar> &current = scenario == 0 ? same : changed;
+            QElapsedTimer timer;
+            timer.start();
+            int dirty = 0;
+            for (int i = 0; i < iterations; i++) {
+                FrameDiffResult result = compare(previous.data(), stride, current.data(), stride,
+                                                 width, height, bytesPerPixel, DEFAULT_TILE_SIZE, 0.5, level);
+                dirty = result.dirtyCount;
+            }
+            double nsPerMp = timer.nsecsElapsed() / (iterations * megapixels);
+            qInfo().noquote() << QString("framediff %1 %2: %3 ns/MP, %4 us per 1080p frame, %5 dirty tiles")
+                                     .arg(Simd::levelName(level), -6)
+                                     .arg(scenario == 0 ? "static " : "changed")
+                                     .arg(nsPerMp, 0, 'f', 0)
+                                     .arg(nsPerMp * megapixels / 1000.0, 0, 'f', 1)
+                                     .arg(dirty);
+        }
+    }
+}
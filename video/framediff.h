@@ -0,0 +1,135 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef FRAMEDIFF_H
+#define FRAMEDIFF_H
+
+#include <QObject>
+#include <QRect>
+#include <QVector>
+#include <QThread>
+#include <QVideoFrame>
+#include <QImage>
+#include <QLoggingCategory>
+#include <atomic>
+#include <vector>
+
+#include "simd.h"
+#include "framedistributor.h"
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_diff)
+
+struct FrameDiffResult {
+    int tileSize = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    int dirtyCount = 0;
+    std::vector<quint8> dirtyTiles;     // One bit per tile, row major, LSB first
+    QVector<QRect> regions;             // Dirty tiles merged into rectangles, frame pixels
+    qint64 timestampUs = 0;
+
+    bool isDirty(int tx, int ty) const
+    {
+        int bit = ty * tilesX + tx;
+        return (dirtyTiles[bit >> 3] >> (bit & 7)) & 1;
+    }
+    bool hasChanges() const { return dirtyCount > 0; }
+};
+Q_DECLARE_METATYPE(FrameDiffResult)
+
+/*
+ * Compares every captured frame with the previous one in square tiles.
+ *
+ * The comparison runs on the first plane of the frame as it came from the
+ * decoder (luma for planar formats, the packed bytes otherwise), so no
+ * colour conversion is needed. A tile is dirty when its sum of absolute
+ * differences exceeds the noise floor; once a tile is known dirty the rest
+ * of its rows are skipped.
+ */
+class FrameDiff : public QObject
+{
+    Q_OBJECT
+
+public:
+    static FrameDiff& getInstance()
+    {
+        static FrameDiff instance;
+        return instance;
+    }
+
+    FrameDiff(FrameDiff const&) = delete;
+    void operator=(FrameDiff const&) = delete;
+
+    static const int DEFAULT_TILE_SIZE = 32;
+
+    void start();
+    void stop();
+    bool isRunning() const { return m_subscription != 0; }
+
+    void setTileSize(int pixels);
+    // Mean absolute difference per byte a tile must exceed to count as changed
+    void setNoiseFloor(double meanAbsDiff) { m_noiseFloor = meanAbsDiff; }
+
+    // MediaClock time of the last frame that differed from its predecessor
+    qint64 lastChangeUs() const { return m_lastChangeUs.load(); }
+    qint64 idleMs() const;
+    quint64 comparedFrames() const { return m_comparedFrames.load(); }
+
+    static FrameDiffResult compare(const uchar *previous, int previousStride,
+                                   const uchar *current, int currentStride,
+                                   int width, int height, int bytesPerPixel,
+                                   int tileSize, double noiseFloor,
+                                   Simd::Level level = Simd::bestLevel());
+    // Bytes per pixel compare() works on for a format, 0 when it has to be converted first
+    static int bytesPerPixelOfPlane0(QVideoFrameFormat::PixelFormat format);
+
+    // Prints ns per megapixel for each supported kernel
+    static void runBenchmark();
+
+signals:
+    // Emitted from the diff thread for every compared frame
+    void frameCompared(const FrameDiffResult &result);
+    // Emitted from the diff thread when at least one tile changed
+    void screenChanged(const QVector<QRect> &regions, qint64 timestampUs);
+
+private:
+    explicit FrameDiff(QObject *parent = nullptr);
+    ~FrameDiff();
+
+    void process(const FrameDistributor::Frame &frame);
+    void report(FrameDiffResult &result, qint64 timestampUs);
+
+    QThread m_thread;
+    QObject *m_worker = nullptr;
+    int m_subscription = 0;
+    int m_tileSize = DEFAULT_TILE_SIZE;
+    double m_noiseFloor = 0.5;
+
+    // Only touched from the diff thread
+    QVideoFrame m_previous;
+    QImage m_previousImage;
+
+    std::atomic<qint64> m_lastChangeUs{0};
+    std::atomic<quint64> m_comparedFrames{0};
+};
+
+#endif // FRAMEDIFF_H
@@ -0,0 +1,187 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "framedistributor.h"
+#include "framemetrics.h"
+#include "host/mediaclock.h"
+
+#include <QMutexLocker>
+#include <algorithm>
+
+Q_LOGGING_CATEGORY(log_video_frames, "opf.core.video.frames")
+
+FrameDistributor::FrameDistributor(QObject *parent)
+    : QObject(parent), m_ring(DEFAULT_RING_SIZE)
+{
+}
+
+void FrameDistributor::attach(QVideoSink *sink)
+{
+    if (sink == m_sink) {
+        return;
+    }
+    detach();
+    if (!sink) {
+        qCWarning(log_video_frames) << "Attempted to attach a null video sink";
+        return;
+    }
+    m_sink = sink;
+    // Direct connection: the frame is only referenced here, never converted,
+    // so this is cheap enough to run in whatever thread the sink emits from
+    m_sinkConnection = connect(sink, &QVideoSink::videoFrameChanged, this,
+                               &FrameDistributor::onVideoFrameChanged, Qt::DirectConnection);
+    qCDebug(log_video_frames) << "Frame tap attached to sink" << sink;
+    emit sinkAttached(sink);
+}
+
+void FrameDistributor::detach()
+{
+    if (m_sinkConnection) {
+        disconnect(m_sinkConnection);
+    }
+    m_sink = nullptr;
+    clear();
+}
+
+void FrameDistributor::clear()
+{
+    // Release the frames so the backend can reuse their buffers
+    QMutexLocker locker(&m_mutex);
+    std::fill(m_ring.begin(), m_ring.end(), Frame());
+}
+
+void FrameDistributor::pushFrame(const QVideoFrame &frame)
+{
+    onVideoFrameChanged(frame);
+}
+
+void FrameDistributor::onVideoFrameChanged(const QVideoFrame &frame)
+{
+    if (!frame.isValid()) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<Subscriber>> toNotify;
+    quint64 sequence;
+    qint64 timestampUs;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_ringHead = (m_ringHead + 1) % static_cast<int>(m_ring.size());
+        Frame &slot = m_ring[m_ringHead];
+        slot.frame = frame;
+        slot.timestampUs = MediaClock::nowUs();
+        slot.sequence = m_sequence.fetch_add(1) + 1;
+        sequence = slot.sequence;
+        timestampUs = slot.timestampUs;
+
+        m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+                                           [](const std::shared_ptr<Subscriber> &s) { return s->context.isNull(); }),
+                            m_subscribers.end());
+        toNotify = m_subscribers;
+    }
+    FrameMetrics::getInstance().frameArrived(frame, sequence, timestampUs);
+
+    for (const auto &subscriber : toNotify) {
+        if (subscriber->pending.exchange(true)) {
+            // Still busy, it picks up this frame or a newer one when it returns
+            subscriber->dropped++;
+            continue;
+        }
+        QObject *context = subscriber->context.data();
+        if (!context) {
+            continue;
+        }
+        QMetaObject::invokeMethod(context, [this, subscriber]() { deliver(subscriber); }, Qt::QueuedConnection);
+    }
+}
+
+void FrameDistributor::deliver(const std::shared_ptr<Subscriber> &subscriber)
+{
+    // Clear first so a frame arriving during the callback schedules one more call
+    subscriber->pending = false;
+    if (!subscriber->active) {
+        return;
+    }
+
+    Frame frame = latestFrame();
+    if (!frame.isValid() || frame.sequence == subscriber->lastSequence) {
+        return;
+    }
+    subscriber->lastSequence = frame.sequence;
+    subscriber->callback(frame);
+}
+
+FrameDistributor::Frame FrameDistributor::latestFrame() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_ring[m_ringHead];
+}
+
+QList<FrameDistributor::Frame> FrameDistributor::recentFrames() const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<Frame> frames;
+    int size = static_cast<int>(m_ring.size());
+    for (int i = 1; i <= size; i++) {
+        const Frame &frame = m_ring[(m_ringHead + i) % size];
+        if (frame.isValid()) {
+            frames.append(frame);
+        }
+    }
+    return frames;
+}
+
+int FrameDistributor::subscribe(QObject *context, Callback callback)
+{
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->context = context;
+    subscriber->callback = std::move(callback);
+
+    QMutexLocker locker(&m_mutex);
+    subscriber->id = m_nextId++;
+    m_subscribers.push_back(subscriber);
+    qCDebug(log_video_frames) << "Frame subscriber added" << subscriber->id << context;
+    return subscriber->id;
+}
+
+void FrameDistributor::unsubscribe(int id)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = std::find_if(m_subscribers.begin(), m_subscribers.end(),
+                           [id](const std::shared_ptr<Subscriber> &s) { return s->id == id; });
+    if (it != m_subscribers.end()) {
+        // A delivery may already be queued, it is dropped once it runs
+        (*it)->active = false;
+        m_subscribers.erase(it);
+    }
+}
+
+quint64 FrameDistributor::droppedFrames(int id) const
+{
+    QMutexLocker locker(&m_mutex);
+    for (const auto &subscriber : m_subscribers) {
+        if (subscriber->id == id) {
+            return subscriber->dropped.load();
+        }
+    }
+    return 0;
+}
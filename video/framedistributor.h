@@ -0,0 +1,121 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef FRAMEDISTRIBUTOR_H
+#define FRAMEDISTRIBUTOR_H
+
+#include <QObject>
+#include <QVideoFrame>
+#include <QVideoSink>
+#include <QPointer>
+#include <QMutex>
+#include <QLoggingCategory>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_frames)
+
+/*
+ * Taps the frames the capture session delivers to the video widget sink.
+ *
+ * The last few frames are kept in a small ring. QVideoFrame is reference
+ * counted, so keeping and handing them out never copies pixel data.
+ * Consumers subscribe with a context object and are called in that object's
+ * thread. A consumer that is still busy with a frame is not queued more
+ * frames, it gets the newest one once it returns, so a slow consumer never
+ * holds back the display or other consumers.
+ */
+class FrameDistributor : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Frame {
+        QVideoFrame frame;
+        qint64 timestampUs = 0;     // MediaClock time the frame reached the sink
+        quint64 sequence = 0;       // 0 means no frame
+        bool isValid() const { return sequence != 0 && frame.isValid(); }
+    };
+
+    using Callback = std::function<void(const Frame &)>;
+
+    static FrameDistributor& getInstance()
+    {
+        static FrameDistributor instance;
+        return instance;
+    }
+
+    FrameDistributor(FrameDistributor const&) = delete;
+    void operator=(FrameDistributor const&) = delete;
+
+    static const int DEFAULT_RING_SIZE = 3;
+
+    void attach(QVideoSink *sink);
+    void detach();
+    // Drop the kept frames, e.g. when the camera stops, so no stale frame is served
+    void clear();
+
+    // Frame sources that do not go through a QVideoSink can push directly
+    void pushFrame(const QVideoFrame &frame);
+
+    Frame latestFrame() const;
+    // Oldest first, at most the ring size
+    QList<Frame> recentFrames() const;
+    quint64 frameCount() const { return m_sequence.load(); }
+
+    int subscribe(QObject *context, Callback callback);
+    void unsubscribe(int id);
+    // Frames a subscriber missed because it was still busy
+    quint64 droppedFrames(int id) const;
+
+signals:
+    void sinkAttached(QVideoSink *sink);
+
+private:
+    explicit FrameDistributor(QObject *parent = nullptr);
+
+    struct Subscriber {
+        int id;
+        QPointer<QObject> context;
+        Callback callback;
+        std::atomic<bool> pending{false};
+        std::atomic<bool> active{true};
+        std::atomic<quint64> dropped{0};
+        quint64 lastSequence = 0;
+    };
+
+    void onVideoFrameChanged(const QVideoFrame &frame);
+    void deliver(const std::shared_ptr<Subscriber> &subscriber);
+
+    mutable QMutex m_mutex;
+    std::vector<Frame> m_ring;
+    int m_ringHead = 0;
+    std::atomic<quint64> m_sequence{0};
+    std::vector<std::shared_ptr<Subscriber>> m_subscribers;
+    int m_nextId = 1;
+    QPointer<QVideoSink> m_sink;
+    QMetaObject::Connection m_sinkConnection;
+};
+
+#endif // FRAMEDISTRIBUTOR_H
@@ -0,0 +1,323 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "framemetrics.h"
+#include "host/mediaclock.h"
+#include "global.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <cmath>
+
+Q_LOGGING_CATEGORY(log_video_metrics, "opf.core.video.metrics")
+
+namespace {
+
+// Decode times are matched to frames within this many pending entries
+const int MAX_PENDING_DECODES = 16;
+
+} // namespace
+
+FrameMetrics::FrameMetrics(QObject *parent)
+    : QObject(parent), m_ring(HISTORY_SIZE)
+{
+    qRegisterMetaType<FrameMetricsSummary>();
+    // The first call may come from the sink thread, the timer belongs to the GUI thread
+    m_timer.setParent(this);
+    if (QCoreApplication::instance()) {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+    m_timer.setInterval(1000);
+    connect(&m_timer, &QTimer::timeout, this, [this]() {
+        // The expected interval follows the capture format, which can change at any time
+        int captureFps = GlobalVar::instance().getCaptureFps();
+        m_expectedIntervalUs = captureFps > 0 ? 1000000 / captureFps : 0;
+        emit summaryUpdated(summary());
+    });
+}
+
+void FrameMetrics::setEnabled(bool enabled)
+{
+    if (enabled == m_enabled.load()) {
+        return;
+    }
+    if (enabled) {
+        reset();
+        int captureFps = GlobalVar::instance().getCaptureFps();
+        m_expectedIntervalUs = captureFps > 0 ? 1000000 / captureFps : 0;
+        m_timer.start();
+    } else {
+        m_timer.stop();
+    }
+    m_enabled = enabled;
+    qCDebug(log_video_metrics) << "Frame metrics" << (enabled ? "enabled" : "disabled");
+}
+
+void FrameMetrics::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_head = -1;
+    m_count = 0;
+    m_haveOffset = false;
+    m_lastStreamUs = -1;
+    m_lastArrivalUs = -1;
+    m_decodes.clear();
+}
+
+void FrameMetrics::setStreamOrigin(qint64 originUs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_streamOriginUs = originUs;
+    // A new stream, its times start over
+    m_haveOffset = false;
+    m_lastStreamUs = -1;
+    m_lastArrivalUs = -1;
+    m_decodes.clear();
+}
+
+void FrameMetrics::frameArrived(const QVideoFrame &frame, quint64 sequence, qint64 arrivalUs)
+{
+    if (!m_enabled.load()) {
+        return;
+    }
+    Record record;
+    record.sequence = sequence;
+    record.arrivalUs = arrivalUs;
+    record.streamUs = frame.startTime();
+    const qint64 interval = m_expectedIntervalUs.load();
+
+    QMutexLocker locker(&m_mutex);
+    if (record.streamUs >= 0) {
+        if (m_streamOriginUs >= 0) {
+            record.captureUs = m_streamOriginUs + record.streamUs;
+        } else {
+            qint64 offset = arrivalUs - record.streamUs;
+            if (!m_haveOffset || offset < m_minOffsetUs) {
+                m_minOffsetUs = offset;
+                m_haveOffset = true;
+            }
+            record.captureUs = record.streamUs + m_minOffsetUs;
+        }
+        for (int i = 0; i < m_decodes.size(); i++) {
+            if (m_decodes[i].first == record.streamUs) {
+                record.decodeUs = m_decodes[i].second;
+                m_decodes.removeAt(i);
+                break;
+            }
+        }
+    }
+
+    // Stream times are exact, arrival times are the fallback for sources without them
+    qint64 previous = record.streamUs >= 0 ? m_lastStreamUs : m_lastArrivalUs;
+    qint64 current = record.streamUs >= 0 ? record.streamUs : arrivalUs;
+    if (interval > 0 && previous >= 0 && current >= previous) {
+        qint64 delta = current - previous;
+        if (delta <= interval / 2) {
+            record.duplicate = record.streamUs >= 0;
+        } else {
+            record.missingBefore = qMax<qint64>(0, (delta + interval / 2) / interval - 1);
+        }
+    }
+    m_lastStreamUs = record.streamUs;
+    m_lastArrivalUs = arrivalUs;
+
+    m_head = (m_head + 1) % HISTORY_SIZE;
+    m_ring[m_head] = record;
+    m_count = qMin(m_count + 1, HISTORY_SIZE);
+}
+
+void FrameMetrics::frameDecoded(qint64 streamUs, qint64 decodeUs)
+{
+    if (!m_enabled.load()) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    m_decodes.append(qMakePair(streamUs, decodeUs));
+    while (m_decodes.size() > MAX_PENDING_DECODES) {
+        m_decodes.removeFirst();
+    }
+}
+
+FrameMetrics::Record *FrameMetrics::findRecord(quint64 sequence)
+{
+    // Presented frames are recent, search from the newest
+    for (int i = 0; i < m_count; i++) {
+        Record &record = m_ring[(m_head - i + HISTORY_SIZE) % HISTORY_SIZE];
+        if (record.sequence == sequence) {
+            return &record;
+        }
+        if (record.sequence < sequence) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+void FrameMetrics::framePresented(quint64 sequence, qint64 presentUs, qint64 drawUs)
+{
+    if (!m_enabled.load()) {
+        return;
+    }
+    QMutexLocker locker(&m_mutex);
+    if (Record *record = findRecord(sequence)) {
+        record->presentUs = presentUs;
+        record->drawUs = drawUs;
+    }
+}
+
+QList<FrameMetrics::Record> FrameMetrics::records() const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<Record> list;
+    list.reserve(m_count);
+    for (int i = m_count - 1; i >= 0; i--) {
+        list.append(m_ring[(m_head - i + HISTORY_SIZE) % HISTORY_SIZE]);
+    }
+    return list;
+}
+
+FrameMetricsSummary FrameMetrics::summary(qint64 windowUs) const
+{
+    FrameMetricsSummary summary;
+    summary.inputFps = GlobalVar::instance().getInputFps();
+    summary.captureFps = GlobalVar::instance().getCaptureFps();
+    const bool presenter = m_presenterActive.load();
+    const qint64 now = MediaClock::nowUs();
+    // Frames younger than this may still be waiting for their paint
+    const qint64 paintGraceUs = 100000;
+
+    QMutexLocker locker(&m_mutex);
+    summary.captureLatencyRelative = m_streamOriginUs < 0;
+
+    double captureSum = 0, decodeSum = 0, presentSum = 0, drawSum = 0, totalSum = 0;
+    int captureCount = 0, decodeCount = 0, presentCount = 0, totalCount = 0;
+    double intervalSum = 0, intervalSquares = 0;
+    int intervalCount = 0;
+    qint64 firstArrival = -1, lastArrival = -1, previousArrival = -1;
+
+    for (int i = m_count - 1; i >= 0; i--) {
+        const Record &r = m_ring[(m_head - i + HISTORY_SIZE) % HISTORY_SIZE];
+        if (r.arrivalUs < now - windowUs) {
+            continue;
+        }
+        summary.frames++;
+        summary.dropped += r.missingBefore;
+        summary.duplicated += r.duplicate ? 1 : 0;
+        if (firstArrival < 0) {
+            firstArrival = r.arrivalUs;
+        }
+        lastArrival = r.arrivalUs;
+        if (previousArrival >= 0) {
+            double interval = double(r.arrivalUs - previousArrival);
+            intervalSum += interval;
+            intervalSquares += interval * interval;
+            intervalCount++;
+        }
+        previousArrival = r.arrivalUs;
+
+        if (r.captureUs >= 0) {
+            captureSum += r.arrivalUs - r.captureUs;
+            captureCount++;
+        }
+        if (r.decodeUs >= 0) {
+            decodeSum += r.decodeUs;
+            decodeCount++;
+        }
+        if (r.presentUs >= 0) {
+            presentSum += r.presentUs - r.arrivalUs;
+            drawSum += r.drawUs;
+            presentCount++;
+        } else if (presenter && r.arrivalUs < now - paintGraceUs) {
+            summary.notPresented++;
+        }
+        if (r.captureUs >= 0 && (!presenter || r.presentUs >= 0)) {
+            totalSum += (presenter ? r.presentUs : r.arrivalUs) - r.captureUs;
+            totalCount++;
+        }
+    }
+
+    if (intervalCount > 0) {
+        double mean = intervalSum / intervalCount;
+        summary.jitterUs = std::sqrt(qMax(0.0, intervalSquares / intervalCount - mean * mean));
+        summary.arrivalFps = lastArrival > firstArrival ? intervalCount * 1e6 / (lastArrival - firstArrival) : 0;
+    }
+    if (captureCount > 0) {
+        summary.captureLatencyUs = captureSum / captureCount;
+    }
+    if (decodeCount > 0) {
+        summary.decodeUs = decodeSum / decodeCount;
+    }
+    if (presenter) {
+        summary.presentFps = presentCount * 1e6 / windowUs;
+        if (presentCount > 0) {
+            summary.presentLatencyUs = presentSum / presentCount;
+            summary.drawUs = drawSum / presentCount;
+        }
+    }
+    if (totalCount > 0) {
+        summary.totalLatencyUs = totalSum / totalCount;
+    }
+    return summary;
+}
+
+bool FrameMetrics::exportCsv(const QString &filePath, QString *errorString) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        if (errorString) {
+            *errorString = file.errorString();
+        }
+        return false;
+    }
+    const QList<Record> list = records();
+    bool relative;
+    {
+        QMutexLocker locker(&m_mutex);
+        relative = m_streamOriginUs < 0;
+    }
+
+    QTextStream out(&file);
+    out << "sequence,stream_us,capture_us,arrival_us,decode_us,present_us,draw_us,"
+           "capture_to_arrival_us,arrival_to_present_us,interval_us,missing_before,duplicate\n";
+    qint64 previousArrival = -1;
+    for (const Record &r : list) {
+        out << r.sequence << ',' << r.streamUs << ',' << r.captureUs << ',' << r.arrivalUs << ','
+            << r.decodeUs << ',' << r.presentUs << ',' << r.drawUs << ','
+            << (r.captureUs >= 0 ? r.arrivalUs - r.captureUs : -1) << ','
+            << (r.presentUs >= 0 ? r.presentUs - r.arrivalUs : -1) << ','
+            << (previousArrival >= 0 ? r.arrivalUs - previousArrival : -1) << ','
+            << r.missingBefore << ',' << (r.duplicate ? 1 : 0) << '\n';
+        previousArrival = r.arrivalUs;
+    }
+    out.flush();
+    if (file.error() != QFile::NoError) {
+        if (errorString) {
+            *errorString = file.errorString();
+        }
+        return false;
+    }
+    qCDebug(log_video_metrics) << "Exported" << list.size() << "frames to" << filePath
+                               << (relative ? "(relative capture latency)" : "");
+    return true;
+}
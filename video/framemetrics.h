@@ -0,0 +1,144 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef FRAMEMETRICS_H
+#define FRAMEMETRICS_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QTimer>
+#include <QVideoFrame>
+#include <QLoggingCategory>
+#include <atomic>
+#include <vector>
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_metrics)
+
+// One second of the video path, times in microseconds, -1 when not measured
+struct FrameMetricsSummary {
+    double inputFps = 0;            // Signal rate the capture chip reports
+    double captureFps = 0;          // Rate the capture format asks for
+    double arrivalFps = 0;          // Frames that reached the sink
+    double presentFps = -1;         // Frames painted, only with the software presenter
+    double jitterUs = 0;            // Standard deviation of the arrival intervals
+    double captureLatencyUs = -1;   // Capture to sink
+    bool captureLatencyRelative = false;
+    double decodeUs = -1;
+    double presentLatencyUs = -1;   // Sink to paint
+    double drawUs = -1;
+    double totalLatencyUs = -1;     // Capture to paint, or to the sink without the presenter
+    int frames = 0;
+    int dropped = 0;
+    int duplicated = 0;
+    int notPresented = 0;
+};
+Q_DECLARE_METATYPE(FrameMetricsSummary)
+
+/*
+ * Per frame timing of the video path: capture, decode, arrival at the sink
+ * and paint by the software presenter, all on the MediaClock.
+ *
+ * The capture time comes from QVideoFrame::startTime(). Synthetic sources
+ * know which MediaClock time their stream starts at, so their capture
+ * latency is absolute. Camera backends use their own clock, there the
+ * latency is measured against the fastest frame seen since the stream
+ * started, which still shows queueing in the backend.
+ *
+ * Gaps and repeats in the stream times, compared with the capture frame
+ * rate, count as dropped and duplicated frames.
+ */
+class FrameMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Record {
+        quint64 sequence = 0;
+        qint64 streamUs = -1;       // QVideoFrame::startTime()
+        qint64 captureUs = -1;
+        qint64 arrivalUs = 0;
+        qint64 decodeUs = -1;
+        qint64 presentUs = -1;
+        qint64 drawUs = -1;
+        int missingBefore = 0;      // Frames the stream skipped right before this one
+        bool duplicate = false;
+    };
+
+    static FrameMetrics& getInstance()
+    {
+        static FrameMetrics instance;
+        return instance;
+    }
+
+    FrameMetrics(FrameMetrics const&) = delete;
+    void operator=(FrameMetrics const&) = delete;
+
+    static const int HISTORY_SIZE = 4096;
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled.load(); }
+    void reset();
+
+    // MediaClock time of stream time zero, -1 when the source does not know
+    void setStreamOrigin(qint64 originUs);
+    void setPresenterActive(bool active) { m_presenterActive = active; }
+
+    // Safe to call from any thread, cheap no-ops while disabled
+    void frameArrived(const QVideoFrame &frame, quint64 sequence, qint64 arrivalUs);
+    // Reported by a decoder before the frame with this stream time arrives
+    void frameDecoded(qint64 streamUs, qint64 decodeUs);
+    void framePresented(quint64 sequence, qint64 presentUs, qint64 drawUs);
+
+    // Oldest first
+    QList<Record> records() const;
+    FrameMetricsSummary summary(qint64 windowUs = 1000000) const;
+    bool exportCsv(const QString &filePath, QString *errorString = nullptr) const;
+
+signals:
+    // Once a second while enabled
+    void summaryUpdated(const FrameMetricsSummary &summary);
+
+private:
+    explicit FrameMetrics(QObject *parent = nullptr);
+
+    Record *findRecord(quint64 sequence);
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<bool> m_presenterActive{false};
+    std::atomic<qint64> m_expectedIntervalUs{0};
+    QTimer m_timer;
+
+    mutable QMutex m_mutex;
+    std::vector<Record> m_ring;
+    int m_head = -1;
+    int m_count = 0;
+    qint64 m_streamOriginUs = -1;
+    qint64 m_minOffsetUs = 0;
+    bool m_haveOffset = false;
+    qint64 m_lastStreamUs = -1;
+    qint64 m_lastArrivalUs = -1;
+    // Decode times waiting for their frames, by stream time
+    QList<QPair<qint64, qint64>> m_decodes;
+};
+
+#endif // FRAMEMETRICS_H
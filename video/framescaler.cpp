@@ -0,0 +1,438 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "framescaler.h"
+
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+// Below this many target pixels the bands are not worth the pool round trip
+const int PARALLEL_PIXELS = 512 * 1024;
+
+void convertRowScalar(const uchar *y, const uchar *u, const uchar *v, int width, quint32 *dst,
+                      const YuvCoefficients &c)
+{
+    for (int i = 0; i < width; i++) {
+        dst[i] = FrameConverter::yuvToRgb32(y[i], u[i], v[i], c);
+    }
+}
+
+/*
+ * The vector kernels work on 16 bit lanes. Samples are shifted up by 7 bits
+ * and multiplied with _mm_mulhi_epi16 by the coefficients divided by 32, so
+ * the products keep 2 fractional bits that are rounded off after the sums.
+ * The result differs from the 16.16 scalar path by at most one step.
+ */
+struct Coefficients16 {
+    qint16 yOffset;
+    qint16 y;
+    qint16 rv;
+    qint16 gu;
+    qint16 gv;
+    qint16 bu;
+
+    explicit Coefficients16(const YuvCoefficients &c)
+        : yOffset(qint16(c.yOffset)), y(qint16((c.y + 16) >> 5)), rv(qint16((c.rv + 16) >> 5)),
+          gu(qint16((c.gu + 16) >> 5)), gv(qint16((c.gv + 16) >> 5)), bu(qint16((c.bu + 16) >> 5))
+    {
+    }
+};
+
+#ifdef OPF_HAVE_SSE2
+void convertRowSse2(const uchar *y, const uchar *u, const uchar *v, int width, quint32 *dst,
+                    const YuvCoefficients &c)
+{
+    const Coefficients16 k(c);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8(-1);
+    const __m128i yOffset = _mm_set1_epi16(k.yOffset);
+    const __m128i chromaOffset = _mm_set1_epi16(128);
+    const __m128i round = _mm_set1_epi16(2);
+    const __m128i cy = _mm_set1_epi16(k.y);
+    const __m128i crv = _mm_set1_epi16(k.rv);
+    const __m128i cgu = _mm_set1_epi16(k.gu);
+    const __m128i cgv = _mm_set1_epi16(k.gv);
+    const __m128i cbu = _mm_set1_epi16(k.bu);
+
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m128i ys = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(y + i)), zero);
+        __m128i us = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + i)), zero);
+        __m128i vs = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + i)), zero);
+        ys = _mm_slli_epi16(_mm_sub_epi16(ys, yOffset), 7);
+        us = _mm_slli_epi16(_mm_sub_epi16(us, chromaOffset), 7);
+        vs = _mm_slli_epi16(_mm_sub_epi16(vs, chromaOffset), 7);
+
+        __m128i luma = _mm_add_epi16(_mm_mulhi_epi16(ys, cy), round);
+        __m128i r = _mm_srai_epi16(_mm_adds_epi16(luma, _mm_mulhi_epi16(vs, crv)), 2);
+        __m128i g = _mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(luma, _mm_mulhi_epi16(us, cgu)),
+                                                  _mm_mulhi_epi16(vs, cgv)), 2);
+        __m128i b = _mm_srai_epi16(_mm_adds_epi16(luma, _mm_mulhi_epi16(us, cbu)), 2);
+
+        __m128i bg = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_packus_epi16(g, g));
+        __m128i ra = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4), _mm_unpackhi_epi16(bg, ra));
+    }
+    convertRowScalar(y + i, u + i, v + i, width - i, dst + i, c);
+}
+#endif
+
+#ifdef OPF_HAVE_AVX2
+OPF_TARGET_AVX2
+void convertRowAvx2(const uchar *y, const uchar *u, const uchar *v, int width, quint32 *dst,
+                    const YuvCoefficients &c)
+{
+    const Coefficients16 k(c);
+    const __m256i alpha = _mm256_set1_epi8(-1);
+    const __m256i yOffset = _mm256_set1_epi16(k.yOffset);
+    const __m256i chromaOffset = _mm256_set1_epi16(128);
+    const __m256i round = _mm256_set1_epi16(2);
+    const __m256i cy = _mm256_set1_epi16(k.y);
+    const __m256i crv = _mm256_set1_epi16(k.rv);
+    const __m256i cgu = _mm256_set1_epi16(k.gu);
+    const __m256i cgv = _mm256_set1_epi16(k.gv);
+    const __m256i cbu = _mm256_set1_epi16(k.bu);
+
+    int i = 0;
+    for (; i + 16 <= width; i += 16) {
+        __m256i ys = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(y + i)));
+        __m256i us = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(u + i)));
+        __m256i vs = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(v + i)));
+        ys = _mm256_slli_epi16(_mm256_sub_epi16(ys, yOffset), 7);
+        us = _mm256_slli_epi16(_mm256_sub_epi16(us, chromaOffset), 7);
+        vs = _mm256_slli_epi16(_mm256_sub_epi16(vs, chromaOffset), 7);
+
+        __m256i luma = _mm256_add_epi16(_mm256_mulhi_epi16(ys, cy), round);
+        __m256i r = _mm256_srai_epi16(_mm256_adds_epi16(luma, _mm256_mulhi_epi16(vs, crv)), 2);
+        __m256i g = _mm256_srai_epi16(_mm256_subs_epi16(_mm256_subs_epi16(luma, _mm256_mulhi_epi16(us, cgu)),
+                                                        _mm256_mulhi_epi16(vs, cgv)), 2);
+        __m256i b = _mm256_srai_epi16(_mm256_adds_epi16(luma, _mm256_mulhi_epi16(us, cbu)), 2);
+
+        // Packing and unpacking stay within 128 bit lanes, so the low lane
+        // holds pixels 0-3 and 8-11 and the high lane 4-7 and 12-15
+        __m256i bg = _mm256_unpacklo_epi8(_mm256_packus_epi16(b, b), _mm256_packus_epi16(g, g));
+        __m256i ra = _mm256_unpacklo_epi8(_mm256_packus_epi16(r, r), alpha);
+        __m256i lo = _mm256_unpacklo_epi16(bg, ra);
+        __m256i hi = _mm256_unpackhi_epi16(bg, ra);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    convertRowScalar(y + i, u + i, v + i, width - i, dst + i, c);
+}
+#endif
+
+using ConvertFn = void (*)(const uchar *, const uchar *, const uchar *, int, quint32 *, const YuvCoefficients &);
+
+ConvertFn convertFor(Simd::Level level)
+{
+#ifdef OPF_HAVE_AVX2
+    if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+        return convertRowAvx2;
+    }
+#endif
+#ifdef OPF_HAVE_SSE2
+    if (level != Simd::Level::Scalar) {
+        return convertRowSse2;
+    }
+#endif
+    Q_UNUSED(level);
+    return convertRowScalar;
+}
+
+bool isPackedRgb(QVideoFrameFormat::PixelFormat format)
+{
+    switch (format) {
+    case QVideoFrameFormat::Format_BGRX8888:
+    case QVideoFrameFormat::Format_BGRA8888:
+    case QVideoFrameFormat::Format_RGBX8888:
+    case QVideoFrameFormat::Format_RGBA8888:
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct Band {
+    int firstRow;
+    int lastRow;
+};
+
+} // namespace
+
+bool FrameScaler::isSupported(QVideoFrameFormat::PixelFormat format)
+{
+    switch (format) {
+    case QVideoFrameFormat::Format_YUYV:
+    case QVideoFrameFormat::Format_UYVY:
+    case QVideoFrameFormat::Format_NV12:
+    case QVideoFrameFormat::Format_NV21:
+    case QVideoFrameFormat::Format_YUV420P:
+    case QVideoFrameFormat::Format_YV12:
+    case QVideoFrameFormat::Format_YUV422P:
+        return true;
+    default:
+        return isPackedRgb(format);
+    }
+}
+
+void FrameScaler::setGeometry(const QSize &source, const QSize &target, const QRect &crop)
+{
+    const QRect bounds(QPoint(0, 0), source);
+    QRect area = crop.isEmpty() ? bounds : crop.intersected(bounds);
+    if (area.isEmpty()) {
+        area = bounds;
+    }
+    if (source == m_source && target == m_target && area == m_crop) {
+        return;
+    }
+    m_source = source;
+    m_target = target;
+    m_crop = area;
+    m_columns.resize(qMax(0, target.width()));
+    m_rows.resize(qMax(0, target.height()));
+    // Sample at the centre of every target pixel
+    for (int x = 0; x < target.width(); x++) {
+        m_columns[x] = area.x() + int((qint64(2 * x + 1) * area.width()) / (2 * target.width()));
+    }
+    for (int y = 0; y < target.height(); y++) {
+        m_rows[y] = area.y() + int((qint64(2 * y + 1) * area.height()) / (2 * target.height()));
+    }
+}
+
+QRect FrameScaler::targetRectFor(const QRect &sourceRect) const
+{
+    if (m_crop.isEmpty() || m_target.isEmpty()) {
+        return QRect();
+    }
+    const QRect visible = sourceRect.intersected(m_crop).translated(-m_crop.topLeft());
+    if (visible.isEmpty()) {
+        return QRect();
+    }
+    const int w = m_crop.width();
+    const int h = m_crop.height();
+    int x0 = int(qint64(visible.left()) * m_target.width() / w) - 1;
+    int y0 = int(qint64(visible.top()) * m_target.height() / h) - 1;
+    int x1 = int((qint64(visible.right() + 1) * m_target.width() + w - 1) / w);
+    int y1 = int((qint64(visible.bottom() + 1) * m_target.height() + h - 1) / h);
+    return QRect(QPoint(x0, y0), QPoint(x1, y1)).intersected(QRect(QPoint(0, 0), m_target));
+}
+
+void FrameScaler::convertRow(const uchar *y, const uchar *u, const uchar *v, int width, quint32 *dst,
+                             const YuvCoefficients &c, Simd::Level level)
+{
+    convertFor(level)(y, u, v, width, dst, c);
+}
+
+bool FrameScaler::convert(const QVideoFrame &frame, const QRect &targetRect, QImage *image,
+                          Simd::Level level) const
+{
+    if (!frame.isMapped() || frame.size() != m_source || !isSupported(frame.pixelFormat())
+        || image->size() != m_target || image->format() != QImage::Format_RGB32) {
+        return false;
+    }
+    QRect rect = targetRect.intersected(QRect(QPoint(0, 0), m_target));
+    if (rect.isEmpty()) {
+        return true;
+    }
+
+    YuvCoefficients c = FrameConverter::coefficientsFor(frame.surfaceFormat());
+    const int threads = QThreadPool::globalInstance()->maxThreadCount();
+    if (qint64(rect.width()) * rect.height() < PARALLEL_PIXELS || threads < 2) {
+        convertRows(frame, rect, rect.top(), rect.bottom(), image, c, level);
+        return true;
+    }
+
+    const int bandRows = qMax(16, rect.height() / threads);
+    QList<Band> bands;
+    for (int y = rect.top(); y <= rect.bottom(); y += bandRows) {
+        bands.append(Band{y, qMin(rect.bottom(), y + bandRows - 1)});
+    }
+    QtConcurrent::blockingMap(bands, [&](Band &band) {
+        convertRows(frame, rect, band.firstRow, band.lastRow, image, c, level);
+    });
+    return true;
+}
+
+void FrameScaler::convertRows(const QVideoFrame &frame, const QRect &targetRect, int firstRow, int lastRow,
+                              QImage *image, const YuvCoefficients &c, Simd::Level level) const
+{
+    const QVideoFrameFormat::PixelFormat format = frame.pixelFormat();
+    const int x0 = targetRect.left();
+    const int width = targetRect.width();
+    const int *columns = m_columns.data() + x0;
+    const ConvertFn convertRowFn = convertFor(level);
+
+    std::vector<uchar> samples(size_t(width) * 3);
+    uchar *ys = samples.data();
+    uchar *us = ys + width;
+    uchar *vs = us + width;
+
+    // Index of Y, U and V in a YUYV or UYVY macropixel
+    const bool uyvy = format == QVideoFrameFormat::Format_UYVY;
+    const int yIndex = uyvy ? 1 : 0;
+    const int uIndex = uyvy ? 0 : 1;
+    const int vIndex = uyvy ? 2 : 3;
+    const bool nv21 = format == QVideoFrameFormat::Format_NV21;
+    const int uPlane = format == QVideoFrameFormat::Format_YV12 ? 2 : 1;
+    const int vPlane = 3 - uPlane;
+    const bool swapRedBlue = format == QVideoFrameFormat::Format_RGBX8888
+                             || format == QVideoFrameFormat::Format_RGBA8888;
+
+    int previousRow = -1;
+    for (int ty = firstRow; ty <= lastRow; ty++) {
+        const int sy = m_rows[ty];
+        quint32 *dst = reinterpret_cast<quint32 *>(image->scanLine(ty)) + x0;
+        if (sy == previousRow) {
+            // Upscaling repeats source rows, copy the row converted just before
+            memcpy(dst, reinterpret_cast<const quint32 *>(image->constScanLine(ty - 1)) + x0,
+                   size_t(width) * 4);
+            continue;
+        }
+        previousRow = sy;
+
+        const uchar *row = frame.bits(0) + qsizetype(sy) * frame.bytesPerLine(0);
+        switch (format) {
+        case QVideoFrameFormat::Format_YUYV:
+        case QVideoFrameFormat::Format_UYVY:
+            for (int i = 0; i < width; i++) {
+                const int sx = columns[i];
+                const uchar *m = row + (sx >> 1) * 4;
+                ys[i] = m[yIndex + (sx & 1) * 2];
+                us[i] = m[uIndex];
+                vs[i] = m[vIndex];
+            }
+            break;
+        case QVideoFrameFormat::Format_NV12:
+        case QVideoFrameFormat::Format_NV21: {
+            const uchar *uvRow = frame.bits(1) + qsizetype(sy >> 1) * frame.bytesPerLine(1);
+            for (int i = 0; i < width; i++) {
+                const int sx = columns[i];
+                const uchar *uv = uvRow + (sx >> 1) * 2;
+                ys[i] = row[sx];
+                us[i] = uv[nv21 ? 1 : 0];
+                vs[i] = uv[nv21 ? 0 : 1];
+            }
+            break;
+        }
+        case QVideoFrameFormat::Format_YUV420P:
+        case QVideoFrameFormat::Format_YV12:
+        case QVideoFrameFormat::Format_YUV422P: {
+            const int chromaRow = format == QVideoFrameFormat::Format_YUV422P ? sy : sy >> 1;
+            const uchar *uRow = frame.bits(uPlane) + qsizetype(chromaRow) * frame.bytesPerLine(uPlane);
+            const uchar *vRow = frame.bits(vPlane) + qsizetype(chromaRow) * frame.bytesPerLine(vPlane);
+            for (int i = 0; i < width; i++) {
+                const int sx = columns[i];
+                ys[i] = row[sx];
+                us[i] = uRow[sx >> 1];
+                vs[i] = vRow[sx >> 1];
+            }
+            break;
+        }
+        default: {
+            // Packed RGB only needs the gather
+            const quint32 *src = reinterpret_cast<const quint32 *>(row);
+            for (int i = 0; i < width; i++) {
+                quint32 px = src[columns[i]];
+                if (swapRedBlue) {
+                    px = ((px & 0xFF) << 16) | (px & 0xFF00) | ((px >> 16) & 0xFF);
+                }
+                dst[i] = 0xFF000000u | px;
+            }
+            continue;
+        }
+        }
+        convertRowFn(ys, us, vs, width, dst, c);
+    }
+}
+
+void FrameScaler::runBenchmark()
+{
+    const QSize source(1920, 1080);
+    const QSize targets[] = {QSize(2560, 1440), QSize(1280, 720)};
+    const int iterations = 50;
+
+    // YUYV gradient, the format the capture card delivers
+    QVideoFrame frame(QVideoFrameFormat(source, QVideoFrameFormat::Format_YUYV));
+    if (!frame.map(QVideoFrame::WriteOnly)) {
+        qWarning() << "present: failed to map the benchmark frame";
+        return;
+    }
+    for (int y = 0; y < source.height(); y++) {
+        uchar *row = frame.bits(0) + qsizetype(y) * frame.bytesPerLine(0);
+        for (int x = 0; x < source.width(); x += 2) {
+            row[x * 2] = uchar(16 + x % 220);
+            row[x * 2 + 1] = uchar(y % 256);
+            row[x * 2 + 2] = uchar(16 + (x + 1) % 220);
+            row[x * 2 + 3] = uchar(255 - y % 256);
+        }
+    }
+    frame.unmap();
+    frame.map(QVideoFrame::ReadOnly);
+
+    const Simd::Level levels[] = {Simd::Level::Scalar, Simd::Level::Sse2, Simd::Level::Avx2};
+    for (const QSize &target : targets) {
+        FrameScaler scaler;
+        scaler.setGeometry(source, target);
+        QImage image(target, QImage::Format_RGB32);
+        const QRect full(QPoint(0, 0), target);
+        // A typical incremental update, a 256x64 region of the source
+        const QRect partial = scaler.targetRectFor(QRect(800, 500, 256, 64));
+        // The centre quarter of the frame, as shown at 4x zoom
+        FrameScaler zoomed;
+        zoomed.setGeometry(source, target, QRect(720, 405, 480, 270));
+        for (Simd::Level level : levels) {
+            if (!Simd::isSupported(level)) {
+                continue;
+            }
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < iterations; i++) {
+                scaler.convert(frame, full, &image, level);
+            }
+            double fullUs = timer.nsecsElapsed() / (iterations * 1000.0);
+            timer.restart();
+            for (int i = 0; i < iterations; i++) {
+                scaler.convert(frame, partial, &image, level);
+            }
+            double partialUs = timer.nsecsElapsed() / (iterations * 1000.0);
+            timer.restart();
+            for (int i = 0; i < iterations; i++) {
+                zoomed.convert(frame, full, &image, level);
+            }
+            double zoomedUs = timer.nsecsElapsed() / (iterations * 1000.0);
+            qInfo().noquote() << QString("present 1080p->%1x%2 %3: %4 us full frame, %5 us dirty region, %6 us zoomed 4x")
+                                     .arg(target.width())
+                                     .arg(target.height())
+                                     .arg(Simd::levelName(level), -6)
+                                     .arg(fullUs, 0, 'f', 0)
+                                     .arg(partialUs, 0, 'f', 1)
+                                     .arg(zoomedUs, 0, 'f', 0);
+        }
+    }
+    frame.unmap();
+}
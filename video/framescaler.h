@@ -0,0 +1,89 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef FRAMESCALER_H
+#define FRAMESCALER_H
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QVideoFrame>
+#include <vector>
+
+#include "simd.h"
+#include "frameconverter.h"
+
+/*
+ * Converts a mapped YUV frame to RGB32 and scales it to a target size in a
+ * single pass, nearest neighbour. For every target row the source samples
+ * are gathered through precomputed column and row maps, then converted
+ * eight (SSE2) or sixteen (AVX2) pixels per step straight into the target
+ * scanline, so no full size RGB copy of the frame is ever made.
+ *
+ * Only a rectangle of the target is written, which lets a presenter redraw
+ * just the areas that changed since the previous frame. The maps can also
+ * cover a crop of the source, so a zoomed view reads only the visible part
+ * of the frame and costs the same as an unzoomed one.
+ */
+class FrameScaler
+{
+public:
+    static bool isSupported(QVideoFrameFormat::PixelFormat format);
+
+    // Recomputes the maps, cheap when nothing changed. crop is the part of
+    // the source scaled to the target, an empty crop means the whole frame.
+    void setGeometry(const QSize &source, const QSize &target, const QRect &crop = QRect());
+    QSize sourceSize() const { return m_source; }
+    QSize targetSize() const { return m_target; }
+    QRect crop() const { return m_crop; }
+
+    // Target rectangle covering a source rectangle, grown by a pixel so
+    // rounding at the edges never leaves stale pixels behind. Empty when the
+    // source rectangle is outside the crop.
+    QRect targetRectFor(const QRect &sourceRect) const;
+
+    // frame must be mapped for reading and match the source size, image must
+    // be a Format_RGB32 image of the target size. Large areas are split into
+    // bands converted on the global thread pool.
+    bool convert(const QVideoFrame &frame, const QRect &targetRect, QImage *image,
+                 Simd::Level level = Simd::bestLevel()) const;
+
+    // Converts width pixels from separate Y, U and V sample arrays
+    static void convertRow(const uchar *y, const uchar *u, const uchar *v, int width, quint32 *dst,
+                           const YuvCoefficients &c, Simd::Level level = Simd::bestLevel());
+
+    // Prints the time to present a 1080p frame into a 1440p and a 720p window,
+    // unzoomed and zoomed in 4x
+    static void runBenchmark();
+
+private:
+    void convertRows(const QVideoFrame &frame, const QRect &targetRect, int firstRow, int lastRow,
+                     QImage *image, const YuvCoefficients &c, Simd::Level level) const;
+
+    QSize m_source;
+    QSize m_target;
+    QRect m_crop;
+    std::vector<int> m_columns;     // Source column for every target column
+    std::vector<int> m_rows;        // Source row for every target row
+};
+
+#endif // FRAMESCALER_H
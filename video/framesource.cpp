@@ -0,0 +1,606 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "framesource.h"
+#include "framedistributor.h"
+#include "frameconverter.h"
+#include "framediff.h"
+#include "screenshotwriter.h"
+#include "mjpegdecoder.h"
+#include "framemetrics.h"
+#include "host/mediaclock.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QImage>
+#include <QSettings>
+#include <QDebug>
+#include <cstring>
+#include <vector>
+
+Q_LOGGING_CATEGORY(log_video_source, "opf.core.video.source")
+
+namespace {
+
+struct Yuv {
+    uchar y;
+    uchar u;
+    uchar v;
+};
+
+// BT.601 limited range, the same as the capture card delivers
+Yuv rgbToYuv(int r, int g, int b)
+{
+    return Yuv{static_cast<uchar>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16),
+               static_cast<uchar>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128),
+               static_cast<uchar>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128)};
+}
+
+const Yuv YUV_BLACK = {16, 128, 128};
+const Yuv YUV_WHITE = {235, 128, 128};
+
+// rect must start and end on even coordinates, frame must be mapped writable
+void fillRect(QVideoFrame &frame, const QRect &rect, const Yuv &color)
+{
+    QRect area = rect.intersected(QRect(QPoint(0, 0), frame.size()));
+    if (frame.pixelFormat() == QVideoFrameFormat::Format_YUYV) {
+        for (int y = area.top(); y <= area.bottom(); y++) {
+            uchar *row = frame.bits(0) + y * frame.bytesPerLine(0);
+            for (int x = area.left(); x < area.right(); x += 2) {
+                uchar *px = row + x * 2;
+                px[0] = color.y;
+                px[1] = color.u;
+                px[2] = color.y;
+                px[3] = color.v;
+            }
+        }
+    } else {
+        for (int y = area.top(); y <= area.bottom(); y++) {
+            memset(frame.bits(0) + y * frame.bytesPerLine(0) + area.left(), color.y, area.width());
+            if ((y & 1) == 0) {
+                uchar *uv = frame.bits(1) + (y / 2) * frame.bytesPerLine(1);
+                for (int x = area.left(); x < area.right(); x += 2) {
+                    uv[x] = color.u;
+                    uv[x + 1] = color.v;
+                }
+            }
+        }
+    }
+}
+
+int planeHeight(const QVideoFrame &frame, int plane)
+{
+    return plane > 0 && frame.pixelFormat() == QVideoFrameFormat::Format_NV12 ? frame.height() / 2 : frame.height();
+}
+
+// Both frames must be mapped and have the same format and size
+void copyPlanes(const QVideoFrame &src, QVideoFrame &dst)
+{
+    for (int plane = 0; plane < src.planeCount(); plane++) {
+        int rowBytes = qMin(src.bytesPerLine(plane), dst.bytesPerLine(plane));
+        for (int y = 0; y < planeHeight(src, plane); y++) {
+            memcpy(dst.bits(plane) + y * dst.bytesPerLine(plane), src.bits(plane) + y * src.bytesPerLine(plane), rowBytes);
+        }
+    }
+}
+
+QSize sizeFromString(const QString &text, const QSize &fallback)
+{
+    QStringList parts = text.toLower().split('x');
+    if (parts.size() != 2) {
+        return fallback;
+    }
+    QSize size(parts[0].toInt(), parts[1].toInt());
+    return size.isValid() && !size.isEmpty() ? size : fallback;
+}
+
+} // namespace
+
+void FrameSource::deliver(QVideoFrame &frame)
+{
+    m_delivered++;
+    if (m_sink) {
+        m_sink->setVideoFrame(frame);
+    } else {
+        FrameDistributor::getInstance().pushFrame(frame);
+    }
+}
+
+FrameSource::Type FrameSource::typeFromString(const QString &name)
+{
+    QString type = name.trimmed().toLower();
+    if (type == "testpattern" || type == "pattern") {
+        return Type::TestPattern;
+    }
+    if (type == "file") {
+        return Type::File;
+    }
+    return Type::Camera;
+}
+
+FrameSource::Settings FrameSource::loadSettings()
+{
+    QSettings settings("Techxartisan", "Openterface");
+    QString type = settings.value("video/source", "camera").toString();
+    QString filePath = settings.value("video/sourceFile").toString();
+    QString size = settings.value("video/sourceSize", "1920x1080").toString();
+    int fps = settings.value("video/sourceFps", 30).toInt();
+    QString format = settings.value("video/sourceFormat").toString();
+
+    QStringList arguments = QCoreApplication::arguments();
+    auto argument = [&arguments](const QString &name, const QString &fallback) {
+        int index = arguments.indexOf(name);
+        return index != -1 && index + 1 < arguments.size() ? arguments[index + 1] : fallback;
+    };
+    type = argument("--source", type);
+    filePath = argument("--source-file", filePath);
+    size = argument("--source-size", size);
+    fps = argument("--source-fps", QString::number(fps)).toInt();
+    format = argument("--source-format", format).toLower();
+
+    Settings result;
+    result.type = typeFromString(type);
+    result.filePath = filePath;
+    result.size = sizeFromString(size, result.size);
+    result.fps = qBound(1, fps, 240);
+    if (format.isEmpty()) {
+        QString suffix = QFileInfo(filePath).suffix().toLower();
+        format = suffix == "nv12" ? "nv12" : (suffix == "mjpeg" || suffix == "mjpg" || suffix == "jpg") ? "mjpeg" : "yuyv";
+    }
+    result.mjpeg = format == "mjpeg" || format == "mjpg";
+    result.pixelFormat = format == "nv12" ? QVideoFrameFormat::Format_NV12 : QVideoFrameFormat::Format_YUYV;
+    return result;
+}
+
+std::unique_ptr<FrameSource> FrameSource::create(const Settings &settings, QObject *parent)
+{
+    switch (settings.type) {
+    case Type::TestPattern:
+        return std::make_unique<TestPatternSource>(settings.size, settings.fps, settings.pixelFormat, parent);
+    case Type::File:
+        return std::make_unique<FileFrameSource>(settings.filePath, settings.size, settings.fps,
+                                                 settings.pixelFormat, settings.mjpeg, parent);
+    case Type::Camera:
+        break;
+    }
+    return nullptr;
+}
+
+CameraFrameSource::CameraFrameSource(QCamera *camera, QObject *parent)
+    : FrameSource(parent), m_camera(camera)
+{
+    if (m_camera) {
+        connect(m_camera, &QCamera::activeChanged, this, &FrameSource::activeChanged);
+        connect(m_camera, &QCamera::errorOccurred, this, [this](QCamera::Error error, const QString &errorString) {
+            Q_UNUSED(error);
+            emit errorOccurred(errorString);
+        });
+    }
+    m_decoder = std::make_unique<MjpegDecoder>(this, [this](const QVideoFrame &decoded, qint64 startUs, qint64 latencyUs) {
+        FrameMetrics::getInstance().frameDecoded(startUs, latencyUs);
+        QVideoFrame frame(decoded);
+        frame.setStartTime(startUs);
+        deliver(frame);
+    });
+    // Direct, so the backend thread hands a JPEG frame to the decoder and
+    // frames the decoder drops never queue up on the GUI thread
+    connect(&m_captureSink, &QVideoSink::videoFrameChanged, this, [this](const QVideoFrame &frame) {
+        captured(frame);
+    }, Qt::DirectConnection);
+}
+
+CameraFrameSource::~CameraFrameSource()
+{
+    disconnect(&m_captureSink, nullptr, this, nullptr);
+}
+
+void CameraFrameSource::captured(const QVideoFrame &frame)
+{
+    if (frame.pixelFormat() != QVideoFrameFormat::Format_Jpeg) {
+        QVideoFrame passed(frame);
+        deliver(passed);
+        return;
+    }
+    QVideoFrame jpeg(frame);
+    if (!jpeg.map(QVideoFrame::ReadOnly)) {
+        return;
+    }
+    // Copied, the backend reuses its buffer once the frame is released
+    QByteArray data(reinterpret_cast<const char *>(jpeg.bits(0)), jpeg.mappedBytes(0));
+    jpeg.unmap();
+    m_decoder->submit(data, frame.startTime());
+}
+
+bool CameraFrameSource::start()
+{
+    if (!m_camera) {
+        return false;
+    }
+    m_camera->start();
+    return true;
+}
+
+void CameraFrameSource::stop()
+{
+    if (m_camera) {
+        m_camera->stop();
+    }
+}
+
+bool CameraFrameSource::isActive() const
+{
+    return m_camera && m_camera->isActive();
+}
+
+QString CameraFrameSource::description() const
+{
+    return m_camera ? m_camera->cameraDevice().description() : QString();
+}
+
+TimedFrameSource::TimedFrameSource(int fps, QObject *parent)
+    : FrameSource(parent), m_fps(qMax(1, fps))
+{
+    // Poll at twice the frame rate so a frame is never more than half a period late
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_timer.setInterval(qMax(1, 500 / m_fps));
+    connect(&m_timer, &QTimer::timeout, this, &TimedFrameSource::tick);
+}
+
+bool TimedFrameSource::start()
+{
+    if (m_timer.isActive()) {
+        return true;
+    }
+    if (!open()) {
+        return false;
+    }
+    m_lastIndex = -1;
+    m_clock.start();
+    m_originUs = MediaClock::nowUs();
+    m_timer.start();
+    qCDebug(log_video_source) << "Started" << description();
+    emit activeChanged(true);
+    return true;
+}
+
+void TimedFrameSource::stop()
+{
+    if (!m_timer.isActive()) {
+        return;
+    }
+    m_timer.stop();
+    qCDebug(log_video_source) << "Stopped" << description() << "after" << deliveredFrames() << "frames";
+    emit activeChanged(false);
+}
+
+void TimedFrameSource::tick()
+{
+    qint64 index = m_clock.elapsed() * m_fps / 1000;
+    if (index == m_lastIndex) {
+        return;
+    }
+    m_lastIndex = index;
+    produce(static_cast<quint64>(index));
+}
+
+void TimedFrameSource::produce(quint64 index)
+{
+    QVideoFrame frame = frameAt(index);
+    if (!frame.isValid()) {
+        return;
+    }
+    frame.setStartTime(qint64(index) * 1000000 / m_fps);
+    frame.setEndTime(qint64(index + 1) * 1000000 / m_fps);
+    deliver(frame);
+}
+
+TestPatternSource::TestPatternSource(const QSize &size, int fps, QVideoFrameFormat::PixelFormat pixelFormat,
+                                     QObject *parent)
+    : TimedFrameSource(fps, parent)
+{
+    // Room for the counter and the marker, even dimensions for the chroma
+    QSize minimum(COUNTER_BITS * COUNTER_BLOCK, 4 * MARKER_SIZE);
+    m_size = size.expandedTo(minimum);
+    m_size = QSize(m_size.width() & ~1, m_size.height() & ~1);
+    if (pixelFormat != QVideoFrameFormat::Format_NV12) {
+        pixelFormat = QVideoFrameFormat::Format_YUYV;
+    }
+    m_format = QVideoFrameFormat(m_size, pixelFormat);
+    m_format.setFrameRate(m_fps);
+    m_format.setColorSpace(QVideoFrameFormat::ColorSpace_BT601);
+    m_format.setColorRange(QVideoFrameFormat::ColorRange_Video);
+
+    // 75% colour bars over a grey ramp, drawn once and copied into every frame
+    m_background = QVideoFrame(m_format);
+    if (!m_background.map(QVideoFrame::WriteOnly)) {
+        qCWarning(log_video_source) << "Failed to map the test pattern background";
+        return;
+    }
+    static const int bars[7][3] = {
+        {191, 191, 191}, {191, 191, 0}, {0, 191, 191}, {0, 191, 0}, {191, 0, 191}, {191, 0, 0}, {0, 0, 191}
+    };
+    int barsHeight = (m_size.height() * 2 / 3) & ~1;
+    for (int i = 0; i < 7; i++) {
+        int left = (i * m_size.width() / 7) & ~1;
+        int right = ((i + 1) * m_size.width() / 7) & ~1;
+        fillRect(m_background, QRect(left, 0, right - left, barsHeight), rgbToYuv(bars[i][0], bars[i][1], bars[i][2]));
+    }
+    for (int x = 0; x < m_size.width(); x += 2) {
+        uchar level = static_cast<uchar>(16 + x * 219 / m_size.width());
+        fillRect(m_background, QRect(x, barsHeight, 2, m_size.height() - barsHeight), Yuv{level, 128, 128});
+    }
+    m_background.unmap();
+}
+
+QString TestPatternSource::description() const
+{
+    return QString("Test pattern %1x%2@%3 %4")
+        .arg(m_size.width())
+        .arg(m_size.height())
+        .arg(m_fps)
+        .arg(m_format.pixelFormat() == QVideoFrameFormat::Format_NV12 ? "NV12" : "YUYV");
+}
+
+QPoint TestPatternSource::markerPosition(quint64 index) const
+{
+    int range = m_size.width() - MARKER_SIZE;
+    int x = static_cast<int>((index * 8) % static_cast<quint64>(range)) & ~1;
+    int y = (m_size.height() * 2 / 3 - MARKER_SIZE / 2) & ~1;
+    return QPoint(x, y);
+}
+
+QVideoFrame TestPatternSource::frameAt(quint64 index)
+{
+    QVideoFrame frame(m_format);
+    if (!m_background.map(QVideoFrame::ReadOnly)) {
+        return QVideoFrame();
+    }
+    if (!frame.map(QVideoFrame::WriteOnly)) {
+        m_background.unmap();
+        return QVideoFrame();
+    }
+    copyPlanes(m_background, frame);
+    m_background.unmap();
+
+    fillRect(frame, QRect(markerPosition(index), QSize(MARKER_SIZE, MARKER_SIZE)), rgbToYuv(255, 32, 32));
+    for (int bit = 0; bit < COUNTER_BITS; bit++) {
+        bool set = (index >> (COUNTER_BITS - 1 - bit)) & 1;
+        fillRect(frame, QRect(bit * COUNTER_BLOCK, 0, COUNTER_BLOCK, COUNTER_BLOCK), set ? YUV_WHITE : YUV_BLACK);
+    }
+    frame.unmap();
+    return frame;
+}
+
+qint64 TestPatternSource::decodeCounter(const QVideoFrame &frame)
+{
+    if (frame.width() < COUNTER_BITS * COUNTER_BLOCK || frame.height() < COUNTER_BLOCK) {
+        return -1;
+    }
+    QImage strip = FrameConverter::toGray(frame, QRect(0, 0, COUNTER_BITS * COUNTER_BLOCK, COUNTER_BLOCK));
+    if (strip.isNull()) {
+        return -1;
+    }
+    const uchar *row = strip.constScanLine(COUNTER_BLOCK / 2);
+    quint64 value = 0;
+    for (int bit = 0; bit < COUNTER_BITS; bit++) {
+        int level = row[bit * COUNTER_BLOCK + COUNTER_BLOCK / 2];
+        // Anything in between means this is not a test pattern frame
+        if (level > 64 && level < 192) {
+            return -1;
+        }
+        value = (value << 1) | (level >= 192 ? 1 : 0);
+    }
+    return static_cast<qint64>(value);
+}
+
+FileFrameSource::FileFrameSource(const QString &filePath, const QSize &size, int fps,
+                                 QVideoFrameFormat::PixelFormat pixelFormat, bool mjpeg, QObject *parent)
+    : TimedFrameSource(fps, parent), m_file(filePath), m_size(QSize(size.width() & ~1, size.height() & ~1)),
+      m_pixelFormat(pixelFormat == QVideoFrameFormat::Format_NV12 ? pixelFormat : QVideoFrameFormat::Format_YUYV),
+      m_mjpeg(mjpeg)
+{
+}
+
+FileFrameSource::~FileFrameSource() = default;
+
+QString FileFrameSource::description() const
+{
+    return QString("File %1 (%2 frames)").arg(m_file.fileName()).arg(frameCount());
+}
+
+int FileFrameSource::frameCount() const
+{
+    if (m_mjpeg) {
+        return m_jpegFrames.size();
+    }
+    return m_frameBytes > 0 ? static_cast<int>(m_dataSize / m_frameBytes) : 0;
+}
+
+bool FileFrameSource::open()
+{
+    if (m_data) {
+        return true;
+    }
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        emit errorOccurred(tr("Failed to open %1").arg(m_file.fileName()));
+        return false;
+    }
+    m_dataSize = m_file.size();
+    m_data = m_file.map(0, m_dataSize);
+    if (!m_data) {
+        m_file.close();
+        emit errorOccurred(tr("Failed to map %1").arg(m_file.fileName()));
+        return false;
+    }
+
+    if (m_mjpeg) {
+        m_jpegFrames = MjpegDecoder::indexStream(m_data, m_dataSize);
+    } else {
+        m_frameBytes = qint64(m_size.width()) * m_size.height() * (m_pixelFormat == QVideoFrameFormat::Format_NV12 ? 3 : 4) / 2;
+    }
+
+    if (frameCount() == 0) {
+        emit errorOccurred(tr("%1 does not contain a whole frame").arg(m_file.fileName()));
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = nullptr;
+        m_file.close();
+        return false;
+    }
+    qCDebug(log_video_source) << "Opened" << description();
+    return true;
+}
+
+void FileFrameSource::produce(quint64 index)
+{
+    if (!m_mjpeg || frameCount() == 0) {
+        TimedFrameSource::produce(index);
+        return;
+    }
+    if (!m_decoder) {
+        m_decoder = std::make_unique<MjpegDecoder>(this, [this](const QVideoFrame &decoded, qint64 startUs, qint64 latencyUs) {
+            FrameMetrics::getInstance().frameDecoded(startUs, latencyUs);
+            QVideoFrame frame(decoded);
+            frame.setStartTime(startUs);
+            frame.setEndTime(startUs + 1000000 / m_fps);
+            deliver(frame);
+        });
+    }
+    const QPair<qint64, qint64> &jpeg = m_jpegFrames[static_cast<int>(index % static_cast<quint64>(frameCount()))];
+    // Copied, the decode runs on the pool while the mapping may go away
+    QByteArray data(reinterpret_cast<const char *>(m_data) + jpeg.first, static_cast<int>(jpeg.second));
+    m_decoder->submit(data, qint64(index) * 1000000 / m_fps);
+}
+
+QVideoFrame FileFrameSource::frameAt(quint64 index)
+{
+    if (!m_data && !open()) {
+        return QVideoFrame();
+    }
+    int frameIndex = static_cast<int>(index % static_cast<quint64>(frameCount()));
+
+    if (m_mjpeg) {
+        const QPair<qint64, qint64> &jpeg = m_jpegFrames[frameIndex];
+        return MjpegDecoder::decode(QByteArray::fromRawData(reinterpret_cast<const char *>(m_data) + jpeg.first,
+                                                            static_cast<int>(jpeg.second)));
+    }
+
+    QVideoFrameFormat format(m_size, m_pixelFormat);
+    format.setFrameRate(m_fps);
+    format.setColorSpace(QVideoFrameFormat::ColorSpace_BT601);
+    format.setColorRange(QVideoFrameFormat::ColorRange_Video);
+    QVideoFrame frame(format);
+    if (!frame.map(QVideoFrame::WriteOnly)) {
+        return QVideoFrame();
+    }
+    const uchar *src = m_data + frameIndex * m_frameBytes;
+    if (m_pixelFormat == QVideoFrameFormat::Format_NV12) {
+        int width = m_size.width();
+        for (int y = 0; y < m_size.height(); y++, src += width) {
+            memcpy(frame.bits(0) + y * frame.bytesPerLine(0), src, width);
+        }
+        for (int y = 0; y < m_size.height() / 2; y++, src += width) {
+            memcpy(frame.bits(1) + y * frame.bytesPerLine(1), src, width);
+        }
+    } else {
+        int rowBytes = m_size.width() * 2;
+        for (int y = 0; y < m_size.height(); y++, src += rowBytes) {
+            memcpy(frame.bits(0) + y * frame.bytesPerLine(0), src, rowBytes);
+        }
+    }
+    frame.unmap();
+    return frame;
+}
+
+/*
+ * Runs frames of the test pattern, and of the configured file source if
+ * there is one, through the conversion, diff and screenshot stages without
+ * a timer, so the numbers do not depend on the frame rate.
+ */
+void FrameSource::runBenchmark()
+{
+    const int frames = 120;
+    std::vector<std::unique_ptr<TimedFrameSource>> sources;
+    sources.push_back(std::make_unique<TestPatternSource>(QSize(1920, 1080), 60, QVideoFrameFormat::Format_YUYV));
+    sources.push_back(std::make_unique<TestPatternSource>(QSize(1920, 1080), 60, QVideoFrameFormat::Format_NV12));
+    Settings settings = loadSettings();
+    if (settings.type == Type::File) {
+        sources.push_back(std::make_unique<FileFrameSource>(settings.filePath, settings.size, settings.fps,
+                                                            settings.pixelFormat, settings.mjpeg));
+    }
+
+    ScreenshotWriter::Options options;
+    options.format = ScreenshotWriter::Format::Qoi;
+    for (const auto &source : sources) {
+        qint64 sourceNs = 0, convertNs = 0, diffNs = 0, encodeNs = 0;
+        int counterErrors = 0;
+        int dirtyFrames = 0;
+        QVideoFrame previous;
+        QElapsedTimer timer;
+        for (int i = 0; i < frames; i++) {
+            timer.start();
+            QVideoFrame frame = source->frameAt(i);
+            sourceNs += timer.nsecsElapsed();
+            if (!frame.isValid()) {
+                qInfo().noquote() << QString("pipeline %1: no frames").arg(source->description());
+                break;
+            }
+            if (source->type() == Type::TestPattern && TestPatternSource::decodeCounter(frame) != i) {
+                counterErrors++;
+            }
+
+            timer.start();
+            QImage image = FrameConverter::toImage(frame);
+            convertNs += timer.nsecsElapsed();
+
+            if (previous.isValid() && previous.map(QVideoFrame::ReadOnly)) {
+                if (frame.map(QVideoFrame::ReadOnly)) {
+                    int bytesPerPixel = frame.pixelFormat() == QVideoFrameFormat::Format_YUYV ? 2
+                                      : frame.pixelFormat() == QVideoFrameFormat::Format_NV12 ? 1 : 4;
+                    timer.start();
+                    FrameDiffResult result = FrameDiff::compare(previous.bits(0), previous.bytesPerLine(0),
+                                                                frame.bits(0), frame.bytesPerLine(0),
+                                                                frame.width(), frame.height(), bytesPerPixel,
+                                                                FrameDiff::DEFAULT_TILE_SIZE, 0.5, Simd::bestLevel());
+                    diffNs += timer.nsecsElapsed();
+                    dirtyFrames += result.hasChanges() ? 1 : 0;
+                    frame.unmap();
+                }
+                previous.unmap();
+            }
+            previous = frame;
+
+            QBuffer buffer;
+            buffer.open(QIODevice::WriteOnly);
+            timer.start();
+            ScreenshotWriter::encode(image, options, &buffer);
+            encodeNs += timer.nsecsElapsed();
+        }
+
+        auto us = [frames](qint64 ns) { return QString::number(ns / 1000.0 / frames, 'f', 1); };
+        qInfo().noquote() << QString("pipeline %1: source %2 us, convert %3 us, diff %4 us, qoi %5 us per frame, "
+                                     "%6 changed frames, %7 counter errors")
+                                 .arg(source->description(), us(sourceNs), us(convertNs), us(diffNs), us(encodeNs))
+                                 .arg(dirtyFrames)
+                                 .arg(counterErrors);
+    }
+}
@@ -0,0 +1,242 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <QObject>
+#include <QCamera>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPointer>
+#include <QSize>
+#include <QTimer>
+#include <QVector>
+#include <QVideoFrame>
+#include <QVideoSink>
+#include <QLoggingCategory>
+#include <memory>
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_source)
+
+class MjpegDecoder;
+
+/*
+ * Where the video frames come from.
+ *
+ * The camera source passes the frames of the capture session on to the
+ * video sink, decoding MJPEG on the way. The synthetic sources write their
+ * frames into the same sink, so the video pane, the frame distributor and
+ * everything subscribed to it see them exactly like camera frames. That allows the display, screenshot, diff and
+ * recording paths to run on a machine without capture hardware.
+ */
+class FrameSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Type {
+        Camera,
+        TestPattern,
+        File
+    };
+
+    struct Settings {
+        Type type = Type::Camera;
+        QString filePath;
+        QSize size = QSize(1920, 1080);
+        int fps = 30;
+        QVideoFrameFormat::PixelFormat pixelFormat = QVideoFrameFormat::Format_YUYV;
+        bool mjpeg = false;     // File source only, the file is a sequence of JPEG images
+    };
+
+    explicit FrameSource(QObject *parent = nullptr) : QObject(parent) {}
+
+    virtual Type type() const = 0;
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+    virtual bool isActive() const = 0;
+    virtual QString description() const = 0;
+    // MediaClock time of QVideoFrame::startTime() zero, -1 when unknown
+    virtual qint64 streamOriginUs() const { return -1; }
+
+    // Synthetic frames go to this sink, without one they are pushed to the
+    // frame distributor directly
+    void setVideoSink(QVideoSink *sink) { m_sink = sink; }
+    quint64 deliveredFrames() const { return m_delivered; }
+
+    // "video/source*" settings, overridden by --source, --source-file,
+    // --source-size, --source-fps and --source-format on the command line
+    static Settings loadSettings();
+    static Type typeFromString(const QString &name);
+    // Synthetic sources only, returns nullptr for Type::Camera
+    static std::unique_ptr<FrameSource> create(const Settings &settings, QObject *parent = nullptr);
+
+    static void runBenchmark();
+
+signals:
+    void activeChanged(bool active);
+    void errorOccurred(const QString &errorString);
+
+protected:
+    void deliver(QVideoFrame &frame);
+
+private:
+    QPointer<QVideoSink> m_sink;
+    quint64 m_delivered = 0;
+};
+
+/*
+ * The capture card. The capture session writes into captureSink(), from
+ * there MJPEG frames go through an MjpegDecoder, which drops the frames the
+ * display has not caught up with before decoding them. Frames the backend
+ * already decoded are passed on as they are.
+ */
+class CameraFrameSource : public FrameSource
+{
+    Q_OBJECT
+
+public:
+    explicit CameraFrameSource(QCamera *camera, QObject *parent = nullptr);
+    ~CameraFrameSource();
+
+    Type type() const override { return Type::Camera; }
+    bool start() override;
+    void stop() override;
+    bool isActive() const override;
+    QString description() const override;
+
+    // The capture session's video sink
+    QVideoSink *captureSink() { return &m_captureSink; }
+
+private:
+    void captured(const QVideoFrame &frame);
+
+    QPointer<QCamera> m_camera;
+    QVideoSink m_captureSink;
+    std::unique_ptr<MjpegDecoder> m_decoder;
+};
+
+/*
+ * Base of the sources that produce frames on a timer. The frame index is
+ * derived from the elapsed time, so a late tick skips frames like a real
+ * device would instead of slowing the stream down.
+ */
+class TimedFrameSource : public FrameSource
+{
+    Q_OBJECT
+
+public:
+    explicit TimedFrameSource(int fps, QObject *parent = nullptr);
+
+    bool start() override;
+    void stop() override;
+    bool isActive() const override { return m_timer.isActive(); }
+    qint64 streamOriginUs() const override { return m_originUs; }
+
+    // Frame n of the stream, for benchmarks that drive the source without a timer
+    virtual QVideoFrame frameAt(quint64 index) = 0;
+
+protected:
+    virtual bool open() { return true; }
+    // Deliver frame n, synchronously unless a source overrides it
+    virtual void produce(quint64 index);
+    int m_fps;
+
+private:
+    void tick();
+
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_originUs = -1;
+    qint64 m_lastIndex = -1;
+};
+
+/*
+ * Colour bars with a grey ramp, a marker moving 8 pixels per frame and the
+ * frame index written as 32 black or white blocks along the top edge, which
+ * decodeCounter() reads back to detect dropped or repeated frames.
+ */
+class TestPatternSource : public TimedFrameSource
+{
+    Q_OBJECT
+
+public:
+    static const int COUNTER_BITS = 32;
+    static const int COUNTER_BLOCK = 16;
+    static const int MARKER_SIZE = 64;
+
+    TestPatternSource(const QSize &size, int fps, QVideoFrameFormat::PixelFormat pixelFormat,
+                      QObject *parent = nullptr);
+
+    Type type() const override { return Type::TestPattern; }
+    QString description() const override;
+    QVideoFrame frameAt(quint64 index) override;
+
+    // Marker top left corner in frame n
+    QPoint markerPosition(quint64 index) const;
+    // Frame index embedded in a test pattern frame, -1 if it cannot be read
+    static qint64 decodeCounter(const QVideoFrame &frame);
+
+private:
+    QSize m_size;
+    QVideoFrameFormat m_format;
+    QVideoFrame m_background;
+};
+
+/*
+ * Loops a raw YUYV or NV12 file, or a file of concatenated JPEG images
+ * such as a dump of the capture card MJPEG stream. While running, JPEG
+ * images are decoded in parallel by an MjpegDecoder, which drops frames
+ * before decoding them when the display falls behind.
+ */
+class FileFrameSource : public TimedFrameSource
+{
+    Q_OBJECT
+
+public:
+    FileFrameSource(const QString &filePath, const QSize &size, int fps,
+                    QVideoFrameFormat::PixelFormat pixelFormat, bool mjpeg, QObject *parent = nullptr);
+    ~FileFrameSource();
+
+    Type type() const override { return Type::File; }
+    QString description() const override;
+    QVideoFrame frameAt(quint64 index) override;
+    int frameCount() const;
+
+protected:
+    bool open() override;
+    void produce(quint64 index) override;
+
+private:
+    QFile m_file;
+    std::unique_ptr<MjpegDecoder> m_decoder;
+    const uchar *m_data = nullptr;
+    qint64 m_dataSize = 0;
+    QSize m_size;
+    QVideoFrameFormat::PixelFormat m_pixelFormat;
+    bool m_mjpeg;
+    qint64 m_frameBytes = 0;
+    QVector<QPair<qint64, qint64>> m_jpegFrames;   // Offset and length of every image
+};
+
+#endif // FRAMESOURCE_H
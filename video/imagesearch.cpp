@@ -0,0 +1,572 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "imagesearch.h"
+
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+Q_LOGGING_CATEGORY(log_video_search, "opf.core.video.search")
+
+namespace {
+
+const int MAX_LEVELS = 4;
+const int MIN_COARSE_WIDTH = 16;
+const int MIN_COARSE_HEIGHT = 8;
+
+struct Plane {
+    int width = 0;
+    int height = 0;
+    std::vector<uchar> pixels;
+    const uchar *row(int y) const { return pixels.data() + size_t(y) * width; }
+};
+
+Plane planeFromImage(const QImage &image)
+{
+    QImage gray = image.format() == QImage::Format_Grayscale8 ? image : image.convertToFormat(QImage::Format_Grayscale8);
+    Plane plane;
+    plane.width = gray.width();
+    plane.height = gray.height();
+    plane.pixels.resize(size_t(plane.width) * plane.height);
+    for (int y = 0; y < plane.height; y++) {
+        memcpy(plane.pixels.data() + size_t(y) * plane.width, gray.constScanLine(y), plane.width);
+    }
+    return plane;
+}
+
+Plane downsample(const Plane &src)
+{
+    Plane dst;
+    dst.width = src.width / 2;
+    dst.height = src.height / 2;
+    dst.pixels.resize(size_t(dst.width) * dst.height);
+    for (int y = 0; y < dst.height; y++) {
+        const uchar *a = src.row(y * 2);
+        const uchar *b = src.row(y * 2 + 1);
+        uchar *out = dst.pixels.data() + size_t(y) * dst.width;
+        for (int x = 0; x < dst.width; x++) {
+            out[x] = static_cast<uchar>((a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1] + 2) >> 2);
+        }
+    }
+    return dst;
+}
+
+// Summed area tables for the window sums the correlation needs
+struct Integral {
+    int stride = 0;
+    std::vector<quint64> sum;
+    std::vector<quint64> sumSq;
+
+    void build(const Plane &plane)
+    {
+        stride = plane.width + 1;
+        sum.assign(size_t(stride) * (plane.height + 1), 0);
+        sumSq.assign(sum.size(), 0);
+        for (int y = 0; y < plane.height; y++) {
+            quint64 rowSum = 0;
+            quint64 rowSq = 0;
+            const uchar *row = plane.row(y);
+            for (int x = 0; x < plane.width; x++) {
+                rowSum += row[x];
+                rowSq += quint64(row[x]) * row[x];
+                size_t i = size_t(y + 1) * stride + x + 1;
+                sum[i] = sum[i - stride] + rowSum;
+                sumSq[i] = sumSq[i - stride] + rowSq;
+            }
+        }
+    }
+
+    void window(int x, int y, int w, int h, quint64 &s, quint64 &sq) const
+    {
+        size_t a = size_t(y) * stride + x;
+        size_t b = a + w;
+        size_t c = a + size_t(h) * stride;
+        size_t d = c + w;
+        s = sum[d] - sum[b] - sum[c] + sum[a];
+        sq = sumSq[d] - sumSq[b] - sumSq[c] + sumSq[a];
+    }
+};
+
+/*
+ * Patch kernels compare a w x h reference (stride w) with the haystack at
+ * one position. The SAD kernels stop once the running sum reaches limit.
+ */
+using SadFn = quint32 (*)(const uchar *, int, const uchar *, int, int, quint32);
+using DotFn = quint64 (*)(const uchar *, int, const uchar *, int, int);
+
+quint32 sadPatchScalar(const uchar *hay, int stride, const uchar *ndl, int w, int h, quint32 limit)
+{
+    quint32 total = 0;
+    for (int r = 0; r < h; r++) {
+        const uchar *a = hay + size_t(r) * stride;
+        const uchar *b = ndl + size_t(r) * w;
+        for (int i = 0; i < w; i++) {
+            total += static_cast<quint32>(std::abs(int(a[i]) - int(b[i])));
+        }
+        if (total >= limit) {
+            break;
+        }
+    }
+    return total;
+}
+
+quint64 dotPatchScalar(const uchar *hay, int stride, const uchar *ndl, int w, int h)
+{
+    quint64 total = 0;
+    for (int r = 0; r < h; r++) {
+        const uchar *a = hay + size_t(r) * stride;
+        const uchar *b = ndl + size_t(r) * w;
+        quint32 rowTotal = 0;
+        for (int i = 0; i < w; i++) {
+            rowTotal += quint32(a[i]) * b[i];
+        }
+        total += rowTotal;
+    }
+    return total;
+}
+
+#ifdef OPF_HAVE_SSE2
+inline quint32 hsum64(__m128i v)
+{
+    return static_cast<quint32>(_mm_cvtsi128_si32(v) + _mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+}
+
+inline quint32 hsum32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_srli_si128(v, 8));
+    v = _mm_add_epi32(v, _mm_srli_si128(v, 4));
+    return static_cast<quint32>(_mm_cvtsi128_si32(v));
+}
+
+quint32 sadPatchSse2(const uchar *hay, int stride, const uchar *ndl, int w, int h, quint32 limit)
+{
+    quint32 total = 0;
+    for (int r = 0; r < h; r++) {
+        const uchar *a = hay + size_t(r) * stride;
+        const uchar *b = ndl + size_t(r) * w;
+        __m128i acc = _mm_setzero_si128();
+        int i = 0;
+        for (; i + 16 <= w; i += 16) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i))));
+        }
+        if (i + 8 <= w) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i)),
+                                                  _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i))));
+            i += 8;
+        }
+        total += hsum64(acc);
+        for (; i < w; i++) {
+            total += static_cast<quint32>(std::abs(int(a[i]) - int(b[i])));
+        }
+        if (total >= limit) {
+            break;
+        }
+    }
+    return total;
+}
+
+quint64 dotPatchSse2(const uchar *hay, int stride, const uchar *ndl, int w, int h)
+{
+    const __m128i zero = _mm_setzero_si128();
+    quint64 total = 0;
+    for (int r = 0; r < h; r++) {
+        const uchar *a = hay + size_t(r) * stride;
+        const uchar *b = ndl + size_t(r) * w;
+        __m128i acc = _mm_setzero_si128();
+        int i = 0;
+        for (; i + 16 <= w; i += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)));
+        }
+        if (i + 8 <= w) {
+            __m128i va = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+            i += 8;
+        }
+        quint64 rowTotal = hsum32(acc);
+        for (; i < w; i++) {
+            rowTotal += quint32(a[i]) * b[i];
+        }
+        total += rowTotal;
+    }
+    return total;
+}
+#endif
+
+#ifdef OPF_HAVE_AVX2
+OPF_TARGET_AVX2
+quint32 sadPatchAvx2(const uchar *hay, int stride, const uchar *ndl, int w, int h, quint32 limit)
+{
+    quint32 total = 0;
+    for (int r = 0; r < h; r++) {
+        const uchar *a = hay + size_t(r) * stride;
+        const uchar *b = ndl + size_t(r) * w;
+        __m256i acc = _mm256_setzero_si256();
+        int i = 0;
+        for (; i + 32 <= w; i += 32) {
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)),
+                                                        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i))));
+        }
+        __m128i acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        if (i + 16 <= w) {
+            acc128 = _mm_add_epi64(acc128, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                                                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i))));
+            i += 16;
+        }
+        if (i + 8 <= w) {
+            acc128 = _mm_add_epi64(acc128, _mm_sad_epu8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i)),
+                                                        _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i))));
+            i += 8;
+        }
+        total += static_cast<quint32>(_mm_cvtsi128_si32(acc128) + _mm_cvtsi128_si32(_mm_srli_si128(acc128, 8)));
+        for (; i < w; i++) {
+            total += static_cast<quint32>(std::abs(int(a[i]) - int(b[i])));
+        }
+        if (total >= limit) {
+            break;
+        }
+    }
+    return total;
+}
+
+OPF_TARGET_AVX2
+quint64 dotPatchAvx2(const uchar *hay, int stride, const uchar *ndl, int w, int h)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    quint64 total = 0;
+    for (int r = 0; r < h; r++) {
+        const uchar *a = hay + size_t(r) * stride;
+        const uchar *b = ndl + size_t(r) * w;
+        __m256i acc = _mm256_setzero_si256();
+        int i = 0;
+        for (; i + 32 <= w; i += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero)));
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero)));
+        }
+        __m128i acc128 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        const __m128i zero128 = _mm_setzero_si128();
+        for (; i + 8 <= w; i += 8) {
+            __m128i va = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i));
+            acc128 = _mm_add_epi32(acc128, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero128), _mm_unpacklo_epi8(vb, zero128)));
+        }
+        acc128 = _mm_add_epi32(acc128, _mm_srli_si128(acc128, 8));
+        acc128 = _mm_add_epi32(acc128, _mm_srli_si128(acc128, 4));
+        quint64 rowTotal = static_cast<quint32>(_mm_cvtsi128_si32(acc128));
+        for (; i < w; i++) {
+            rowTotal += quint32(a[i]) * b[i];
+        }
+        total += rowTotal;
+    }
+    return total;
+}
+#endif
+
+struct Kernels {
+    SadFn sad = sadPatchScalar;
+    DotFn dot = dotPatchScalar;
+};
+
+Kernels kernelsFor(Simd::Level level)
+{
+    Kernels kernels;
+#ifdef OPF_HAVE_SSE2
+    if (level != Simd::Level::Scalar) {
+        kernels.sad = sadPatchSse2;
+        kernels.dot = dotPatchSse2;
+    }
+#endif
+#ifdef OPF_HAVE_AVX2
+    if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+        kernels.sad = sadPatchAvx2;
+        kernels.dot = dotPatchAvx2;
+    }
+#endif
+    return kernels;
+}
+
+struct Level {
+    Plane hay;
+    Plane ndl;
+    Integral integral;
+    quint64 ndlSum = 0;
+    double ndlVariance = 0;     // Sum of squared deviations
+
+    // The summed area table only pays off on the level searched exhaustively
+    void prepare(bool ncc, bool exhaustive)
+    {
+        if (!ncc) {
+            return;
+        }
+        if (exhaustive) {
+            integral.build(hay);
+        }
+        quint64 sq = 0;
+        ndlSum = 0;
+        for (uchar v : ndl.pixels) {
+            ndlSum += v;
+            sq += quint64(v) * v;
+        }
+        double n = double(ndl.pixels.size());
+        ndlVariance = double(sq) - double(ndlSum) * double(ndlSum) / n;
+    }
+};
+
+struct Candidate {
+    double cost;
+    int x;
+    int y;
+};
+
+// Lower is better for both methods, Sad: absolute difference sum, Ncc: 1 - correlation
+double costAt(const Level &level, int x, int y, ImageSearch::Method method, const Kernels &kernels, double limit)
+{
+    const int w = level.ndl.width;
+    const int h = level.ndl.height;
+    const uchar *hay = level.hay.row(y) + x;
+    if (method == ImageSearch::Method::Sad) {
+        quint32 cap = limit >= double(std::numeric_limits<quint32>::max())
+                          ? std::numeric_limits<quint32>::max()
+                          : static_cast<quint32>(limit);
+        return kernels.sad(hay, level.hay.width, level.ndl.pixels.data(), w, h, cap);
+    }
+
+    quint64 sum = 0;
+    quint64 sumSq = 0;
+    if (!level.integral.sum.empty()) {
+        level.integral.window(x, y, w, h, sum, sumSq);
+    } else {
+        for (int r = 0; r < h; r++) {
+            const uchar *row = hay + size_t(r) * level.hay.width;
+            for (int i = 0; i < w; i++) {
+                sum += row[i];
+                sumSq += quint32(row[i]) * row[i];
+            }
+        }
+    }
+    double n = double(w) * h;
+    double variance = double(sumSq) - double(sum) * double(sum) / n;
+    if (variance < 1e-6 || level.ndlVariance < 1e-6) {
+        // Flat areas have no correlation, compare their levels instead
+        bool bothFlat = variance < 1e-6 && level.ndlVariance < 1e-6;
+        return bothFlat ? std::abs(double(sum) - double(level.ndlSum)) / (n * 255.0) : 1.0;
+    }
+    quint64 dot = kernels.dot(hay, level.hay.width, level.ndl.pixels.data(), w, h);
+    double covariance = double(dot) - double(sum) * double(level.ndlSum) / n;
+    return 1.0 - covariance / std::sqrt(variance * level.ndlVariance);
+}
+
+// Keep the best k candidates, merging neighbours one pixel apart
+void addCandidate(std::vector<Candidate> &list, const Candidate &candidate, int k)
+{
+    for (Candidate &existing : list) {
+        if (std::abs(existing.x - candidate.x) <= 1 && std::abs(existing.y - candidate.y) <= 1) {
+            if (candidate.cost < existing.cost) {
+                existing = candidate;
+                std::sort(list.begin(), list.end(), [](const Candidate &a, const Candidate &b) { return a.cost < b.cost; });
+            }
+            return;
+        }
+    }
+    auto it = std::upper_bound(list.begin(), list.end(), candidate,
+                               [](const Candidate &a, const Candidate &b) { return a.cost < b.cost; });
+    list.insert(it, candidate);
+    if (int(list.size()) > k) {
+        list.pop_back();
+    }
+}
+
+struct Band {
+    int y0;
+    int y1;
+    std::vector<Candidate> found;
+};
+
+} // namespace
+
+ImageSearch::Result ImageSearch::find(const QImage &haystack, const QImage &needle, const Options &options)
+{
+    QElapsedTimer timer;
+    timer.start();
+    Result result;
+
+    if (haystack.isNull() || needle.isNull()
+        || needle.width() > haystack.width() || needle.height() > haystack.height()) {
+        qCWarning(log_video_search) << "Invalid search, haystack" << haystack.size() << "needle" << needle.size();
+        return result;
+    }
+
+    const bool ncc = options.method == Method::Ncc;
+    const Kernels kernels = kernelsFor(options.level);
+    const int k = qMax(1, options.candidates);
+
+    std::vector<Level> levels(1);
+    levels[0].hay = planeFromImage(haystack);
+    levels[0].ndl = planeFromImage(needle);
+    while (int(levels.size()) < MAX_LEVELS
+           && (levels.back().ndl.width / 2) >= MIN_COARSE_WIDTH
+           && (levels.back().ndl.height / 2) >= MIN_COARSE_HEIGHT) {
+        Level next;
+        next.hay = downsample(levels.back().hay);
+        next.ndl = downsample(levels.back().ndl);
+        levels.push_back(std::move(next));
+    }
+    for (size_t i = 0; i < levels.size(); i++) {
+        levels[i].prepare(ncc, i + 1 == levels.size());
+    }
+    result.levels = int(levels.size());
+
+    // Exhaustive pass over the coarsest level, in row bands on the pool
+    const Level &top = levels.back();
+    const int maxX = top.hay.width - top.ndl.width;
+    const int maxY = top.hay.height - top.ndl.height;
+    const int threads = qMax(1, QThreadPool::globalInstance()->maxThreadCount());
+    const int bandRows = qMax(4, (maxY + 1) / (threads * 4));
+    QList<Band> bands;
+    for (int y = 0; y <= maxY; y += bandRows) {
+        bands.append(Band{y, qMin(maxY + 1, y + bandRows), {}});
+    }
+
+    QtConcurrent::blockingMap(bands, [&](Band &band) {
+        double worst = std::numeric_limits<double>::max();
+        for (int y = band.y0; y < band.y1; y++) {
+            for (int x = 0; x <= maxX; x++) {
+                double cost = costAt(top, x, y, options.method, kernels, worst);
+                if (cost < worst || int(band.found.size()) < k) {
+                    addCandidate(band.found, Candidate{cost, x, y}, k);
+                    if (int(band.found.size()) == k) {
+                        worst = band.found.back().cost;
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<Candidate> candidates;
+    for (const Band &band : bands) {
+        for (const Candidate &candidate : band.found) {
+            addCandidate(candidates, candidate, k);
+        }
+    }
+
+    // Refine each candidate in a small window on every finer level
+    Candidate best{std::numeric_limits<double>::max(), 0, 0};
+    for (Candidate candidate : candidates) {
+        for (int l = int(levels.size()) - 2; l >= 0; l--) {
+            const Level &level = levels[l];
+            int cx = candidate.x * 2;
+            int cy = candidate.y * 2;
+            Candidate refined{std::numeric_limits<double>::max(), cx, cy};
+            for (int y = qMax(0, cy - 2); y <= qMin(level.hay.height - level.ndl.height, cy + 2); y++) {
+                for (int x = qMax(0, cx - 2); x <= qMin(level.hay.width - level.ndl.width, cx + 2); x++) {
+                    double cost = costAt(level, x, y, options.method, kernels, refined.cost);
+                    if (cost < refined.cost) {
+                        refined = Candidate{cost, x, y};
+                    }
+                }
+            }
+            candidate = refined;
+        }
+        if (candidate.cost < best.cost) {
+            best = candidate;
+        }
+    }
+
+    const Level &base = levels.front();
+    result.position = QPoint(best.x, best.y);
+    if (ncc) {
+        result.score = 1.0 - best.cost;
+        result.found = result.score >= options.nccThreshold;
+    } else {
+        result.score = best.cost / (double(base.ndl.width) * base.ndl.height);
+        result.found = result.score <= options.variation;
+    }
+    result.elapsedUs = timer.nsecsElapsed() / 1000;
+
+    qCDebug(log_video_search) << "Search" << needle.size() << "in" << haystack.size()
+                              << (result.found ? "found at" : "best at") << result.position
+                              << "score" << result.score << "levels" << result.levels
+                              << "in" << result.elapsedUs << "us";
+    return result;
+}
+
+void ImageSearch::runBenchmark()
+{
+    // A desktop like haystack: flat panels, text like noise and a few gradients
+    QImage haystack(1920, 1080, QImage::Format_Grayscale8);
+    quint32 seed = 12345;
+    for (int y = 0; y < haystack.height(); y++) {
+        uchar *row = haystack.scanLine(y);
+        for (int x = 0; x < haystack.width(); x++) {
+            seed = seed * 1664525u + 1013904223u;
+            int panel = ((x / 240) + (y / 135)) % 4;
+            int value = panel == 0 ? 230 : panel == 1 ? (x + y) / 12 : panel == 2 ? 40 : int(seed >> 24);
+            row[x] = static_cast<uchar>(value);
+        }
+    }
+    const QPoint target(1337, 733);
+    const int iterations = 20;
+    const int sizes[] = {32, 64};
+
+    const Simd::Level simdLevels[] = {Simd::Level::Scalar, Simd::Level::Sse2, Simd::Level::Avx2};
+    for (int size : sizes) {
+        QImage needle = haystack.copy(QRect(target, QSize(size, size)));
+        for (Simd::Level simd : simdLevels) {
+            if (!Simd::isSupported(simd)) {
+                continue;
+            }
+            for (Method method : {Method::Sad, Method::Ncc}) {
+                Options options;
+                options.method = method;
+                options.level = simd;
+                Result result;
+                QElapsedTimer timer;
+                timer.start();
+                for (int i = 0; i < iterations; i++) {
+                    result = find(haystack, needle, options);
+                }
+                qInfo().noquote() << QString("imagesearch %1x%1 %2 %3: %4 ms per 1080p search, %5 at %6,%7")
+                                         .arg(size)
+                                         .arg(method == Method::Sad ? "sad" : "ncc")
+                                         .arg(Simd::levelName(simd), -6)
+                                         .arg(timer.nsecsElapsed() / 1e6 / iterations, 0, 'f', 2)
+                                         .arg(result.found && result.position == target ? "found" : "MISSED")
+                                         .arg(result.position.x())
+                                         .arg(result.position.y());
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef IMAGESEARCH_H
+#define IMAGESEARCH_H
+
+#include <QImage>
+#include <QPoint>
+#include <QLoggingCategory>
+
+#include "simd.h"
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_search)
+
+/*
+ * Locates a reference image inside a larger image, both 8 bit gray.
+ *
+ * The search runs coarse-to-fine over an image pyramid: every position is
+ * scored on the smallest level where the reference is still at least 16
+ * pixels wide and 8 high, the best candidates are then refined in a small
+ * window on each finer level. The exhaustive coarse pass is split into row
+ * bands scored on the global thread pool.
+ */
+class ImageSearch
+{
+public:
+    enum class Method {
+        Sad,    // Mean absolute difference, fastest
+        Ncc     // Normalized cross correlation, tolerates brightness and contrast changes
+    };
+
+    struct Options {
+        Method method = Method::Sad;
+        int variation = 10;             // Sad: largest mean difference per pixel that still matches
+        double nccThreshold = 0.9;      // Ncc: smallest correlation that still matches
+        int candidates = 16;            // Coarse positions refined on finer levels
+        Simd::Level level = Simd::bestLevel();
+    };
+
+    struct Result {
+        bool found = false;
+        QPoint position;                // Top left of the best match in haystack pixels
+        double score = 0;               // Sad: mean difference, Ncc: correlation
+        int levels = 0;
+        qint64 elapsedUs = 0;
+    };
+
+    static Result find(const QImage &haystack, const QImage &needle, const Options &options);
+    static Result find(const QImage &haystack, const QImage &needle) { return find(haystack, needle, Options()); }
+
+    static void runBenchmark();
+};
+
+#endif // IMAGESEARCH_H
@@ -0,0 +1,454 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "mjpegdecoder.h"
+#include "aviwriter.h"
+#include "framesource.h"
+#include "frameconverter.h"
+#include "host/mediaclock.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QMediaPlayer>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <QVideoSink>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+Q_LOGGING_CATEGORY(log_video_mjpeg, "opf.core.video.mjpeg")
+
+namespace {
+
+QVideoFrame imageToFrame(const QImage &decoded)
+{
+    QImage image = decoded.convertToFormat(QImage::Format_RGB32);
+    if (image.isNull()) {
+        return QVideoFrame();
+    }
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    QVideoFrameFormat format(image.size(), QVideoFrameFormat::Format_BGRX8888);
+#else
+    QVideoFrameFormat format(image.size(), QVideoFrameFormat::Format_XRGB8888);
+#endif
+    QVideoFrame frame(format);
+    if (!frame.map(QVideoFrame::WriteOnly)) {
+        return QVideoFrame();
+    }
+    for (int y = 0; y < image.height(); y++) {
+        memcpy(frame.bits(0) + y * frame.bytesPerLine(0), image.constScanLine(y), image.width() * 4);
+    }
+    frame.unmap();
+    return frame;
+}
+
+#ifdef HAVE_TURBOJPEG
+// A handle must not be shared between threads, every pool thread gets its own
+struct TurboHandle {
+    tjhandle handle = tjInitDecompress();
+    ~TurboHandle()
+    {
+        if (handle) {
+            tjDestroy(handle);
+        }
+    }
+};
+
+QVideoFrame decodeTurbo(const QByteArray &jpeg, bool fastDct)
+{
+    static thread_local TurboHandle turbo;
+    if (!turbo.handle) {
+        return QVideoFrame();
+    }
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(jpeg.constData());
+    unsigned long size = static_cast<unsigned long>(jpeg.size());
+    int width, height, subsampling, colorspace;
+    if (tjDecompressHeader3(turbo.handle, data, size, &width, &height, &subsampling, &colorspace) != 0) {
+        return QVideoFrame();
+    }
+    int flags = fastDct ? TJFLAG_FASTDCT : 0;
+
+    bool planar = (subsampling == TJSAMP_420 || subsampling == TJSAMP_422) && (width % 2) == 0 && (height % 2) == 0;
+    if (planar) {
+        QVideoFrameFormat format(QSize(width, height), subsampling == TJSAMP_420 ? QVideoFrameFormat::Format_YUV420P
+                                                                                 : QVideoFrameFormat::Format_YUV422P);
+        // JPEG uses full range BT.601
+        format.setColorSpace(QVideoFrameFormat::ColorSpace_BT601);
+        format.setColorRange(QVideoFrameFormat::ColorRange_Full);
+        QVideoFrame frame(format);
+        if (!frame.map(QVideoFrame::WriteOnly)) {
+            return QVideoFrame();
+        }
+        unsigned char *planes[3] = {frame.bits(0), frame.bits(1), frame.bits(2)};
+        int strides[3] = {frame.bytesPerLine(0), frame.bytesPerLine(1), frame.bytesPerLine(2)};
+        bool ok = tjDecompressToYUVPlanes(turbo.handle, data, size, planes, width, strides, height, flags) == 0;
+        frame.unmap();
+        return ok ? frame : QVideoFrame();
+    }
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    QVideoFrameFormat format(QSize(width, height), QVideoFrameFormat::Format_BGRX8888);
+    const int pixelFormat = TJPF_BGRX;
+#else
+    QVideoFrameFormat format(QSize(width, height), QVideoFrameFormat::Format_XRGB8888);
+    const int pixelFormat = TJPF_XRGB;
+#endif
+    QVideoFrame frame(format);
+    if (!frame.map(QVideoFrame::WriteOnly)) {
+        return QVideoFrame();
+    }
+    bool ok = tjDecompress2(turbo.handle, data, size, frame.bits(0), width, frame.bytesPerLine(0), height,
+                            pixelFormat, flags) == 0;
+    frame.unmap();
+    return ok ? frame : QVideoFrame();
+}
+#endif
+
+} // namespace
+
+MjpegDecoder::MjpegDecoder(QObject *context, Callback callback, int threads, QObject *parent)
+    : QObject(parent), m_context(context), m_callback(std::move(callback))
+{
+    if (threads <= 0) {
+        threads = qBound(1, QThread::idealThreadCount() - 1, 4);
+    }
+    m_pool.setMaxThreadCount(threads);
+    m_pool.setObjectName("MjpegDecoder");
+}
+
+MjpegDecoder::~MjpegDecoder()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_waiting.clear();
+    }
+    m_pool.waitForDone();
+}
+
+bool MjpegDecoder::hasTurboJpeg()
+{
+#ifdef HAVE_TURBOJPEG
+    return true;
+#else
+    return false;
+#endif
+}
+
+QVideoFrame MjpegDecoder::decode(const QByteArray &jpeg, bool fastDct)
+{
+#ifdef HAVE_TURBOJPEG
+    QVideoFrame frame = decodeTurbo(jpeg, fastDct);
+    if (frame.isValid()) {
+        return frame;
+    }
+#else
+    Q_UNUSED(fastDct);
+#endif
+    return imageToFrame(QImage::fromData(jpeg, "JPG"));
+}
+
+void MjpegDecoder::submit(const QByteArray &jpeg, qint64 timestampUs)
+{
+    Job job{jpeg, timestampUs, MediaClock::nowUs()};
+    QMutexLocker locker(&m_mutex);
+    if (m_inFlight < m_pool.maxThreadCount()) {
+        m_inFlight++;
+        quint64 sequence = m_nextSequence++;
+        locker.unlock();
+        dispatch(std::move(job), sequence);
+        return;
+    }
+    // Latest frame wins, anything older than maxPending is dropped undecoded
+    m_waiting.push_back(std::move(job));
+    while (static_cast<int>(m_waiting.size()) > m_maxPending) {
+        m_waiting.pop_front();
+        m_dropped++;
+    }
+}
+
+void MjpegDecoder::dispatch(Job job, quint64 sequence)
+{
+    bool fastDct = m_fastDct;
+    m_pool.start([this, job = std::move(job), sequence, fastDct]() {
+        Result result{decode(job.jpeg, fastDct), job.timestampUs, job.submitUs};
+        if (result.frame.isValid()) {
+            m_decoded++;
+        } else {
+            qCWarning(log_video_mjpeg) << "Failed to decode frame" << job.timestampUs;
+        }
+        finished(sequence, std::move(result));
+    });
+}
+
+void MjpegDecoder::finished(quint64 sequence, Result result)
+{
+    QMutexLocker locker(&m_mutex);
+    m_done.emplace(sequence, std::move(result));
+    // Posting in sequence order under the lock keeps the frames in order
+    for (auto it = m_done.find(m_nextDelivery); it != m_done.end(); it = m_done.find(m_nextDelivery)) {
+        Result ready = std::move(it->second);
+        m_done.erase(it);
+        m_nextDelivery++;
+        QPointer<MjpegDecoder> self(this);
+        bool posted = m_context && QMetaObject::invokeMethod(m_context, [self, ready]() {
+            if (!self) {
+                return;
+            }
+            if (ready.frame.isValid()) {
+                self->m_callback(ready.frame, ready.timestampUs, MediaClock::nowUs() - ready.submitUs);
+            }
+            self->delivered();
+        }, Qt::QueuedConnection);
+        if (!posted) {
+            m_inFlight--;
+        }
+    }
+}
+
+void MjpegDecoder::delivered()
+{
+    QMutexLocker locker(&m_mutex);
+    m_inFlight--;
+    if (m_waiting.empty() || m_inFlight >= m_pool.maxThreadCount()) {
+        return;
+    }
+    Job job = std::move(m_waiting.front());
+    m_waiting.pop_front();
+    m_inFlight++;
+    quint64 sequence = m_nextSequence++;
+    locker.unlock();
+    dispatch(std::move(job), sequence);
+}
+
+bool MjpegDecoder::waitForDone(int msecs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_inFlight == 0 && m_waiting.empty()) {
+                return true;
+            }
+        }
+        if (msecs >= 0 && timer.elapsed() > msecs) {
+            return false;
+        }
+        // Deliveries are posted to the context, which is usually this thread
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+        QThread::usleep(200);
+    }
+}
+
+QVector<QPair<qint64, qint64>> MjpegDecoder::indexStream(const uchar *data, qint64 size)
+{
+    // Images are found by their start and end markers
+    QVector<QPair<qint64, qint64>> images;
+    qint64 start = -1;
+    for (qint64 i = 0; i + 1 < size; i++) {
+        if (data[i] != 0xFF) {
+            continue;
+        }
+        if (data[i + 1] == 0xD8 && start < 0) {
+            start = i;
+        } else if (data[i + 1] == 0xD9 && start >= 0) {
+            images.append(qMakePair(start, i + 2 - start));
+            start = -1;
+        }
+    }
+    return images;
+}
+
+namespace {
+
+struct RunStats {
+    double fps = 0;
+    double meanLatencyMs = 0;
+    double p95LatencyMs = 0;
+    quint64 dropped = 0;
+};
+
+// Submits the frames at fps, or as fast as possible when fps is 0
+RunStats runDecoder(const QVector<QByteArray> &frames, int threads, int fps)
+{
+    std::vector<qint64> latencies;
+    QObject context;
+    MjpegDecoder decoder(&context, [&latencies](const QVideoFrame &, qint64, qint64 latencyUs) {
+        latencies.push_back(latencyUs);
+    }, threads);
+    decoder.setMaxPending(fps > 0 ? 1 : frames.size());
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames.size(); i++) {
+        if (fps > 0) {
+            qint64 dueNs = qint64(i) * 1000000000 / fps;
+            while (timer.nsecsElapsed() < dueNs) {
+                QCoreApplication::processEvents(QEventLoop::AllEvents, 1);
+            }
+        }
+        decoder.submit(frames[i], i);
+    }
+    decoder.waitForDone();
+
+    RunStats stats;
+    stats.fps = latencies.size() * 1e9 / timer.nsecsElapsed();
+    stats.dropped = decoder.droppedFrames();
+    if (!latencies.empty()) {
+        qint64 total = 0;
+        for (qint64 latency : latencies) {
+            total += latency;
+        }
+        stats.meanLatencyMs = total / 1000.0 / latencies.size();
+        std::sort(latencies.begin(), latencies.end());
+        stats.p95LatencyMs = latencies[latencies.size() * 95 / 100] / 1000.0;
+    }
+    return stats;
+}
+
+// Frames per second the multimedia backend delivers when playing the stream as an AVI file
+double runBackend(const QVector<QByteArray> &frames, const QSize &size, int fps)
+{
+    QTemporaryDir dir;
+    QString path = dir.filePath("benchmark.avi");
+    AviWriter writer;
+    if (!dir.isValid() || !writer.open(path, size)) {
+        return 0;
+    }
+    for (const QByteArray &jpeg : frames) {
+        writer.addFrame(jpeg);
+    }
+    writer.close(fps);
+
+    QMediaPlayer player;
+    QVideoSink sink;
+    int delivered = 0;
+    QObject::connect(&sink, &QVideoSink::videoFrameChanged, &sink, [&delivered](const QVideoFrame &frame) {
+        // Mapping forces the backend to hand over decoded pixels
+        QVideoFrame mapped(frame);
+        if (mapped.map(QVideoFrame::ReadOnly)) {
+            mapped.unmap();
+            delivered++;
+        }
+    });
+    player.setVideoSink(&sink);
+    player.setSource(QUrl::fromLocalFile(path));
+    player.setPlaybackRate(8.0);
+
+    QEventLoop loop;
+    QObject::connect(&player, &QMediaPlayer::mediaStatusChanged, &loop, [&loop](QMediaPlayer::MediaStatus status) {
+        if (status == QMediaPlayer::EndOfMedia || status == QMediaPlayer::InvalidMedia) {
+            loop.quit();
+        }
+    });
+    QObject::connect(&player, &QMediaPlayer::errorOccurred, &loop, &QEventLoop::quit);
+    QTimer::singleShot(60000, &loop, &QEventLoop::quit);
+    QElapsedTimer timer;
+    timer.start();
+    player.play();
+    loop.exec();
+    player.stop();
+    return delivered * 1e9 / timer.nsecsElapsed();
+}
+
+} // namespace
+
+void MjpegDecoder::runBenchmark()
+{
+    QVector<QByteArray> frames;
+    QString source;
+    int fps = 30;
+    FrameSource::Settings settings = FrameSource::loadSettings();
+    if (settings.type == FrameSource::Type::File && settings.mjpeg) {
+        QFile file(settings.filePath);
+        if (file.open(QIODevice::ReadOnly)) {
+            QByteArray data = file.readAll();
+            const auto images = indexStream(reinterpret_cast<const uchar *>(data.constData()), data.size());
+            for (const auto &image : images) {
+                frames.append(data.mid(image.first, image.second));
+            }
+        }
+        source = settings.filePath;
+        fps = settings.fps;
+    } else {
+        TestPatternSource pattern(QSize(1920, 1080), fps, QVideoFrameFormat::Format_YUYV);
+        for (int i = 0; i < 120; i++) {
+            QByteArray jpeg;
+            QBuffer buffer(&jpeg);
+            buffer.open(QIODevice::WriteOnly);
+            QImageWriter writer(&buffer, "jpg");
+            writer.setQuality(85);
+            writer.write(FrameConverter::toImage(pattern.frameAt(i)));
+            frames.append(jpeg);
+        }
+        source = "test pattern 1920x1080";
+    }
+    if (frames.isEmpty()) {
+        qInfo().noquote() << "mjpeg: no frames in" << source;
+        return;
+    }
+    QSize size = QImage::fromData(frames.first(), "JPG").size();
+    qInfo().noquote() << QString("mjpeg: %1 frames of %2x%3 from %4, libjpeg-turbo %5")
+                             .arg(frames.size()).arg(size.width()).arg(size.height())
+                             .arg(source, hasTurboJpeg() ? "yes" : "no");
+
+    QElapsedTimer timer;
+    timer.start();
+    for (const QByteArray &jpeg : frames) {
+        QImage image = QImage::fromData(jpeg, "JPG");
+        Q_UNUSED(image);
+    }
+    qInfo().noquote() << QString("mjpeg Qt image reader: %1 fps").arg(frames.size() * 1e9 / timer.nsecsElapsed(), 0, 'f', 1);
+
+    const int threadCounts[] = {1, 2, 4};
+    for (int threads : threadCounts) {
+        if (threads > 1 && threads > QThread::idealThreadCount()) {
+            continue;
+        }
+        RunStats unpaced = runDecoder(frames, threads, 0);
+        RunStats paced = runDecoder(frames, threads, fps);
+        qInfo().noquote() << QString("mjpeg decoder %1 threads: %2 fps max, at %3 fps latency %4 ms mean %5 ms p95, %6 dropped")
+                                 .arg(threads)
+                                 .arg(unpaced.fps, 0, 'f', 1)
+                                 .arg(fps)
+                                 .arg(paced.meanLatencyMs, 0, 'f', 1)
+                                 .arg(paced.p95LatencyMs, 0, 'f', 1)
+                                 .arg(paced.dropped);
+    }
+
+    qInfo().noquote() << QString("mjpeg multimedia backend (%1): %2 fps at 8x playback rate")
+                             .arg(qEnvironmentVariable("QT_MEDIA_BACKEND", "default"))
+                             .arg(runBackend(frames, size, fps), 0, 'f', 1);
+}
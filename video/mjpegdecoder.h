@@ -0,0 +1,120 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef MJPEGDECODER_H
+#define MJPEGDECODER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QMutex>
+#include <QPointer>
+#include <QThreadPool>
+#include <QVector>
+#include <QVideoFrame>
+#include <QLoggingCategory>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_mjpeg)
+
+/*
+ * Decodes MJPEG frames on a small thread pool.
+ *
+ * Frames are decoded in parallel and handed to the callback in the order
+ * they were submitted, in the thread of the context object. A frame counts
+ * as in flight until the callback for it has returned, and no more frames
+ * than there are threads are in flight. Frames submitted beyond that wait,
+ * and when more than maxPending are waiting the oldest is dropped before
+ * it is decoded, so a consumer that falls behind costs no decode work.
+ *
+ * With libjpeg-turbo (HAVE_TURBOJPEG) 4:2:0 and 4:2:2 images are decoded
+ * straight into planar YUV frames, skipping the colour conversion. Without
+ * it Qt's JPEG reader is used.
+ */
+class MjpegDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // latencyUs is the time from submit() to the start of the callback
+    using Callback = std::function<void(const QVideoFrame &frame, qint64 timestampUs, qint64 latencyUs)>;
+
+    MjpegDecoder(QObject *context, Callback callback, int threads = 0, QObject *parent = nullptr);
+    ~MjpegDecoder();
+
+    void submit(const QByteArray &jpeg, qint64 timestampUs);
+    void setMaxPending(int frames) { m_maxPending = qMax(0, frames); }
+    void setFastDct(bool fast) { m_fastDct = fast; }
+    int threadCount() const { return m_pool.maxThreadCount(); }
+    // Wait until every submitted frame was delivered or dropped
+    bool waitForDone(int msecs = -1);
+
+    quint64 decodedFrames() const { return m_decoded.load(); }
+    quint64 droppedFrames() const { return m_dropped.load(); }
+
+    static QVideoFrame decode(const QByteArray &jpeg, bool fastDct = false);
+    static bool hasTurboJpeg();
+    // Offset and length of every image in a stream of concatenated JPEG images
+    static QVector<QPair<qint64, qint64>> indexStream(const uchar *data, qint64 size);
+
+    // Compares Qt's reader, this decoder at several thread counts and the
+    // multimedia backend on the file given with --source-file, or on
+    // encoded test pattern frames
+    static void runBenchmark();
+
+private:
+    struct Job {
+        QByteArray jpeg;
+        qint64 timestampUs;
+        qint64 submitUs;
+    };
+    struct Result {
+        QVideoFrame frame;
+        qint64 timestampUs;
+        qint64 submitUs;
+    };
+
+    // m_inFlight and the sequence number are taken by the caller
+    void dispatch(Job job, quint64 sequence);
+    void finished(quint64 sequence, Result result);
+    void delivered();
+
+    QPointer<QObject> m_context;
+    Callback m_callback;
+    QThreadPool m_pool;
+    int m_maxPending = 1;
+    bool m_fastDct = false;
+
+    QMutex m_mutex;
+    std::deque<Job> m_waiting;
+    std::map<quint64, Result> m_done;   // Decoded ahead of an earlier frame
+    quint64 m_nextSequence = 0;
+    quint64 m_nextDelivery = 0;
+    int m_inFlight = 0;
+
+    std::atomic<quint64> m_decoded{0};
+    std::atomic<quint64> m_dropped{0};
+};
+
+#endif // MJPEGDECODER_H
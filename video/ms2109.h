@@ -3,6 +3,17 @@
 
 #include <cstdint>
 
+// Vendor feature report commands, byte 1 of the 9 byte report
+const uint8_t CMD_XDATA_READ = 0xB5;
+const uint8_t CMD_XDATA_WRITE = 0xB6;
+const uint8_t CMD_EEPROM_READ = 0xE5;
+const uint8_t CMD_EEPROM_WRITE = 0xE6;
+
+// Every xdata/eeprom request moves at most 4 bytes
+const int MS2109_TRANSFER_BYTES = 4;
+// The firmware EEPROM attached to the MS2109 is a 64KiB part
+const uint32_t MS2109_EEPROM_SIZE = 0x10000;
+
 const uint16_t ADDR_HDMI_CONNECTION_STATUS = 0xFA8C;
 // 0xDF00 bit0: GPIO0 reads the hard switch status, 1 means switchable usb connects to the target, 0 means switchable usb connects to the host
 const uint16_t ADDR_GPIO0 = 0xDF00;
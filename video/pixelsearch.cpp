@@ -0,0 +1,173 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "pixelsearch.h"
+#include "frameconverter.h"
+
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QtAlgorithms>
+#include <cstdlib>
+
+namespace {
+
+// Returns the index of the first matching pixel in the row, or -1
+int findInRowScalar(const quint32 *row, int width, quint32 color, int variation)
+{
+    const int r = qRed(color);
+    const int g = qGreen(color);
+    const int b = qBlue(color);
+    for (int x = 0; x < width; x++) {
+        quint32 px = row[x];
+        if (std::abs(qRed(px) - r) <= variation && std::abs(qGreen(px) - g) <= variation
+            && std::abs(qBlue(px) - b) <= variation) {
+            return x;
+        }
+    }
+    return -1;
+}
+
+#ifdef OPF_HAVE_SSE2
+int findInRowSse2(const quint32 *row, int width, quint32 color, int variation)
+{
+    // Alpha is ignored by allowing it the full range
+    const __m128i target = _mm_set1_epi32(static_cast<int>(color));
+    const __m128i limit = _mm_set1_epi32(static_cast<int>(0xFF000000u | (quint32(variation) * 0x010101u)));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi32(-1);
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(px, target), _mm_subs_epu8(target, px));
+        __m128i within = _mm_cmpeq_epi8(_mm_subs_epu8(diff, limit), zero);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(within, ones));
+        if (mask) {
+            return x + qCountTrailingZeroBits(static_cast<quint32>(mask)) / 4;
+        }
+    }
+    int tail = findInRowScalar(row + x, width - x, color, variation);
+    return tail < 0 ? -1 : x + tail;
+}
+#endif
+
+#ifdef OPF_HAVE_AVX2
+OPF_TARGET_AVX2
+int findInRowAvx2(const quint32 *row, int width, quint32 color, int variation)
+{
+    const __m256i target = _mm256_set1_epi32(static_cast<int>(color));
+    const __m256i limit = _mm256_set1_epi32(static_cast<int>(0xFF000000u | (quint32(variation) * 0x010101u)));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi32(-1);
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x));
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(px, target), _mm256_subs_epu8(target, px));
+        __m256i within = _mm256_cmpeq_epi8(_mm256_subs_epu8(diff, limit), zero);
+        int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(within, ones));
+        if (mask) {
+            return x + qCountTrailingZeroBits(static_cast<quint32>(mask)) / 4;
+        }
+    }
+    int tail = findInRowScalar(row + x, width - x, color, variation);
+    return tail < 0 ? -1 : x + tail;
+}
+#endif
+
+using FindFn = int (*)(const quint32 *, int, quint32, int);
+
+FindFn findFor(Simd::Level level)
+{
+#ifdef OPF_HAVE_AVX2
+    if (level == Simd::Level::Avx2 && Simd::cpuHasAvx2()) {
+        return findInRowAvx2;
+    }
+#endif
+#ifdef OPF_HAVE_SSE2
+    if (level != Simd::Level::Scalar) {
+        return findInRowSse2;
+    }
+#endif
+    Q_UNUSED(level);
+    return findInRowScalar;
+}
+
+} // namespace
+
+bool PixelSearch::colorAt(const QVideoFrame &frame, const QPoint &point, QRgb *color)
+{
+    if (!QRect(QPoint(0, 0), frame.size()).contains(point)) {
+        return false;
+    }
+    QImage pixel = FrameConverter::toImage(frame, QRect(point, QSize(1, 1)));
+    if (pixel.isNull()) {
+        return false;
+    }
+    *color = pixel.pixel(0, 0);
+    return true;
+}
+
+bool PixelSearch::find(const QImage &image, QRgb color, int variation, QPoint *found, Simd::Level level)
+{
+    if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32) {
+        return find(image.convertToFormat(QImage::Format_RGB32), color, variation, found, level);
+    }
+    FindFn findInRow = findFor(level);
+    variation = qBound(0, variation, 255);
+    for (int y = 0; y < image.height(); y++) {
+        int x = findInRow(reinterpret_cast<const quint32 *>(image.constScanLine(y)), image.width(), color, variation);
+        if (x >= 0) {
+            *found = QPoint(x, y);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PixelSearch::runBenchmark()
+{
+    QImage image(1920, 1080, QImage::Format_RGB32);
+    image.fill(qRgb(32, 48, 64));
+    // The colour sits in the last row, so every pixel is scanned
+    image.setPixel(1900, 1079, qRgb(200, 30, 30));
+    const int iterations = 100;
+    const double megapixels = image.width() * image.height() / 1e6;
+
+    const Simd::Level levels[] = {Simd::Level::Scalar, Simd::Level::Sse2, Simd::Level::Avx2};
+    for (Simd::Level level : levels) {
+        if (!Simd::isSupported(level)) {
+            continue;
+        }
+        QPoint found;
+        bool ok = false;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++) {
+            ok = find(image, qRgb(205, 25, 33), 8, &found, level);
+        }
+        double nsPerMp = timer.nsecsElapsed() / (iterations * megapixels);
+        qInfo().noquote() << QString("pixelsearch %1: %2 ns/MP, %3 us per 1080p scan, %4")
+                                 .arg(Simd::levelName(level), -6)
+                                 .arg(nsPerMp, 0, 'f', 0)
+                                 .arg(nsPerMp * megapixels / 1000.0, 0, 'f', 1)
+                                 .arg(ok && found == QPoint(1900, 1079) ? "found" : "MISSED");
+    }
+}
@@ -0,0 +1,52 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef PIXELSEARCH_H
+#define PIXELSEARCH_H
+
+#include <QImage>
+#include <QPoint>
+#include <QRgb>
+#include <QVideoFrame>
+
+#include "simd.h"
+
+/*
+ * Pixel colour queries on the live video frame. Only the pixels asked for are
+ * converted to RGB, the scan itself compares four (SSE2) or eight (AVX2)
+ * pixels per step.
+ */
+class PixelSearch
+{
+public:
+    // Colour of one frame pixel, returns false when there is no such pixel
+    static bool colorAt(const QVideoFrame &frame, const QPoint &point, QRgb *color);
+
+    // First pixel in row major order whose channels are all within variation
+    // of color. image must be Format_RGB32 or Format_ARGB32.
+    static bool find(const QImage &image, QRgb color, int variation, QPoint *found,
+                     Simd::Level level = Simd::bestLevel());
+
+    static void runBenchmark();
+};
+
+#endif // PIXELSEARCH_H
@@ -0,0 +1,237 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "screenshotwriter.h"
+#include "frameconverter.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImageWriter>
+#include <QSettings>
+#include <QThread>
+#include <array>
+
+Q_LOGGING_CATEGORY(log_video_screenshot, "opf.core.video.screenshot")
+
+ScreenshotWriter::ScreenshotWriter(QObject *parent)
+    : QObject(parent)
+{
+    // Encoding is CPU bound, leave room for the decoder and the GUI
+    m_pool.setMaxThreadCount(qMax(2, QThread::idealThreadCount() / 2));
+}
+
+ScreenshotWriter::~ScreenshotWriter()
+{
+    m_pool.waitForDone();
+}
+
+void ScreenshotWriter::capture(const QVideoFrame &frame, const QRect &area, const QString &filePath, const Options &options)
+{
+    m_pool.start([this, frame, area, filePath, options]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        bool success = false;
+        QImage image = FrameConverter::toImage(frame, area);
+        if (image.isNull()) {
+            qCWarning(log_video_screenshot) << "Failed to convert frame for" << filePath;
+        } else {
+            QFile file(filePath);
+            if (file.open(QIODevice::WriteOnly)) {
+                success = encode(image, options, &file);
+                file.close();
+                if (!success) {
+                    file.remove();
+                }
+            } else {
+                qCWarning(log_video_screenshot) << "Failed to open" << filePath;
+            }
+        }
+
+        qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+        qCDebug(log_video_screenshot) << (success ? "Saved" : "Failed to save") << filePath
+                                      << image.size() << "in" << elapsedUs << "us";
+        emit saved(filePath, success, elapsedUs);
+    });
+}
+
+bool ScreenshotWriter::waitForDone(int msecs)
+{
+    return m_pool.waitForDone(msecs);
+}
+
+ScreenshotWriter::Options ScreenshotWriter::loadOptions()
+{
+    QSettings settings("Techxartisan", "Openterface");
+    Options options;
+    options.format = formatFromString(settings.value("screenshot/format", "png").toString());
+    options.pngLevel = qBound(0, settings.value("screenshot/pngLevel", 6).toInt(), 9);
+    options.jpegQuality = qBound(1, settings.value("screenshot/jpegQuality", 90).toInt(), 100);
+    return options;
+}
+
+QString ScreenshotWriter::suffixFor(Format format)
+{
+    switch (format) {
+    case Format::Jpeg: return "jpg";
+    case Format::Ppm: return "ppm";
+    case Format::Qoi: return "qoi";
+    case Format::Png:
+    default: return "png";
+    }
+}
+
+ScreenshotWriter::Format ScreenshotWriter::formatFromString(const QString &name)
+{
+    QString lower = name.toLower();
+    if (lower == "jpg" || lower == "jpeg") return Format::Jpeg;
+    if (lower == "ppm") return Format::Ppm;
+    if (lower == "qoi") return Format::Qoi;
+    return Format::Png;
+}
+
+QString ScreenshotWriter::formatToString(Format format)
+{
+    return suffixFor(format);
+}
+
+bool ScreenshotWriter::encode(const QImage &image, const Options &options, QIODevice *device)
+{
+    switch (options.format) {
+    case Format::Ppm:
+        return writePpm(image, device);
+    case Format::Qoi:
+        return writeQoi(image, device);
+    case Format::Jpeg: {
+        QImageWriter writer(device, "jpg");
+        writer.setQuality(options.jpegQuality);
+        return writer.write(image);
+    }
+    case Format::Png:
+    default: {
+        QImageWriter writer(device, "png");
+        // The PNG handler maps quality to a zlib level as (100 - quality) * 9 / 91
+        int level = qBound(0, options.pngLevel, 9);
+        writer.setQuality(100 - (level * 91 + 8) / 9);
+        return writer.write(image);
+    }
+    }
+}
+
+bool ScreenshotWriter::writePpm(const QImage &image, QIODevice *device)
+{
+    QImage rgb = image.format() == QImage::Format_RGB888 ? image : image.convertToFormat(QImage::Format_RGB888);
+    QByteArray header = QString("P6\n%1 %2\n255\n").arg(rgb.width()).arg(rgb.height()).toLatin1();
+    if (device->write(header) != header.size()) {
+        return false;
+    }
+    const qint64 rowBytes = qint64(rgb.width()) * 3;
+    for (int y = 0; y < rgb.height(); y++) {
+        if (device->write(reinterpret_cast<const char *>(rgb.constScanLine(y)), rowBytes) != rowBytes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * QOI ("Quite OK Image") encoder, 3 channels, sRGB.
+ * See https://qoiformat.org/qoi-specification.pdf
+ */
+bool ScreenshotWriter::writeQoi(const QImage &image, QIODevice *device)
+{
+    QImage rgb = image.format() == QImage::Format_RGB32 ? image : image.convertToFormat(QImage::Format_RGB32);
+    const int width = rgb.width();
+    const int height = rgb.height();
+
+    QByteArray out;
+    // Worst case is one QOI_OP_RGB per pixel
+    out.reserve(14 + qsizetype(width) * height * 4 + 8);
+
+    auto put32 = [&out](quint32 v) {
+        out.append(char(v >> 24));
+        out.append(char(v >> 16));
+        out.append(char(v >> 8));
+        out.append(char(v));
+    };
+    out.append("qoif", 4);
+    put32(quint32(width));
+    put32(quint32(height));
+    out.append(char(3));    // channels
+    out.append(char(0));    // sRGB with linear alpha
+
+    std::array<quint32, 64> index{};
+    quint32 prev = 0xFF000000u;
+    int run = 0;
+    const qint64 last = qint64(width) * height - 1;
+    qint64 n = 0;
+
+    for (int y = 0; y < height; y++) {
+        const quint32 *line = reinterpret_cast<const quint32 *>(rgb.constScanLine(y));
+        for (int x = 0; x < width; x++, n++) {
+            quint32 px = line[x] | 0xFF000000u;
+            if (px == prev) {
+                run++;
+                if (run == 62 || n == last) {
+                    out.append(char(0xC0 | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out.append(char(0xC0 | (run - 1)));
+                run = 0;
+            }
+
+            int r = (px >> 16) & 0xFF;
+            int g = (px >> 8) & 0xFF;
+            int b = px & 0xFF;
+            int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+            if (index[hash] == px) {
+                out.append(char(hash));
+            } else {
+                index[hash] = px;
+                signed char vr = static_cast<signed char>(r - int((prev >> 16) & 0xFF));
+                signed char vg = static_cast<signed char>(g - int((prev >> 8) & 0xFF));
+                signed char vb = static_cast<signed char>(b - int(prev & 0xFF));
+                int vgr = vr - vg;
+                int vgb = vb - vg;
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                    out.append(char(0x40 | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2)));
+                } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                    out.append(char(0x80 | (vg + 32)));
+                    out.append(char(((vgr + 8) << 4) | (vgb + 8)));
+                } else {
+                    out.append(char(0xFE));
+                    out.append(char(r));
+                    out.append(char(g));
+                    out.append(char(b));
+                }
+            }
+            prev = px;
+        }
+    }
+
+    static const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    out.append(padding, 8);
+    return device->write(out) == out.size();
+}
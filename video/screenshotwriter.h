@@ -0,0 +1,84 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef SCREENSHOTWRITER_H
+#define SCREENSHOTWRITER_H
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QThreadPool>
+#include <QVideoFrame>
+#include <QIODevice>
+#include <QLoggingCategory>
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_screenshot)
+
+/*
+ * Saves screenshots from video frames without going through QImageCapture.
+ * The frame is cropped and converted, then encoded, on a small thread pool,
+ * so the GUI thread only hands over a reference to the frame.
+ */
+class ScreenshotWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Format {
+        Png,
+        Jpeg,
+        Ppm,    // Raw binary RGB, fastest to write
+        Qoi     // Lossless, much faster to encode than PNG
+    };
+
+    struct Options {
+        Format format = Format::Png;
+        int pngLevel = 6;       // zlib level 0 - 9
+        int jpegQuality = 90;   // 1 - 100
+    };
+
+    explicit ScreenshotWriter(QObject *parent = nullptr);
+    ~ScreenshotWriter();
+
+    // Queue a screenshot of area (frame pixels, empty for the whole frame)
+    void capture(const QVideoFrame &frame, const QRect &area, const QString &filePath, const Options &options);
+    // Wait for queued screenshots, returns false on timeout
+    bool waitForDone(int msecs = -1);
+
+    static Options loadOptions();
+    static QString suffixFor(Format format);
+    static Format formatFromString(const QString &name);
+    static QString formatToString(Format format);
+
+    static bool encode(const QImage &image, const Options &options, QIODevice *device);
+    static bool writePpm(const QImage &image, QIODevice *device);
+    static bool writeQoi(const QImage &image, QIODevice *device);
+
+signals:
+    // Emitted from a pool thread
+    void saved(const QString &filePath, bool success, qint64 elapsedUs);
+
+private:
+    QThreadPool m_pool;
+};
+
+#endif // SCREENSHOTWRITER_H
@@ -3,6 +3,7 @@
 #include <QDebug>
 #include <QDir>
 #include <QTimer>
+#include <cstring>
 
 #include "ms2109.h"
 #include "../global.h"
@@ -174,10 +175,11 @@ void VideoHid::setEventCallback(StatusEventCallback* callback) {
 }
 
 QPair<QByteArray, bool> VideoHid::usbXdataRead4Byte(quint16 u16_address) {
+    QMutexLocker locker(&m_ioMutex);
     QByteArray ctrlData(9, 0); // Initialize with 9 bytes set to 0
     QByteArray result(9, 0);
 
-    ctrlData[1] = 0xB5;
+    ctrlData[1] = CMD_XDATA_READ;
     ctrlData[2] = static_cast<char>((u16_address >> 8) & 0xFF);
     ctrlData[3] = static_cast<char>(u16_address & 0xFF);
     // 0: Some devices use report ID 0 to indicate that no specific report ID is used.
@@ -200,9 +202,10 @@ QPair<QByteArray, bool> VideoHid::usbXdataRead4Byte(quint16 u16_address) {
 }
 
 bool VideoHid::usbXdataWrite4Byte(quint16 u16_address, QByteArray data) {
+    QMutexLocker locker(&m_ioMutex);
     QByteArray ctrlData(9, 0); // Initialize with 9 bytes set to 0
 
-    ctrlData[1] = 0xB6;
+    ctrlData[1] = CMD_XDATA_WRITE;
     ctrlData[2] = static_cast<char>((u16_address >> 8) & 0xFF);
     ctrlData[3] = static_cast<char>(u16_address & 0xFF);
     ctrlData.replace(4, 4, data);
@@ -212,6 +215,57 @@ bool VideoHid::usbXdataWrite4Byte(quint16 u16_address, QByteArray data) {
     return this->sendFeatureReport((uint8_t*)ctrlData.data(), ctrlData.size());
 }
 
+/*
+ * Read 4 bytes of the firmware EEPROM, the response carries the data at byte 4..7
+ */
+bool VideoHid::eepromRead4Byte(quint16 address, QByteArray &data) {
+    QMutexLocker locker(&m_ioMutex);
+    uint8_t ctrlData[9] = {0};
+    uint8_t result[9] = {0};
+
+    ctrlData[1] = CMD_EEPROM_READ;
+    ctrlData[2] = static_cast<uint8_t>((address >> 8) & 0xFF);
+    ctrlData[3] = static_cast<uint8_t>(address & 0xFF);
+
+    if (!sendFeatureReport(ctrlData, sizeof(ctrlData)) || !getFeatureReport(result, sizeof(result))) {
+        return false;
+    }
+    data = QByteArray(reinterpret_cast<const char*>(result + 4), MS2109_TRANSFER_BYTES);
+    return true;
+}
+
+/*
+ * Write up to 4 bytes of the firmware EEPROM. Unlike usbXdataWrite4Byte this does not
+ * log every report, a full image is tens of thousands of them.
+ */
+bool VideoHid::eepromWrite4Byte(quint16 address, const QByteArray &data) {
+    QMutexLocker locker(&m_ioMutex);
+    uint8_t ctrlData[9] = {0};
+
+    ctrlData[1] = CMD_EEPROM_WRITE;
+    ctrlData[2] = static_cast<uint8_t>((address >> 8) & 0xFF);
+    ctrlData[3] = static_cast<uint8_t>(address & 0xFF);
+    memcpy(ctrlData + 4, data.constData(), qMin<int>(data.size(), MS2109_TRANSFER_BYTES));
+
+    return sendFeatureReport(ctrlData, sizeof(ctrlData));
+}
+
+/*
+ * Hold the HID device open so a bulk transfer does not pay the
+ * device lookup and open for every single report
+ */
+bool VideoHid::beginTransfer() {
+    QMutexLocker locker(&m_ioMutex);
+    return openHIDDevice();
+}
+
+void VideoHid::endTransfer() {
+#ifdef _WIN32
+    QMutexLocker locker(&m_ioMutex);
+    closeHIDDevice();
+#endif
+}
+
 bool VideoHid::getFeatureReport(uint8_t* buffer, size_t bufferLength) {
 #ifdef _WIN32
     return this->getFeatureReportWindows(buffer, bufferLength);
@@ -281,8 +335,34 @@ std::wstring VideoHid::getHIDDevicePath() {
     return L""; // Device not found
 }
 
+// Open the HID device and cache the handle until closeHIDDevice
+bool VideoHid::openHIDDevice() {
+    if (m_deviceHandle == INVALID_HANDLE_VALUE) {
+        m_deviceHandle = CreateFileW(getHIDDevicePath().c_str(),
+                                     GENERIC_READ | GENERIC_WRITE,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                     NULL,
+                                     OPEN_EXISTING,
+                                     0,
+                                     NULL);
+        if (m_deviceHandle == INVALID_HANDLE_VALUE) {
+            qDebug() << "Failed to open HID device handle.";
+            return false;
+        }
+    }
+    return true;
+}
+
+void VideoHid::closeHIDDevice() {
+    if (m_deviceHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_deviceHandle);
+        m_deviceHandle = INVALID_HANDLE_VALUE;
+    }
+}
+
 bool VideoHid::sendFeatureReportWindows(BYTE* reportBuffer, DWORD bufferSize) {
-    HANDLE deviceHandle = CreateFileW(getHIDDevicePath().c_str(),
+    bool cached = m_deviceHandle != INVALID_HANDLE_VALUE;
+    HANDLE deviceHandle = cached ? m_deviceHandle : CreateFileW(getHIDDevicePath().c_str(),
                                       GENERIC_READ | GENERIC_WRITE,
                                       FILE_SHARE_READ | FILE_SHARE_WRITE,
                                       NULL,
@@ -297,7 +377,7 @@ bool VideoHid::sendFeatureReportWindows(BYTE* reportBuffer, DWORD bufferSize) {
     // Send the Set Feature Report request
     BOOL result = HidD_SetFeature(deviceHandle, reportBuffer, bufferSize);
 
-    CloseHandle(deviceHandle); // Always close the handle when done
+    if (!cached) CloseHandle(deviceHandle); // Close the handle unless a transfer holds it open
 
     if (!result) {
         qDebug() << "Failed to send feature report.";
@@ -307,8 +387,8 @@ bool VideoHid::sendFeatureReportWindows(BYTE* reportBuffer, DWORD bufferSize) {
 }
 
 bool VideoHid::getFeatureReportWindows(BYTE* reportBuffer, DWORD bufferSize) {
-    // Assuming devicePath is a member variable containing the device path
-    HANDLE deviceHandle = CreateFileW(getHIDDevicePath().c_str(),
+    bool cached = m_deviceHandle != INVALID_HANDLE_VALUE;
+    HANDLE deviceHandle = cached ? m_deviceHandle : CreateFileW(getHIDDevicePath().c_str(),
                                       GENERIC_READ | GENERIC_WRITE,
                                       FILE_SHARE_READ | FILE_SHARE_WRITE,
                                       NULL,
@@ -327,8 +407,8 @@ bool VideoHid::getFeatureReportWindows(BYTE* reportBuffer, DWORD bufferSize) {
         qDebug() << "Failed to get feature report.";
     }
 
-    // Close the device handle
-    CloseHandle(deviceHandle);
+    // Close the device handle unless a transfer holds it open
+    if (!cached) CloseHandle(deviceHandle);
 
     return result;
 }
@@ -3,15 +3,17 @@
 
 #include <QObject>
 #include <QTimer>
+#include <QMutex>
 
 #include "../ui/statusevents.h"
+#include "eepromaccess.h"
 #ifdef _WIN32
 #include <windows.h> 
 #elif __linux__
 #include <linux/hid.h>
 #endif
 
-class VideoHid : public QObject
+class VideoHid : public QObject, public EepromAccess
 {
 public:
     static VideoHid& getInstance()
@@ -50,6 +52,11 @@ public:
     bool openHIDDevice();
     void closeHIDDevice();
 
+    bool eepromRead4Byte(quint16 address, QByteArray &data) override;
+    bool eepromWrite4Byte(quint16 address, const QByteArray &data) override;
+    bool beginTransfer() override;
+    void endTransfer() override;
+
 private:
     explicit VideoHid(QObject *parent = nullptr);
 
@@ -66,9 +73,13 @@ private:
     bool getFeatureReport(uint8_t* buffer, size_t bufferLength);
     bool sendFeatureReport(uint8_t* buffer, size_t bufferLength);
 
+    // Serializes the report request/response pairs between the status timer and bulk transfers
+    QMutex m_ioMutex;
+
 #ifdef _WIN32
     std::wstring m_cachedDevicePath;
     std::wstring getHIDDevicePath();
+    HANDLE m_deviceHandle = INVALID_HANDLE_VALUE; // Only held open during a bulk transfer
     bool sendFeatureReportWindows(uint8_t* reportBuffer, DWORD bufferSize);
     bool getFeatureReportWindows(uint8_t* reportBuffer, DWORD bufferSize);
 #elif __linux__
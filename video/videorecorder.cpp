@@ -0,0 +1,294 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#include "videorecorder.h"
+#include "aviwriter.h"
+#include "frameconverter.h"
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QDir>
+#include <QImageWriter>
+#include <QSettings>
+#include <QDebug>
+#include <vector>
+
+Q_LOGGING_CATEGORY(log_video_recorder, "opf.core.video.recorder")
+
+VideoRecorder::VideoRecorder(QObject *parent)
+    : QObject(parent)
+{
+    m_thread.setObjectName("VideoRecorder");
+    m_savePool.setMaxThreadCount(1);
+}
+
+VideoRecorder::~VideoRecorder()
+{
+    stop();
+    m_savePool.waitForDone();
+}
+
+VideoRecorder::Options VideoRecorder::loadOptions()
+{
+    QSettings settings("Techxartisan", "Openterface");
+    Options options;
+    options.prerollSeconds = qBound(0, settings.value("recording/prerollSeconds", 30).toInt(), 600);
+    options.maxMegabytes = qBound(16, settings.value("recording/maxMegabytes", 200).toInt(), 4096);
+    options.fps = qBound(1, settings.value("recording/fps", 15).toInt(), 60);
+    options.quality = qBound(1, settings.value("recording/quality", 70).toInt(), 100);
+    options.segmentSeconds = qBound(10, settings.value("recording/segmentSeconds", 300).toInt(), 3600);
+    return options;
+}
+
+void VideoRecorder::start(const Options &options)
+{
+    if (isRunning()) {
+        return;
+    }
+    m_options = options;
+    m_lastEncodedUs = 0;
+    m_worker = new QObject();
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.start(QThread::LowPriority);
+    m_subscription = FrameDistributor::getInstance().subscribe(m_worker, [this](const FrameDistributor::Frame &frame) {
+        process(frame);
+    });
+    qCDebug(log_video_recorder) << "Recorder started, pre-roll" << m_options.prerollSeconds << "s at" << m_options.fps << "fps";
+}
+
+void VideoRecorder::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    FrameDistributor::getInstance().unsubscribe(m_subscription);
+    m_subscription = 0;
+    stopSegments();
+    m_thread.quit();
+    m_thread.wait();
+    m_worker = nullptr;
+
+    QMutexLocker locker(&m_ringMutex);
+    m_ring.clear();
+    m_ringBytes = 0;
+}
+
+void VideoRecorder::process(const FrameDistributor::Frame &frame)
+{
+    bool segments = m_segmentsActive.load();
+    if (!segments && m_segment) {
+        closeSegment();
+    }
+    if (m_options.prerollSeconds == 0 && !segments) {
+        return;
+    }
+    // Frame rate cap, the distributor already drops frames while we are busy
+    if (m_lastEncodedUs != 0 && frame.timestampUs - m_lastEncodedUs < 1000000 / m_options.fps) {
+        return;
+    }
+
+    QImage image = FrameConverter::toImage(frame.frame);
+    if (image.isNull()) {
+        return;
+    }
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, "jpg");
+    writer.setQuality(m_options.quality);
+    if (!writer.write(image)) {
+        qCWarning(log_video_recorder) << "JPEG encoding failed:" << writer.errorString();
+        return;
+    }
+    m_lastEncodedUs = frame.timestampUs;
+    m_encodedFrames++;
+
+    EncodedFrame encoded{jpeg, frame.timestampUs, image.size()};
+    if (m_options.prerollSeconds > 0) {
+        appendToRing(encoded);
+    }
+    if (segments) {
+        writeSegment(encoded);
+    }
+}
+
+void VideoRecorder::appendToRing(const EncodedFrame &encoded)
+{
+    QMutexLocker locker(&m_ringMutex);
+    m_ring.push_back(encoded);
+    m_ringBytes += encoded.jpeg.size();
+
+    const qint64 maxBytes = qint64(m_options.maxMegabytes) * 1024 * 1024;
+    const qint64 oldestUs = encoded.timestampUs - qint64(m_options.prerollSeconds) * 1000000;
+    while (m_ring.size() > 1 && (m_ring.front().timestampUs < oldestUs || m_ringBytes > maxBytes)) {
+        m_ringBytes -= m_ring.front().jpeg.size();
+        m_ring.pop_front();
+    }
+}
+
+qint64 VideoRecorder::ringBytes() const
+{
+    QMutexLocker locker(&m_ringMutex);
+    return m_ringBytes;
+}
+
+int VideoRecorder::ringFrames() const
+{
+    QMutexLocker locker(&m_ringMutex);
+    return static_cast<int>(m_ring.size());
+}
+
+double VideoRecorder::ringSeconds() const
+{
+    QMutexLocker locker(&m_ringMutex);
+    return m_ring.empty() ? 0.0 : (m_ring.back().timestampUs - m_ring.front().timestampUs) / 1e6;
+}
+
+double VideoRecorder::averageFps(int frames, qint64 firstUs, qint64 lastUs)
+{
+    return frames > 1 && lastUs > firstUs ? (frames - 1) * 1e6 / (lastUs - firstUs) : 0.0;
+}
+
+void VideoRecorder::saveLast(int seconds, const QString &filePath)
+{
+    // Taking the frames only copies references, the JPEG data is shared
+    std::vector<EncodedFrame> frames;
+    {
+        QMutexLocker locker(&m_ringMutex);
+        if (!m_ring.empty()) {
+            const qint64 newestUs = m_ring.back().timestampUs;
+            const QSize size = m_ring.back().size;
+            for (const EncodedFrame &encoded : m_ring) {
+                // Frames from before a resolution change cannot go into the same stream
+                if (encoded.timestampUs >= newestUs - qint64(seconds) * 1000000 && encoded.size == size) {
+                    frames.push_back(encoded);
+                }
+            }
+        }
+    }
+    // A large ring can hold more than one AVI file, the newest frames are kept
+    size_t first = frames.size();
+    qint64 bytes = 0;
+    while (first > 0 && AviWriter::fileSize(int(frames.size() - first + 1), bytes + frames[first - 1].jpeg.size())
+                            <= AviWriter::MAX_FILE_BYTES) {
+        first--;
+        bytes += frames[first].jpeg.size();
+    }
+    frames.erase(frames.begin(), frames.begin() + first);
+    if (frames.empty()) {
+        qCWarning(log_video_recorder) << "Nothing recorded to save";
+        emit saved(filePath, false, 0);
+        return;
+    }
+
+    m_savePool.start([this, frames = std::move(frames), filePath]() {
+        AviWriter writer;
+        bool ok = writer.open(filePath, frames.front().size);
+        for (size_t i = 0; ok && i < frames.size(); i++) {
+            ok = writer.addFrame(frames[i].jpeg);
+        }
+        ok = writer.close(averageFps(static_cast<int>(frames.size()), frames.front().timestampUs,
+                                     frames.back().timestampUs)) && ok;
+        if (ok) {
+            qCDebug(log_video_recorder) << "Saved" << frames.size() << "frames to" << filePath;
+        } else {
+            qCWarning(log_video_recorder) << "Failed to save" << filePath << writer.errorString();
+        }
+        emit saved(filePath, ok, static_cast<int>(frames.size()));
+    });
+}
+
+void VideoRecorder::startSegments(const QString &folder)
+{
+    if (!QDir().mkpath(folder)) {
+        qCWarning(log_video_recorder) << "Failed to create" << folder;
+        return;
+    }
+    if (m_worker) {
+        QMetaObject::invokeMethod(m_worker, [this, folder]() { m_segmentFolder = folder; }, Qt::BlockingQueuedConnection);
+    } else {
+        // No recorder thread yet, it sees the folder once start() runs it
+        m_segmentFolder = folder;
+    }
+    m_segmentsActive = true;
+}
+
+void VideoRecorder::stopSegments()
+{
+    if (!m_segmentsActive.exchange(false)) {
+        return;
+    }
+    // Finish the open file now instead of on the next frame, which may never come
+    if (m_worker) {
+        QMetaObject::invokeMethod(m_worker, [this]() { closeSegment(); }, Qt::BlockingQueuedConnection);
+    }
+}
+
+void VideoRecorder::writeSegment(const EncodedFrame &encoded)
+{
+    bool full = m_segment && (encoded.timestampUs - m_segmentFirstUs >= qint64(m_options.segmentSeconds) * 1000000
+                              || !m_segment->canAdd(encoded.jpeg.size()));
+    if (m_segment && (full || encoded.size != m_segmentSize)) {
+        closeSegment();
+    }
+    if (!m_segment) {
+        openSegment(encoded.size, encoded.timestampUs);
+        if (!m_segment) {
+            return;
+        }
+    }
+    if (!m_segment->addFrame(encoded.jpeg)) {
+        qCWarning(log_video_recorder) << "Failed to write" << m_segment->fileName();
+        closeSegment();
+        return;
+    }
+    m_segmentLastUs = encoded.timestampUs;
+}
+
+void VideoRecorder::openSegment(const QSize &size, qint64 timestampUs)
+{
+    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss_zzz");
+    QString filePath = m_segmentFolder + "/" + timestamp + ".avi";
+    m_segment = std::make_unique<AviWriter>();
+    if (!m_segment->open(filePath, size)) {
+        qCWarning(log_video_recorder) << "Failed to open" << filePath << m_segment->errorString();
+        m_segment.reset();
+        return;
+    }
+    m_segmentSize = size;
+    m_segmentFirstUs = timestampUs;
+    m_segmentLastUs = timestampUs;
+    emit segmentStarted(filePath, timestampUs);
+}
+
+void VideoRecorder::closeSegment()
+{
+    if (!m_segment) {
+        return;
+    }
+    QString filePath = m_segment->fileName();
+    bool ok = m_segment->close(averageFps(m_segment->frameCount(), m_segmentFirstUs, m_segmentLastUs));
+    qCDebug(log_video_recorder) << "Closed segment" << filePath << m_segment->frameCount() << "frames";
+    m_segment.reset();
+    emit segmentFinished(filePath, ok);
+}
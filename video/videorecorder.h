@@ -0,0 +1,132 @@
+/*
+* ========================================================================== *
+*                                                                            *
+*    This file is part of the Openterface Mini KVM App QT version            *
+*                                                                            *
+*    Copyright (C) 2024   <info@openterface.com>                             *
+*                                                                            *
+*    This program is free software: you can redistribute it and/or modify    *
+*    it under the terms of the GNU General Public License as published by    *
+*    the Free Software Foundation version 3.                                 *
+*                                                                            *
+*    This program is distributed in the hope that it will be useful, but     *
+*    WITHOUT ANY WARRANTY; without even the implied warranty of              *
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU        *
+*    General Public License for more details.                                *
+*                                                                            *
+*    You should have received a copy of the GNU General Public License       *
+*    along with this program. If not, see <http://www.gnu.org/licenses/>.    *
+*                                                                            *
+* ========================================================================== *
+*/
+
+#ifndef VIDEORECORDER_H
+#define VIDEORECORDER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QMutex>
+#include <QSize>
+#include <QThread>
+#include <QThreadPool>
+#include <QLoggingCategory>
+#include <atomic>
+#include <deque>
+#include <memory>
+
+#include "framedistributor.h"
+
+Q_DECLARE_LOGGING_CATEGORY(log_video_recorder)
+
+class AviWriter;
+
+/*
+ * Records the captured video as MJPEG.
+ *
+ * Frames from the frame distributor are encoded to JPEG on the recorder
+ * thread at a capped frame rate. The encoded frames of the last few seconds
+ * are kept in a ring bounded by both duration and memory, so saveLast() only
+ * has to write out data that is already compressed. Continuous recording
+ * writes the same encoded frames into AVI files of a fixed length, a file
+ * that reaches the 1 GB AVI limit first is closed early.
+ */
+class VideoRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        int prerollSeconds = 30;    // 0 disables the ring
+        int maxMegabytes = 200;
+        int fps = 15;
+        int quality = 70;           // JPEG quality 1 - 100
+        int segmentSeconds = 300;
+    };
+
+    explicit VideoRecorder(QObject *parent = nullptr);
+    ~VideoRecorder();
+
+    void start(const Options &options);
+    void stop();
+    bool isRunning() const { return m_subscription != 0; }
+
+    // Write the last seconds of the ring to an AVI file on a pool thread
+    void saveLast(int seconds, const QString &filePath);
+
+    // Continuous recording into "<folder>/<timestamp>.avi" files
+    void startSegments(const QString &folder);
+    void stopSegments();
+    bool isRecordingSegments() const { return m_segmentsActive.load(); }
+
+    qint64 ringBytes() const;
+    int ringFrames() const;
+    double ringSeconds() const;
+    quint64 encodedFrames() const { return m_encodedFrames.load(); }
+
+    static Options loadOptions();
+
+signals:
+    // Emitted from a pool thread
+    void saved(const QString &filePath, bool success, int frames);
+    // Emitted from the recorder thread
+    // firstFrameUs is the MediaClock time of the segment's first frame
+    void segmentStarted(const QString &filePath, qint64 firstFrameUs);
+    void segmentFinished(const QString &filePath, bool success);
+
+private:
+    struct EncodedFrame {
+        QByteArray jpeg;
+        qint64 timestampUs;
+        QSize size;
+    };
+
+    void process(const FrameDistributor::Frame &frame);
+    void appendToRing(const EncodedFrame &encoded);
+    void writeSegment(const EncodedFrame &encoded);
+    void openSegment(const QSize &size, qint64 timestampUs);
+    void closeSegment();
+    static double averageFps(int frames, qint64 firstUs, qint64 lastUs);
+
+    Options m_options;
+    QThread m_thread;
+    QObject *m_worker = nullptr;
+    int m_subscription = 0;
+    QThreadPool m_savePool;
+
+    mutable QMutex m_ringMutex;
+    std::deque<EncodedFrame> m_ring;
+    qint64 m_ringBytes = 0;
+
+    // Only touched from the recorder thread
+    qint64 m_lastEncodedUs = 0;
+    QString m_segmentFolder;
+    std::unique_ptr<AviWriter> m_segment;
+    QSize m_segmentSize;
+    qint64 m_segmentFirstUs = 0;
+    qint64 m_segmentLastUs = 0;
+
+    std::atomic<bool> m_segmentsActive{false};
+    std::atomic<quint64> m_encodedFrames{0};
+};
+
+#endif // VIDEORECORDER_H